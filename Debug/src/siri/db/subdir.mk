@@ -3,10 +3,13 @@ C_SRCS += \
 ../src/siri/db/access.c \
 ../src/siri/db/aggregate.c \
 ../src/siri/db/auth.c \
+../src/siri/db/batch.c \
 ../src/siri/db/buffer.c \
+../src/siri/db/cursor.c \
 ../src/siri/db/db.c \
 ../src/siri/db/ffile.c \
 ../src/siri/db/fifo.c \
+../src/siri/db/flush.c \
 ../src/siri/db/forward.c \
 ../src/siri/db/group.c \
 ../src/siri/db/groups.c \
@@ -16,6 +19,7 @@ C_SRCS += \
 ../src/siri/db/lookup.c \
 ../src/siri/db/median.c \
 ../src/siri/db/misc.c \
+../src/siri/db/mselect.c \
 ../src/siri/db/nodes.c \
 ../src/siri/db/pcache.c \
 ../src/siri/db/points.c \
@@ -28,17 +32,21 @@ C_SRCS += \
 ../src/siri/db/re.c \
 ../src/siri/db/reindex.c \
 ../src/siri/db/replicate.c \
+../src/siri/db/scan.c \
 ../src/siri/db/series.c \
 ../src/siri/db/server.c \
 ../src/siri/db/servers.c \
 ../src/siri/db/shard.c \
 ../src/siri/db/shards.c \
+../src/siri/db/share.c \
 ../src/siri/db/sset.c \
+../src/siri/db/subscriptions.c \
 ../src/siri/db/tag.c \
 ../src/siri/db/tags.c \
 ../src/siri/db/tasks.c \
 ../src/siri/db/tee.c \
 ../src/siri/db/time.c \
+../src/siri/db/topk.c \
 ../src/siri/db/user.c \
 ../src/siri/db/users.c \
 ../src/siri/db/variance.c \
@@ -48,10 +56,13 @@ OBJS += \
 ./src/siri/db/access.o \
 ./src/siri/db/aggregate.o \
 ./src/siri/db/auth.o \
+./src/siri/db/batch.o \
 ./src/siri/db/buffer.o \
+./src/siri/db/cursor.o \
 ./src/siri/db/db.o \
 ./src/siri/db/ffile.o \
 ./src/siri/db/fifo.o \
+./src/siri/db/flush.o \
 ./src/siri/db/forward.o \
 ./src/siri/db/group.o \
 ./src/siri/db/groups.o \
@@ -61,6 +72,7 @@ OBJS += \
 ./src/siri/db/lookup.o \
 ./src/siri/db/median.o \
 ./src/siri/db/misc.o \
+./src/siri/db/mselect.o \
 ./src/siri/db/nodes.o \
 ./src/siri/db/pcache.o \
 ./src/siri/db/points.o \
@@ -73,17 +85,21 @@ OBJS += \
 ./src/siri/db/re.o \
 ./src/siri/db/reindex.o \
 ./src/siri/db/replicate.o \
+./src/siri/db/scan.o \
 ./src/siri/db/series.o \
 ./src/siri/db/server.o \
 ./src/siri/db/servers.o \
 ./src/siri/db/shard.o \
 ./src/siri/db/shards.o \
+./src/siri/db/share.o \
 ./src/siri/db/sset.o \
+./src/siri/db/subscriptions.o \
 ./src/siri/db/tag.o \
 ./src/siri/db/tags.o \
 ./src/siri/db/tasks.o \
 ./src/siri/db/tee.o \
 ./src/siri/db/time.o \
+./src/siri/db/topk.o \
 ./src/siri/db/user.o \
 ./src/siri/db/users.o \
 ./src/siri/db/variance.o \
@@ -93,10 +109,13 @@ C_DEPS += \
 ./src/siri/db/access.d \
 ./src/siri/db/aggregate.d \
 ./src/siri/db/auth.d \
+./src/siri/db/batch.d \
 ./src/siri/db/buffer.d \
+./src/siri/db/cursor.d \
 ./src/siri/db/db.d \
 ./src/siri/db/ffile.d \
 ./src/siri/db/fifo.d \
+./src/siri/db/flush.d \
 ./src/siri/db/forward.d \
 ./src/siri/db/group.d \
 ./src/siri/db/groups.d \
@@ -106,6 +125,7 @@ C_DEPS += \
 ./src/siri/db/lookup.d \
 ./src/siri/db/median.d \
 ./src/siri/db/misc.d \
+./src/siri/db/mselect.d \
 ./src/siri/db/nodes.d \
 ./src/siri/db/pcache.d \
 ./src/siri/db/points.d \
@@ -118,17 +138,21 @@ C_DEPS += \
 ./src/siri/db/re.d \
 ./src/siri/db/reindex.d \
 ./src/siri/db/replicate.d \
+./src/siri/db/scan.d \
 ./src/siri/db/series.d \
 ./src/siri/db/server.d \
 ./src/siri/db/servers.d \
 ./src/siri/db/shard.d \
 ./src/siri/db/shards.d \
+./src/siri/db/share.d \
 ./src/siri/db/sset.d \
+./src/siri/db/subscriptions.d \
 ./src/siri/db/tag.d \
 ./src/siri/db/tags.d \
 ./src/siri/db/tasks.d \
 ./src/siri/db/tee.d \
 ./src/siri/db/time.d \
+./src/siri/db/topk.d \
 ./src/siri/db/user.d \
 ./src/siri/db/users.d \
 ./src/siri/db/variance.d \
@@ -14,6 +14,7 @@ src/argparse \
 src/base64 \
 src/cexpr \
 src/cfgparser \
+src/crc32c \
 src/ctree \
 src/expr \
 src/imap \
@@ -1,6 +1,7 @@
 # Add inputs and outputs from these tool invocations to the build variables
 C_SRCS += \
 ../src/siri/api.c \
+../src/siri/auth.c \
 ../src/siri/async.c \
 ../src/siri/backup.c \
 ../src/siri/buffersync.c \
@@ -8,12 +9,15 @@ C_SRCS += \
 ../src/siri/evars.c \
 ../src/siri/health.c \
 ../src/siri/heartbeat.c \
+../src/siri/mem.c \
 ../src/siri/optimize.c \
+../src/siri/scrub.c \
 ../src/siri/siri.c \
 ../src/siri/version.c
 
 OBJS += \
 ./src/siri/api.o \
+./src/siri/auth.o \
 ./src/siri/async.o \
 ./src/siri/backup.o \
 ./src/siri/buffersync.o \
@@ -21,12 +25,15 @@ OBJS += \
 ./src/siri/evars.o \
 ./src/siri/health.o \
 ./src/siri/heartbeat.o \
+./src/siri/mem.o \
 ./src/siri/optimize.o \
+./src/siri/scrub.o \
 ./src/siri/siri.o \
 ./src/siri/version.o
 
 C_DEPS += \
 ./src/siri/api.d \
+./src/siri/auth.d \
 ./src/siri/async.d \
 ./src/siri/backup.d \
 ./src/siri/buffersync.d \
@@ -34,7 +41,9 @@ C_DEPS += \
 ./src/siri/evars.d \
 ./src/siri/health.d \
 ./src/siri/heartbeat.d \
+./src/siri/mem.d \
 ./src/siri/optimize.d \
+./src/siri/scrub.d \
 ./src/siri/siri.d \
 ./src/siri/version.d
 
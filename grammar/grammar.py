@@ -59,6 +59,8 @@ class SiriGrammar(Grammar):
     k_buffer_size = Keyword('buffer_size')
     k_buffer_path = Keyword('buffer_path')
     k_between = Keyword('between')
+    k_bottom = Keyword('bottom')
+    k_columnar = Keyword('columnar')
     k_count = Keyword('count')
     k_create = Keyword('create')
     k_critical = Keyword('critical')
@@ -68,12 +70,14 @@ class SiriGrammar(Grammar):
     k_debug = Keyword('debug')
     k_derivative = Keyword('derivative')
     k_difference = Keyword('difference')
+    k_downsample = Keyword('downsample')
     k_drop = Keyword('drop')
     k_drop_threshold = Keyword('drop_threshold')
     k_duration_log = Keyword('duration_log')
     k_duration_num = Keyword('duration_num')
     k_end = Keyword('end')
     k_error = Keyword('error')
+    k_ewma = Keyword('ewma')
     k_expiration_log = Keyword('expiration_log')
     k_expiration_num = Keyword('expiration_num')
     k_expression = Keyword('expression')
@@ -83,6 +87,7 @@ class SiriGrammar(Grammar):
     k_first = Keyword('first')
     k_float = Keyword('float')
     k_for = Keyword('for')
+    k_format = Keyword('format')
     k_from = Keyword('from')
     k_full = Keyword('full')
     k_grant = Keyword('grant')
@@ -116,10 +121,21 @@ class SiriGrammar(Grammar):
     k_median = Keyword('median')
     k_median_high = Keyword('median_high')
     k_median_low = Keyword('median_low')
+    k_mem_buffers = Keyword('mem_buffers')
+    k_mem_caches = Keyword('mem_caches')
+    k_mem_groups = Keyword('mem_groups')
+    k_mem_index = Keyword('mem_index')
+    k_mem_names = Keyword('mem_names')
+    k_mem_network = Keyword('mem_network')
+    k_mem_queries = Keyword('mem_queries')
+    k_mem_series = Keyword('mem_series')
+    k_mem_tags = Keyword('mem_tags')
     k_mem_usage = Keyword('mem_usage')
     k_merge = Keyword('merge')
     k_min = Keyword('min')
+    k_minmax = Keyword('minmax')
     k_modify = Keyword('modify')
+    k_moving = Keyword('moving')
     k_name = Keyword('name')
     k_nan = Keyword('nan')
     k_ninf = Sequence('-', k_inf)
@@ -171,6 +187,7 @@ class SiriGrammar(Grammar):
     k_timeval = Keyword('timeval')
     k_timezone = Keyword('timezone')
     k_to = Keyword('to')
+    k_top = Keyword('top')
     k_true = Keyword('true')
     k_type = Keyword('type')
     k_union = Choice(
@@ -567,6 +584,34 @@ class SiriGrammar(Grammar):
             k_last,
             most_greedy=False),
         ')')
+    f_moving = Sequence(
+        k_moving,
+        '(',
+        time_expr,
+        ',',
+        Choice(
+            k_mean,
+            k_sum,
+            k_min,
+            k_max,
+            k_count,
+            k_variance,
+            k_pvariance,
+            k_stddev,
+            k_derivative,
+            most_greedy=False),
+        ')')
+    f_ewma = Sequence(
+        k_ewma,
+        '(',
+        time_expr,
+        ')')
+    f_downsample = Sequence(
+        k_downsample,
+        '(',
+        int_expr,
+        Optional(Sequence(',', k_minmax)),
+        ')')
 
     aggregate_functions = List(Choice(
         f_all,
@@ -588,6 +633,9 @@ class SiriGrammar(Grammar):
         f_interval,
         f_difference,
         f_derivative,
+        f_moving,
+        f_ewma,
+        f_downsample,
         f_filter,
         f_points,
         most_greedy=False), '=>', 1)
@@ -605,11 +653,42 @@ class SiriGrammar(Grammar):
         string,
         Optional(Sequence(k_using, aggregate_functions)))
 
+    top_expr = Sequence(
+        Choice(k_top, k_bottom, most_greedy=False),
+        '(',
+        int_expr,
+        ',',
+        Choice(
+            k_mean,
+            k_median,
+            k_median_high,
+            k_median_low,
+            k_sum,
+            k_min,
+            k_max,
+            k_count,
+            k_variance,
+            k_pvariance,
+            k_stddev,
+            k_first,
+            k_last,
+            most_greedy=False),
+        ')')
+
     set_address = Sequence(k_set, k_address, string)
+    tee_filter = Sequence(k_filter, Choice(
+        r_regex,
+        Sequence(k_tag, r_grave_str),
+        Sequence(k_group, r_grave_str),
+        most_greedy=False))
+    tee_format = Sequence(k_format, Choice(
+        k_insert,
+        k_columnar,
+        most_greedy=False))
     set_tee_pipe_name = Sequence(k_set, k_tee_pipe_name, Choice(
         k_false,
         string,
-        most_greedy=False))
+        most_greedy=False), Optional(tee_filter), Optional(tee_format))
     set_backup_mode = Sequence(k_set, k_backup_mode, _boolean)
     set_drop_threshold = Sequence(k_set, k_drop_threshold, r_float)
     set_expression = Sequence(k_set, k_expression, r_regex)
@@ -820,7 +899,10 @@ class SiriGrammar(Grammar):
             between_expr,
             before_expr,
             most_greedy=False)),
-        Optional(merge_as))
+        Optional(Choice(
+            merge_as,
+            top_expr,
+            most_greedy=False)))
 
     show_stmt = Sequence(k_show, List(Choice(
         k_active_handles,
@@ -842,6 +924,15 @@ class SiriGrammar(Grammar):
         k_list_limit,
         k_log_level,
         k_max_open_files,
+        k_mem_buffers,
+        k_mem_caches,
+        k_mem_groups,
+        k_mem_index,
+        k_mem_names,
+        k_mem_network,
+        k_mem_queries,
+        k_mem_series,
+        k_mem_tags,
         k_mem_usage,
         k_open_files,
         k_pool,
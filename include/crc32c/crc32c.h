@@ -0,0 +1,12 @@
+/*
+ * crc32c.h - CRC-32C (Castagnoli) checksum.
+ */
+#ifndef CRC32C_H_
+#define CRC32C_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+uint32_t crc32c(uint32_t crc, const void * data, size_t n);
+
+#endif  /* CRC32C_H_ */
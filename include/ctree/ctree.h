@@ -37,6 +37,7 @@ void * ct_pop(ct_t * ct, const char * key);
 int ct_items(ct_t * ct, ct_item_cb cb, void * args);
 int ct_values(ct_t * ct, ct_val_cb cb, void * args);
 void ct_valuesn(ct_t * ct, size_t * n, ct_val_cb cb, void * args);
+size_t ct_mem_usage(ct_t * ct);
 
 struct ct_node_s
 {
@@ -47,6 +47,22 @@ void imap_symmetric_difference_ref(
         imap_t * dest,
         imap_t * imap,
         imap_free_cb decref_cb);
+void imap_union_src(
+        imap_t * dest,
+        imap_t * imap,
+        imap_free_cb decref_cb);
+void imap_intersection_src(
+        imap_t * dest,
+        imap_t * imap,
+        imap_free_cb decref_cb);
+void imap_difference_src(
+        imap_t * dest,
+        imap_t * imap,
+        imap_free_cb decref_cb);
+void imap_symmetric_difference_src(
+        imap_t * dest,
+        imap_t * imap,
+        imap_free_cb decref_cb);
 
 
 struct imap_node_s
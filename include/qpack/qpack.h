@@ -11,6 +11,9 @@
 
 #define QP_SUGGESTED_SIZE 65536
 
+/* maximum size in bytes for a packed integer or double */
+#define QP_MAX_NUM_SZ 9
+
 typedef enum
 {
     /*
@@ -112,7 +115,12 @@ struct qp_packer_s
 qp_packer_t * qp_packer_new(size_t alloc_size);
 void qp_packer_free(qp_packer_t * packer);
 int qp_packer_extend(qp_packer_t * packer, qp_packer_t * source);
+int qp_packer_reserve(qp_packer_t * packer, size_t n);
 int qp_packer_extend_fu(qp_packer_t * packer, qp_unpacker_t * unpacker);
+int qp_packer_extend_bytes(
+        qp_packer_t * packer,
+        const unsigned char * pt,
+        size_t n);
 
 /* unpacker: create and destroy functions */
 void qp_unpacker_init(qp_unpacker_t * unpacker, unsigned char * pt, size_t len);
@@ -123,6 +131,7 @@ qp_unpacker_t * qp_unpacker_ff(const char * fn);
 qp_types_t qp_next(qp_unpacker_t * unpacker, qp_obj_t * qp_obj);
 qp_types_t qp_current(qp_unpacker_t * unpacker);
 qp_types_t qp_skip_next(qp_unpacker_t * unpacker);
+int qp_next_point(qp_unpacker_t * unpacker, int64_t * ts, qp_obj_t * qp_val);
 
 /* print function */
 void qp_print(unsigned char * pt, size_t len);
@@ -187,6 +196,79 @@ int qp_add_type(qp_packer_t * packer, qp_types_t tp);
 int qp_add_fmt(qp_packer_t * packer, const char * fmt, ...);
 int qp_add_fmt_safe(qp_packer_t * packer, const char * fmt, ...);
 
+/*
+ * Unchecked add functions. These functions do not resize the packer buffer
+ * so qp_packer_reserve() must be used to make sure enough space is available.
+ */
+static inline void qp_put_type(qp_packer_t * packer, qp_types_t tp)
+{
+    packer->buffer[packer->len++] = tp;
+}
+
+static inline void qp_put_int64(qp_packer_t * packer, int64_t integer)
+{
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+
+    if ((i8 = (int8_t) integer) == integer)
+    {
+        if (i8 >= 0 && i8 < 64)
+        {
+            packer->buffer[packer->len++] = i8;
+        }
+        else if (i8 >= -60 && i8 < 0)
+        {
+            packer->buffer[packer->len++] = 63 - i8;
+        }
+        else
+        {
+            packer->buffer[packer->len++] = QP_INT8;
+            packer->buffer[packer->len++] = i8;
+        }
+    }
+    else if ((i16 = (int16_t) integer) == integer)
+    {
+        packer->buffer[packer->len++] = QP_INT16;
+        memcpy(packer->buffer + packer->len, &i16, sizeof(int16_t));
+        packer->len += sizeof(int16_t);
+    }
+    else if ((i32 = (int32_t) integer) == integer)
+    {
+        packer->buffer[packer->len++] = QP_INT32;
+        memcpy(packer->buffer + packer->len, &i32, sizeof(int32_t));
+        packer->len += sizeof(int32_t);
+    }
+    else
+    {
+        packer->buffer[packer->len++] = QP_INT64;
+        memcpy(packer->buffer + packer->len, &integer, sizeof(int64_t));
+        packer->len += sizeof(int64_t);
+    }
+}
+
+static inline void qp_put_double(qp_packer_t * packer, double real)
+{
+    if (real == 0.0)
+    {
+        packer->buffer[packer->len++] = QP_DOUBLE_0;
+    }
+    else if (real == 1.0)
+    {
+        packer->buffer[packer->len++] = QP_DOUBLE_1;
+    }
+    else if (real == -1.0)
+    {
+        packer->buffer[packer->len++] = QP_DOUBLE_N1;
+    }
+    else
+    {
+        packer->buffer[packer->len++] = QP_DOUBLE;
+        memcpy(packer->buffer + packer->len, &real, sizeof(double));
+        packer->len += sizeof(double);
+    }
+}
+
 /* Add to file-packer functions */
 int qp_fadd_type(qp_fpacker_t * fpacker, qp_types_t tp);
 int qp_fadd_raw(qp_fpacker_t * fpacker, const unsigned char * raw, size_t len);
@@ -23,6 +23,7 @@ typedef enum
     SIRI_API_RT_QUERY,
     SIRI_API_RT_INSERT,
     SIRI_APT_RT_SERVICE,
+    SIRI_API_RT_TOKEN,
 } siri_api_req_t;
 
 typedef enum
@@ -65,6 +66,7 @@ struct siri_api_request_s
     siri_api_req_t request_type;
     service_request_t service_type;
     bool service_authenticated;
+    bool token_authenticated;
     http_parser parser;
     uv_write_t req;
 };
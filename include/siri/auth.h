@@ -0,0 +1,38 @@
+/*
+ * auth.h - Credential cache and tokens for the HTTP API.
+ */
+#ifndef SIRI_AUTH_H_
+#define SIRI_AUTH_H_
+
+#include <siri/db/db.h>
+#include <siri/db/user.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* number of seconds a verified basic credential is cached */
+#define SIRI_AUTH_CACHE_TTL 60
+
+/* number of seconds a token is valid after it is issued */
+#define SIRI_AUTH_TOKEN_TTL 3600
+
+/* length of a token string, excluding the terminator */
+#define SIRI_AUTH_TOKEN_LEN 32
+
+int siri_auth_init(void);
+void siri_auth_destroy(void);
+siridb_user_t * siri_auth_basic_user(
+        siridb_t * siridb,
+        const char * data,
+        size_t n);
+bool siri_auth_basic_service(const char * data, size_t n);
+int siri_auth_token_new(
+        siridb_user_t * user,
+        char token[SIRI_AUTH_TOKEN_LEN + 1]);
+siridb_user_t * siri_auth_token_user(
+        siridb_t * siridb,
+        const char * data,
+        size_t n);
+void siri_auth_drop_user(siridb_user_t * user);
+void siri_auth_drop_service(void);
+
+#endif  /* SIRI_AUTH_H_ */
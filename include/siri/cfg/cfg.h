@@ -27,6 +27,7 @@ struct siri_cfg_s
 {
     uint32_t optimize_interval;
     uint32_t buffer_sync_interval;
+    uint32_t scrub_interval;
 
     uint16_t listen_client_port;
     uint16_t listen_backend_port;
@@ -47,6 +48,8 @@ struct siri_cfg_s
     char pipe_client_name[XPATH_MAX];
 
     uint8_t ignore_broken_data;
+    uint8_t optimize_drop_cache;
+    uint8_t select_read_ahead;
 };
 
 #endif  /* SIRI_CFG_H_ */
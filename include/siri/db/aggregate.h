@@ -20,6 +20,8 @@ siridb_points_t * siridb_aggregate_run(
 void siridb_init_aggregates(void);
 vec_t * siridb_aggregate_list(cleri_children_t * children, char * err_msg);
 void siridb_aggregate_list_free(vec_t * alist);
+siridb_aggr_t * siridb_aggregate_new(uint32_t gid);
+void siridb_aggregate_free(siridb_aggr_t * aggr);
 int siridb_aggregate_can_skip(cleri_children_t * children);
 
 struct siridb_aggr_s
@@ -31,6 +33,10 @@ struct siridb_aggr_s
     uint64_t limit;
     uint64_t offset;
     double timespan;  /* used for derivative        */
+    uint64_t window;  /* used for moving and ewma   */
+    uint32_t moving_gid;  /* function used for moving */
+    uint64_t max_points;  /* used for downsample      */
+    uint8_t minmax;  /* downsample using min/max decimation */
     pcre2_code * regex;             \
     pcre2_match_data * match_data;
     qp_via_t filter_via;
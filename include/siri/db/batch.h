@@ -0,0 +1,86 @@
+/*
+ * batch.h - Batch of queries which are handled using a single request.
+ */
+#ifndef SIRIDB_BATCH_H_
+#define SIRIDB_BATCH_H_
+
+/* maximum number of queries in a single batch request */
+#define SIRIDB_BATCH_MAX_QUERIES 256
+
+/* maximum number of points which are shared by the queries in a batch */
+#define SIRIDB_BATCH_MAX_POINTS 1000000
+
+typedef struct siridb_batch_s siridb_batch_t;
+
+#define siridb_batch_incref(batch__) (batch__)->ref++
+
+#include <ctree/ctree.h>
+#include <imap/imap.h>
+#include <inttypes.h>
+#include <qpack/qpack.h>
+#include <siri/db/points.h>
+#include <siri/db/series.h>
+#include <siri/net/pkg.h>
+#include <siri/net/promises.h>
+#include <siri/net/stream.h>
+#include <uv.h>
+#include <vec/vec.h>
+
+int siridb_batch_run(
+        sirinet_stream_t * client,
+        sirinet_pkg_t * pkg,
+        uint8_t tp,
+        int flags);
+void siridb_batch_set_result(
+        siridb_batch_t * batch,
+        uint16_t idx,
+        sirinet_pkg_t * pkg);
+void siridb_batch_finish(siridb_batch_t * batch, uint16_t idx);
+int siridb_batch_forward(
+        siridb_batch_t * batch,
+        uv_async_t * handle,
+        qp_packer_t * packer,
+        sirinet_promises_cb cb,
+        sirinet_promises_each_cb each_cb,
+        int flags);
+int siridb_batch_series_re_get(
+        siridb_batch_t * batch,
+        const char * re,
+        size_t len,
+        imap_t * dest);
+void siridb_batch_series_re_set(
+        siridb_batch_t * batch,
+        const char * re,
+        size_t len,
+        imap_t * source);
+siridb_points_t * siridb_batch_get_points(
+        siridb_batch_t * batch,
+        siridb_series_t * series,
+        uint64_t * start_ts,
+        uint64_t * end_ts);
+void siridb_batch_add_points(
+        siridb_batch_t * batch,
+        siridb_series_t * series,
+        uint64_t * start_ts,
+        uint64_t * end_ts,
+        siridb_points_t * points);
+int siridb_batch_count(sirinet_pkg_t * pkg);
+vec_t ** siridb_batch_split(vec_t * promises, size_t n);
+
+struct siridb_batch_s
+{
+    uint16_t ref;
+    uint16_t pid;               /* package id of the batch request */
+    uint16_t n;                 /* number of queries in the batch */
+    uint16_t done;              /* number of queries with a result */
+    uint8_t tp;                 /* package type for the response */
+    uint8_t * has_result;       /* for each query */
+    sirinet_pkg_t ** results;   /* result package for each query */
+    sirinet_stream_t * client;
+    ct_t * series_re;           /* regular expression -> imap with series */
+    imap_t * points;            /* series id -> points for a time range */
+    size_t npoints;             /* total number of shared points */
+    vec_t * fwd;                /* queries waiting for a combined forward */
+};
+
+#endif  /* SIRIDB_BATCH_H_ */
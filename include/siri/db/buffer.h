@@ -9,6 +9,7 @@ typedef struct siridb_buffer_s siridb_buffer_t;
 #include <siri/db/db.h>
 #include <siri/db/series.h>
 #include <siri/db/points.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <stdbool.h>
 
@@ -16,7 +17,7 @@ typedef struct siridb_buffer_s siridb_buffer_t;
 
 siridb_buffer_t * siridb_buffer_new(void);
 void siridb_buffer_free(siridb_buffer_t * buffer);
-void siridb_buffer_close(siridb_buffer_t * buffer);
+int siridb_buffer_close(siridb_buffer_t * buffer);
 bool siridb_buffer_is_valid_size(ssize_t ssize);
 void siridb_buffer_set_path(siridb_buffer_t * buffer, const char * str);
 int siridb_buffer_new_series(
@@ -28,6 +29,13 @@ int siridb_buffer_test_path(siridb_t * siridb);
 int siridb_buffer_write_empty(
         siridb_buffer_t * buffer,
         siridb_series_t * series);
+int siridb_buffer_swap(
+        siridb_buffer_t * buffer,
+        siridb_series_t * series);
+int siridb_buffer_release(
+        siridb_buffer_t * buffer,
+        long int bf_flush,
+        siridb_points_t * points);
 int siridb_buffer_write_point(
         siridb_buffer_t * buffer,
         siridb_series_t * series,
@@ -44,11 +52,26 @@ struct siridb_buffer_s
     vec_t * empty;        /* list with empty buffer spaces */
     FILE * fp;              /* buffer file pointer */
     int fd;                 /* buffer file descriptor */
+    char * map;             /* shared mapping of the buffer file */
+    size_t map_sz;          /* size of the mapping (equal to the file size) */
 };
 
+/*
+ * Points are written as stores into the mapped buffer file, this function
+ * makes sure they are written to disk.
+ */
 static inline int siridb_buffer_fsync(siridb_buffer_t * buffer)
 {
-    return (buffer->fp == NULL) ? 0 : fsync(buffer->fd);
+    return (buffer->map == NULL) ?
+            0 : msync(buffer->map, buffer->map_sz, MS_SYNC);
+}
+
+/*
+ * Returns the memory used by the buffer of a single series.
+ */
+static inline size_t siridb_buffer_mem(siridb_buffer_t * buffer)
+{
+    return sizeof(siridb_points_t) + buffer->len * sizeof(siridb_point_t);
 }
 
 #endif  /* SIRIDB_BUFFER_H_ */
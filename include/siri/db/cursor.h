@@ -0,0 +1,30 @@
+/*
+ * cursor.h - Cursor for incremental select queries.
+ */
+#ifndef SIRIDB_CURSOR_H_
+#define SIRIDB_CURSOR_H_
+
+/* key for the cursor in a select response */
+#define SIRIDB_CURSOR_KEY "__cursor__"
+#define SIRIDB_CURSOR_KEY_LEN 10
+
+#include <ctree/ctree.h>
+#include <inttypes.h>
+#include <qpack/qpack.h>
+#include <stddef.h>
+#include <vec/vec.h>
+
+ct_t * siridb_cursor_load(const char * data, size_t len);
+void siridb_cursor_free(ct_t * cursor);
+int siridb_cursor_start(
+        ct_t * cursor,
+        const char * name,
+        vec_t * alist,
+        uint64_t * start);
+int siridb_cursor_pack(
+        qp_packer_t * packer,
+        const char * name,
+        size_t len,
+        uint64_t ts);
+
+#endif  /* SIRIDB_CURSOR_H_ */
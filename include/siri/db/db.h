@@ -8,7 +8,7 @@ typedef struct siridb_s siridb_t;
 
 #define SIRIDB_MAX_SIZE_ERR_MSG 1024
 #define SIRIDB_MAX_DBNAME_LEN 256  /*    255 + NULL     */
-#define SIRIDB_SCHEMA 6
+#define SIRIDB_SCHEMA 7
 #define SIRIDB_FLAG_REINDEXING 1
 #define SIRIDB_FLAG_DROPPED 2
 
@@ -36,8 +36,11 @@ typedef struct siridb_s siridb_t;
 #include <siri/db/tasks.h>
 #include <siri/db/time.h>
 #include <siri/db/buffer.h>
+#include <siri/db/flush.h>
+#include <siri/db/share.h>
 #include <siri/db/tee.h>
 #include <siri/db/tags.h>
+#include <siri/db/subscriptions.h>
 
 
 int32_t siridb_get_uptime(siridb_t * siridb);
@@ -60,6 +63,15 @@ void siridb_update_shard_expiration(siridb_t * siridb);
     if (!__atomic_sub_fetch(&(siridb__)->ref, 1, __ATOMIC_SEQ_CST)) siridb__free(siridb__)
 #define siridb_is_reindexing(siridb) (siridb->flags & SIRIDB_FLAG_REINDEXING)
 
+/*
+ * Maintained totals which are used to answer count statements without a
+ * where expression. The counters are updated from multiple threads.
+ */
+#define siridb_points_total_add(siridb__, n__)     __atomic_add_fetch(&(siridb__)->points_total, (n__), __ATOMIC_RELAXED)
+#define siridb_points_total_sub(siridb__, n__)     __atomic_sub_fetch(&(siridb__)->points_total, (n__), __ATOMIC_RELAXED)
+#define siridb_shards_size_add(siridb__, tp__, n__)     __atomic_add_fetch(&(siridb__)->shards_size[tp__], (n__), __ATOMIC_RELAXED)
+#define siridb_shards_size_sub(siridb__, tp__, n__)     __atomic_sub_fetch(&(siridb__)->shards_size[tp__], (n__), __ATOMIC_RELAXED)
+
 struct siridb_s
 {
     uint16_t ref;
@@ -71,6 +83,7 @@ struct siridb_s
     uint16_t shard_mask_log;
     uint32_t select_points_limit;
     uint32_t list_limit;
+    uint32_t scrub_series_id;       /* next series id for the scrub task    */
     uuid_t uuid;
     iso8601_tz_t tz;
     struct timespec start_time;     /* to calculate up-time.                */
@@ -85,6 +98,8 @@ struct siridb_s
     double drop_threshold;
     size_t received_points;
     size_t selected_points;
+    uint64_t points_total;          /* points in series on this server      */
+    uint64_t shards_size[2];        /* shard bytes by type, number and log  */
 
     siridb_time_t * time;
     siridb_server_t * server;
@@ -106,6 +121,9 @@ struct siridb_s
     siridb_groups_t * groups;
     siridb_tags_t * tags;
     siridb_buffer_t * buffer;
+    siridb_flush_t * flush;
+    siridb_share_t * share;
+    siridb_subscriptions_t * subscriptions;
     siridb_tee_t * tee;
     siridb_tasks_t tasks;
 };
@@ -0,0 +1,28 @@
+/*
+ * flush.h - Background flush of full series buffers.
+ */
+#ifndef SIRIDB_FLUSH_H_
+#define SIRIDB_FLUSH_H_
+
+typedef struct siridb_flush_s siridb_flush_t;
+
+#include <siri/db/db.h>
+#include <siri/db/series.h>
+#include <uv.h>
+#include <vec/vec.h>
+
+siridb_flush_t * siridb_flush_new(void);
+void siridb_flush_free(siridb_flush_t * flush);
+int siridb_flush_series(siridb_t * siridb, siridb_series_t * series);
+
+struct siridb_flush_s
+{
+    uv_work_t work;
+    vec_t * queue;          /* series waiting for a flush */
+    vec_t * work_queue;     /* series which are flushed by the worker */
+    vec_t * release;        /* written series, released by the main thread */
+    vec_t * shards;         /* shards with chunks for the current batch */
+    uint8_t is_running;
+};
+
+#endif  /* SIRIDB_FLUSH_H_ */
@@ -15,6 +15,7 @@ enum
 typedef struct siridb_group_s siridb_group_t;
 
 #include <vec/vec.h>
+#include <imap/imap.h>
 #include <siri/db/series.h>
 #include <siri/db/db.h>
 #include <pcre2.h>
@@ -36,6 +37,7 @@ int siridb_group_update_expression(
         char * err_msg);
 void siridb_group_cleanup(siridb_group_t * group);
 int siridb_group_test_series(siridb_group_t * group, siridb_series_t * series);
+imap_t * siridb_group_series_set(siridb_group_t * group);
 int siridb_group_cexpr_cb(siridb_group_t * group, cexpr_condition_t * cond);
 void siridb_group_prop(siridb_group_t * group, qp_packer_t * packer, int prop);
 int siridb_group_is_remote_prop(uint32_t prop);
@@ -54,6 +56,7 @@ struct siridb_group_s
     char * name;
     char * source;  /* pattern/flags representation */
     vec_t * series;
+    imap_t * set;   /* series by id, created when used by a query */
     pcre2_code * regex;
     pcre2_match_data * match_data;
 };
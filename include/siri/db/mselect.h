@@ -0,0 +1,11 @@
+/*
+ * mselect.h - Parallel processing of select results on the master.
+ */
+#ifndef SIRIDB_MSELECT_H_
+#define SIRIDB_MSELECT_H_
+
+#include <uv.h>
+
+int siridb_mselect_start(uv_async_t * handle);
+
+#endif  /* SIRIDB_MSELECT_H_ */
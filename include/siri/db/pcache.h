@@ -17,9 +17,7 @@ int siridb_pcache_add_ts_obj(
         siridb_pcache_t * pcache,
         uint64_t * ts,
         qp_obj_t * obj);
-
-#define siridb_pcache_free(pcache) \
-    siridb_points_free((siridb_points_t *) pcache)
+void siridb_pcache_free(siridb_pcache_t * pcache);
 
 struct siridb_pcache_s
 {
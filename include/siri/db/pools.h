@@ -30,6 +30,7 @@ void siridb_pools_send_pkg(
         sirinet_pkg_t * pkg,
         uint64_t timeout,
         sirinet_promises_cb cb,
+        sirinet_promises_each_cb each_cb,
         void * data,
         int flags);
 void siridb_pools_send_pkg_2some(
@@ -37,6 +38,7 @@ void siridb_pools_send_pkg_2some(
         sirinet_pkg_t * pkg,
         uint64_t timeout,
         sirinet_promises_cb cb,
+        sirinet_promises_each_cb each_cb,
         void * data,
         int flags);
 
@@ -15,11 +15,13 @@
 #include <siri/db/presuf.h>
 #include <siri/db/series.h>
 #include <siri/db/tag.h>
+#include <siri/db/topk.h>
 #include <siri/db/user.h>
 #include <pcre2.h>
 
 #define QUERIES_IGNORE_DROP_THRESHOLD 1
 #define QUERIES_SKIP_GET_POINTS 2
+#define QUERIES_IGNORE_CURSOR 4
 
 enum
 {
@@ -135,6 +137,9 @@ struct query_select_s
     char * merge_as;
     ct_t * result;
     imap_t * points_map;    /* points_map for caching                       */
+    ct_t * cursor;          /* last timestamp by name when using a cursor   */
+    siridb_topk_t * topk;   /* candidates when using top() or bottom()      */
+    uint64_t share_gen;     /* generation for sharing decoded chunks        */
     vec_t * alist;        /* aggregation list (can be used multiple times)*/
     vec_t * mlist;        /* merge aggregation list                       */
 };
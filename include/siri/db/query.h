@@ -39,6 +39,7 @@ typedef struct siridb_query_s siridb_query_t;
 #include <sys/time.h>
 #include <cleri/cleri.h>
 #include <qpack/qpack.h>
+#include <siri/db/batch.h>
 #include <siri/db/time.h>
 #include <siri/db/nodes.h>
 #include <siri/db/series.h>
@@ -57,6 +58,22 @@ void siridb_query_run(
         size_t q_len,
         float factor,
         int flags);
+void siridb_query_run_cursor(
+        uint16_t pid,
+        sirinet_stream_t * client,
+        const char * q,
+        size_t q_len,
+        const char * cursor,
+        size_t cursor_len,
+        float factor,
+        int flags);
+void siridb_query_run_batch(
+        siridb_batch_t * batch,
+        uint16_t idx,
+        const char * q,
+        size_t q_len,
+        float factor,
+        int flags);
 void siridb_query_free(uv_handle_t * handle);
 void siridb_send_query_result(uv_async_t * handle);
 void siridb_query_send_error(
@@ -67,6 +84,12 @@ void siridb_query_forward(
         siridb_query_fwd_t fwd,
         sirinet_promises_cb cb,
         int flags);
+void siridb_query_forward_each(
+        uv_async_t * handle,
+        siridb_query_fwd_t fwd,
+        sirinet_promises_cb cb,
+        sirinet_promises_each_cb each_cb,
+        int flags);
 void siridb_query_timeit_from_unpacker(
         siridb_query_t * query,
         qp_unpacker_t * unpacker);
@@ -81,7 +104,10 @@ struct siridb_query_s
     float factor;
     void * data;
     sirinet_stream_t * client;
+    siridb_batch_t * batch;     /* NULL when not part of a batch */
     char * q;
+    char * cursor;              /* NULL when the query has no cursor */
+    size_t cursor_len;
     char err_msg[SIRIDB_MAX_SIZE_ERR_MSG];
     qp_packer_t * packer;
     qp_packer_t * timeit;
@@ -0,0 +1,23 @@
+/*
+ * scan.h - Parallel scan over the series of a query.
+ */
+#ifndef SIRIDB_SCAN_H_
+#define SIRIDB_SCAN_H_
+
+typedef enum
+{
+    SIRIDB_SCAN_COUNT,      /* count the series matching the where expr.  */
+    SIRIDB_SCAN_LENGTH,     /* sum the length of the matching series.     */
+    SIRIDB_SCAN_MATCH,      /* keep only the matching series in the vec.  */
+} siridb_scan_tp;
+
+#include <stddef.h>
+#include <uv.h>
+
+int siridb_scan_start(
+        uv_async_t * handle,
+        siridb_scan_tp tp,
+        size_t * n,
+        size_t limit);
+
+#endif  /* SIRIDB_SCAN_H_ */
@@ -24,6 +24,8 @@
 #define SIRIDB_SERIES_INIT_REPL 4
 #define SIRIDB_SERIES_IS_SERVER_ONE 8     /* if not set its server_id 0 */
 #define SIRIDB_SERIES_IS_32BIT_TS 16    /* if not set its a 64 bit ts */
+#define SIRIDB_SERIES_TEE_CHECKED 32    /* tee filter result is cached */
+#define SIRIDB_SERIES_TEE_MATCH 64      /* series must be written to tee */
 
 /* the max length including terminator char */
 #define SIRIDB_SERIES_NAME_LEN_MAX 65535
@@ -65,10 +67,13 @@ struct siridb_series_s
     uint32_t length;
     uint32_t idx_len;
     long int bf_offset;
+    long int bf_flush;
     siridb_points_t * buffer;
+    siridb_points_t * flushing;
     char * name;
     idx_t * idx;
     siridb_t * siridb;
+    uint64_t subs;  /* bit for each subscription which matches the series */
 };
 
 #include <siri/db/shard.h>
@@ -125,6 +130,22 @@ siridb_points_t * siridb_series_get_last(
         siridb_series_t * series, int * required_shard);
 siridb_points_t * siridb_series_get_count(siridb_series_t * series);
 void siridb_series_ensure_type(siridb_series_t * series, qp_obj_t * qp_obj);
+/*
+ * Change the length of a series and the total points for the database.
+ * Points of a dropped series are no longer part of the total.
+ */
+#define siridb_series_length_add(series__, n__)                             \
+do {                                                                        \
+    (series__)->length += (n__);                                            \
+    if (~(series__)->flags & SIRIDB_SERIES_IS_DROPPED)                      \
+        siridb_points_total_add((series__)->siridb, (n__));                 \
+} while (0)
+#define siridb_series_length_sub(series__, n__)                             \
+do {                                                                        \
+    (series__)->length -= (n__);                                            \
+    if (~(series__)->flags & SIRIDB_SERIES_IS_DROPPED)                      \
+        siridb_points_total_sub((series__)->siridb, (n__));                 \
+} while (0)
 /*
  * Increment the series reference counter.
  */
@@ -63,6 +63,8 @@ size_t siridb_shard_write_points(
         uint_fast32_t end,
         FILE * idx_fp,
         uint16_t * cinfo);
+int siridb_shard_wbuf_start(siridb_shard_t * shard);
+int siridb_shard_wbuf_write(siridb_shard_t * shard);
 typedef int (*siridb_shard_get_points_cb)(
         siridb_points_t * points,
         idx_t * idx,
@@ -105,6 +107,11 @@ int siridb_shard_get_points_log_compressed(
         uint64_t * start_ts,
         uint64_t * end_ts,
         uint8_t has_overlap);
+ssize_t siridb_shard_verify_chunk(siridb_series_t * series, idx_t * idx);
+void siridb_shard_read_ahead(
+        siridb_series_t * series,
+        uint32_t * indexes,
+        size_t len);
 int siridb_shard_migrate(
         siridb_t * siridb,
         uint64_t shard_id,
@@ -125,6 +132,8 @@ struct siridb_shard_s
     uint8_t tp;         /* TP_NUMBER, TP_LOG */
     uint8_t flags;
     uint16_t max_chunk_sz;
+    uint8_t schema;     /* shard schema, see shard.c */
+    uint8_t replaced;   /* replaced by an optimized shard, size not counted */
     uint64_t id;
     size_t len;         /* size of the shard which is used */
     size_t size;        /* size of shard on disk */
@@ -132,6 +141,9 @@ struct siridb_shard_s
     siri_fp_t * fp;
     char * fn;
     siridb_shard_t * replacing;
+    char * wbuf;        /* pending chunks for a batched write */
+    size_t wbuf_len;
+    size_t wbuf_sz;
 };
 
 struct siridb_shard_view_s
@@ -19,13 +19,16 @@
 
 #include <siri/db/db.h>
 #include <omap/omap.h>
+#include <vec/vec.h>
 
 void siridb_shards_destroy_cb(omap_t * shards);
 int siridb_shards_load(siridb_t * siridb);
 int siridb_shards_add_points(
         siridb_t * siridb,
         siridb_series_t * series,
-        siridb_points_t * points);
+        siridb_points_t * points,
+        vec_t ** batch);
+int siridb_shards_write_batch(vec_t * batch);
 double siridb_shards_count_percent(
         siridb_t * siridb,
         uint64_t end_ts,
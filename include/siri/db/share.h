@@ -0,0 +1,39 @@
+/*
+ * share.h - Share decoded chunks between concurrent select queries.
+ */
+#ifndef SIRIDB_SHARE_H_
+#define SIRIDB_SHARE_H_
+
+/* maximum number of decoded points which are kept for sharing */
+#define SIRIDB_SHARE_MAX_POINTS 1000000
+
+typedef struct siridb_share_s siridb_share_t;
+
+#include <imap/imap.h>
+#include <inttypes.h>
+#include <siri/db/points.h>
+#include <siri/db/series.h>
+#include <vec/vec.h>
+
+siridb_share_t * siridb_share_new(void);
+void siridb_share_free(siridb_share_t * share);
+uint64_t siridb_share_enter(siridb_share_t * share);
+void siridb_share_leave(siridb_share_t * share, uint64_t gen);
+int siridb_share_get_points(
+        siridb_share_t * share,
+        siridb_points_t * points,
+        siridb_series_t * series,
+        idx_t * idx,
+        uint64_t * start_ts,
+        uint64_t * end_ts);
+
+struct siridb_share_s
+{
+    uint32_t readers;       /* number of running select queries */
+    size_t npoints;         /* number of decoded points in chunks */
+    uint64_t gen;           /* generation of the last select query */
+    vec_t * active;         /* generations of the running select queries */
+    imap_t * chunks;        /* decoded chunks by shard and position */
+};
+
+#endif  /* SIRIDB_SHARE_H_ */
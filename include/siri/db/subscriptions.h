@@ -0,0 +1,104 @@
+/*
+ * subscriptions.h - Push new points to subscribed clients.
+ */
+#ifndef SIRIDB_SUBSCRIPTIONS_H_
+#define SIRIDB_SUBSCRIPTIONS_H_
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+
+/* maximum number of subscriptions, each has a bit in siridb_series_t */
+#define SIRIDB_SUBSCRIPTIONS_MAX 64
+
+/* maximum number of subscriptions for a single client connection */
+#define SIRIDB_SUBSCRIPTIONS_MAX_CLIENT 8
+
+/* points are dropped when more bytes are waiting to be sent to a client */
+#define SIRIDB_SUBSCRIPTIONS_MAX_QUEUE 4194304  /*  4 MB  */
+
+/* key for the number of dropped points in a push package */
+#define SIRIDB_SUBSCRIPTIONS_DROPPED_KEY "__dropped__"
+#define SIRIDB_SUBSCRIPTIONS_DROPPED_KEY_LEN 11
+
+typedef enum
+{
+    SUBSCRIPTION_SERIES,
+    SUBSCRIPTION_REGEX,
+    SUBSCRIPTION_TAG,
+    SUBSCRIPTION_GROUP,
+} siridb_subscription_tp;
+
+typedef struct siridb_subscription_s siridb_subscription_t;
+typedef struct siridb_subscriptions_s siridb_subscriptions_t;
+
+#include <inttypes.h>
+#include <pcre2.h>
+#include <qpack/qpack.h>
+#include <siri/db/db.h>
+#include <siri/db/pcache.h>
+#include <siri/db/series.h>
+#include <siri/db/tag.h>
+#include <siri/net/stream.h>
+
+siridb_subscriptions_t * siridb_subscriptions_new(void);
+void siridb_subscriptions_free(siridb_subscriptions_t * subscriptions);
+int siridb_subscriptions_subscribe(
+        siridb_t * siridb,
+        sirinet_stream_t * client,
+        siridb_subscription_tp tp,
+        const char * expr,
+        size_t len,
+        double factor,
+        char * err_msg);
+int siridb_subscriptions_unsubscribe(
+        siridb_t * siridb,
+        sirinet_stream_t * client,
+        uint16_t id);
+void siridb_subscriptions_drop_client(
+        siridb_t * siridb,
+        sirinet_stream_t * client);
+uint64_t siridb_subscriptions_match(
+        siridb_subscriptions_t * subscriptions,
+        siridb_series_t * series);
+void siridb_subscriptions_tag(
+        siridb_subscriptions_t * subscriptions,
+        siridb_tag_t * tag,
+        siridb_series_t * series);
+void siridb_subscriptions_untag(
+        siridb_subscriptions_t * subscriptions,
+        siridb_tag_t * tag,
+        siridb_series_t * series);
+void siridb_subscriptions_drop_tag(siridb_t * siridb, const char * name);
+void siridb_subscriptions_point(
+        siridb_subscriptions_t * subscriptions,
+        siridb_series_t * series,
+        uint64_t ts,
+        qp_obj_t * val);
+void siridb_subscriptions_pcache(
+        siridb_subscriptions_t * subscriptions,
+        siridb_series_t * series,
+        siridb_pcache_t * pcache);
+void siridb_subscriptions_flush(siridb_subscriptions_t * subscriptions);
+
+struct siridb_subscription_s
+{
+    uint16_t id;                /* bit in series and pid for push packages */
+    uint8_t tp;                 /* siridb_subscription_tp */
+    uint8_t is_full;            /* points are dropped until the next flush */
+    double factor;              /* time precision factor or 0.0 */
+    uint64_t tag_id;            /* only used for tag subscriptions */
+    uint64_t dropped;           /* dropped points since the last push */
+    char * expr;                /* series name, regex, tag or group name */
+    pcre2_code * regex;
+    pcre2_match_data * match_data;
+    sirinet_stream_t * client;
+    qp_packer_t * packer;       /* points waiting for the next flush */
+};
+
+struct siridb_subscriptions_s
+{
+    uint64_t used;              /* bit for each subscription in use */
+    uint64_t pending;           /* bit for each subscription with points */
+    siridb_subscription_t * subs[SIRIDB_SUBSCRIPTIONS_MAX];
+};
+
+#endif  /* SIRIDB_SUBSCRIPTIONS_H_ */
@@ -10,6 +10,7 @@ enum
 {
     TAG_FLAG_CLEANUP        = 1<<0,
     TAG_FLAG_REQUIRE_SAVE   = 1<<1,
+    TAG_FLAG_JOURNALED      = 1<<2,
 };
 
 #include <inttypes.h>
@@ -8,6 +8,7 @@ typedef struct siridb_tags_s siridb_tags_t;
 
 #include <inttypes.h>
 #include <ctree/ctree.h>
+#include <stdio.h>
 #include <vec/vec.h>
 #include <uv.h>
 #include <siri/db/db.h>
@@ -19,8 +20,15 @@ enum
 {
     TAGS_FLAG_DROPPED_SERIES    = 1<<0,
     TAGS_FLAG_REQUIRE_SAVE      = 1<<1,
+    TAGS_FLAG_REQUIRE_COMPACT   = 1<<2,
 };
 
+typedef enum
+{
+    TAGS_JOURNAL_ADD,
+    TAGS_JOURNAL_DEL,
+} siridb_tags_journal_tp;
+
 struct siridb_tags_s
 {
     uint16_t flags;
@@ -29,6 +37,8 @@ struct siridb_tags_s
     uint64_t next_id;
     char * path;
     ct_t * tags;
+    FILE * journal;         /* append-only tag/untag journal */
+    size_t journal_sz;      /* current size of the journal in bytes */
     uv_mutex_t mutex;
 };
 
@@ -44,6 +54,16 @@ siridb_tag_t * siridb_tags_add_n(
 siridb_tag_t * siridb_tags_add(siridb_tags_t * tags, const char * name);
 void siridb_tags_dropped_series(siridb_tags_t * tags);
 void siridb_tags_save(siridb_tags_t * tags);
+int siridb_tags_journal(
+        siridb_tag_t * tag,
+        siridb_tags_journal_tp tp,
+        uint32_t series_id);
+int siridb_tags_journal_map(
+        siridb_tag_t * tag,
+        siridb_tags_journal_tp tp,
+        imap_t * series_map);
+int siridb_tags_journal_flush(siridb_tags_t * tags);
+int siridb_tags_journal_close(siridb_tags_t * tags);
 void siridb_tags_init_nseries(siridb_tags_t * tags);
 sirinet_pkg_t * siridb_tags_pkg(siridb_tags_t * tags, uint16_t pid);
 sirinet_pkg_t * siridb_tags_series(siridb_series_t * series);
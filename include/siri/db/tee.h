@@ -14,15 +14,61 @@ enum
     SIRIDB_TEE_FLAG = 1<<31,
 };
 
+/* select the series which are written to the tee */
+typedef enum
+{
+    SIRIDB_TEE_FILTER_NONE,
+    SIRIDB_TEE_FILTER_REGEX,
+    SIRIDB_TEE_FILTER_TAG,
+    SIRIDB_TEE_FILTER_GROUP,
+} siridb_tee_filter_t;
+
+/* format of the packages which are written to the tee */
+typedef enum
+{
+    SIRIDB_TEE_FORMAT_INSERT,       /* {series: [[ts, val], ...], ...}    */
+    SIRIDB_TEE_FORMAT_COLUMNAR,     /* {series: [[ts, ...], [val, ...]]}  */
+} siridb_tee_format_t;
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+
+#include <ctree/ctree.h>
+#include <pcre2.h>
 #include <uv.h>
 #include <stdbool.h>
+#include <siri/db/db.h>
+#include <siri/db/series.h>
+#include <siri/net/pkg.h>
 #include <siri/net/promise.h>
 
 siridb_tee_t * siridb_tee_new(void);
 void siridb_tee_free(siridb_tee_t * tee);
 int siridb_tee_connect(siridb_tee_t * tee);
 int siridb_tee_set_pipe_name(siridb_tee_t * tee, const char * pipe_name);
-void siridb_tee_write(siridb_tee_t * tee, sirinet_promise_t * promise);
+int siridb_tee_set_filter(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        siridb_tee_filter_t filter_tp,
+        const char * filter,
+        siridb_tee_format_t format,
+        char * err_msg);
+sirinet_pkg_t * siridb_tee_update_pkg(
+        const char * pipe_name,
+        siridb_tee_filter_t filter_tp,
+        const char * filter,
+        siridb_tee_format_t format);
+void siridb_tee_forget(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        siridb_series_t * series);
+void siridb_tee_drop_tag(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        const char * name);
+void siridb_tee_write(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        sirinet_promise_t * promise);
 const char * tee_str(siridb_tee_t * tee);
 static inline bool siridb_tee_is_configured(siridb_tee_t * tee);
 static inline bool siridb_tee_is_connected(siridb_tee_t * tee);
@@ -33,6 +79,11 @@ struct siridb_tee_s
     uint32_t flags;  /* maps to sirnet_stream_t tp for cleanup */
     char * pipe_name_;
     char * err_msg_;
+    uint8_t filter_tp_;             /* siridb_tee_filter_t */
+    uint8_t format_;                /* siridb_tee_format_t */
+    char * filter_;                 /* regex, tag name or group name */
+    pcre2_code * regex_;
+    pcre2_match_data * match_data_;
     uv_pipe_t pipe;
 };
 
@@ -0,0 +1,54 @@
+/*
+ * topk.h - Top-k and bottom-k series for select queries.
+ */
+#ifndef SIRIDB_TOPK_H_
+#define SIRIDB_TOPK_H_
+
+/* key for the candidates in a select response from another pool */
+#define SIRIDB_TOPK_KEY "__top__"
+#define SIRIDB_TOPK_KEY_LEN 7
+
+typedef struct siridb_topk_s siridb_topk_t;
+typedef struct siridb_topk_item_s siridb_topk_item_t;
+
+#include <ctree/ctree.h>
+#include <inttypes.h>
+#include <qpack/qpack.h>
+#include <siri/db/aggregate.h>
+#include <siri/db/points.h>
+#include <siri/db/presuf.h>
+#include <stddef.h>
+
+siridb_topk_t * siridb_topk_new(uint32_t gid, size_t k, int bottom);
+void siridb_topk_free(siridb_topk_t * topk);
+int siridb_topk_score(
+        siridb_topk_t * topk,
+        siridb_points_t * points,
+        double * score,
+        char * err_msg);
+int siridb_topk_push(siridb_topk_t * topk, const char * name, double score);
+int siridb_topk_pack(siridb_topk_t * topk, qp_packer_t * packer);
+int siridb_topk_unpack(siridb_topk_t * topk, qp_unpacker_t * unpacker);
+int siridb_topk_crop(
+        siridb_topk_t * topk,
+        ct_t ** result,
+        siridb_presuf_t * presuf);
+
+struct siridb_topk_item_s
+{
+    double score;
+    char * name;
+};
+
+struct siridb_topk_s
+{
+    uint8_t bottom;             /* keep the series with the lowest score */
+    uint8_t is_ranked;          /* local series are ranked */
+    size_t k;
+    size_t len;                 /* number of candidates in the heap */
+    size_t size;                /* allocated number of items */
+    siridb_aggr_t * aggr;       /* aggregation for the score of a series */
+    siridb_topk_item_t * items; /* heap with the worst candidate first */
+};
+
+#endif  /* SIRIDB_TOPK_H_ */
@@ -5,7 +5,7 @@
  * should be used with the libcleri module.
  *
  * Source class: SiriGrammar
- * Created at: 2020-09-25 10:57:26
+ * Created at: 2026-10-18 11:02:41
  */
 #ifndef CLERI_EXPORT_SIRI_GRAMMAR_GRAMMAR_H_
 #define CLERI_EXPORT_SIRI_GRAMMAR_GRAMMAR_H_
@@ -59,6 +59,8 @@ enum cleri_grammar_ids {
     CLERI_GID_F_COUNT,
     CLERI_GID_F_DERIVATIVE,
     CLERI_GID_F_DIFFERENCE,
+    CLERI_GID_F_DOWNSAMPLE,
+    CLERI_GID_F_EWMA,
     CLERI_GID_F_FILTER,
     CLERI_GID_F_FIRST,
     CLERI_GID_F_INTERVAL,
@@ -70,6 +72,7 @@ enum cleri_grammar_ids {
     CLERI_GID_F_MEDIAN_HIGH,
     CLERI_GID_F_MEDIAN_LOW,
     CLERI_GID_F_MIN,
+    CLERI_GID_F_MOVING,
     CLERI_GID_F_POINTS,
     CLERI_GID_F_PVARIANCE,
     CLERI_GID_F_STDDEV,
@@ -134,8 +137,10 @@ enum cleri_grammar_ids {
     CLERI_GID_K_BACKUP_MODE,
     CLERI_GID_K_BEFORE,
     CLERI_GID_K_BETWEEN,
+    CLERI_GID_K_BOTTOM,
     CLERI_GID_K_BUFFER_PATH,
     CLERI_GID_K_BUFFER_SIZE,
+    CLERI_GID_K_COLUMNAR,
     CLERI_GID_K_COUNT,
     CLERI_GID_K_CREATE,
     CLERI_GID_K_CRITICAL,
@@ -145,12 +150,14 @@ enum cleri_grammar_ids {
     CLERI_GID_K_DEBUG,
     CLERI_GID_K_DERIVATIVE,
     CLERI_GID_K_DIFFERENCE,
+    CLERI_GID_K_DOWNSAMPLE,
     CLERI_GID_K_DROP,
     CLERI_GID_K_DROP_THRESHOLD,
     CLERI_GID_K_DURATION_LOG,
     CLERI_GID_K_DURATION_NUM,
     CLERI_GID_K_END,
     CLERI_GID_K_ERROR,
+    CLERI_GID_K_EWMA,
     CLERI_GID_K_EXPIRATION_LOG,
     CLERI_GID_K_EXPIRATION_NUM,
     CLERI_GID_K_EXPRESSION,
@@ -160,6 +167,7 @@ enum cleri_grammar_ids {
     CLERI_GID_K_FIRST,
     CLERI_GID_K_FLOAT,
     CLERI_GID_K_FOR,
+    CLERI_GID_K_FORMAT,
     CLERI_GID_K_FROM,
     CLERI_GID_K_FULL,
     CLERI_GID_K_GRANT,
@@ -190,10 +198,21 @@ enum cleri_grammar_ids {
     CLERI_GID_K_MEDIAN,
     CLERI_GID_K_MEDIAN_HIGH,
     CLERI_GID_K_MEDIAN_LOW,
+    CLERI_GID_K_MEM_BUFFERS,
+    CLERI_GID_K_MEM_CACHES,
+    CLERI_GID_K_MEM_GROUPS,
+    CLERI_GID_K_MEM_INDEX,
+    CLERI_GID_K_MEM_NAMES,
+    CLERI_GID_K_MEM_NETWORK,
+    CLERI_GID_K_MEM_QUERIES,
+    CLERI_GID_K_MEM_SERIES,
+    CLERI_GID_K_MEM_TAGS,
     CLERI_GID_K_MEM_USAGE,
     CLERI_GID_K_MERGE,
     CLERI_GID_K_MIN,
+    CLERI_GID_K_MINMAX,
     CLERI_GID_K_MODIFY,
+    CLERI_GID_K_MOVING,
     CLERI_GID_K_NAME,
     CLERI_GID_K_NAN,
     CLERI_GID_K_NINF,
@@ -242,6 +261,7 @@ enum cleri_grammar_ids {
     CLERI_GID_K_TIMEZONE,
     CLERI_GID_K_TIME_PRECISION,
     CLERI_GID_K_TO,
+    CLERI_GID_K_TOP,
     CLERI_GID_K_TRUE,
     CLERI_GID_K_TYPE,
     CLERI_GID_K_UNION,
@@ -318,8 +338,11 @@ enum cleri_grammar_ids {
     CLERI_GID_TAG_COLUMNS,
     CLERI_GID_TAG_NAME,
     CLERI_GID_TAG_SERIES,
+    CLERI_GID_TEE_FILTER,
+    CLERI_GID_TEE_FORMAT,
     CLERI_GID_TIMEIT_STMT,
     CLERI_GID_TIME_EXPR,
+    CLERI_GID_TOP_EXPR,
     CLERI_GID_UNTAG_SERIES,
     CLERI_GID_USER_COLUMNS,
     CLERI_GID_UUID,
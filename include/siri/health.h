@@ -25,6 +25,7 @@ struct siri_health_request_s
     uv_stream_t uvstream;
     http_parser parser;
     uv_buf_t * response;
+    uv_buf_t dyn;   /* allocated response, for example for /metrics */
 };
 
 static inline bool siri_health_is_handle(uv_handle_t * handle)
@@ -0,0 +1,42 @@
+/*
+ * mem.h - Memory accounting per subsystem.
+ *
+ * Counters for series, index, buffers, queries, network and caches are
+ * updated at the allocation sites of these subsystems. The memory used by
+ * the series name index, groups and tags is computed on request since their
+ * memory is spread over many small allocations.
+ *
+ * Values are in bytes and do not include allocator overhead.
+ */
+#ifndef SIRI_MEM_H_
+#define SIRI_MEM_H_
+
+typedef enum
+{
+    SIRI_MEM_SERIES,    /* series objects including their names */
+    SIRI_MEM_INDEX,     /* shard index (idx_t) arrays */
+    SIRI_MEM_BUFFERS,   /* series buffers */
+    SIRI_MEM_QUERIES,   /* points selected by queries in flight */
+    SIRI_MEM_NETWORK,   /* network read buffers */
+    SIRI_MEM_CACHES,    /* point caches */
+    SIRI_MEM_TRACKED,   /* number of tracked counters */
+} siri_mem_tp;
+
+#include <stddef.h>
+
+extern size_t siri_mem[SIRI_MEM_TRACKED];
+
+size_t siri_mem_names(void);
+size_t siri_mem_groups(void);
+size_t siri_mem_tags(void);
+
+#define siri_mem_get(tp__) \
+        __atomic_load_n(&siri_mem[tp__], __ATOMIC_RELAXED)
+
+#define siri_mem_add(tp__, n__) \
+        __atomic_add_fetch(&siri_mem[tp__], (n__), __ATOMIC_RELAXED)
+
+#define siri_mem_sub(tp__, n__) \
+        __atomic_sub_fetch(&siri_mem[tp__], (n__), __ATOMIC_RELAXED)
+
+#endif  /* SIRI_MEM_H_ */
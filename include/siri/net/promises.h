@@ -14,6 +14,16 @@ typedef void (* sirinet_promises_cb)(
 #include <siri/net/promise.h>
 #include <siri/net/pkg.h>
 
+/*
+ * Optional call-back which is called for each successful response. The
+ * call-back should return 1 (true) when the package is handled, in which
+ * case only the package header is kept for the promises call-back.
+ */
+typedef int (* sirinet_promises_each_cb)(
+        sirinet_promise_t * promise,
+        sirinet_pkg_t * pkg,
+        void * data);
+
 sirinet_promises_t * sirinet_promises_new(
         size_t size,
         sirinet_promises_cb cb,
@@ -37,6 +47,7 @@ if (promises->promises->len == promises->promises->size)    \
 struct sirinet_promises_s
 {
     sirinet_promises_cb cb;
+    sirinet_promises_each_cb each_cb;   /* can be NULL */
     vec_t * promises;
     void * data;
     sirinet_pkg_t * pkg;
@@ -11,6 +11,7 @@ typedef enum
     CPROTO_REQ_INSERT=1,                /* series with points map/array     */
     CPROTO_REQ_AUTH=2,                  /* (user, password, dbname)         */
     CPROTO_REQ_PING=3,                  /* empty                            */
+    CPROTO_REQ_QUERY_BATCH=4,           /* [(query, time_precision), ...]   */
 
     /* Internal usage only */
     CPROTO_REQ_REGISTER_SERVER=6,       /* (uuid, host, port, pool)         */
@@ -19,6 +20,10 @@ typedef enum
     CPROTO_REQ_FILE_GROUPS=9,           /* empty                            */
     CPROTO_REQ_FILE_DATABASE=10,        /* empty                            */
 
+    /* Public subscription requests */
+    CPROTO_REQ_SUBSCRIBE=11,            /* (kind, expr, time_precision)     */
+    CPROTO_REQ_UNSUBSCRIBE=12,          /* subscription_id                  */
+
     /* Public Service API request */
     CPROTO_REQ_SERVICE=32,              /* (user, password, request, {...}) */
 } cproto_client_t;
@@ -30,7 +35,11 @@ typedef enum
     CPROTO_RES_INSERT=1,                /* {"success_msg": ...}             */
     CPROTO_RES_AUTH_SUCCESS=2,          /* empty                            */
     CPROTO_RES_ACK=3,                   /* empty                            */
+    CPROTO_RES_QUERY_BATCH=4,           /* [(tp, query response), ...]      */
     CPROTO_RES_FILE=5,                  /* file content                     */
+    CPROTO_RES_SUBSCRIBE=6,             /* subscription_id                  */
+    CPROTO_PUSH_POINTS=7,               /* {series: points, ...}            */
+    CPROTO_TEE_COLUMNAR=8,              /* {series: [[ts..], [val..]], ...} */
 
     /* Service API success */
     CPROTO_ACK_SERVICE=32,                /* empty                          */
@@ -82,6 +91,8 @@ typedef enum
     BPROTO_REQ_TAGS,                    /* empty                            */
     BPROTO_SERIES_TAGS,                 /* [series name, tag name, ...]     */
     BPROTO_EMPTY_TAGS,                  /* [tag name, tag name, ...]        */
+    BPROTO_QUERY_BATCH_SERVER,          /* [(query, time_precision), ...]   */
+    BPROTO_TEE_UPDATE,                  /* [pipe, filter_tp, filter, fmt]   */
 } bproto_client_t;
 
 /*
@@ -134,6 +145,7 @@ typedef enum
     BPROTO_RES_TAGS,                            /* [[name, series], ...]    */
     BPROTO_ACK_SERIES_TAGS,                     /* empty                    */
     BPROTO_ACK_EMPTY_TAGS,                      /* empty                    */
+    BPROTO_RES_QUERY_BATCH,                     /* [(tp, response), ...]    */
 } bproto_server_t;
 
 #define sirinet_protocol_is_error(tp) (tp >= 64 && tp < 192)
@@ -0,0 +1,33 @@
+/*
+ * scrub.h - Scrub task SiriDB.
+ *
+ * The scrub task runs in the background and verifies the checksums of shard
+ * chunks which are no longer written to. Corrupt shards are marked and will
+ * be repaired by the next optimize cycle.
+ */
+#ifndef SIRI_SCRUB_H_
+#define SIRI_SCRUB_H_
+
+#define SIRI_SCRUB_PENDING 0
+#define SIRI_SCRUB_RUNNING 1
+#define SIRI_SCRUB_CANCELLED 2
+
+typedef struct siri_scrub_s siri_scrub_t;
+
+#include <uv.h>
+#include <siri/siri.h>
+
+void siri_scrub_init(siri_t * siri);
+void siri_scrub_stop(siri_t * siri);
+
+struct siri_scrub_s
+{
+    uv_timer_t timer;
+    int status;
+    time_t start;
+    uv_work_t work;
+    size_t verified;    /* bytes verified in the last run */
+    size_t corrupt;     /* corrupt chunks found in the last run */
+};
+
+#endif  /* SIRI_SCRUB_H_ */
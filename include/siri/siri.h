@@ -47,6 +47,7 @@ extern siri_t siri;
 #include <siri/optimize.h>
 #include <siri/backup.h>
 #include <siri/heartbeat.h>
+#include <siri/scrub.h>
 #include <siri/cfg/cfg.h>
 #include <siri/args/args.h>
 #include <llist/llist.h>
@@ -68,6 +69,7 @@ struct siri_s
     uv_timer_t * backup;
     uv_timer_t * heartbeat;
     uv_timer_t * buffersync;
+    siri_scrub_t * scrub;
     siri_cfg_t * cfg;
     siri_args_t * args;
     uv_mutex_t siridb_mutex;
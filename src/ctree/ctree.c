@@ -40,6 +40,7 @@ static void CT_valuesn(
         ct_val_cb cb,
         void * args);
 static void CT_free(ct_node_t * node, ct_free_cb cb);
+static size_t CT_mem_usage(ct_node_t * node);
 
 /*
  * Returns NULL in case an error has occurred.
@@ -342,6 +343,26 @@ void ct_valuesn(ct_t * ct, size_t * n, ct_val_cb cb, void * args)
     }
 }
 
+/*
+ * Returns the memory in bytes which is allocated by the tree. This does not
+ * include the memory used by the values.
+ */
+size_t ct_mem_usage(ct_t * ct)
+{
+    ct_node_t * nd;
+    uint_fast16_t i, end;
+    size_t size = sizeof(ct_t) + ct->n * sizeof(ct_nodes_t);
+
+    for (i = 0, end = ct->n * BLOCKSZ; i < end; i++)
+    {
+        if ((nd = (*ct->nodes)[i]) != NULL)
+        {
+            size += CT_mem_usage(nd);
+        }
+    }
+    return size;
+}
+
 /*
  * Loop over all items in the tree and perform the call-back on each item.
  * Walking stops either when the call-back is called on each item or
@@ -894,3 +915,24 @@ static void CT_free(ct_node_t * node, ct_free_cb cb)
     free(node);
 }
 
+static size_t CT_mem_usage(ct_node_t * node)
+{
+    size_t size = sizeof(ct_node_t) + node->len;
+
+    if (node->nodes != NULL)
+    {
+        ct_node_t * nd;
+        uint_fast16_t i, end;
+
+        size += node->n * sizeof(ct_nodes_t);
+
+        for (i = 0, end = node->n * BLOCKSZ; i < end; i++)
+        {
+            if ((nd = (*node->nodes)[i]) != NULL)
+            {
+                size += CT_mem_usage(nd);
+            }
+        }
+    }
+    return size;
+}
@@ -10,6 +10,17 @@
 
 #define IMAP_NODE_SZ 32
 
+typedef struct
+{
+    imap_t * dest;
+    imap_t * imap;
+    imap_free_cb decref_cb;
+    uint64_t * ids;
+    size_t n;
+} IMAP_src_t;
+
+typedef void (*IMAP_id_cb)(uint64_t id, void * data, IMAP_src_t * src);
+
 static void IMAP_node_free(imap_node_t * node);
 static void IMAP_node_free_cb(imap_node_t * node, imap_free_cb cb);
 static int IMAP_set(imap_node_t * node, uint64_t id, void * data);
@@ -32,6 +43,12 @@ static void IMAP_symmetric_difference_ref(
         imap_node_t * dest,
         imap_node_t * node,
         imap_free_cb decref_cb);
+static void IMAP_walk_id(
+        imap_node_t * node,
+        uint64_t offset,
+        uint64_t mult,
+        IMAP_id_cb cb,
+        IMAP_src_t * src);
 
 static imap_node_t IMAP_empty_node = {
         .data = NULL,
@@ -749,6 +766,210 @@ void imap_symmetric_difference_ref(
     free(imap);
 }
 
+/*
+ * Walk over all items in a map and call the call-back with the id for each
+ * item. The call-back is not allowed to change the map.
+ */
+static void IMAP_walk_id_map(imap_t * imap, IMAP_id_cb cb, IMAP_src_t * src)
+{
+    if (imap->len)
+    {
+        imap_node_t * nd;
+        uint_fast8_t i;
+
+        for (i = 0; i < IMAP_NODE_SZ; i++)
+        {
+            nd = imap->nodes + i;
+
+            if (nd->data != NULL)
+            {
+                (*cb)(i, nd->data, src);
+            }
+
+            if (nd->nodes != NULL)
+            {
+                IMAP_walk_id(nd, i + IMAP_NODE_SZ, IMAP_NODE_SZ, cb, src);
+            }
+        }
+    }
+}
+
+static void IMAP_union_src_cb(uint64_t id, void * data, IMAP_src_t * src)
+{
+    if (imap_add(src->dest, id, data) == 0)
+    {
+        vec_object_incref(data);
+    }
+}
+
+static void IMAP_intersection_src_cb(
+        uint64_t id,
+        void * data __attribute__((unused)),
+        IMAP_src_t * src)
+{
+    if (imap_get(src->imap, id) == NULL)
+    {
+        src->ids[src->n++] = id;
+    }
+}
+
+static void IMAP_difference_src_cb(
+        uint64_t id,
+        void * data __attribute__((unused)),
+        IMAP_src_t * src)
+{
+    void * item = imap_pop(src->dest, id);
+    if (item != NULL)
+    {
+        (*src->decref_cb)(item);
+    }
+}
+
+static void IMAP_symmetric_difference_src_cb(
+        uint64_t id,
+        void * data,
+        IMAP_src_t * src)
+{
+    void * item = imap_pop(src->dest, id);
+    if (item != NULL)
+    {
+        (*src->decref_cb)(item);
+    }
+    else if (imap_add(src->dest, id, data) == 0)
+    {
+        vec_object_incref(data);
+    }
+}
+
+/*
+ * Map 'dest' will be the union between the two maps. Map 'imap' is not
+ * changed and can still be used. A reference is added for each item which
+ * is added to 'dest'.
+ *
+ * This function can be used to combine 'dest' with a map which is kept by
+ * another object (for example the series of a tag) without making a copy.
+ */
+void imap_union_src(
+        imap_t * dest,
+        imap_t * imap,
+        imap_free_cb decref_cb)
+{
+    IMAP_src_t src = {
+            .dest=dest,
+            .imap=imap,
+            .decref_cb=decref_cb,
+            .ids=NULL,
+            .n=0};
+
+    if (dest->vec != NULL)
+    {
+        vec_free(dest->vec);
+        dest->vec = NULL;
+    }
+
+    IMAP_walk_id_map(imap, IMAP_union_src_cb, &src);
+}
+
+/*
+ * Map 'dest' will be the intersection between the two maps. Map 'imap' is
+ * not changed and can still be used. Function 'decref_cb' is called for each
+ * item which is removed from 'dest'.
+ */
+void imap_intersection_src(
+        imap_t * dest,
+        imap_t * imap,
+        imap_free_cb decref_cb)
+{
+    IMAP_src_t src = {
+            .dest=dest,
+            .imap=imap,
+            .decref_cb=decref_cb,
+            .ids=NULL,
+            .n=0};
+    size_t i;
+
+    if (dest->vec != NULL)
+    {
+        vec_free(dest->vec);
+        dest->vec = NULL;
+    }
+
+    if (!dest->len)
+    {
+        return;
+    }
+
+    /* items cannot be removed while walking so we collect the id's first */
+    src.ids = malloc(dest->len * sizeof(uint64_t));
+    if (src.ids == NULL)
+    {
+        log_critical("Memory allocation error in intersection");
+        return;
+    }
+
+    IMAP_walk_id_map(dest, IMAP_intersection_src_cb, &src);
+
+    for (i = 0; i < src.n; i++)
+    {
+        (*decref_cb)(imap_pop(dest, src.ids[i]));
+    }
+
+    free(src.ids);
+}
+
+/*
+ * Map 'dest' will be the difference between the two maps. Map 'imap' is not
+ * changed and can still be used. Function 'decref_cb' is called for each
+ * item which is removed from 'dest'.
+ */
+void imap_difference_src(
+        imap_t * dest,
+        imap_t * imap,
+        imap_free_cb decref_cb)
+{
+    IMAP_src_t src = {
+            .dest=dest,
+            .imap=imap,
+            .decref_cb=decref_cb,
+            .ids=NULL,
+            .n=0};
+
+    if (dest->vec != NULL)
+    {
+        vec_free(dest->vec);
+        dest->vec = NULL;
+    }
+
+    IMAP_walk_id_map(imap, IMAP_difference_src_cb, &src);
+}
+
+/*
+ * Map 'dest' will be the symmetric difference between the two maps. Map
+ * 'imap' is not changed and can still be used. A reference is added for each
+ * item which is added to 'dest' and function 'decref_cb' is called for each
+ * item which is removed from 'dest'.
+ */
+void imap_symmetric_difference_src(
+        imap_t * dest,
+        imap_t * imap,
+        imap_free_cb decref_cb)
+{
+    IMAP_src_t src = {
+            .dest=dest,
+            .imap=imap,
+            .decref_cb=decref_cb,
+            .ids=NULL,
+            .n=0};
+
+    if (dest->vec != NULL)
+    {
+        vec_free(dest->vec);
+        dest->vec = NULL;
+    }
+
+    IMAP_walk_id_map(imap, IMAP_symmetric_difference_src_cb, &src);
+}
+
 static void IMAP_node_free(imap_node_t * node)
 {
     imap_node_t * nd = node->nodes, * end = nd + IMAP_node_size(node);
@@ -1251,3 +1472,39 @@ static void IMAP_symmetric_difference_ref(
 
     free(node->nodes);
 }
+
+/*
+ * Recursive function, the id for an item in 'node' is calculated as
+ * 'offset + mult * key' where 'key' is the position within the node.
+ */
+static void IMAP_walk_id(
+        imap_node_t * node,
+        uint64_t offset,
+        uint64_t mult,
+        IMAP_id_cb cb,
+        IMAP_src_t * src)
+{
+    imap_node_t * nd = node->nodes, * end = nd + IMAP_node_size(node);
+    uint64_t key;
+
+    do
+    {
+        key = (node->key == IMAP_NODE_SZ) ? nd - node->nodes : node->key;
+
+        if (nd->data != NULL)
+        {
+            (*cb)(offset + mult * key, nd->data, src);
+        }
+
+        if (nd->nodes != NULL)
+        {
+            IMAP_walk_id(
+                    nd,
+                    offset + mult * (key + IMAP_NODE_SZ),
+                    mult * IMAP_NODE_SZ,
+                    cb,
+                    src);
+        }
+    }
+    while (++nd < end);
+}
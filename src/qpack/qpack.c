@@ -241,6 +241,18 @@ void qp_packer_free(qp_packer_t * packer)
     free(packer);
 }
 
+/*
+ * Make sure the packer has room for at least `n` more bytes. This should be
+ * called before using the unchecked qp_put_*() functions.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+int qp_packer_reserve(qp_packer_t * packer, size_t n)
+{
+    QP_RESIZE(n)
+    return 0;
+}
+
 /*
  * Extend packer with another packer (source).
  *
@@ -278,6 +290,22 @@ int qp_packer_extend_fu(qp_packer_t * packer, qp_unpacker_t * unpacker)
     return 0;
 }
 
+/*
+ * Extend packer with `n` bytes which should contain valid qpack data.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+int qp_packer_extend_bytes(
+        qp_packer_t * packer,
+        const unsigned char * pt,
+        size_t n)
+{
+    QP_RESIZE(n)
+    memcpy(packer->buffer + packer->len, pt, n);
+    packer->len += n;
+    return 0;
+}
+
 /*
  * Print qpack content.
  */
@@ -447,25 +475,8 @@ int qp_add_raw_term(qp_packer_t * packer, const unsigned char * raw, size_t len_
  */
 int qp_add_double(qp_packer_t * packer, double real)
 {
-    QP_RESIZE(9)
-    if (real == 0.0)
-    {
-        packer->buffer[packer->len++] = QP_DOUBLE_0;
-    }
-    else if (real == 1.0)
-    {
-        packer->buffer[packer->len++] = QP_DOUBLE_1;
-    }
-    else if (real == -1.0)
-    {
-        packer->buffer[packer->len++] = QP_DOUBLE_N1;
-    }
-    else
-    {
-        packer->buffer[packer->len++] = QP_DOUBLE;
-        memcpy(packer->buffer + packer->len, &real, sizeof(double));
-        packer->len += sizeof(double);
-    }
+    QP_RESIZE(QP_MAX_NUM_SZ)
+    qp_put_double(packer, real);
     return 0;
 }
 
@@ -481,51 +492,8 @@ int qp_add_double(qp_packer_t * packer, double real)
  */
 int qp_add_int64(qp_packer_t * packer, int64_t integer)
 {
-    int8_t i8;
-    if ((i8 = (int8_t) integer) == integer)
-    {
-        QP_RESIZE(2)
-        if (i8 >= 0 && i8 < 64)
-        {
-            packer->buffer[packer->len++] = i8;
-        }
-        else if (i8 >= -60 && i8 < 0)
-        {
-            packer->buffer[packer->len++] = 63 - i8;
-        }
-        else
-        {
-            packer->buffer[packer->len++] = QP_INT8;
-            packer->buffer[packer->len++] = i8;
-        }
-        return 0;
-    }
-
-    int16_t i16;
-    if ((i16 = (int16_t) integer) == integer)
-    {
-        QP_RESIZE(3)
-        packer->buffer[packer->len++] = QP_INT16;
-        memcpy(packer->buffer + packer->len, &i16, sizeof(int16_t));
-        packer->len += sizeof(int16_t);
-        return 0;
-    }
-
-    int32_t i32;
-    if ((i32 = (int32_t) integer) == integer)
-    {
-        QP_RESIZE(5)
-        packer->buffer[packer->len++] = QP_INT32;
-        memcpy(packer->buffer + packer->len, &i32, sizeof(int32_t));
-        packer->len += sizeof(int32_t);
-        return 0;
-    }
-
-
-    QP_RESIZE(9)
-    packer->buffer[packer->len++] = QP_INT64;
-    memcpy(packer->buffer + packer->len, &integer, sizeof(int64_t));
-    packer->len += sizeof(int64_t);
+    QP_RESIZE(QP_MAX_NUM_SZ)
+    qp_put_int64(packer, integer);
     return 0;
 }
 
@@ -681,6 +649,84 @@ int qp_fadd_double(qp_fpacker_t * fpacker, double real)
     return 0;
 }
 
+/*
+ * Unpack an integer or double at `*pt`. Returns QP_INT64 or QP_DOUBLE and
+ * moves `*pt` to the next object if successful. QP_ERR is returned, without
+ * moving `*pt`, if no number is found. At least one byte must be available.
+ */
+static inline qp_types_t QP_unpack_num(
+        unsigned char ** pt,
+        unsigned char * end,
+        qp_via_t * via)
+{
+    unsigned char * p = *pt;
+    uint8_t tp = *p++;
+
+    if (tp < 64)
+    {
+        via->int64 = (int64_t) tp;
+        *pt = p;
+        return QP_INT64;
+    }
+
+    if (tp < QP_HOOK)
+    {
+        via->int64 = (int64_t) 63 - tp;
+        *pt = p;
+        return QP_INT64;
+    }
+
+    switch (tp)
+    {
+    case QP_DOUBLE_N1:
+    case QP_DOUBLE_0:
+    case QP_DOUBLE_1:
+        via->real = (double) (tp - QP_DOUBLE_0);
+        *pt = p;
+        return QP_DOUBLE;
+    case QP_INT8:
+        if (p + sizeof(int8_t) > end)
+            return QP_ERR;
+        via->int64 = (int64_t) *((int8_t *) p);
+        *pt = p + sizeof(int8_t);
+        return QP_INT64;
+    case QP_INT16:
+    {
+        int16_t i16;
+        if (p + sizeof(int16_t) > end)
+            return QP_ERR;
+        memcpy(&i16, p, sizeof(int16_t));
+        via->int64 = (int64_t) i16;
+        *pt = p + sizeof(int16_t);
+        return QP_INT64;
+    }
+    case QP_INT32:
+    {
+        int32_t i32;
+        if (p + sizeof(int32_t) > end)
+            return QP_ERR;
+        memcpy(&i32, p, sizeof(int32_t));
+        via->int64 = (int64_t) i32;
+        *pt = p + sizeof(int32_t);
+        return QP_INT64;
+    }
+    case QP_INT64:
+        if (p + sizeof(int64_t) > end)
+            return QP_ERR;
+        memcpy(&via->int64, p, sizeof(int64_t));
+        *pt = p + sizeof(int64_t);
+        return QP_INT64;
+    case QP_DOUBLE:
+        if (p + sizeof(double) > end)
+            return QP_ERR;
+        memcpy(&via->real, p, sizeof(double));
+        *pt = p + sizeof(double);
+        return QP_DOUBLE;
+    }
+
+    return QP_ERR;
+}
+
 /*
  * Jump to the next object. If 'qp_obj' is not NULL, the object will be stored
  * in qp_obj so you can use it later.
@@ -1040,6 +1086,40 @@ qp_types_t qp_next(qp_unpacker_t * unpacker, qp_obj_t * qp_obj)
     return -1;
 }
 
+/*
+ * Fast path for unpacking a point, which is an array with two items where the
+ * first is an integer time-stamp and the second an integer or double value.
+ *
+ * Returns 0 if successful. When the next object has a different shape, -1
+ * is returned and the unpacker is not moved so qp_next() can be used.
+ */
+int qp_next_point(qp_unpacker_t * unpacker, int64_t * ts, qp_obj_t * qp_val)
+{
+    unsigned char * pt = unpacker->pt;
+
+    if (    pt >= unpacker->end ||
+            *pt != QP_ARRAY2 ||
+            ++pt >= unpacker->end ||
+            QP_unpack_num(&pt, unpacker->end, &qp_val->via) != QP_INT64)
+    {
+        return -1;
+    }
+
+    *ts = qp_val->via.int64;
+
+    if (    pt >= unpacker->end ||
+            (qp_val->tp = QP_unpack_num(
+                    &pt,
+                    unpacker->end,
+                    &qp_val->via)) == QP_ERR)
+    {
+        return -1;
+    }
+
+    unpacker->pt = pt;
+    return 0;
+}
+
 /*
  * Returns one of the following: (these are the ONLY possible return values)
  *
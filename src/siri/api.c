@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <math.h>
 #include <siri/api.h>
+#include <siri/auth.h>
 #include <stdbool.h>
 #include <string.h>
 #include <siri/siri.h>
@@ -144,6 +145,7 @@ static void api__reset(siri_api_request_t * ar)
     ar->size = 0;
     ar->on_state = NULL;
     ar->service_authenticated = 0;
+    ar->token_authenticated = 0;
     ar->request_type = SIRI_API_RT_NONE;
     ar->content_type = SIRI_API_CT_TEXT;
 }
@@ -240,6 +242,11 @@ static int api__url_cb(http_parser * parser, const char * at, size_t n)
         ar->request_type = SIRI_API_RT_INSERT;
         api__get_siridb(ar, at, n);
     }
+    else if (api__starts_with(&at, &n, "/token/", strlen("/token/")))
+    {
+        ar->request_type = SIRI_API_RT_TOKEN;
+        api__get_siridb(ar, at, n);
+    }
     else if (API__CMP_WITH(at, n, "/new-account"))
     {
         ar->request_type = SIRI_APT_RT_SERVICE;
@@ -371,22 +378,38 @@ static int api__on_content_type(siri_api_request_t * ar, const char * at, size_t
 
 static int api__on_authorization(siri_api_request_t * ar, const char * at, size_t n)
 {
+    siridb_user_t * user;
+
+    if (ar->origin)
+    {
+        return 0;  /* already authenticated */
+    }
+
     if (api__istarts_with(&at, &n, "bearer ", strlen("bearer ")))
     {
-        log_debug("token authorization is not supported yet");
+        /* tokens are only valid for database users */
+        user = ar->siridb
+                ? siri_auth_token_user(ar->siridb, at, n)
+                : NULL;
+
+        if (user)
+        {
+            siridb_user_incref(user);
+            ar->origin = user;
+            ar->token_authenticated = 1;
+        }
+        return 0;
     }
 
     if (api__istarts_with(&at, &n, "basic ", strlen("basic ")))
     {
         if (ar->request_type == SIRI_APT_RT_SERVICE)
         {
-            ar->service_authenticated = \
-                    siri_service_account_check_basic(&siri, at, n);
+            ar->service_authenticated = siri_auth_basic_service(at, n);
             return 0;
         }
-        siridb_user_t * user;
         user = ar->siridb
-                ? siridb_users_get_user_from_basic(ar->siridb, at, n)
+                ? siri_auth_basic_user(ar->siridb, at, n)
                 : NULL;
 
         if (user)
@@ -728,6 +751,47 @@ static int api__query_cb(http_parser * parser)
     return api__plain_response(ar, E415_UNSUPPORTED_MEDIA_TYPE);
 }
 
+/*
+ * Issue a new token. A token can only be requested using basic
+ * authorization so a token cannot be used to extend its own lifetime.
+ */
+static int api__token_cb(http_parser * parser)
+{
+    char token[SIRI_AUTH_TOKEN_LEN + 1];
+    siri_api_request_t * ar = parser->data;
+    qp_packer_t * packer;
+    int rc;
+
+    if (parser->method != HTTP_POST)
+        return api__plain_response(ar, E405_METHOD_NOT_ALLOWED);
+
+    if (!ar->siridb)
+        return api__plain_response(ar, E404_NOT_FOUND);
+
+    if (!ar->origin || ar->token_authenticated)
+        return api__plain_response(ar, E401_UNAUTHORIZED);
+
+    if (siri_auth_token_new((siridb_user_t *) ar->origin, token))
+        return api__plain_response(ar, E500_INTERNAL_SERVER_ERROR);
+
+    packer = qp_packer_new(128);
+    if (packer == NULL)
+        return api__plain_response(ar, E500_INTERNAL_SERVER_ERROR);
+
+    if (ar->content_type == SIRI_API_CT_TEXT)
+        ar->content_type = SIRI_API_CT_JSON;
+
+    qp_add_type(packer, QP_MAP2);
+    qp_add_raw(packer, (const unsigned char *) "token", 5);
+    qp_add_raw(packer, (const unsigned char *) token, SIRI_AUTH_TOKEN_LEN);
+    qp_add_raw(packer, (const unsigned char *) "expires_in", 10);
+    qp_add_int64(packer, SIRI_AUTH_TOKEN_TTL);
+
+    rc = siri_api_send(ar, E200_OK, packer->buffer, packer->len);
+    qp_packer_free(packer);
+    return rc;
+}
+
 static int api__service_cb(http_parser * parser)
 {
     qp_unpacker_t up;
@@ -835,6 +899,8 @@ static int api__message_complete_cb(http_parser * parser)
         return api__insert_cb(parser);
     case SIRI_APT_RT_SERVICE:
         return api__service_cb(parser);
+    case SIRI_API_RT_TOKEN:
+        return api__token_cb(parser);
     }
 
     return api__plain_response(ar, E500_INTERNAL_SERVER_ERROR);
@@ -886,6 +952,9 @@ int siri_api_init(void)
         (void) uv_ip6_addr("::", (int) port, (struct sockaddr_in6 *) &addr);
     }
 
+    if (siri_auth_init())
+        return -1;
+
     api__settings.on_url = api__url_cb;
     api__settings.on_header_field = api__header_field_cb;
     api__settings.on_header_value = api__header_value_cb;
@@ -0,0 +1,429 @@
+/*
+ * auth.c - Credential cache and tokens for the HTTP API.
+ *
+ * Verifying a basic authorization header requires a password hash which is
+ * expensive when handling many HTTP requests. Verified headers are therefore
+ * cached for SIRI_AUTH_CACHE_TTL seconds. The cache is keyed by a SipHash of
+ * the header using a random key, so the credentials themselves are never
+ * kept in memory.
+ *
+ * Tokens can be requested using basic authorization and can be used as
+ * bearer token for SIRI_AUTH_TOKEN_TTL seconds.
+ *
+ * A cached credential or token is only valid as long as the user is still
+ * part of the database. Changing a password or name drops all cached
+ * credentials and tokens for the user.
+ *
+ * All functions must be called from the main thread.
+ */
+#include <fcntl.h>
+#include <inttypes.h>
+#include <logger/logger.h>
+#include <siri/auth.h>
+#include <siri/db/users.h>
+#include <siri/service/account.h>
+#include <siri/siri.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* number of cached credentials, must be a power of 2 */
+#define AUTH_CACHE_SZ 256
+
+/* maximum number of tokens, must be a power of 2 */
+#define AUTH_TOKENS_SZ 1024
+
+/* number of slots to search for a token */
+#define AUTH_TOKENS_PROBE 8
+
+typedef struct
+{
+    uint64_t hash;
+    uint64_t expire;            /* 0 when the slot is empty */
+    siridb_t * siridb;          /* NULL for service accounts */
+    siridb_user_t * user;       /* NULL for service accounts */
+} AUTH_cred_t;
+
+typedef struct
+{
+    uint64_t id;
+    uint64_t secret;
+    uint64_t expire;            /* 0 when the slot is empty */
+    siridb_user_t * user;
+} AUTH_token_t;
+
+static uint64_t auth__key[2];
+static uint64_t auth__counter;
+static AUTH_cred_t auth__cache[AUTH_CACHE_SZ];
+static AUTH_token_t auth__tokens[AUTH_TOKENS_SZ];
+
+#define AUTH_ROTL(x__, b__) \
+    (uint64_t) (((x__) << (b__)) | ((x__) >> (64 - (b__))))
+
+#define AUTH_SIPROUND           \
+    do {                        \
+        v0 += v1;               \
+        v1 = AUTH_ROTL(v1, 13); \
+        v1 ^= v0;               \
+        v0 = AUTH_ROTL(v0, 32); \
+        v2 += v3;               \
+        v3 = AUTH_ROTL(v3, 16); \
+        v3 ^= v2;               \
+        v0 += v3;               \
+        v3 = AUTH_ROTL(v3, 21); \
+        v3 ^= v0;               \
+        v2 += v1;               \
+        v1 = AUTH_ROTL(v1, 17); \
+        v1 ^= v2;               \
+        v2 = AUTH_ROTL(v2, 32); \
+    } while(0)
+
+/*
+ * SipHash-2-4 using the random key.
+ */
+static uint64_t AUTH_hash(const void * data, size_t n)
+{
+    const unsigned char * pt = data;
+    const unsigned char * end = pt + (n - (n % 8));
+    uint64_t v0 = 0x736f6d6570736575ULL ^ auth__key[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ auth__key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ auth__key[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ auth__key[1];
+    uint64_t b = ((uint64_t) n) << 56;
+    uint64_t m;
+    size_t i;
+
+    for (; pt != end; pt += 8)
+    {
+        memcpy(&m, pt, sizeof(uint64_t));
+        v3 ^= m;
+        AUTH_SIPROUND;
+        AUTH_SIPROUND;
+        v0 ^= m;
+    }
+
+    for (i = 0; i < n % 8; i++)
+    {
+        b |= ((uint64_t) pt[i]) << (8 * i);
+    }
+
+    v3 ^= b;
+    AUTH_SIPROUND;
+    AUTH_SIPROUND;
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    AUTH_SIPROUND;
+    AUTH_SIPROUND;
+    AUTH_SIPROUND;
+    AUTH_SIPROUND;
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+static int AUTH_is_user(siridb_user_t * user, siridb_user_t * other)
+{
+    return user == other;
+}
+
+/*
+ * Returns true if the user is (still) a user of the given database.
+ */
+static inline bool AUTH_has_user(siridb_t * siridb, siridb_user_t * user)
+{
+    return llist_get(siridb->users, (llist_cb) AUTH_is_user, user) != NULL;
+}
+
+static inline uint64_t AUTH_now(void)
+{
+    return uv_now(siri.loop);
+}
+
+static void AUTH_cred_clear(AUTH_cred_t * cred)
+{
+    if (cred->user != NULL)
+    {
+        siridb_user_decref(cred->user);
+    }
+    memset(cred, 0, sizeof(AUTH_cred_t));
+}
+
+static void AUTH_token_clear(AUTH_token_t * token)
+{
+    if (token->user != NULL)
+    {
+        siridb_user_decref(token->user);
+    }
+    memset(token, 0, sizeof(AUTH_token_t));
+}
+
+/*
+ * Initialize the random key which is used for hashing credentials and
+ * generating tokens.
+ *
+ * Returns 0 if successful or -1 in case of an error.
+ */
+int siri_auth_init(void)
+{
+    int fd;
+    ssize_t n;
+
+    memset(auth__cache, 0, sizeof(auth__cache));
+    memset(auth__tokens, 0, sizeof(auth__tokens));
+
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd == -1)
+    {
+        log_error("Cannot open '/dev/urandom' for reading");
+        return -1;
+    }
+
+    n = read(fd, auth__key, sizeof(auth__key));
+    close(fd);
+
+    if (n != (ssize_t) sizeof(auth__key))
+    {
+        log_error("Cannot read a random key from '/dev/urandom'");
+        return -1;
+    }
+
+    auth__counter = 0;
+    return 0;
+}
+
+/*
+ * Release all cached credentials and tokens.
+ */
+void siri_auth_destroy(void)
+{
+    size_t i;
+
+    for (i = 0; i < AUTH_CACHE_SZ; i++)
+    {
+        AUTH_cred_clear(auth__cache + i);
+    }
+
+    for (i = 0; i < AUTH_TOKENS_SZ; i++)
+    {
+        AUTH_token_clear(auth__tokens + i);
+    }
+}
+
+/*
+ * Returns a user (borrowed reference) if the basic authorization data is
+ * valid for the given database, or NULL if not.
+ */
+siridb_user_t * siri_auth_basic_user(
+        siridb_t * siridb,
+        const char * data,
+        size_t n)
+{
+    siridb_user_t * user;
+    uint64_t now = AUTH_now();
+    uint64_t hash = AUTH_hash(data, n);
+    AUTH_cred_t * cred = auth__cache +
+            ((hash ^ (uintptr_t) siridb) & (AUTH_CACHE_SZ - 1));
+
+    if (    cred->expire > now &&
+            cred->hash == hash &&
+            cred->siridb == siridb &&
+            cred->user != NULL &&
+            AUTH_has_user(siridb, cred->user))
+    {
+        return cred->user;
+    }
+
+    user = siridb_users_get_user_from_basic(siridb, data, n);
+    if (user != NULL)
+    {
+        AUTH_cred_clear(cred);
+        cred->hash = hash;
+        cred->expire = now + SIRI_AUTH_CACHE_TTL * 1000;
+        cred->siridb = siridb;
+        cred->user = user;
+        siridb_user_incref(user);
+    }
+
+    return user;
+}
+
+/*
+ * Returns true if the basic authorization data is valid for a service
+ * account.
+ */
+bool siri_auth_basic_service(const char * data, size_t n)
+{
+    uint64_t now = AUTH_now();
+    uint64_t hash = AUTH_hash(data, n);
+    AUTH_cred_t * cred = auth__cache + (hash & (AUTH_CACHE_SZ - 1));
+
+    if (    cred->expire > now &&
+            cred->hash == hash &&
+            cred->siridb == NULL)
+    {
+        return true;
+    }
+
+    if (siri_service_account_check_basic(&siri, data, n))
+    {
+        AUTH_cred_clear(cred);
+        cred->hash = hash;
+        cred->expire = now + SIRI_AUTH_CACHE_TTL * 1000;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Issue a new token for the given user. The token is written to `token` as
+ * a terminated string.
+ *
+ * Returns 0 if successful or -1 in case of an error.
+ */
+int siri_auth_token_new(
+        siridb_user_t * user,
+        char token[SIRI_AUTH_TOKEN_LEN + 1])
+{
+    uint64_t now = AUTH_now();
+    uint64_t input[2];
+    AUTH_token_t * slot = NULL, * tok;
+    uint64_t id, secret;
+    size_t i;
+
+    input[0] = ++auth__counter;
+    input[1] = 0;
+    id = AUTH_hash(input, sizeof(input));
+    input[1] = 1;
+    secret = AUTH_hash(input, sizeof(input));
+
+    /* use an empty or expired slot, or replace the first to expire */
+    for (i = 0; i < AUTH_TOKENS_PROBE; i++)
+    {
+        tok = auth__tokens + ((id + i) & (AUTH_TOKENS_SZ - 1));
+        if (tok->expire <= now)
+        {
+            slot = tok;
+            break;
+        }
+        if (slot == NULL || tok->expire < slot->expire)
+        {
+            slot = tok;
+        }
+    }
+
+    AUTH_token_clear(slot);
+
+    if (snprintf(
+            token,
+            SIRI_AUTH_TOKEN_LEN + 1,
+            "%016" PRIx64 "%016" PRIx64,
+            id,
+            secret) != SIRI_AUTH_TOKEN_LEN)
+    {
+        return -1;
+    }
+
+    slot->id = id;
+    slot->secret = secret;
+    slot->expire = now + SIRI_AUTH_TOKEN_TTL * 1000;
+    slot->user = user;
+    siridb_user_incref(user);
+
+    return 0;
+}
+
+/*
+ * Returns a user (borrowed reference) if the bearer token is valid for the
+ * given database, or NULL if not.
+ */
+siridb_user_t * siri_auth_token_user(
+        siridb_t * siridb,
+        const char * data,
+        size_t n)
+{
+    char buf[17];
+    char * end;
+    uint64_t id, secret;
+    uint64_t now = AUTH_now();
+    AUTH_token_t * tok;
+    size_t i;
+
+    if (n != SIRI_AUTH_TOKEN_LEN)
+    {
+        return NULL;
+    }
+
+    memcpy(buf, data, 16);
+    buf[16] = '\0';
+    id = strtoull(buf, &end, 16);
+    if (end != buf + 16)
+    {
+        return NULL;
+    }
+
+    memcpy(buf, data + 16, 16);
+    secret = strtoull(buf, &end, 16);
+    if (end != buf + 16)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < AUTH_TOKENS_PROBE; i++)
+    {
+        tok = auth__tokens + ((id + i) & (AUTH_TOKENS_SZ - 1));
+        if (tok->id == id && tok->expire)
+        {
+            return (
+                tok->secret == secret &&
+                tok->expire > now &&
+                AUTH_has_user(siridb, tok->user)) ? tok->user : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Drop cached credentials and tokens for a user. Must be called when the
+ * password or name for a user changes or when a user is dropped.
+ */
+void siri_auth_drop_user(siridb_user_t * user)
+{
+    size_t i;
+
+    for (i = 0; i < AUTH_CACHE_SZ; i++)
+    {
+        if (auth__cache[i].user == user)
+        {
+            AUTH_cred_clear(auth__cache + i);
+        }
+    }
+
+    for (i = 0; i < AUTH_TOKENS_SZ; i++)
+    {
+        if (auth__tokens[i].user == user)
+        {
+            AUTH_token_clear(auth__tokens + i);
+        }
+    }
+}
+
+/*
+ * Drop cached service account credentials. Must be called when a service
+ * account password changes or when a service account is dropped.
+ */
+void siri_auth_drop_service(void)
+{
+    size_t i;
+
+    for (i = 0; i < AUTH_CACHE_SZ; i++)
+    {
+        if (auth__cache[i].expire && auth__cache[i].siridb == NULL)
+        {
+            AUTH_cred_clear(auth__cache + i);
+        }
+    }
+}
@@ -9,6 +9,7 @@
 #include <siri/db/servers.h>
 #include <siri/db/shard.h>
 #include <siri/db/shards.h>
+#include <siri/db/tags.h>
 #include <siri/optimize.h>
 #include <siri/siri.h>
 #include <stddef.h>
@@ -162,16 +163,15 @@ static int BACKUP_walk(siridb_t * siridb, void * args __attribute__((unused)))
         siridb_fifo_close(siridb->fifo);
     }
 
-    if (siridb->buffer->fp != NULL)
+    if (siridb->buffer->fp != NULL && siridb_buffer_close(siridb->buffer))
     {
-        if (fclose(siridb->buffer->fp) == 0)
-        {
-            siridb->buffer->fp = NULL;
-        }
-        else
-        {
-            log_critical("Cannot close buffer file");
-        }
+        log_critical("Cannot close buffer file");
+    }
+
+    if (siridb->tags->journal != NULL &&
+        siridb_tags_journal_close(siridb->tags))
+    {
+        log_critical("Cannot close tag journal");
     }
 
     if (siridb->dropped_fp != NULL)
@@ -32,7 +32,10 @@ static siri_cfg_t siri_cfg = {
         .pipe_support=0,
         .pipe_client_name="siridb_client.sock",
         .buffer_sync_interval=0,
-        .ignore_broken_data=0
+        .scrub_interval=0,
+        .ignore_broken_data=0,
+        .optimize_drop_cache=1,
+        .select_read_ahead=1
 };
 
 static void SIRI_CFG_read_uint(
@@ -58,6 +61,10 @@ static void SIRI_CFG_read_shard_compression(cfgparser_t * cfgparser);
 static void SIRI_CFG_read_shard_auto_duration(cfgparser_t * cfgparser);
 static void SIRI_CFG_read_pipe_support(cfgparser_t * cfgparser);
 static void SIRI_CFG_ignore_broken_data(cfgparser_t * cfgparser);
+static void SIRI_CFG_read_flag(
+        cfgparser_t * cfgparser,
+        const char * option_name,
+        uint8_t * value);
 
 void siri_cfg_init(siri_t * siri)
 {
@@ -162,8 +169,25 @@ void siri_cfg_init(siri_t * siri)
             &tmp);
     siri_cfg.buffer_sync_interval = (uint32_t) tmp;
 
+    SIRI_CFG_read_uint(
+            cfgparser,
+            "scrub_interval",
+            0,
+            2419200,  /* 4 weeks */
+            &siri_cfg.scrub_interval);
+
     SIRI_CFG_ignore_broken_data(cfgparser);
 
+    SIRI_CFG_read_flag(
+            cfgparser,
+            "optimize_drop_cache",
+            &siri_cfg.optimize_drop_cache);
+
+    SIRI_CFG_read_flag(
+            cfgparser,
+            "select_read_ahead",
+            &siri_cfg.select_read_ahead);
+
     cfgparser_free(cfgparser);
 }
 
@@ -384,6 +408,42 @@ static void SIRI_CFG_ignore_broken_data(cfgparser_t * cfgparser)
     }
 }
 
+/*
+ * Read an optional option which can be 0 (disabled) or 1 (enabled). The
+ * default value is kept when the option is missing or invalid.
+ */
+static void SIRI_CFG_read_flag(
+        cfgparser_t * cfgparser,
+        const char * option_name,
+        uint8_t * value)
+{
+    cfgparser_option_t * option;
+    cfgparser_return_t rc;
+    rc = cfgparser_get_option(
+            &option,
+            cfgparser,
+            "siridb",
+            option_name);
+    if (rc != CFGPARSER_SUCCESS)
+    {
+        return;  /* optional config option */
+    }
+
+    if (    option->tp != CFGPARSER_TP_INTEGER ||
+            option->val->integer < 0 ||
+            option->val->integer > 1)
+    {
+        log_warning(
+                "Error reading '%s' in '%s': %s.",
+                option_name,
+                siri.args->config,
+                "error: expecting 0 or 1");
+        return;
+    }
+
+    *value = (uint8_t) option->val->integer;
+}
+
 static void SIRI_CFG_read_addr(
         cfgparser_t * cfgparser,
         const char * option_name,
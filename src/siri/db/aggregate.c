@@ -46,6 +46,7 @@ static AGGR_cb AGGREGATES[F_OFFSET];
 static siridb_aggr_t * AGGREGATE_new(uint32_t gid);
 static int AGGREGATE_regex_cmp(siridb_aggr_t * aggr, char * val);
 static void AGGREGATE_free(siridb_aggr_t * aggr);
+static uint32_t AGGREGATE_keyword_gid(uint32_t gid);
 static int AGGREGATE_init_filter(
         siridb_aggr_t * aggr,
         cleri_node_t * node,
@@ -71,6 +72,18 @@ static siridb_points_t * AGGREGATE_filter(
         siridb_points_t * source,
         siridb_aggr_t * aggr,
         char * err_msg);
+static siridb_points_t * AGGREGATE_moving(
+        siridb_points_t * source,
+        siridb_aggr_t * aggr,
+        char * err_msg);
+static siridb_points_t * AGGREGATE_ewma(
+        siridb_points_t * source,
+        siridb_aggr_t * aggr,
+        char * err_msg);
+static siridb_points_t * AGGREGATE_downsample(
+        siridb_points_t * source,
+        siridb_aggr_t * aggr,
+        char * err_msg);
 static siridb_points_t * AGGREGATE_to_one(
         siridb_points_t * source,
         siridb_aggr_t * aggr,
@@ -242,72 +255,7 @@ vec_t * siridb_aggregate_list(cleri_children_t * children, char * err_msg)
                         next->next->next->node->children->node->
                         cl_obj->gid;
 
-                switch (gid)
-                {
-                case CLERI_GID_K_MEAN:
-                    aggr->gid = CLERI_GID_F_MEAN;
-                    break;
-
-                case CLERI_GID_K_MEDIAN:
-                    aggr->gid = CLERI_GID_F_MEDIAN;
-                    break;
-
-                case CLERI_GID_K_MEDIAN_LOW:
-                    aggr->gid = CLERI_GID_F_MEDIAN_LOW;
-                    break;
-
-                case CLERI_GID_K_MEDIAN_HIGH:
-                    aggr->gid = CLERI_GID_F_MEDIAN_HIGH;
-                    break;
-
-                case CLERI_GID_K_SUM:
-                    aggr->gid = CLERI_GID_F_SUM;
-                    break;
-
-                case CLERI_GID_K_MIN:
-                    aggr->gid = CLERI_GID_F_MIN;
-                    break;
-
-                case CLERI_GID_K_MAX:
-                    aggr->gid = CLERI_GID_F_MAX;
-                    break;
-
-                case CLERI_GID_K_COUNT:
-                    aggr->gid = CLERI_GID_F_COUNT;
-                    break;
-
-                case CLERI_GID_K_VARIANCE:
-                    aggr->gid = CLERI_GID_F_VARIANCE;
-                    break;
-
-                case CLERI_GID_K_PVARIANCE:
-                    aggr->gid = CLERI_GID_F_PVARIANCE;
-                    break;
-
-                case CLERI_GID_K_STDDEV:
-                    aggr->gid = CLERI_GID_F_STDDEV;
-                    break;
-
-                case CLERI_GID_K_FIRST:
-                    aggr->gid = CLERI_GID_F_FIRST;
-                    break;
-
-                case CLERI_GID_K_LAST:
-                    aggr->gid = CLERI_GID_F_LAST;
-                    break;
-
-                case CLERI_GID_K_TIMEVAL:
-                    aggr->gid = CLERI_GID_F_TIMEVAL;
-                    break;
-
-                case CLERI_GID_K_INTERVAL:
-                    aggr->gid = CLERI_GID_F_INTERVAL;
-                    break;
-
-                default:
-                    assert (0);
-                    break;
-                }
+                aggr->gid = AGGREGATE_keyword_gid(gid);
             }
 
             VEC_APPEND
@@ -406,6 +354,122 @@ vec_t * siridb_aggregate_list(cleri_children_t * children, char * err_msg)
 
             break;
 
+        case CLERI_GID_F_MOVING:
+            AGGR_NEW
+            {
+                /* result is always positive, checked earlier */
+                aggr->window = CLERI_NODE_DATA(children->node->children->
+                        node->children->next->next->node);
+
+                if (!aggr->window)
+                {
+                    sprintf(err_msg,
+                            "Window must be an integer value "
+                            "larger than zero.");
+                    AGGREGATE_free(aggr);
+                    siridb_aggregate_list_free(vec);
+                    return NULL;
+                }
+
+                gid = children->node->children->node->children->next->
+                        next->next->next->node->children->node->
+                        cl_obj->gid;
+
+                switch (gid)
+                {
+                case CLERI_GID_K_MEAN:
+                    aggr->moving_gid = CLERI_GID_F_MEAN;
+                    break;
+
+                case CLERI_GID_K_SUM:
+                    aggr->moving_gid = CLERI_GID_F_SUM;
+                    break;
+
+                case CLERI_GID_K_MIN:
+                    aggr->moving_gid = CLERI_GID_F_MIN;
+                    break;
+
+                case CLERI_GID_K_MAX:
+                    aggr->moving_gid = CLERI_GID_F_MAX;
+                    break;
+
+                case CLERI_GID_K_COUNT:
+                    aggr->moving_gid = CLERI_GID_F_COUNT;
+                    break;
+
+                case CLERI_GID_K_VARIANCE:
+                    aggr->moving_gid = CLERI_GID_F_VARIANCE;
+                    break;
+
+                case CLERI_GID_K_PVARIANCE:
+                    aggr->moving_gid = CLERI_GID_F_PVARIANCE;
+                    break;
+
+                case CLERI_GID_K_STDDEV:
+                    aggr->moving_gid = CLERI_GID_F_STDDEV;
+                    break;
+
+                case CLERI_GID_K_DERIVATIVE:
+                    aggr->moving_gid = CLERI_GID_F_DERIVATIVE;
+                    break;
+
+                default:
+                    assert (0);
+                    break;
+                }
+            }
+
+            VEC_APPEND
+
+            break;
+
+        case CLERI_GID_F_EWMA:
+            AGGR_NEW
+            {
+                /* result is always positive, checked earlier */
+                aggr->window = CLERI_NODE_DATA(children->node->children->
+                        node->children->next->next->node);
+
+                if (!aggr->window)
+                {
+                    sprintf(err_msg,
+                            "Time constant must be an integer value "
+                            "larger than zero.");
+                    AGGREGATE_free(aggr);
+                    siridb_aggregate_list_free(vec);
+                    return NULL;
+                }
+            }
+
+            VEC_APPEND
+
+            break;
+
+        case CLERI_GID_F_DOWNSAMPLE:
+            AGGR_NEW
+            {
+                int64_t max_points = CLERI_NODE_DATA(children->node->
+                        children->node->children->next->next->node);
+
+                if (max_points < 2)
+                {
+                    sprintf(err_msg,
+                            "Downsample must be an integer value "
+                            "of at least 2.");
+                    AGGREGATE_free(aggr);
+                    siridb_aggregate_list_free(vec);
+                    return NULL;
+                }
+
+                aggr->max_points = max_points;
+                aggr->minmax = children->node->children->node->children->
+                        next->next->next->next != NULL;
+            }
+
+            VEC_APPEND
+
+            break;
+
         case CLERI_GID_F_DIFFERENCE:
         case CLERI_GID_F_COUNT:
         case CLERI_GID_F_MAX:
@@ -482,6 +546,25 @@ void siridb_aggregate_list_free(vec_t * alist)
     free(alist);
 }
 
+/*
+ * Returns a new aggregation which reduces all points to one point using the
+ * function for a keyword, for example CLERI_GID_K_MAX.
+ *
+ * Returns NULL in case of an allocation error.
+ */
+siridb_aggr_t * siridb_aggregate_new(uint32_t gid)
+{
+    return AGGREGATE_new(AGGREGATE_keyword_gid(gid));
+}
+
+/*
+ * Destroy an aggregation created with siridb_aggregate_new().
+ */
+void siridb_aggregate_free(siridb_aggr_t * aggr)
+{
+    AGGREGATE_free(aggr);
+}
+
 /*
  * Returns 1 (true) if at least one aggregation requires all points to be queried.
  */
@@ -539,6 +622,15 @@ siridb_points_t * siridb_aggregate_run(
     case CLERI_GID_F_TIMEVAL:
         return AGGREGATE_timeval(source, err_msg);
 
+    case CLERI_GID_F_MOVING:
+        return AGGREGATE_moving(source, aggr, err_msg);
+
+    case CLERI_GID_F_EWMA:
+        return AGGREGATE_ewma(source, aggr, err_msg);
+
+    case CLERI_GID_F_DOWNSAMPLE:
+        return AGGREGATE_downsample(source, aggr, err_msg);
+
     default:
         return AGGREGATE_to_one(source, aggr, err_msg);
     }
@@ -561,6 +653,10 @@ static siridb_aggr_t * AGGREGATE_new(uint32_t gid)
     aggr->limit = 0;
     aggr->offset = 0;
     aggr->timespan = 1.0;
+    aggr->window = 0;
+    aggr->moving_gid = 0;
+    aggr->max_points = 0;
+    aggr->minmax = 0;
     aggr->regex = NULL;
     aggr->match_data = NULL;
     aggr->filter_via.raw = NULL;
@@ -582,6 +678,51 @@ static void AGGREGATE_free(siridb_aggr_t * aggr)
     free(aggr);
 }
 
+/*
+ * Returns the aggregation function for a keyword, for example
+ * CLERI_GID_F_MAX for keyword CLERI_GID_K_MAX.
+ */
+static uint32_t AGGREGATE_keyword_gid(uint32_t gid)
+{
+    switch (gid)
+    {
+    case CLERI_GID_K_MEAN:
+        return CLERI_GID_F_MEAN;
+    case CLERI_GID_K_MEDIAN:
+        return CLERI_GID_F_MEDIAN;
+    case CLERI_GID_K_MEDIAN_LOW:
+        return CLERI_GID_F_MEDIAN_LOW;
+    case CLERI_GID_K_MEDIAN_HIGH:
+        return CLERI_GID_F_MEDIAN_HIGH;
+    case CLERI_GID_K_SUM:
+        return CLERI_GID_F_SUM;
+    case CLERI_GID_K_MIN:
+        return CLERI_GID_F_MIN;
+    case CLERI_GID_K_MAX:
+        return CLERI_GID_F_MAX;
+    case CLERI_GID_K_COUNT:
+        return CLERI_GID_F_COUNT;
+    case CLERI_GID_K_VARIANCE:
+        return CLERI_GID_F_VARIANCE;
+    case CLERI_GID_K_PVARIANCE:
+        return CLERI_GID_F_PVARIANCE;
+    case CLERI_GID_K_STDDEV:
+        return CLERI_GID_F_STDDEV;
+    case CLERI_GID_K_FIRST:
+        return CLERI_GID_F_FIRST;
+    case CLERI_GID_K_LAST:
+        return CLERI_GID_F_LAST;
+    case CLERI_GID_K_TIMEVAL:
+        return CLERI_GID_F_TIMEVAL;
+    case CLERI_GID_K_INTERVAL:
+        return CLERI_GID_F_INTERVAL;
+    default:
+        assert (0);
+        break;
+    }
+    return 0;
+}
+
 /*
  * Returns 0 if successful or -1 in case or an error.
  * The err_msg is set for any error.
@@ -680,10 +821,13 @@ static siridb_points_t * AGGREGATE_limit(
     uint64_t timespan =
             source->data[source->len - 1].ts - source->data[0].ts;
 
-    aggr->group_by = timespan / aggr->limit + 1;
-    aggr->offset = (source->data[0].ts - 1) % aggr->group_by;
+    /* the aggregate may be shared by threads, so group on a local copy */
+    siridb_aggr_t limit_aggr = *aggr;
 
-    return AGGREGATE_group_by(source, aggr, err_msg);
+    limit_aggr.group_by = timespan / aggr->limit + 1;
+    limit_aggr.offset = (source->data[0].ts - 1) % limit_aggr.group_by;
+
+    return AGGREGATE_group_by(source, &limit_aggr, err_msg);
 }
 
 static siridb_points_t * AGGREGATE_derivative(
@@ -902,79 +1046,659 @@ static siridb_points_t * AGGREGATE_timeval(
     return points;
 }
 
-static int AGGREGATE_regex_cmp(siridb_aggr_t * aggr, char * val)
+#define MOVING_VAL(tp__, pt__) \
+    ((tp__) == TP_INT ? (double) (pt__)->val.int64 : (pt__)->val.real)
+
+/*
+ * Moving count. The window for a point contains all points with a
+ * time-stamp in the range (ts - window, ts].
+ */
+static void AGGREGATE_moving_count(
+        siridb_points_t * source,
+        siridb_points_t * points,
+        uint64_t window)
 {
-    int ret;
-    ret = pcre2_match(
-            aggr->regex,
-            (PCRE2_SPTR8) val,
-            strlen(val),
-            0,                     /* start looking at this point   */
-            0,                     /* OPTIONS                       */
-            aggr->match_data,
-            0);                    /* length of sub_str_vec         */
-    return aggr->filter_opr == CEXPR_EQ ? ret >= 0 : ret < 0;
+    siridb_point_t * lo = source->data;
+    siridb_point_t * spt = source->data;
+    siridb_point_t * end = source->data + source->len;
+    siridb_point_t * dpt = points->data;
+
+    for (; spt < end; spt++, dpt++)
+    {
+        while (spt->ts - lo->ts >= window)
+        {
+            lo++;
+        }
+        dpt->ts = spt->ts;
+        dpt->val.int64 = spt - lo + 1;
+    }
+    points->len = source->len;
 }
 
-static siridb_points_t * AGGREGATE_filter(
+/*
+ * Moving sum using a running sum. Each point is added once when it enters
+ * the window and subtracted once when it leaves the window.
+ */
+static int AGGREGATE_moving_sum(
         siridb_points_t * source,
-        siridb_aggr_t * aggr,
+        siridb_points_t * points,
+        uint64_t window,
         char * err_msg)
 {
-    qp_via_t value = aggr->filter_via;
+    siridb_point_t * lo = source->data;
+    siridb_point_t * spt = source->data;
+    siridb_point_t * end = source->data + source->len;
+    siridb_point_t * dpt = points->data;
 
-    if (source->tp != aggr->filter_tp)
+    if (source->tp == TP_INT)
     {
-        if (source->tp == TP_STRING)
+        int64_t sum = 0;
+        int64_t tmp;
+
+        for (; spt < end; spt++, dpt++)
         {
-            sprintf(err_msg, "Cannot use a number filter on string type.");
-            return NULL;
+            tmp = spt->val.int64;
+            if ((tmp > 0 && sum > LLONG_MAX - tmp) ||
+                    (tmp < 0 && sum < LLONG_MIN - tmp))
+            {
+                sprintf(err_msg, "Overflow detected while using moving().");
+                return -1;
+            }
+            sum += tmp;
+
+            for (; spt->ts - lo->ts >= window; lo++)
+            {
+                tmp = lo->val.int64;
+                if ((tmp < 0 && sum > LLONG_MAX + tmp) ||
+                        (tmp > 0 && sum < LLONG_MIN + tmp))
+                {
+                    sprintf(err_msg,
+                            "Overflow detected while using moving().");
+                    return -1;
+                }
+                sum -= tmp;
+            }
+
+            dpt->ts = spt->ts;
+            dpt->val.int64 = sum;
         }
+    }
+    else
+    {
+        double sum = 0.0;
 
-        switch (aggr->filter_tp)
+        for (; spt < end; spt++, dpt++)
         {
-        case TP_STRING:
-            sprintf(err_msg, "Cannot use a string filter on number type.");
-            return NULL;
+            sum += spt->val.real;
 
-        case TP_INT:
-            value.real = (double) value.int64;
-            break;
+            for (; spt->ts - lo->ts >= window; lo++)
+            {
+                sum -= lo->val.real;
+            }
 
-        case TP_DOUBLE:
-            value.int64 = (int64_t) value.real;
-            break;
+            /* start over when the window is reduced to a single point */
+            if (lo == spt)
+            {
+                sum = spt->val.real;
+            }
 
-        default:
-            assert (0);
-            break;
+            dpt->ts = spt->ts;
+            dpt->val.real = sum;
         }
     }
+    points->len = source->len;
+    return 0;
+}
 
-    siridb_points_t * points = siridb_points_new(source->len, source->tp);
+/*
+ * Moving min or max using a monotonic deque of positions. The value at the
+ * front of the deque is the min (or max) within the window.
+ */
+static int AGGREGATE_moving_minmax(
+        siridb_points_t * source,
+        siridb_points_t * points,
+        siridb_aggr_t * aggr,
+        char * err_msg)
+{
+    size_t * deque = malloc(source->len * sizeof(size_t));
+    size_t head = 0, tail = 0, i;
+    siridb_point_t * spt;
+    siridb_point_t * dpt = points->data;
+    int is_max = aggr->moving_gid == CLERI_GID_F_MAX;
 
-    if (points == NULL)
+    if (deque == NULL)
     {
         sprintf(err_msg, "Memory allocation error.");
+        return -1;
     }
-    else
+
+    for (i = 0, spt = source->data; i < source->len; i++, spt++, dpt++)
     {
-        size_t i;
-        siridb_point_t * spt;
-        siridb_point_t * dpt;
-        switch ((points_tp) source->tp)
+        if (source->tp == TP_INT)
         {
-        case TP_STRING:
-            for (   i = 0, spt = source->data, dpt = points->data;
-                    i < source->len;
-                    i++, spt++)
+            int64_t val = spt->val.int64;
+            while (tail > head && (is_max ?
+                    source->data[deque[tail - 1]].val.int64 <= val :
+                    source->data[deque[tail - 1]].val.int64 >= val))
             {
-                if (value.str != NULL  /* NULL is a regular expression  */
-                        ? cexpr_str_cmp(
-                                aggr->filter_opr,
-                                spt->val.str, value.str)
-                        : AGGREGATE_regex_cmp(aggr, spt->val.str))
-                {
+                tail--;
+            }
+        }
+        else
+        {
+            double val = spt->val.real;
+            while (tail > head && (is_max ?
+                    source->data[deque[tail - 1]].val.real <= val :
+                    source->data[deque[tail - 1]].val.real >= val))
+            {
+                tail--;
+            }
+        }
+
+        deque[tail++] = i;
+
+        while (spt->ts - source->data[deque[head]].ts >= aggr->window)
+        {
+            head++;
+        }
+
+        dpt->ts = spt->ts;
+        dpt->val = source->data[deque[head]].val;
+    }
+
+    free(deque);
+    points->len = source->len;
+    return 0;
+}
+
+/*
+ * Moving mean, variance, pvariance and stddev. The mean and sum of squared
+ * differences are updated using Welford's method when a point enters or
+ * leaves the window.
+ */
+static void AGGREGATE_moving_variance(
+        siridb_points_t * source,
+        siridb_points_t * points,
+        siridb_aggr_t * aggr)
+{
+    siridb_point_t * lo = source->data;
+    siridb_point_t * spt = source->data;
+    siridb_point_t * end = source->data + source->len;
+    siridb_point_t * dpt = points->data;
+    size_t n = 0;
+    double mean = 0.0, m2 = 0.0, val, delta;
+
+    for (; spt < end; spt++, dpt++)
+    {
+        val = MOVING_VAL(source->tp, spt);
+        delta = val - mean;
+        mean += delta / ++n;
+        m2 += delta * (val - mean);
+
+        for (; spt->ts - lo->ts >= aggr->window; lo++)
+        {
+            val = MOVING_VAL(source->tp, lo);
+            delta = val - mean;
+            mean -= delta / --n;
+            m2 -= delta * (val - mean);
+        }
+
+        if (n == 1)
+        {
+            /* start over to prevent accumulating rounding errors */
+            mean = MOVING_VAL(source->tp, spt);
+            m2 = 0.0;
+        }
+        else if (m2 < 0.0)
+        {
+            m2 = 0.0;
+        }
+
+        dpt->ts = spt->ts;
+
+        switch (aggr->moving_gid)
+        {
+        case CLERI_GID_F_MEAN:
+            dpt->val.real = mean;
+            break;
+
+        case CLERI_GID_F_VARIANCE:
+            dpt->val.real = (n > 1) ? m2 / (n - 1) : 0.0;
+            break;
+
+        case CLERI_GID_F_PVARIANCE:
+            dpt->val.real = m2 / n;
+            break;
+
+        case CLERI_GID_F_STDDEV:
+            dpt->val.real = (n > 1) ? sqrt(m2 / (n - 1)) : 0.0;
+            break;
+
+        default:
+            assert (0);
+            break;
+        }
+    }
+    points->len = source->len;
+}
+
+/*
+ * Moving derivative, the difference per time unit between the first point
+ * in the window and the current point. No value is returned for points
+ * which are the only point within their window.
+ */
+static void AGGREGATE_moving_derivative(
+        siridb_points_t * source,
+        siridb_points_t * points,
+        uint64_t window)
+{
+    siridb_point_t * lo = source->data;
+    siridb_point_t * spt = source->data;
+    siridb_point_t * end = source->data + source->len;
+    siridb_point_t * dpt = points->data;
+
+    for (; spt < end; spt++)
+    {
+        while (spt->ts - lo->ts >= window)
+        {
+            lo++;
+        }
+
+        if (spt->ts == lo->ts)
+        {
+            continue;
+        }
+
+        dpt->ts = spt->ts;
+        dpt->val.real = (MOVING_VAL(source->tp, spt) -
+                MOVING_VAL(source->tp, lo)) / (double) (spt->ts - lo->ts);
+        dpt++;
+    }
+    points->len = dpt - points->data;
+}
+
+/*
+ * Sliding window aggregation. Each point in the source enters and leaves
+ * the window exactly once, so all moving functions run in O(n).
+ */
+static siridb_points_t * AGGREGATE_moving(
+        siridb_points_t * source,
+        siridb_aggr_t * aggr,
+        char * err_msg)
+{
+    siridb_points_t * points;
+    uint8_t tp;
+    int rc = 0;
+
+    if (source->tp == TP_STRING && aggr->moving_gid != CLERI_GID_F_COUNT)
+    {
+        sprintf(err_msg, "Cannot use moving() on string type.");
+        return NULL;
+    }
+
+    switch (aggr->moving_gid)
+    {
+    case CLERI_GID_F_COUNT:
+        tp = TP_INT;
+        break;
+
+    case CLERI_GID_F_SUM:
+    case CLERI_GID_F_MIN:
+    case CLERI_GID_F_MAX:
+        tp = source->tp;
+        break;
+
+    default:
+        tp = TP_DOUBLE;
+        break;
+    }
+
+    points = siridb_points_new(source->len, tp);
+    if (points == NULL)
+    {
+        sprintf(err_msg, "Memory allocation error.");
+        return NULL;
+    }
+
+    switch (aggr->moving_gid)
+    {
+    case CLERI_GID_F_COUNT:
+        AGGREGATE_moving_count(source, points, aggr->window);
+        break;
+
+    case CLERI_GID_F_SUM:
+        rc = AGGREGATE_moving_sum(source, points, aggr->window, err_msg);
+        break;
+
+    case CLERI_GID_F_MIN:
+    case CLERI_GID_F_MAX:
+        rc = AGGREGATE_moving_minmax(source, points, aggr, err_msg);
+        break;
+
+    case CLERI_GID_F_DERIVATIVE:
+        AGGREGATE_moving_derivative(source, points, aggr->window);
+        break;
+
+    default:
+        AGGREGATE_moving_variance(source, points, aggr);
+        break;
+    }
+
+    if (rc)
+    {
+        siridb_points_free(points);
+        return NULL;  /* err_msg is set */
+    }
+
+    return points;
+}
+
+/*
+ * Exponentially weighted moving average. The weight depends on the time
+ * between points so irregular series are handled correctly. The window is
+ * used as time constant.
+ */
+static siridb_points_t * AGGREGATE_ewma(
+        siridb_points_t * source,
+        siridb_aggr_t * aggr,
+        char * err_msg)
+{
+    if (source->tp == TP_STRING)
+    {
+        sprintf(err_msg, "Cannot use ewma() on string type.");
+        return NULL;
+    }
+
+    siridb_points_t * points = siridb_points_new(source->len, TP_DOUBLE);
+
+    if (points == NULL)
+    {
+        sprintf(err_msg, "Memory allocation error.");
+    }
+    else
+    {
+        siridb_point_t * prev = source->data;
+        siridb_point_t * spt = prev + 1;
+        siridb_point_t * end = source->data + source->len;
+        siridb_point_t * dpt = points->data;
+        double avg = MOVING_VAL(source->tp, prev);
+        double alpha;
+
+        points->len = source->len;
+
+        dpt->ts = prev->ts;
+        dpt->val.real = avg;
+
+        for (dpt++; spt < end; prev++, spt++, dpt++)
+        {
+            alpha = 1.0 - exp(
+                    -(double) (spt->ts - prev->ts) / (double) aggr->window);
+            avg += alpha * (MOVING_VAL(source->tp, spt) - avg);
+            dpt->ts = spt->ts;
+            dpt->val.real = avg;
+        }
+    }
+    return points;
+}
+
+/*
+ * Largest-Triangle-Three-Buckets. The first and last point are always
+ * included. The other points are divided in max_points - 2 buckets and from
+ * each bucket the point which forms the largest triangle with the point
+ * selected from the previous bucket and the average of the next bucket is
+ * selected.
+ */
+static void AGGREGATE_downsample_lttb(
+        siridb_points_t * source,
+        siridb_points_t * points,
+        uint64_t max_points)
+{
+    siridb_point_t * data = source->data;
+    siridb_point_t * dpt = points->data;
+    double every = (max_points > 2) ?
+            (double) (source->len - 2) / (max_points - 2) : 0.0;
+    size_t a = 0, i, j, start, end, next_end, selected;
+    double ts0, avg_ts, avg_val, area, max_area, val_a;
+
+    /* time-stamps are relative to the first point to preserve precision */
+    ts0 = (double) data->ts;
+
+    *dpt++ = *data;
+
+    for (i = 0; i < max_points - 2; i++)
+    {
+        start = (size_t) (i * every) + 1;
+        end = (size_t) ((i + 1) * every) + 1;
+        next_end = (size_t) ((i + 2) * every) + 1;
+
+        if (next_end > source->len)
+        {
+            next_end = source->len;
+        }
+
+        /* average of the next bucket, the last point when this is the last */
+        avg_ts = 0.0;
+        avg_val = 0.0;
+        for (j = end; j < next_end; j++)
+        {
+            avg_ts += (double) data[j].ts - ts0;
+            avg_val += MOVING_VAL(source->tp, data + j);
+        }
+        if (j > end)
+        {
+            avg_ts /= j - end;
+            avg_val /= j - end;
+        }
+        else
+        {
+            avg_ts = (double) data[source->len - 1].ts - ts0;
+            avg_val = MOVING_VAL(source->tp, data + source->len - 1);
+        }
+
+        val_a = MOVING_VAL(source->tp, data + a);
+        max_area = -1.0;
+        selected = start;
+
+        for (j = start; j < end; j++)
+        {
+            area = fabs(
+                    ((double) data[a].ts - ts0 - avg_ts) *
+                    (MOVING_VAL(source->tp, data + j) - val_a) -
+                    ((double) data[a].ts - (double) data[j].ts) *
+                    (avg_val - val_a));
+            if (area > max_area)
+            {
+                max_area = area;
+                selected = j;
+            }
+        }
+
+        *dpt++ = data[selected];
+        a = selected;
+    }
+
+    *dpt++ = data[source->len - 1];
+    points->len = dpt - points->data;
+}
+
+/*
+ * Min/max decimation. The time range is divided in max_points / 2 buckets
+ * and for each bucket the points with the lowest and highest value are
+ * returned in order of time.
+ */
+static void AGGREGATE_downsample_minmax(
+        siridb_points_t * source,
+        siridb_points_t * points,
+        uint64_t max_points)
+{
+    siridb_point_t * data = source->data;
+    siridb_point_t * dpt = points->data;
+    uint64_t buckets = max_points / 2;
+    uint64_t first = data->ts;
+    uint64_t width = (data[source->len - 1].ts - first) / buckets + 1;
+    uint64_t bucket;
+    size_t i = 0, j, lo, hi;
+    double val, min, max;
+
+    while (i < source->len)
+    {
+        bucket = (data[i].ts - first) / width;
+        lo = hi = i;
+        min = max = MOVING_VAL(source->tp, data + i);
+
+        for (j = i + 1;
+             j < source->len && (data[j].ts - first) / width == bucket;
+             j++)
+        {
+            val = MOVING_VAL(source->tp, data + j);
+            if (val < min)
+            {
+                min = val;
+                lo = j;
+            }
+            if (val > max)
+            {
+                max = val;
+                hi = j;
+            }
+        }
+
+        if (lo == hi)
+        {
+            *dpt++ = data[lo];
+        }
+        else if (lo < hi)
+        {
+            *dpt++ = data[lo];
+            *dpt++ = data[hi];
+        }
+        else
+        {
+            *dpt++ = data[hi];
+            *dpt++ = data[lo];
+        }
+
+        i = j;
+    }
+
+    points->len = dpt - points->data;
+}
+
+/*
+ * Reduce the number of points to at most max_points while preserving the
+ * visual shape of the series. The selected points are original points so
+ * the type of the series is preserved.
+ */
+static siridb_points_t * AGGREGATE_downsample(
+        siridb_points_t * source,
+        siridb_aggr_t * aggr,
+        char * err_msg)
+{
+    siridb_points_t * points;
+
+    if (source->tp == TP_STRING)
+    {
+        sprintf(err_msg, "Cannot use downsample() on string type.");
+        return NULL;
+    }
+
+    if (source->len <= aggr->max_points)
+    {
+        return source;
+    }
+
+    points = siridb_points_new(aggr->max_points, source->tp);
+    if (points == NULL)
+    {
+        sprintf(err_msg, "Memory allocation error.");
+        return NULL;
+    }
+
+    if (aggr->minmax)
+    {
+        AGGREGATE_downsample_minmax(source, points, aggr->max_points);
+    }
+    else
+    {
+        AGGREGATE_downsample_lttb(source, points, aggr->max_points);
+    }
+
+    return points;
+}
+
+static int AGGREGATE_regex_cmp(siridb_aggr_t * aggr, char * val)
+{
+    int ret;
+    ret = pcre2_match(
+            aggr->regex,
+            (PCRE2_SPTR8) val,
+            strlen(val),
+            0,                     /* start looking at this point   */
+            0,                     /* OPTIONS                       */
+            aggr->match_data,
+            0);                    /* length of sub_str_vec         */
+    return aggr->filter_opr == CEXPR_EQ ? ret >= 0 : ret < 0;
+}
+
+static siridb_points_t * AGGREGATE_filter(
+        siridb_points_t * source,
+        siridb_aggr_t * aggr,
+        char * err_msg)
+{
+    qp_via_t value = aggr->filter_via;
+
+    if (source->tp != aggr->filter_tp)
+    {
+        if (source->tp == TP_STRING)
+        {
+            sprintf(err_msg, "Cannot use a number filter on string type.");
+            return NULL;
+        }
+
+        switch (aggr->filter_tp)
+        {
+        case TP_STRING:
+            sprintf(err_msg, "Cannot use a string filter on number type.");
+            return NULL;
+
+        case TP_INT:
+            value.real = (double) value.int64;
+            break;
+
+        case TP_DOUBLE:
+            value.int64 = (int64_t) value.real;
+            break;
+
+        default:
+            assert (0);
+            break;
+        }
+    }
+
+    siridb_points_t * points = siridb_points_new(source->len, source->tp);
+
+    if (points == NULL)
+    {
+        sprintf(err_msg, "Memory allocation error.");
+    }
+    else
+    {
+        size_t i;
+        siridb_point_t * spt;
+        siridb_point_t * dpt;
+        switch ((points_tp) source->tp)
+        {
+        case TP_STRING:
+            for (   i = 0, spt = source->data, dpt = points->data;
+                    i < source->len;
+                    i++, spt++)
+            {
+                if (value.str != NULL  /* NULL is a regular expression  */
+                        ? cexpr_str_cmp(
+                                aggr->filter_opr,
+                                spt->val.str, value.str)
+                        : AGGREGATE_regex_cmp(aggr, spt->val.str))
+                {
                     dpt->ts = spt->ts;
                     dpt->val.str = strdup(spt->val.str);
                     if (dpt->val.str == NULL)
@@ -1108,6 +1832,166 @@ static siridb_points_t * AGGREGATE_to_one(
     return points;
 }
 
+typedef int (* AGGR_group_cb)(
+        siridb_points_t * source,
+        siridb_points_t * points,
+        siridb_aggr_t * aggr,
+        char * err_msg);
+
+/*
+ * Generates a group by function for a single aggregate and input type.
+ * The reduction is inlined in the loop over the source points so no
+ * function is called and no type is checked per group.
+ *
+ * Within the statements, `v` is the value of the current point, `acc` the
+ * accumulator, `n` the number of points in the group and `dpt` the point
+ * for the group which is written by the `emit__` statement.
+ */
+#define AGGR_GROUP_BY(name__, field__, acc_tp__, init__, reduce__, emit__)  \
+static int AGGREGATE_group_##name__(                                        \
+        siridb_points_t * source,                                           \
+        siridb_points_t * points,                                           \
+        siridb_aggr_t * aggr,                                               \
+        char * err_msg __attribute__((unused)))                             \
+{                                                                           \
+    siridb_point_t * spt = source->data;                                    \
+    siridb_point_t * end = source->data + source->len;                      \
+    siridb_point_t * dpt = points->data;                                    \
+    uint64_t group_ts = GROUP_TS(spt);                                      \
+    size_t n = 1;                                                           \
+    acc_tp__ acc;                                                           \
+    __typeof__(spt->val.field__) v = spt->val.field__;                      \
+    init__;                                                                 \
+    for (spt++; spt < end; spt++)                                           \
+    {                                                                       \
+        v = spt->val.field__;                                               \
+        if (spt->ts > group_ts)                                             \
+        {                                                                   \
+            dpt->ts = group_ts;                                             \
+            emit__;                                                         \
+            dpt++;                                                          \
+            group_ts = GROUP_TS(spt);                                       \
+            n = 1;                                                          \
+            init__;                                                         \
+            continue;                                                       \
+        }                                                                   \
+        n++;                                                                \
+        reduce__;                                                           \
+    }                                                                       \
+    dpt->ts = group_ts;                                                     \
+    emit__;                                                                 \
+    points->len = dpt - points->data + 1;                                   \
+    return 0;                                                               \
+}
+
+AGGR_GROUP_BY(count, int64, int,
+    (void) v; acc = 0,
+    (void) acc,
+    dpt->val.int64 = n)
+
+AGGR_GROUP_BY(sum_int, int64, int64_t,
+    acc = v,
+    if ((v > 0 && acc > LLONG_MAX - v) || (v < 0 && acc < LLONG_MIN - v))
+    {
+        sprintf(err_msg, "Overflow detected while using sum().");
+        return -1;
+    }
+    acc += v,
+    dpt->val.int64 = acc)
+
+AGGR_GROUP_BY(sum_double, real, double,
+    acc = v,
+    acc += v,
+    dpt->val.real = acc)
+
+AGGR_GROUP_BY(mean_int, int64, double,
+    acc = v,
+    acc += v,
+    dpt->val.real = acc / n)
+
+AGGR_GROUP_BY(mean_double, real, double,
+    acc = v,
+    acc += v,
+    dpt->val.real = acc / n)
+
+AGGR_GROUP_BY(min_int, int64, int64_t,
+    acc = v,
+    if (v < acc) acc = v,
+    dpt->val.int64 = acc)
+
+AGGR_GROUP_BY(min_double, real, double,
+    acc = v,
+    if (v < acc) acc = v,
+    dpt->val.real = acc)
+
+AGGR_GROUP_BY(max_int, int64, int64_t,
+    acc = v,
+    if (v > acc) acc = v,
+    dpt->val.int64 = acc)
+
+AGGR_GROUP_BY(max_double, real, double,
+    acc = v,
+    if (v > acc) acc = v,
+    dpt->val.real = acc)
+
+AGGR_GROUP_BY(first_int, int64, int64_t,
+    acc = v,
+    (void) acc,
+    dpt->val.int64 = acc)
+
+AGGR_GROUP_BY(first_double, real, double,
+    acc = v,
+    (void) acc,
+    dpt->val.real = acc)
+
+AGGR_GROUP_BY(last_int, int64, int64_t,
+    acc = v,
+    acc = v,
+    dpt->val.int64 = acc)
+
+AGGR_GROUP_BY(last_double, real, double,
+    acc = v,
+    acc = v,
+    dpt->val.real = acc)
+
+/*
+ * Returns a specialized group by function for the aggregate and type, or
+ * NULL when the generic (callback per group) implementation must be used.
+ */
+static AGGR_group_cb AGGREGATE_group_fn(uint32_t gid, uint8_t tp)
+{
+    if (tp == TP_STRING)
+    {
+        return NULL;
+    }
+
+    switch (gid)
+    {
+    case CLERI_GID_F_COUNT:
+        return AGGREGATE_group_count;
+    case CLERI_GID_F_SUM:
+        return (tp == TP_INT) ?
+                AGGREGATE_group_sum_int : AGGREGATE_group_sum_double;
+    case CLERI_GID_F_MEAN:
+        return (tp == TP_INT) ?
+                AGGREGATE_group_mean_int : AGGREGATE_group_mean_double;
+    case CLERI_GID_F_MIN:
+        return (tp == TP_INT) ?
+                AGGREGATE_group_min_int : AGGREGATE_group_min_double;
+    case CLERI_GID_F_MAX:
+        return (tp == TP_INT) ?
+                AGGREGATE_group_max_int : AGGREGATE_group_max_double;
+    case CLERI_GID_F_FIRST:
+        return (tp == TP_INT) ?
+                AGGREGATE_group_first_int : AGGREGATE_group_first_double;
+    case CLERI_GID_F_LAST:
+        return (tp == TP_INT) ?
+                AGGREGATE_group_last_int : AGGREGATE_group_last_double;
+    default:
+        return NULL;
+    }
+}
+
 static siridb_points_t * AGGREGATE_group_by(
         siridb_points_t * source,
         siridb_aggr_t * aggr,
@@ -1119,6 +2003,7 @@ static siridb_points_t * AGGREGATE_group_by(
     uint64_t max_sz;
     uint64_t goup_ts;
     size_t start, end;
+    AGGR_group_cb group_cb;
 
     group.tp = source->tp;
 
@@ -1170,6 +2055,18 @@ static siridb_points_t * AGGREGATE_group_by(
         return NULL;
     }
 
+    group_cb = AGGREGATE_group_fn(aggr->gid, source->tp);
+    if (group_cb != NULL)
+    {
+        if (group_cb(source, points, aggr, err_msg))
+        {
+            /* error occurred, return NULL */
+            siridb_points_free(points);
+            return NULL;
+        }
+        goto shrink;
+    }
+
     goup_ts = GROUP_TS(source->data);
 
     for(start = end = 0; end < source->len; end++)
@@ -1204,6 +2101,7 @@ static siridb_points_t * AGGREGATE_group_by(
     }
     points->len++;
 
+shrink:
     if (points->len < max_sz)
     {
         /* shrink points allocation */
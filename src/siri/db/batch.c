@@ -0,0 +1,852 @@
+/*
+ * batch.c - Batch of queries which are handled using a single request.
+ *
+ * A batch request contains multiple queries and is answered with a single
+ * response containing the result for each query, in order:
+ *
+ *  request:    [[query, time_precision], ...]
+ *  response:   [[tp, result], ...]
+ *
+ * The result is the qpack data of the response package for the query and
+ * tp is the package type, so each result can be handled as if the query was
+ * sent as a separate request.
+ *
+ * Queries in a batch are handled as normal queries but share work:
+ *
+ *  - the series for a regular expression are resolved only once;
+ *  - points which are read for a series and time range are shared, up to
+ *    SIRIDB_BATCH_MAX_POINTS points;
+ *  - queries which must be forwarded to all pools are sent using a single
+ *    combined request for each pool. The forward is delayed until all other
+ *    queries in the batch are finished or are waiting for a forward too.
+ *
+ * All functions must be called from the main thread.
+ */
+#include <assert.h>
+#include <logger/logger.h>
+#include <math.h>
+#include <siri/async.h>
+#include <siri/db/batch.h>
+#include <siri/db/pools.h>
+#include <siri/db/query.h>
+#include <siri/db/servers.h>
+#include <siri/db/time.h>
+#include <siri/err.h>
+#include <siri/net/protocol.h>
+#include <siri/siri.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH_RE_MAX_LEN 4096
+
+/* servers in other pools need at least this version for a combined forward */
+#define BATCH_FWD_MIN_VERSION "2.0.45"
+
+typedef struct
+{
+    uint64_t start_ts;
+    uint64_t end_ts;
+    uint8_t has_start;
+    uint8_t has_end;
+    siridb_points_t * points;
+} BATCH_points_t;
+
+typedef struct
+{
+    uv_async_t * handle;
+    sirinet_promises_cb cb;
+    sirinet_promises_each_cb each_cb;
+    int flags;
+    size_t len;
+    unsigned char data[];
+} BATCH_fwd_t;
+
+static siridb_batch_t * BATCH_new(
+        sirinet_stream_t * client,
+        uint16_t pid,
+        uint16_t n,
+        uint8_t tp);
+static void BATCH_decref(siridb_batch_t * batch);
+static void BATCH_send(siridb_batch_t * batch);
+static void BATCH_fwd_check(siridb_batch_t * batch);
+static void BATCH_fwd_send(siridb_batch_t * batch);
+static void BATCH_on_fwd_response(vec_t * promises, vec_t * fwd);
+static sirinet_promise_t * BATCH_promise(
+        sirinet_promise_t * promise,
+        sirinet_pkg_t * pkg);
+static void BATCH_each(sirinet_promise_t * qpromise, BATCH_fwd_t * fwd);
+static void BATCH_free_series(imap_t * series_map);
+static void BATCH_free_points(BATCH_points_t * bpoints);
+static int BATCH_add_series(siridb_series_t * series, imap_t * dest);
+
+/*
+ * Run the queries in a batch request package. The response is sent using
+ * the given package type when all queries are finished.
+ *
+ * Returns 0 if successful or -1 when the package is not a valid batch.
+ * (a SIGNAL might be raised in case of an allocation error)
+ */
+int siridb_batch_run(
+        sirinet_stream_t * client,
+        sirinet_pkg_t * pkg,
+        uint8_t tp,
+        int flags)
+{
+    siridb_t * siridb = client->siridb;
+    siridb_batch_t * batch;
+    siridb_timep_t precision;
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_query, qp_time_precision;
+    qp_types_t qp_tp;
+    float factor;
+    int n = siridb_batch_count(pkg);
+    uint16_t i;
+
+    if (n < 0)
+    {
+        return -1;
+    }
+
+    batch = BATCH_new(client, pkg->pid, (uint16_t) n, tp);
+    if (batch == NULL)
+    {
+        return 0;  /* signal is raised */
+    }
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+    qp_next(&unpacker, NULL);
+
+    for (i = 0; i < batch->n; i++)
+    {
+        qp_tp = qp_next(&unpacker, NULL);
+        qp_next(&unpacker, &qp_query);
+
+        precision = SIRIDB_TIME_DEFAULT;
+
+        if (qp_tp == QP_ARRAY2 &&
+            qp_next(&unpacker, &qp_time_precision) == QP_INT64 &&
+            (precision = (siridb_timep_t) qp_time_precision.via.int64) !=
+                siridb->time->precision)
+        {
+            precision %= SIRIDB_TIME_END;
+        }
+
+        factor = (precision == SIRIDB_TIME_DEFAULT) ? 0.0 :
+                pow(1000.0, precision - siridb->time->precision);
+
+        siridb_query_run_batch(
+                batch,
+                i,
+                (const char *) qp_query.via.raw,
+                qp_query.len,
+                factor,
+                flags);
+    }
+
+    if (!batch->n)
+    {
+        BATCH_send(batch);
+    }
+
+    BATCH_decref(batch);
+    return 0;
+}
+
+/*
+ * Set the result package for a query in the batch. The batch takes the
+ * package which may be NULL in case of an allocation error. The response
+ * is sent when this is the last result.
+ */
+void siridb_batch_set_result(
+        siridb_batch_t * batch,
+        uint16_t idx,
+        sirinet_pkg_t * pkg)
+{
+    assert (idx < batch->n);
+
+    if (batch->has_result[idx])
+    {
+        free(pkg);
+        return;
+    }
+
+    batch->has_result[idx] = 1;
+    batch->results[idx] = pkg;
+
+    if (++batch->done == batch->n)
+    {
+        BATCH_send(batch);
+    }
+    else
+    {
+        BATCH_fwd_check(batch);
+    }
+}
+
+/*
+ * Must be called when a query in the batch is destroyed. A query which is
+ * destroyed without a result gets an empty error as result.
+ */
+void siridb_batch_finish(siridb_batch_t * batch, uint16_t idx)
+{
+    if (!batch->has_result[idx])
+    {
+        siridb_batch_set_result(
+                batch,
+                idx,
+                sirinet_pkg_new(0, 0, CPROTO_ERR, NULL));
+    }
+    BATCH_decref(batch);
+}
+
+/*
+ * Queue a forward to all pools for a query in the batch. The packer must
+ * contain the query as it would be sent to the pools. The call-back
+ * functions are called as if the query was forwarded using
+ * siridb_query_forward_each().
+ *
+ * Returns 0 if the forward is queued or -1 if the query should be forwarded
+ * without the batch.
+ */
+int siridb_batch_forward(
+        siridb_batch_t * batch,
+        uv_async_t * handle,
+        qp_packer_t * packer,
+        sirinet_promises_cb cb,
+        sirinet_promises_each_cb each_cb,
+        int flags)
+{
+    siridb_t * siridb = batch->client->siridb;
+    BATCH_fwd_t * fwd;
+
+    if (    batch->n < 2 ||
+            siridb->pools->len < 2 ||
+            (batch->fwd->len &&
+                ((BATCH_fwd_t *) batch->fwd->data[0])->flags != flags) ||
+            siridb_servers_check_version(siridb, BATCH_FWD_MIN_VERSION))
+    {
+        return -1;
+    }
+
+    fwd = malloc(sizeof(BATCH_fwd_t) + packer->len);
+    if (fwd == NULL)
+    {
+        return -1;
+    }
+
+    fwd->handle = handle;
+    fwd->cb = cb;
+    fwd->each_cb = each_cb;
+    fwd->flags = flags;
+    fwd->len = packer->len;
+    memcpy(fwd->data, packer->buffer, packer->len);
+
+    if (vec_append_safe(&batch->fwd, fwd))
+    {
+        free(fwd);
+        return -1;
+    }
+
+    /* increment reference since handle is bound to the forward */
+    siri_async_incref(handle);
+
+    BATCH_fwd_check(batch);
+
+    return 0;
+}
+
+/*
+ * Copy the series for a regular expression which is already resolved by
+ * another query in the batch to dest. Each series is referenced by dest.
+ *
+ * Returns 1 if the series are copied, 0 if the regular expression is not
+ * resolved yet or -1 in case of an allocation error.
+ */
+int siridb_batch_series_re_get(
+        siridb_batch_t * batch,
+        const char * re,
+        size_t len,
+        imap_t * dest)
+{
+    imap_t * series_map;
+
+    if (len > BATCH_RE_MAX_LEN ||
+        (series_map = ct_getn(batch->series_re, re, len)) == NULL)
+    {
+        return 0;
+    }
+
+    return imap_walk(series_map, (imap_cb) BATCH_add_series, dest) ? -1 : 1;
+}
+
+/*
+ * Store a copy of the series for a regular expression in the batch. The
+ * source must contain all series in the database matching the expression.
+ */
+void siridb_batch_series_re_set(
+        siridb_batch_t * batch,
+        const char * re,
+        size_t len,
+        imap_t * source)
+{
+    char key[BATCH_RE_MAX_LEN + 1];
+    imap_t * series_map;
+
+    if (len > BATCH_RE_MAX_LEN || batch->n < 2)
+    {
+        return;
+    }
+
+    memcpy(key, re, len);
+    key[len] = '\0';
+
+    if (ct_get(batch->series_re, key) != NULL)
+    {
+        return;
+    }
+
+    series_map = imap_new();
+    if (series_map == NULL)
+    {
+        return;
+    }
+
+    if (imap_walk(source, (imap_cb) BATCH_add_series, series_map) ||
+        ct_add(batch->series_re, key, series_map))
+    {
+        BATCH_free_series(series_map);
+    }
+}
+
+/*
+ * Returns a copy of the points for a series and time range when these
+ * points are read before by another query in the batch, or NULL if not.
+ */
+siridb_points_t * siridb_batch_get_points(
+        siridb_batch_t * batch,
+        siridb_series_t * series,
+        uint64_t * start_ts,
+        uint64_t * end_ts)
+{
+    BATCH_points_t * bpoints = imap_get(batch->points, series->id);
+
+    if (    bpoints == NULL ||
+            (series->flags & SIRIDB_SERIES_IS_DROPPED) ||
+            bpoints->has_start != (start_ts != NULL) ||
+            bpoints->has_end != (end_ts != NULL) ||
+            (start_ts != NULL && bpoints->start_ts != *start_ts) ||
+            (end_ts != NULL && bpoints->end_ts != *end_ts))
+    {
+        return NULL;
+    }
+
+    return siridb_points_copy(bpoints->points);
+}
+
+/*
+ * Share a copy of the points for a series and time range with the other
+ * queries in the batch, as long as SIRIDB_BATCH_MAX_POINTS is not reached.
+ */
+void siridb_batch_add_points(
+        siridb_batch_t * batch,
+        siridb_series_t * series,
+        uint64_t * start_ts,
+        uint64_t * end_ts,
+        siridb_points_t * points)
+{
+    BATCH_points_t * bpoints;
+
+    if (    batch->n < 2 ||
+            batch->npoints + points->len > SIRIDB_BATCH_MAX_POINTS ||
+            imap_get(batch->points, series->id) != NULL)
+    {
+        return;
+    }
+
+    bpoints = malloc(sizeof(BATCH_points_t));
+    if (bpoints == NULL)
+    {
+        return;
+    }
+
+    bpoints->has_start = start_ts != NULL;
+    bpoints->has_end = end_ts != NULL;
+    bpoints->start_ts = (start_ts == NULL) ? 0 : *start_ts;
+    bpoints->end_ts = (end_ts == NULL) ? 0 : *end_ts;
+    bpoints->points = siridb_points_copy(points);
+
+    if (    bpoints->points == NULL ||
+            imap_add(batch->points, series->id, bpoints))
+    {
+        BATCH_free_points(bpoints);
+        return;
+    }
+
+    batch->npoints += points->len;
+}
+
+/*
+ * Returns NULL and raises a SIGNAL in case of an allocation error.
+ */
+static siridb_batch_t * BATCH_new(
+        sirinet_stream_t * client,
+        uint16_t pid,
+        uint16_t n,
+        uint8_t tp)
+{
+    siridb_batch_t * batch = malloc(sizeof(siridb_batch_t));
+    if (batch == NULL)
+    {
+        ERR_ALLOC
+        return NULL;
+    }
+
+    batch->ref = 1;
+    batch->pid = pid;
+    batch->n = n;
+    batch->done = 0;
+    batch->tp = tp;
+    batch->has_result = calloc(n + 1, sizeof(uint8_t));
+    batch->results = calloc(n + 1, sizeof(sirinet_pkg_t *));
+    batch->client = client;
+    batch->series_re = ct_new();
+    batch->points = imap_new();
+    batch->npoints = 0;
+    batch->fwd = vec_new(VEC_DEFAULT_SIZE);
+
+    sirinet_stream_incref(client);
+
+    if (    batch->has_result == NULL ||
+            batch->results == NULL ||
+            batch->series_re == NULL ||
+            batch->points == NULL ||
+            batch->fwd == NULL)
+    {
+        ERR_ALLOC
+        BATCH_decref(batch);
+        return NULL;
+    }
+
+    return batch;
+}
+
+static void BATCH_decref(siridb_batch_t * batch)
+{
+    uint16_t i;
+
+    if (--batch->ref)
+    {
+        return;
+    }
+
+    /* queries hold a reference to the handle, so no forward is queued */
+    assert (batch->fwd == NULL || batch->fwd->len == 0);
+
+    if (batch->results != NULL)
+    {
+        for (i = 0; i < batch->n; i++)
+        {
+            free(batch->results[i]);
+        }
+    }
+
+    if (batch->series_re != NULL)
+    {
+        ct_free(batch->series_re, (ct_free_cb) BATCH_free_series);
+    }
+
+    if (batch->points != NULL)
+    {
+        imap_free(batch->points, (imap_free_cb) BATCH_free_points);
+    }
+
+    vec_free(batch->fwd);
+    free(batch->has_result);
+    free(batch->results);
+    sirinet_stream_decref(batch->client);
+    free(batch);
+}
+
+/*
+ * Send the response with the results for all queries in the batch. The
+ * result packages are released.
+ */
+static void BATCH_send(siridb_batch_t * batch)
+{
+    qp_packer_t * packer;
+    sirinet_pkg_t * pkg;
+    size_t size = sizeof(sirinet_pkg_t) + 16;
+    uint16_t i;
+
+    for (i = 0; i < batch->n; i++)
+    {
+        size += 16 + ((batch->results[i] == NULL) ?
+                0 : batch->results[i]->len);
+    }
+
+    packer = sirinet_packer_new(size);
+    if (packer == NULL)
+    {
+        return;  /* signal is raised */
+    }
+
+    qp_add_type(packer, QP_ARRAY_OPEN);
+
+    for (i = 0; i < batch->n; i++)
+    {
+        pkg = batch->results[i];
+
+        qp_add_type(packer, QP_ARRAY2);
+
+        if (pkg == NULL)
+        {
+            qp_add_int64(packer, CPROTO_ERR);
+            qp_add_raw(packer, (const unsigned char *) "", 0);
+        }
+        else
+        {
+            qp_add_int64(packer, pkg->tp);
+            qp_add_raw(packer, pkg->data, pkg->len);
+            free(pkg);
+            batch->results[i] = NULL;
+        }
+    }
+
+    qp_add_type(packer, QP_ARRAY_CLOSE);
+
+    pkg = sirinet_packer2pkg(packer, batch->pid, batch->tp);
+    sirinet_pkg_send(batch->client, pkg);
+}
+
+/*
+ * Returns the number of queries in a batch package, or -1 if the package is
+ * not a valid batch.
+ */
+int siridb_batch_count(sirinet_pkg_t * pkg)
+{
+    qp_unpacker_t unpacker;
+    qp_types_t tp;
+    int n = 0;
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+
+    if (!qp_is_array(qp_next(&unpacker, NULL)))
+    {
+        return -1;
+    }
+
+    while ((tp = qp_next(&unpacker, NULL)) == QP_ARRAY1 || tp == QP_ARRAY2)
+    {
+        if (qp_next(&unpacker, NULL) != QP_RAW)
+        {
+            return -1;
+        }
+
+        if (tp == QP_ARRAY2)
+        {
+            qp_skip_next(&unpacker);
+        }
+
+        if (++n > SIRIDB_BATCH_MAX_QUERIES)
+        {
+            return -1;
+        }
+    }
+
+    return (tp == QP_END || tp == QP_ARRAY_CLOSE) ? n : -1;
+}
+
+/*
+ * Send the queued forwards when all other queries in the batch are
+ * finished, since these cannot add another forward to the combined request.
+ */
+static void BATCH_fwd_check(siridb_batch_t * batch)
+{
+    if (batch->fwd->len && batch->fwd->len + batch->done == batch->n)
+    {
+        BATCH_fwd_send(batch);
+    }
+}
+
+/*
+ * Send the queued forwards to all pools using a single combined request for
+ * each pool.
+ */
+static void BATCH_fwd_send(siridb_batch_t * batch)
+{
+    siridb_t * siridb = batch->client->siridb;
+    vec_t * fwd = vec_copy(batch->fwd);
+    BATCH_fwd_t * entry;
+    qp_packer_t * packer;
+    sirinet_pkg_t * pkg = NULL;
+    size_t i, size = 16;
+    int flags;
+
+    if (fwd == NULL)
+    {
+        ERR_ALLOC
+        return;
+    }
+
+    batch->fwd->len = 0;
+    flags = ((BATCH_fwd_t *) fwd->data[0])->flags;
+
+    for (i = 0; i < fwd->len; i++)
+    {
+        size += ((BATCH_fwd_t *) fwd->data[i])->len;
+    }
+
+    packer = qp_packer_new(size);
+    if (packer != NULL)
+    {
+        qp_add_type(packer, QP_ARRAY_OPEN);
+
+        for (i = 0; i < fwd->len; i++)
+        {
+            entry = (BATCH_fwd_t *) fwd->data[i];
+            qp_packer_extend_bytes(packer, entry->data, entry->len);
+        }
+
+        pkg = sirinet_pkg_new(
+                0,
+                packer->len,
+                BPROTO_QUERY_BATCH_SERVER,
+                packer->buffer);
+
+        qp_packer_free(packer);
+    }
+
+    if (pkg == NULL)
+    {
+        ERR_ALLOC
+        BATCH_on_fwd_response(NULL, fwd);
+        return;
+    }
+
+    siridb_pools_send_pkg(
+            siridb,
+            pkg,
+            0,
+            (sirinet_promises_cb) BATCH_on_fwd_response,
+            NULL,
+            fwd,
+            flags);
+}
+
+/*
+ * Split the combined responses from the pools into a promises vector for
+ * each of the n queries, as if each query was forwarded on its own. A query
+ * gets a promise without a package when the response is not a valid batch
+ * response, or a copy of the response when the pool returned an error.
+ *
+ * Returns an array with n promises vectors or NULL in case of an allocation
+ * error. The promises in the vectors hold only a reference to the server.
+ */
+vec_t ** siridb_batch_split(vec_t * promises, size_t n)
+{
+    sirinet_promise_t * promise;
+    sirinet_pkg_t * pkg, * qpkg;
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_tp, qp_result;
+    vec_t ** qpromises = calloc(n, sizeof(vec_t *));
+    size_t i, j;
+    int is_valid;
+
+    for (i = 0; qpromises != NULL && i < n; i++)
+    {
+        if ((qpromises[i] = vec_new(promises->len)) == NULL)
+        {
+            for (j = 0; j < i; j++)
+            {
+                vec_free(qpromises[j]);
+            }
+            free(qpromises);
+            qpromises = NULL;
+        }
+    }
+
+    for (j = 0; qpromises != NULL && j < promises->len; j++)
+    {
+        promise = promises->data[j];
+
+        if (promise == NULL)
+        {
+            for (i = 0; i < n; i++)
+            {
+                vec_append(qpromises[i], NULL);
+            }
+            continue;
+        }
+
+        pkg = (sirinet_pkg_t *) promise->data;
+        is_valid = pkg != NULL && pkg->tp == BPROTO_RES_QUERY_BATCH;
+
+        if (is_valid)
+        {
+            qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+            is_valid = qp_is_array(qp_next(&unpacker, NULL));
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (is_valid && (
+                    qp_next(&unpacker, NULL) != QP_ARRAY2 ||
+                    qp_next(&unpacker, &qp_tp) != QP_INT64 ||
+                    qp_next(&unpacker, &qp_result) != QP_RAW))
+            {
+                log_error(
+                        "Invalid batch response received from '%s'",
+                        promise->server->name);
+                is_valid = 0;
+            }
+
+            qpkg = (is_valid) ? sirinet_pkg_new(
+                    0,
+                    qp_result.len,
+                    (uint8_t) qp_tp.via.int64,
+                    qp_result.via.raw) :
+                    (pkg != NULL && sirinet_protocol_is_error(pkg->tp)) ?
+                    sirinet_pkg_dup(pkg) : NULL;
+
+            vec_append(qpromises[i], BATCH_promise(promise, qpkg));
+        }
+    }
+
+    return qpromises;
+}
+
+/*
+ * Call-back function: sirinet_promises_cb
+ *
+ * The combined response from each pool is split into a response for each
+ * query and the call-back for each query is called with the promises as if
+ * the query was forwarded on its own.
+ */
+static void BATCH_on_fwd_response(vec_t * promises, vec_t * fwd)
+{
+    sirinet_promise_t * promise;
+    BATCH_fwd_t * entry;
+    vec_t ** qpromises;
+    size_t i, j;
+
+    qpromises = (promises == NULL) ?
+            NULL : siridb_batch_split(promises, fwd->len);
+
+    for (i = 0; i < fwd->len; i++)
+    {
+        entry = (BATCH_fwd_t *) fwd->data[i];
+
+        if (qpromises != NULL)
+        {
+            for (j = 0; j < qpromises[i]->len; j++)
+            {
+                BATCH_each(qpromises[i]->data[j], entry);
+            }
+        }
+
+        entry->cb((qpromises == NULL) ? NULL : qpromises[i], entry->handle);
+
+        if (qpromises != NULL)
+        {
+            vec_free(qpromises[i]);
+        }
+        free(entry);
+    }
+
+    if (promises != NULL)
+    {
+        for (j = 0; j < promises->len; j++)
+        {
+            promise = promises->data[j];
+            if (promise != NULL)
+            {
+                free(promise->data);
+                sirinet_promise_decref(promise);
+            }
+        }
+    }
+
+    free(qpromises);
+    vec_free(fwd);
+}
+
+/*
+ * Returns a promise for a single query in a combined forward, or NULL in
+ * case of an allocation error. The promise takes the package which can be
+ * NULL when no response is received for the query.
+ */
+static sirinet_promise_t * BATCH_promise(
+        sirinet_promise_t * promise,
+        sirinet_pkg_t * pkg)
+{
+    sirinet_promise_t * qpromise = malloc(sizeof(sirinet_promise_t));
+    if (qpromise == NULL)
+    {
+        free(pkg);
+        return NULL;
+    }
+
+    qpromise->pid = promise->pid;
+    qpromise->ref = 1;
+    qpromise->timer = NULL;
+    qpromise->cb = NULL;
+    qpromise->server = promise->server;
+    qpromise->pkg = NULL;
+    qpromise->data = pkg;
+
+    return qpromise;
+}
+
+/*
+ * Call the each call-back for a query promise. When the package is handled,
+ * only the header of the package is kept.
+ */
+static void BATCH_each(sirinet_promise_t * qpromise, BATCH_fwd_t * fwd)
+{
+    sirinet_pkg_t * pkg;
+
+    if (qpromise == NULL || qpromise->data == NULL || fwd->each_cb == NULL)
+    {
+        return;
+    }
+
+    pkg = (sirinet_pkg_t *) qpromise->data;
+
+    if (fwd->each_cb(qpromise, pkg, fwd->handle))
+    {
+        /* the package is handled, keep only the header */
+        qpromise->data = (void *) sirinet_pkg_new(pkg->pid, 0, pkg->tp, NULL);
+        free(pkg);
+    }
+}
+
+static void BATCH_free_series(imap_t * series_map)
+{
+    imap_free(series_map, (imap_free_cb) &siridb__series_decref);
+}
+
+static void BATCH_free_points(BATCH_points_t * bpoints)
+{
+    if (bpoints->points != NULL)
+    {
+        siridb_points_free(bpoints->points);
+    }
+    free(bpoints);
+}
+
+static int BATCH_add_series(siridb_series_t * series, imap_t * dest)
+{
+    if (    (series->flags & SIRIDB_SERIES_IS_DROPPED) ||
+            imap_get(dest, series->id) != NULL)
+    {
+        return 0;
+    }
+
+    if (imap_add(dest, series->id, series))
+    {
+        return -1;
+    }
+
+    siridb_series_incref(series);
+    return 0;
+}
@@ -10,12 +10,16 @@
 #include <siri/db/misc.h>
 #include <siri/db/shard.h>
 #include <siri/db/shards.h>
+#include <siri/mem.h>
 #include <siri/siri.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <xpath/xpath.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
 
 #define SIRIDB_BUFFER_FN "buffer.dat"
@@ -29,6 +33,13 @@ static int buffer__create_new(
 static int buffer__use_empty(
         siridb_buffer_t * buffer,
         siridb_series_t * series);
+static int buffer__map(siridb_buffer_t * buffer, size_t size);
+static int buffer__allocate(siridb_buffer_t * buffer, off_t offset, off_t len);
+static int buffer__flush_space(
+        siridb_t * siridb,
+        siridb_series_t * series,
+        char * pt,
+        size_t max_len);
 static void buffer__migrate_to_new(char * pt, size_t sz);
 static void buffer__init_template(char * template, size_t size);
 
@@ -53,6 +64,8 @@ siridb_buffer_t * siridb_buffer_new(void)
     }
     buffer->fd = 0;
     buffer->fp = NULL;
+    buffer->map = NULL;
+    buffer->map_sz = 0;
     buffer->len = 0;
     buffer->_to_size = 0;  /* 0 means no new size */
     buffer->path = NULL;
@@ -64,23 +77,34 @@ siridb_buffer_t * siridb_buffer_new(void)
 
 void siridb_buffer_free(siridb_buffer_t * buffer)
 {
-    if (buffer->fp != NULL)
-    {
-        fclose(buffer->fp);
-    }
+    (void) siridb_buffer_close(buffer);
     free(buffer->template);
     free(buffer->path);
     vec_free(buffer->empty);
     free(buffer);
 }
 
-void siridb_buffer_close(siridb_buffer_t * buffer)
+/*
+ * Returns 0 if successful or EOF in case of an error.
+ */
+int siridb_buffer_close(siridb_buffer_t * buffer)
 {
+    int rc = 0;
+
+    if (buffer->map != NULL)
+    {
+        rc = munmap(buffer->map, buffer->map_sz) ? EOF : 0;
+        buffer->map = NULL;
+        buffer->map_sz = 0;
+    }
+
     if (buffer->fp != NULL)
     {
-        fclose(buffer->fp);
+        rc = fclose(buffer->fp) ? EOF : rc;
         buffer->fp = NULL;
     }
+
+    return rc;
 }
 
 bool siridb_buffer_is_valid_size(ssize_t ssize)
@@ -134,18 +158,15 @@ int siridb_buffer_write_empty(
         siridb_buffer_t * buffer,
         siridb_series_t * series)
 {
+    if ((size_t) series->bf_offset + buffer->size > buffer->map_sz)
+    {
+        return EOF;
+    }
+
     memcpy(buffer->template + 4, &series->id, sizeof(uint32_t));
-    return (
-        /* go to the series position in buffer */
-        fseeko( buffer->fp,
-                series->bf_offset,
-                SEEK_SET) ||
-
-        /* write end ts */
-        fwrite( buffer->template,
-                buffer->size,
-                1,
-                buffer->fp) != 1) ? EOF : 0;
+    memcpy(buffer->map + series->bf_offset, buffer->template, buffer->size);
+
+    return 0;
 }
 
 /*
@@ -160,22 +181,31 @@ int siridb_buffer_write_point(
         uint64_t * ts,
         qp_via_t * val)
 {
-    const size_t sz = sizeof(uint64_t) + sizeof(qp_via_t);
-    char buf[sz];
-
+    char * pt;
     ssize_t last_idx = series->buffer->len - 1;
     assert (last_idx >= 0);
-    memcpy(buf, ts, sizeof(uint64_t));
-    memcpy(buf + sizeof(uint64_t), val, sizeof(qp_via_t));
 
-    return (
-        /* jump to position where to write the new point */
-        fseeko( buffer->fp,
-                series->bf_offset + 8 + (16 * last_idx),
-                SEEK_SET) ||
+    if (buffer->map == NULL)
+    {
+        return EOF;
+    }
+
+    /* position where to write the new point */
+    pt = buffer->map + series->bf_offset + 8 + (16 * last_idx);
+
+    if (pt + 16 > buffer->map + buffer->map_sz)
+    {
+        return EOF;
+    }
 
-        /* write time-stamp and value */
-        fwrite(buf, sz, 1, buffer->fp) != 1) ? EOF : 0;
+    /*
+     * Write the value before the time-stamp; the time-stamp replaces the
+     * end marker so a partial write is never read as a point.
+     */
+    memcpy(pt + sizeof(uint64_t), val, sizeof(qp_via_t));
+    memcpy(pt, ts, sizeof(uint64_t));
+
+    return 0;
 }
 
 /*
@@ -193,18 +223,89 @@ int siridb_buffer_new_series(
         ERR_ALLOC
         return -1;
     }
+    siri_mem_add(SIRI_MEM_BUFFERS, siridb_buffer_mem(buffer));
 
     return (buffer->empty->len) ?
             buffer__use_empty(buffer, series) :
             buffer__create_new(buffer, series);
 }
 
+/*
+ * Swap the full buffer of a series for an empty one. The full buffer moves
+ * to series->flushing and the series is bound to a new buffer space. The
+ * points in the previous buffer space are kept until the flushing points
+ * are written to the shards and siridb_buffer_release() is called.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+int siridb_buffer_swap(
+        siridb_buffer_t * buffer,
+        siridb_series_t * series)
+{
+    long int bf_offset = series->bf_offset;
+    siridb_points_t * points = siridb_points_new(buffer->len, series->tp);
+    if (points == NULL)
+    {
+        ERR_ALLOC
+        return -1;
+    }
+
+    if ((buffer->empty->len) ?
+            buffer__use_empty(buffer, series) :
+            buffer__create_new(buffer, series))
+    {
+        series->bf_offset = bf_offset;
+        siridb_points_free(points);
+        return -1;  /* signal is raised */
+    }
+    siri_mem_add(SIRI_MEM_BUFFERS, siridb_buffer_mem(buffer));
+
+    series->flushing = series->buffer;
+    series->bf_flush = bf_offset;
+    series->buffer = points;
+
+    return 0;
+}
+
+/*
+ * Release the buffer space of flushed points. The space is cleared so it
+ * will not be loaded again and can be re-used by another series. The
+ * 'bf_flush' argument is the buffer space of the points which might no
+ * longer be equal to series->bf_flush since the series can be swapped again
+ * before the space is released.
+ *
+ * Must be called from the main thread since the buffer file might be
+ * re-mapped and the empty list is changed.
+ *
+ * Returns 0 if successful or EOF in case of an error.
+ */
+int siridb_buffer_release(
+        siridb_buffer_t * buffer,
+        long int bf_flush,
+        siridb_points_t * points)
+{
+    siri_mem_sub(SIRI_MEM_BUFFERS, siridb_buffer_mem(buffer));
+    siridb_points_free(points);
+
+    if ((size_t) bf_flush + buffer->size > buffer->map_sz)
+    {
+        return EOF;
+    }
+
+    /* series id 0 is never used, see buffer__start */
+    memcpy(buffer->template + 4, &buffer__start, sizeof(uint32_t));
+    memcpy(buffer->map + bf_flush, buffer->template, buffer->size);
+
+    return vec_append_safe(&buffer->empty, (void *) bf_flush);
+}
+
 /*
  * Returns 0 if successful or -1 in case of an error.
  */
 int siridb_buffer_open(siridb_buffer_t * buffer)
 {
     int rc;
+    struct stat st;
     siridb_misc_get_fn(fn, buffer->path, SIRIDB_BUFFER_FN)
 
     if ((buffer->fp = fopen(fn, "r+")) == NULL)
@@ -223,6 +324,13 @@ int siridb_buffer_open(siridb_buffer_t * buffer)
         return -1;
     }
 
+    if (fstat(buffer->fd, &st) || buffer__map(buffer, (size_t) st.st_size))
+    {
+        log_critical("Cannot map buffer file: '%s'", fn);
+        (void) siridb_buffer_close(buffer);
+        return -1;
+    }
+
 #ifdef __APPLE__
     rc = 0;  /* no posix_fadvise on apple */
 #else
@@ -238,6 +346,14 @@ int siridb_buffer_open(siridb_buffer_t * buffer)
 }
 
 /*
+ * Load the buffer file using a (private or shared) mapping.
+ *
+ * When the buffer size is not changed, the buffer file is used in place and
+ * buffer spaces which are no longer in use are added to the empty list. Only
+ * when the buffer size is changed (or the file size is not a multiple of the
+ * buffer size), the buffer is written to a new file which replaces the
+ * current buffer file.
+ *
  * Returns 0 if successful or -1 in case of an error.
  * (signal might be raised)
  */
@@ -245,18 +361,20 @@ int siridb_buffer_load(siridb_t * siridb)
 {
     siridb_buffer_t * buffer = siridb->buffer;
     FILE * fp;
-    FILE * fp_temp;
+    FILE * fp_temp = NULL;
+    struct stat st;
+    int fd;
     size_t cur_size = buffer->size;
     size_t cur_len = cur_size / sizeof(siridb_point_t);
     size_t new_size =  buffer->_to_size ? buffer->_to_size : cur_size;
     size_t new_len = new_size / sizeof(siridb_point_t);
-    size_t read_at_once = (size_t) (MAX_BUFFER_SZ / cur_size);
     size_t max_len = cur_len > new_len ? cur_len : new_len;
-    size_t num, i;
-    char * buf, * pt;
+    size_t num, i, map_sz;
+    char * map = NULL, * pt;
     long int offset = 0;
     siridb_series_t * series;
     bool log_migrate = true;
+    bool in_place;
     uint32_t buf_start, series_id;
     uint64_t * ts;
     uint8_t ignore_broken_data = siri.cfg->ignore_broken_data;
@@ -267,11 +385,9 @@ int siridb_buffer_load(siridb_t * siridb)
     buffer->size = new_size;
     buffer->len = new_len;
 
-    buf = malloc(read_at_once * cur_size);
     buffer->template = malloc(new_size);
-    if (buf == NULL || buffer->template == NULL)
+    if (buffer->template == NULL)
     {
-        free(buf);  /* buffer->template will be cleaned */
         log_critical("Allocation error while loading buffer");
         return -1;
     }
@@ -294,13 +410,11 @@ int siridb_buffer_load(siridb_t * siridb)
             log_error("Temporary buffer file found: '%s'. Removing...", fn_temp);
             if (unlink(fn_temp))
             {
-                free(buf);
                 log_error("Failed to remove temporary buffer: %s", fn_temp);
                 return -1;
             }
         } else
         {
-            free(buf);
             log_error(
                 "Temporary buffer file found: '%s'. "
                 "Check if something went wrong or remove this file", fn_temp);
@@ -308,9 +422,8 @@ int siridb_buffer_load(siridb_t * siridb)
         }
     }
 
-    if ((fp = fopen(fn, "r")) == NULL)
+    if ((fd = open(fn, O_RDWR)) == -1)
     {
-        free(buf);
         log_info("Buffer file '%s' not found, create a new one.", fn);
         if ((fp = fopen(fn, "w")) == NULL)
         {
@@ -320,108 +433,188 @@ int siridb_buffer_load(siridb_t * siridb)
         return fclose(fp);
     }
 
-    if ((fp_temp = fopen(fn_temp, "w")) == NULL)
+    if (fstat(fd, &st))
     {
-        log_critical("Cannot open '%s' for writing", fn_temp);
-        fclose(fp);
-        free(buf);
+        log_critical("Cannot read the size of buffer file '%s'", fn);
+        close(fd);
         return -1;
     }
 
-    while ((num = fread(buf, cur_size, read_at_once, fp)))
+    map_sz = (size_t) st.st_size;
+    num = map_sz / cur_size;
+    in_place = new_size == cur_size && num * cur_size == map_sz;
+
+    if (map_sz)
     {
-        for (i = 0; i < num; i++)
-        {
-            pt = buf + i * cur_size;
+        /* a private mapping is used when the buffer file is re-written */
+        map = mmap(
+                NULL,
+                map_sz,
+                PROT_READ|PROT_WRITE,
+                in_place ? MAP_SHARED : MAP_PRIVATE,
+                fd,
+                0);
+    }
 
-            buf_start = *((uint32_t *) pt);
-            if (buf_start != buffer__start)
-            {
-                if (log_migrate)
-                {
-                    log_warning("Buffer will be migrated");
-                    log_migrate = false;
-                }
-                buffer__migrate_to_new(pt, cur_size);
-            }
+    /* the mapping stays valid after closing the file descriptor */
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        log_critical("Cannot map buffer file '%s'", fn);
+        return -1;
+    }
+
+    if (map != NULL)
+    {
+        (void) posix_madvise(map, map_sz, POSIX_MADV_SEQUENTIAL);
+    }
 
-            pt += sizeof(uint32_t);
-            series_id = *((uint32_t *) pt);
-            pt += sizeof(uint32_t);
+    if (!in_place && (fp_temp = fopen(fn_temp, "w")) == NULL)
+    {
+        log_critical("Cannot open '%s' for writing", fn_temp);
+        goto failed;
+    }
 
-            series = imap_get(siridb->series_map, series_id);
+    for (i = 0; i < num; i++)
+    {
+        pt = map + i * cur_size;
 
-            if (series == NULL)
+        buf_start = *((uint32_t *) pt);
+        if (buf_start != buffer__start)
+        {
+            if (log_migrate)
             {
-                continue;
+                log_warning("Buffer will be migrated");
+                log_migrate = false;
             }
-            else if (series->tp == TP_STRING)
+            buffer__migrate_to_new(pt, cur_size);
+        }
+
+        pt += sizeof(uint32_t);
+        series_id = *((uint32_t *) pt);
+        pt += sizeof(uint32_t);
+
+        series = imap_get(siridb->series_map, series_id);
+
+        if (series == NULL)
+        {
+            goto unused;
+        }
+        else if (series->tp == TP_STRING)
+        {
+            log_error("Unexpected buffer found for string series '%s'",
+                    series->name);
+            goto unused;
+        }
+        else if (series->buffer != NULL)
+        {
+            /* a background flush was not finished when SiriDB stopped */
+            if (buffer__flush_space(siridb, series, pt, max_len))
             {
-                log_error("Unexpected buffer found for string series '%s'",
+                log_critical("Error while flushing buffer for series '%s'",
                         series->name);
-                continue;
+                goto failed;
             }
-
-            series->buffer = siridb_points_new(max_len, series->tp);
-            if (series->buffer == NULL)
+            if (in_place)
             {
-                log_critical("Cannot allocate a buffer for series id %u",
-                        series->id);
-                goto failed;
+                memcpy(buffer->template + 4, &buffer__start, sizeof(uint32_t));
+                memcpy(map + i * cur_size, buffer->template, cur_size);
             }
+            goto unused;
+        }
 
-            series->bf_offset = offset;
+        series->buffer = siridb_points_new(max_len, series->tp);
+        if (series->buffer == NULL)
+        {
+            log_critical("Cannot allocate a buffer for series id %u",
+                    series->id);
+            goto failed;
+        }
+        siri_mem_add(SIRI_MEM_BUFFERS, siridb_buffer_mem(buffer));
 
-            for (; *(ts = (uint64_t *) pt) != buffer__end; pt += 16)
-            {
-                qp_via_t * val = (qp_via_t *) (pt + 8);
-                siridb_points_add_point(series->buffer, ts, val);
-            }
+        series->bf_offset = in_place ? (long int) (i * cur_size) : offset;
 
-            offset += new_size;
-            series->length += series->buffer->len;
+        for (; *(ts = (uint64_t *) pt) != buffer__end; pt += 16)
+        {
+            qp_via_t * val = (qp_via_t *) (pt + 8);
+            siridb_points_add_point(series->buffer, ts, val);
+        }
 
-            pt = buf + i * cur_size;
-            if (new_size > cur_size)
-            {
-                memcpy(buffer->template, pt, cur_size);
-                pt = buffer->template;
-            }
-            else if (new_size < cur_size)
-            {
-                if (series->buffer->len >= new_len)
-                {
-                    if (siridb_shards_add_points(
-                            siridb,
-                            series,
-                            series->buffer))
-                    {
-                        log_critical("Error while sharding points");
-                        goto failed;
-                    }
-                    series->buffer->len = 0;
-                    memcpy(
-                            buffer->template + 4,
-                            &series->id,
-                            sizeof(uint32_t));
-                    pt = buffer->template;
-                }
+        siridb_series_length_add(series, series->buffer->len);
 
-                if (siridb_points_resize(series->buffer, new_len))
+        if (in_place)
+        {
+            continue;
+        }
+
+        offset += new_size;
+
+        pt = map + i * cur_size;
+        if (new_size > cur_size)
+        {
+            memcpy(buffer->template, pt, cur_size);
+            pt = buffer->template;
+        }
+        else if (new_size < cur_size)
+        {
+            if (series->buffer->len >= new_len)
+            {
+                if (siridb_shards_add_points(
+                        siridb,
+                        series,
+                        series->buffer,
+                        NULL))
                 {
-                    log_critical("Allocation error while resizing points");
+                    log_critical("Error while sharding points");
                     goto failed;
                 }
+                series->buffer->len = 0;
+                memcpy(
+                        buffer->template + 4,
+                        &series->id,
+                        sizeof(uint32_t));
+                pt = buffer->template;
             }
 
-            /* write to output file and check if write was successful */
-            if ((fwrite(pt, new_size, 1, fp_temp) != 1))
+            if (siridb_points_resize(series->buffer, new_len))
             {
-                log_critical("Could not write to temporary buffer file: '%s'",
-                        fn_temp);
+                log_critical("Allocation error while resizing points");
                 goto failed;
             }
         }
+
+        /* write to output file and check if write was successful */
+        if ((fwrite(pt, new_size, 1, fp_temp) != 1))
+        {
+            log_critical("Could not write to temporary buffer file: '%s'",
+                    fn_temp);
+            goto failed;
+        }
+        continue;
+
+unused:
+        /* the space can be re-used when the buffer file is used in place */
+        if (in_place && vec_append_safe(
+                &buffer->empty,
+                (void *) (long int) (i * cur_size)))
+        {
+            log_critical("Allocation error while loading buffer");
+            goto failed;
+        }
+    }
+
+    if (map != NULL && (
+            (in_place && msync(map, map_sz, MS_SYNC)) ||
+            munmap(map, map_sz)))
+    {
+        log_critical("Cannot write or unmap buffer file '%s'", fn);
+        return -1;
+    }
+
+    if (in_place)
+    {
+        return 0;
     }
 
     if (new_size != cur_size)
@@ -429,15 +622,13 @@ int siridb_buffer_load(siridb_t * siridb)
         if (siridb_save(siridb))
         {
             log_critical("Cannot save changes to SiriDB (database.dat)");
-            goto failed;
+            fclose(fp_temp);
+            return -1;
         }
         buffer__init_template(buffer->template, new_size);
     }
 
-    free(buf);
-    if (fclose(fp) ||
-        fclose(fp_temp) ||
-        rename(fn_temp, fn))
+    if (fclose(fp_temp) || rename(fn_temp, fn))
     {
         log_critical("Could not rename '%s' to '%s'.", fn_temp, fn);
         return -1;
@@ -446,9 +637,14 @@ int siridb_buffer_load(siridb_t * siridb)
     return 0;
 
 failed:
-    fclose(fp);
-    fclose(fp_temp);
-    free(buf);
+    if (map != NULL)
+    {
+        munmap(map, map_sz);
+    }
+    if (fp_temp != NULL)
+    {
+        fclose(fp_temp);
+    }
     return -1;
 }
 
@@ -490,16 +686,30 @@ static int buffer__create_new(
 {
     long int buffer_pos;
 
+    /* bind the current end of the buffer to the new series */
+    series->bf_offset = (long int) buffer->map_sz;
+
+    buffer_pos = series->bf_offset + buffer->size * SIRIDB_BUFFER_CACHE;
 
-    /* jump to end of buffer */
-    if (fseeko(buffer->fp, 0, SEEK_END))
+    /* allocate disk space for the new positions before they are mapped */
+    if (buffer__allocate(
+            buffer,
+            (off_t) series->bf_offset,
+            (off_t) (buffer_pos - series->bf_offset)))
     {
         ERR_FILE
         return -1;
     }
 
-    /* bind the current offset to the new series */
-    if ((series->bf_offset = ftello(buffer->fp)) == -1)
+    /* commit changes to disk */
+    if (fsync(buffer->fd))
+    {
+        ERR_FILE
+        return -1;
+    }
+
+    /* map the new size */
+    if (buffer__map(buffer, (size_t) buffer_pos))
     {
         ERR_FILE
         return -1;
@@ -512,27 +722,163 @@ static int buffer__create_new(
         return -1;
     }
 
-    buffer_pos = series->bf_offset + buffer->size * SIRIDB_BUFFER_CACHE;
+    while ((buffer_pos -= buffer->size) > series->bf_offset)
+    {
+        vec_append_safe(&buffer->empty, (void *) buffer_pos);
+    }
 
-    /* fill buffer with zeros if possible */
-    if (ftruncate(buffer->fd, buffer_pos))
+    return 0;
+}
+
+/*
+ * Write the points from a buffer space to the shards. A series has a second
+ * buffer space when SiriDB has stopped before a background flush of the
+ * series was finished. The pointer must be at the first point.
+ *
+ * Returns 0 if successful or -1 in case of an error.
+ */
+static int buffer__flush_space(
+        siridb_t * siridb,
+        siridb_series_t * series,
+        char * pt,
+        size_t max_len)
+{
+    int rc = 0;
+    uint64_t * ts;
+    siridb_points_t * points = siridb_points_new(max_len, series->tp);
+    if (points == NULL)
     {
-        ERR_FILE
         return -1;
     }
 
-    /* commit changes to disk */
-    if (fsync(buffer->fd))
+    for (; *(ts = (uint64_t *) pt) != buffer__end; pt += 16)
     {
-        ERR_FILE
-        return -1;
+        qp_via_t * val = (qp_via_t *) (pt + 8);
+        siridb_points_add_point(points, ts, val);
     }
 
-    while ((buffer_pos -= buffer->size) > series->bf_offset)
+    if (points->len)
     {
-        vec_append_safe(&buffer->empty, (void *) buffer_pos);
+        log_info("Flushing %zu pending point(s) for series '%s'",
+                points->len, series->name);
+        siridb_series_length_add(series, points->len);
+        rc = siridb_shards_add_points(siridb, series, points, NULL);
     }
 
+    siridb_points_free(points);
+    return rc;
+}
+
+/*
+ * Allocate disk space in the buffer file. Points are written through the
+ * shared mapping, so the space must really exist on disk; a store to a hole
+ * in the file which cannot be allocated raises SIGBUS. When the file system
+ * does not support posix_fallocate(), zeros are written instead.
+ *
+ * Returns 0 if successful or -1 in case of an error (for example when the
+ * disk is full).
+ */
+static int buffer__allocate(siridb_buffer_t * buffer, off_t offset, off_t len)
+{
+    char zeros[4096];
+    ssize_t n;
+
+#ifndef __APPLE__
+    int rc = posix_fallocate(buffer->fd, offset, len);
+    if (rc != EINVAL && rc != EOPNOTSUPP)
+    {
+        if (rc)
+        {
+            log_critical(
+                    "Cannot allocate space in the buffer file (%s)",
+                    strerror(rc));
+            return -1;
+        }
+        return 0;
+    }
+#endif
+
+    memset(zeros, 0, sizeof(zeros));
+
+    while (len > 0)
+    {
+        n = pwrite(
+                buffer->fd,
+                zeros,
+                (len < (off_t) sizeof(zeros)) ? (size_t) len : sizeof(zeros),
+                offset);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log_critical(
+                    "Cannot write zeros to the buffer file (%s)",
+                    strerror(errno));
+            return -1;
+        }
+        offset += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/*
+ * (Re)map the buffer file using the given size. The mapping is shared so
+ * points written to the mapping end up in the buffer file. On Linux an
+ * existing mapping is resized with mremap() so a growing buffer file does
+ * not need to be mapped again as a whole.
+ *
+ * Returns 0 if successful or -1 in case of an error.
+ */
+static int buffer__map(siridb_buffer_t * buffer, size_t size)
+{
+    char * map;
+
+#ifdef __linux__
+    if (buffer->map != NULL && size != 0)
+    {
+        map = mremap(buffer->map, buffer->map_sz, size, MREMAP_MAYMOVE);
+        if (map != MAP_FAILED)
+        {
+            /* points are written at random positions */
+            (void) posix_madvise(map, size, POSIX_MADV_RANDOM);
+
+            buffer->map = map;
+            buffer->map_sz = size;
+            return 0;
+        }
+        log_warning("Cannot resize the buffer mapping, map the file again");
+    }
+#endif
+
+    if (buffer->map != NULL && munmap(buffer->map, buffer->map_sz))
+    {
+        log_error("Cannot unmap buffer file");
+    }
+
+    buffer->map = NULL;
+    buffer->map_sz = 0;
+
+    if (size == 0)
+    {
+        return 0;  /* nothing to map for an empty buffer file */
+    }
+
+    map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, buffer->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    /* points are written at random positions */
+    (void) posix_madvise(map, size, POSIX_MADV_RANDOM);
+
+    buffer->map = map;
+    buffer->map_sz = size;
+
     return 0;
 }
 
@@ -0,0 +1,176 @@
+/*
+ * cursor.c - Cursor for incremental select queries.
+ *
+ * A client can send a cursor with a select query. The response for such
+ * query contains a new cursor using the key '__cursor__' which can be sent
+ * with the next query to receive only the points which are newer than the
+ * points in the previous response. For the client the cursor is just raw
+ * data; internally it is a qpack map with the timestamp of the last point
+ * for each name in the result, using the time precision of the database.
+ * An empty cursor starts a new cursor and returns all points.
+ *
+ * When a select function uses only 'group by' aggregations, the last group
+ * is computed again so the group for the last point is updated. For other
+ * aggregations all points are read and only a new cursor is returned.
+ *
+ * A cursor does not detect points which are inserted with a timestamp older
+ * than the cursor.
+ */
+#include <logger/logger.h>
+#include <siri/db/aggregate.h>
+#include <siri/db/cursor.h>
+#include <siri/err.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Returns a tree with the last timestamp (uint64_t *) for each name in the
+ * cursor or NULL when the cursor is invalid or in case of an allocation
+ * error. (a SIGNAL is raised in case of an allocation error)
+ */
+ct_t * siridb_cursor_load(const char * data, size_t len)
+{
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_name, qp_ts;
+    qp_types_t tp;
+    uint64_t * ts;
+    char * name;
+    ct_t * cursor = ct_new();
+
+    if (cursor == NULL)
+    {
+        ERR_ALLOC
+        return NULL;
+    }
+
+    if (!len)
+    {
+        return cursor;
+    }
+
+    qp_unpacker_init(&unpacker, (unsigned char *) data, len);
+
+    if (!qp_is_map(qp_next(&unpacker, NULL)))
+    {
+        siridb_cursor_free(cursor);
+        return NULL;
+    }
+
+    while ((tp = qp_next(&unpacker, &qp_name)) == QP_RAW)
+    {
+        if (    qp_next(&unpacker, &qp_ts) != QP_INT64 ||
+                qp_ts.via.int64 < 0)
+        {
+            siridb_cursor_free(cursor);
+            return NULL;
+        }
+
+        name = strndup((const char *) qp_name.via.raw, qp_name.len);
+        ts = malloc(sizeof(uint64_t));
+
+        if (name == NULL || ts == NULL)
+        {
+            ERR_ALLOC
+            free(name);
+            free(ts);
+            siridb_cursor_free(cursor);
+            return NULL;
+        }
+
+        *ts = (uint64_t) qp_ts.via.int64;
+
+        if (ct_add(cursor, name, ts) != CT_OK)
+        {
+            /* duplicated names are ignored */
+            free(ts);
+        }
+
+        free(name);
+    }
+
+    if (tp != QP_END && tp != QP_MAP_CLOSE)
+    {
+        siridb_cursor_free(cursor);
+        return NULL;
+    }
+
+    return cursor;
+}
+
+void siridb_cursor_free(ct_t * cursor)
+{
+    ct_free(cursor, free);
+}
+
+/*
+ * Set start to the first timestamp which must be read for a result name in
+ * case the cursor contains the name and the aggregation list allows an
+ * incremental result.
+ *
+ * Returns 1 when start is set or 0 if all points must be read.
+ */
+int siridb_cursor_start(
+        ct_t * cursor,
+        const char * name,
+        vec_t * alist,
+        uint64_t * start)
+{
+    uint64_t * ts = ct_get(cursor, name);
+    uint64_t group = 0;
+    uint64_t n;
+    siridb_aggr_t * aggr;
+    size_t i;
+
+    if (ts == NULL)
+    {
+        return 0;
+    }
+
+    for (i = 0; alist != NULL && i < alist->len; i++)
+    {
+        aggr = (siridb_aggr_t *) alist->data[i];
+
+        /* groups must be aligned so the last group contains all others */
+        if (    !aggr->group_by ||
+                aggr->limit ||
+                aggr->offset ||
+                (group && (group > aggr->group_by ?
+                        group % aggr->group_by :
+                        aggr->group_by % group)))
+        {
+            return 0;
+        }
+
+        if (aggr->group_by > group)
+        {
+            group = aggr->group_by;
+        }
+    }
+
+    if (!group)
+    {
+        *start = *ts + 1;
+        return 1;
+    }
+
+    /* a group contains the points with (n - 1) * group < ts <= n * group */
+    n = (*ts + group - 1) / group;
+    *start = n ? (n - 1) * group + 1 : 0;
+
+    return 1;
+}
+
+/*
+ * Add the last timestamp for a name to a cursor map.
+ *
+ * Returns 0 if successful or -1 in case of an allocation error.
+ */
+int siridb_cursor_pack(
+        qp_packer_t * packer,
+        const char * name,
+        size_t len,
+        uint64_t ts)
+{
+    return (qp_add_raw(packer, (const unsigned char *) name, len) ||
+            qp_add_int64(packer, (int64_t) ts)) ? -1 : 0;
+}
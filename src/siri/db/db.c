@@ -319,7 +319,8 @@ static int siridb__from_unpacker(
             qp_schema.via.int64 == 2 ||
             qp_schema.via.int64 == 3 ||
             qp_schema.via.int64 == 4 ||
-            qp_schema.via.int64 == 5)
+            qp_schema.via.int64 == 5 ||
+            qp_schema.via.int64 == 6)
     {
         log_info(
                 "Found an old database schema (v%d), "
@@ -519,6 +520,48 @@ static int siridb__from_unpacker(
         }
         (*siridb)->expiration_num = qp_obj.via.int64;
     }
+    if (qp_schema.via.int64 >= 7)
+    {
+        qp_obj_t qp_filter;
+        char * filter = NULL;
+        int rc;
+
+        /* read tee filter type, filter and format */
+        if (    qp_next(unpacker, &qp_obj) != QP_INT64 ||
+                qp_obj.via.int64 < SIRIDB_TEE_FILTER_NONE ||
+                qp_obj.via.int64 > SIRIDB_TEE_FILTER_GROUP ||
+                (qp_next(unpacker, &qp_filter) != QP_RAW &&
+                    qp_filter.tp != QP_NULL) ||
+                (qp_filter.tp == QP_NULL &&
+                    qp_obj.via.int64 != SIRIDB_TEE_FILTER_NONE))
+        {
+            READ_DB_EXIT_WITH_ERROR("Cannot read tee filter.")
+        }
+
+        if (    qp_filter.tp == QP_RAW &&
+                (filter = strndup(
+                    (char *) qp_filter.via.raw,
+                    qp_filter.len)) == NULL)
+        {
+            READ_DB_EXIT_WITH_ERROR("Cannot allocate tee filter.")
+        }
+
+        rc = (  qp_next(unpacker, &qp_filter) != QP_INT64 ||
+                siridb_tee_set_filter(
+                    (*siridb)->tee,
+                    *siridb,
+                    (siridb_tee_filter_t) qp_obj.via.int64,
+                    filter,
+                    (siridb_tee_format_t) qp_filter.via.int64,
+                    err_msg));
+
+        free(filter);
+
+        if (rc)
+        {
+            READ_DB_EXIT_WITH_ERROR("Cannot read tee filter or format.")
+        }
+    }
     if ((*siridb)->tee->pipe_name_ == NULL)
     {
         log_debug(
@@ -680,6 +723,11 @@ int siridb_save(siridb_t * siridb)
                 : qp_fadd_string(fpacker, siridb->tee->pipe_name_)) ||
             qp_fadd_int64(fpacker, siridb->expiration_log) ||
             qp_fadd_int64(fpacker, siridb->expiration_num) ||
+            qp_fadd_int64(fpacker, siridb->tee->filter_tp_) ||
+            (siridb->tee->filter_ == NULL
+                ? qp_fadd_type(fpacker, QP_NULL)
+                : qp_fadd_string(fpacker, siridb->tee->filter_)) ||
+            qp_fadd_int64(fpacker, siridb->tee->format_) ||
             qp_fadd_type(fpacker, QP_ARRAY_CLOSE) ||
             qp_close(fpacker));
 }
@@ -750,6 +798,24 @@ void siridb__free(siridb_t * siridb)
         siridb_pools_free(siridb->pools);
     }
 
+    /* release series which are still queued for a flush */
+    if (siridb->flush != NULL)
+    {
+        siridb_flush_free(siridb->flush);
+    }
+
+    /* release chunks shared between select queries */
+    if (siridb->share != NULL)
+    {
+        siridb_share_free(siridb->share);
+    }
+
+    /* release subscriptions for pushing new points */
+    if (siridb->subscriptions != NULL)
+    {
+        siridb_subscriptions_free(siridb->subscriptions);
+    }
+
     /* free imap (series) */
     if (siridb->series_map != NULL)
     {
@@ -891,9 +957,13 @@ static siridb_t * siridb__new(void)
     siridb->max_series_id = 0;
     siridb->received_points = 0;
     siridb->selected_points = 0;
+    siridb->points_total = 0;
+    siridb->shards_size[SIRIDB_SHARD_TP_NUMBER] = 0;
+    siridb->shards_size[SIRIDB_SHARD_TP_LOG] = 0;
     siridb->drop_threshold = DEF_DROP_THRESHOLD;
     siridb->select_points_limit = DEF_SELECT_POINTS_LIMIT;
     siridb->list_limit = DEF_LIST_LIMIT;
+    siridb->scrub_series_id = 0;
     siridb->tz = -1;
     siridb->server = NULL;
     siridb->replica = NULL;
@@ -932,11 +1002,32 @@ static siridb_t * siridb__new(void)
         goto fail3;
     }
 
+    /* allocate flush queue */
+    siridb->flush = siridb_flush_new();
+    if (siridb->flush == NULL)
+    {
+        goto fail4;
+    }
+
+    /* allocate registry for chunks shared between select queries */
+    siridb->share = siridb_share_new();
+    if (siridb->share == NULL)
+    {
+        goto fail5;
+    }
+
+    /* allocate subscriptions for pushing new points */
+    siridb->subscriptions = siridb_subscriptions_new();
+    if (siridb->subscriptions == NULL)
+    {
+        goto fail6;
+    }
+
     /* allocate tee */
     siridb->tee = siridb_tee_new();
     if (siridb->tee == NULL)
     {
-        goto fail4;
+        goto fail7;
     }
 
     uv_mutex_init(&siridb->series_mutex);
@@ -945,6 +1036,12 @@ static siridb_t * siridb__new(void)
 
     return siridb;
 
+fail7:
+    siridb_subscriptions_free(siridb->subscriptions);
+fail6:
+    siridb_share_free(siridb->share);
+fail5:
+    siridb_flush_free(siridb->flush);
 fail4:
     siridb_buffer_free(siridb->buffer);
 fail3:
@@ -0,0 +1,390 @@
+/*
+ * flush.c - Background flush of full series buffers.
+ *
+ * When a series buffer is full, the insert task swaps the buffer for an
+ * empty one (using a new buffer space in the buffer file) and queues the
+ * series. The queue is processed by a worker on the libuv thread pool which
+ * compresses and writes the points to the shards and updates the index,
+ * while holding the series and shards lock for a batch of series. A batch
+ * is limited in the number of series and in time, so the locks are never
+ * held long when the series have many points. Chunks of
+ * a batch which belong to the same shard are collected and written to the
+ * shard at once. Queries read the points which are waiting for a flush from
+ * series->flushing, so the points are always visible; either in the buffer
+ * or in the shards.
+ *
+ * The buffer space with the flushing points is only released after the
+ * points are written to the shards. The buffer file and the list of empty
+ * buffer spaces are only used by the main thread, so the worker only takes
+ * the points from series->flushing and the main thread releases the points,
+ * the buffer spaces and the series references when the worker is finished.
+ * When SiriDB stops before a flush has finished, both buffer spaces are
+ * loaded on the next start and the pending points are written to the shards
+ * while loading the buffer.
+ *
+ * The queue is modified by the main thread and the worker and is protected
+ * by the series lock. Each database uses at most one worker since a flush
+ * holds the series lock anyway.
+ */
+#include <assert.h>
+#include <logger/logger.h>
+#include <siri/db/buffer.h>
+#include <siri/db/flush.h>
+#include <siri/db/shards.h>
+#include <siri/err.h>
+#include <siri/siri.h>
+#include <stdlib.h>
+#include <timeit/timeit.h>
+#include <unistd.h>
+
+/* maximum number of series which are flushed using a single batch */
+#define FLUSH_BATCH_SZ 64
+
+/* no more series are added to a batch after this time in seconds */
+#define FLUSH_BATCH_TIME 0.005
+
+/* time in microseconds the lock is released between two batches */
+#define FLUSH_YIELD_US 200
+
+typedef struct
+{
+    siridb_points_t * points;
+    long int bf_flush;
+} FLUSH_space_t;
+
+static void FLUSH_work(uv_work_t * work);
+static void FLUSH_work_finish(uv_work_t * work, int status);
+static size_t FLUSH_batch(
+        siridb_t * siridb,
+        vec_t * vec,
+        size_t start,
+        size_t end);
+static int FLUSH_series(siridb_t * siridb, siridb_series_t * series);
+static int FLUSH_take(siridb_flush_t * flush, siridb_series_t * series);
+
+/*
+ * Returns NULL in case of an allocation error.
+ */
+siridb_flush_t * siridb_flush_new(void)
+{
+    siridb_flush_t * flush = malloc(sizeof(siridb_flush_t));
+    if (flush == NULL)
+    {
+        return NULL;
+    }
+
+    flush->queue = vec_new(VEC_DEFAULT_SIZE);
+    flush->work_queue = vec_new(VEC_DEFAULT_SIZE);
+    flush->release = vec_new(VEC_DEFAULT_SIZE);
+    flush->shards = vec_new(VEC_DEFAULT_SIZE);
+    flush->is_running = 0;
+
+    if (    flush->queue == NULL ||
+            flush->work_queue == NULL ||
+            flush->release == NULL ||
+            flush->shards == NULL)
+    {
+        siridb_flush_free(flush);
+        return NULL;
+    }
+
+    return flush;
+}
+
+/*
+ * Series which are still queued keep their points in the buffer file and
+ * will be flushed when the buffer is loaded.
+ */
+void siridb_flush_free(siridb_flush_t * flush)
+{
+    if (flush->queue != NULL)
+    {
+        vec_destroy(flush->queue, (vec_destroy_cb) siridb__series_decref);
+    }
+    vec_free(flush->work_queue);
+    if (flush->release != NULL)
+    {
+        vec_destroy(flush->release, free);
+    }
+    vec_free(flush->shards);
+    free(flush);
+}
+
+/*
+ * Swap the full buffer of a series for an empty one and queue the series
+ * for a background flush. Must be called from the main thread while holding
+ * the series lock and only when series->flushing is NULL.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+int siridb_flush_series(siridb_t * siridb, siridb_series_t * series)
+{
+    siridb_flush_t * flush = siridb->flush;
+
+    assert (series->flushing == NULL);
+
+    if (vec_append_safe(&flush->queue, series))
+    {
+        ERR_ALLOC
+        return -1;
+    }
+
+    if (siridb_buffer_swap(siridb->buffer, series))
+    {
+        --flush->queue->len;
+        return -1;  /* signal is raised */
+    }
+
+    siridb_series_incref(series);
+
+    if (!flush->is_running)
+    {
+        flush->is_running = 1;
+        flush->work.data = siridb;
+        siridb_incref(siridb);
+        siridb_tasks_inc(siridb->tasks);
+
+        uv_queue_work(
+                siri.loop,
+                &flush->work,
+                FLUSH_work,
+                FLUSH_work_finish);
+    }
+
+    return 0;
+}
+
+static void FLUSH_work(uv_work_t * work)
+{
+    /*
+     * Flush Thread
+     */
+    siridb_t * siridb = (siridb_t *) work->data;
+    siridb_flush_t * flush = siridb->flush;
+    vec_t * tmp;
+    size_t i, n;
+
+    uv_mutex_lock(&siridb->series_mutex);
+
+    /*
+     * Take the queued series, new series are added to an empty queue and
+     * will be flushed by a next worker. The taken series are released by
+     * the main thread in FLUSH_work_finish().
+     */
+    tmp = flush->queue;
+    flush->queue = flush->work_queue;
+    flush->work_queue = tmp;
+
+    for (i = 0; i < tmp->len && siri.status != SIRI_STATUS_CLOSING; i = n)
+    {
+        n = (tmp->len - i > FLUSH_BATCH_SZ) ? i + FLUSH_BATCH_SZ : tmp->len;
+
+        n = FLUSH_batch(siridb, tmp, i, n);
+
+        /*
+         * Give the insert task the opportunity to get the lock. The lock
+         * is not fair so we must sleep or we would get the lock again.
+         */
+        uv_mutex_unlock(&siridb->series_mutex);
+        usleep(FLUSH_YIELD_US);
+        uv_mutex_lock(&siridb->series_mutex);
+    }
+
+    uv_mutex_unlock(&siridb->series_mutex);
+}
+
+static void FLUSH_work_finish(uv_work_t * work, int status)
+{
+    /*
+     * Main Thread
+     */
+    siridb_t * siridb = (siridb_t *) work->data;
+    siridb_flush_t * flush = siridb->flush;
+    siridb_series_t * series;
+    FLUSH_space_t * space;
+    size_t i;
+
+    if (status)
+    {
+        log_error("Flush task has failed (%d)", status);
+    }
+
+    for (i = 0; i < flush->release->len; i++)
+    {
+        space = (FLUSH_space_t *) flush->release->data[i];
+
+        if (siridb_buffer_release(
+                siridb->buffer,
+                space->bf_flush,
+                space->points))
+        {
+            log_critical(
+                    "Cannot release buffer space at position %ld",
+                    space->bf_flush);
+        }
+
+        free(space);
+    }
+    flush->release->len = 0;
+
+    for (i = 0; i < flush->work_queue->len; i++)
+    {
+        series = (siridb_series_t *) flush->work_queue->data[i];
+
+        /* series might be destroyed when dropped */
+        siridb_series_decref(series);
+    }
+    flush->work_queue->len = 0;
+
+    siridb_tasks_dec(siridb->tasks);
+
+    /* series might be queued after the worker has taken the queue */
+    if (flush->queue->len && siri.status != SIRI_STATUS_CLOSING)
+    {
+        siridb_tasks_inc(siridb->tasks);
+
+        uv_queue_work(
+                siri.loop,
+                &flush->work,
+                FLUSH_work,
+                FLUSH_work_finish);
+        return;
+    }
+
+    flush->is_running = 0;
+    siridb_decref(siridb);
+}
+
+/*
+ * Flush the series in vec from start to end. Chunks for the same shard are
+ * collected and written using a single write for the batch. The flushed
+ * points are taken from the series after the chunks are written. Must be
+ * called while holding the series lock.
+ *
+ * When FLUSH_BATCH_TIME has passed, the remaining series are left for a next
+ * batch so the locks can be released.
+ *
+ * Returns the position of the first series which is not part of the batch.
+ */
+static size_t FLUSH_batch(
+        siridb_t * siridb,
+        vec_t * vec,
+        size_t start,
+        size_t end)
+{
+    siridb_flush_t * flush = siridb->flush;
+    siridb_series_t * series;
+    struct timespec batch_start;
+    size_t i, done;
+
+    uv_mutex_lock(&siridb->shards_mutex);
+
+    timeit_start(&batch_start);
+
+    for (   i = start;
+            i < end && !siri_err && siri.status != SIRI_STATUS_CLOSING;
+            i++)
+    {
+        if (i > start && timeit_get(&batch_start) > FLUSH_BATCH_TIME)
+        {
+            end = i;
+            break;
+        }
+
+        if (FLUSH_series(siridb, (siridb_series_t *) vec->data[i]))
+        {
+            break;  /* signal is raised */
+        }
+    }
+
+    done = siridb_shards_write_batch(flush->shards) ? start : i;
+
+    uv_mutex_unlock(&siridb->shards_mutex);
+
+    for (i = start; i < done; i++)
+    {
+        series = (siridb_series_t *) vec->data[i];
+
+        if (FLUSH_take(flush, series))
+        {
+            break;  /* signal is raised */
+        }
+    }
+
+    return end;
+}
+
+/*
+ * Write the points of series->flushing to the shards using the batch. The
+ * points stay in series->flushing until the batch is written.
+ *
+ * Points of a dropped series are cleaned up when the series is destroyed.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+static int FLUSH_series(siridb_t * siridb, siridb_series_t * series)
+{
+    siridb_points_t * points = series->flushing;
+    int rc;
+
+    if (points == NULL || (series->flags & SIRIDB_SERIES_IS_DROPPED))
+    {
+        return 0;
+    }
+
+    /* expired points are removed so the start and end must exclude them */
+    series->flushing = NULL;
+
+    rc = siridb_shards_add_points(
+            siridb,
+            series,
+            points,
+            &siridb->flush->shards);
+
+    series->flushing = points;
+
+    if (rc)
+    {
+        /* the points stay in the buffer file */
+        log_critical(
+                "Cannot flush the buffer for series '%s'",
+                series->name);
+    }
+
+    return rc;
+}
+
+/*
+ * Take the flushed points from a series so they are no longer read by
+ * queries, since the points are in the shards now. The points and buffer
+ * space are released by the main thread in FLUSH_work_finish().
+ *
+ * Points of a dropped series are cleaned up when the series is destroyed.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+static int FLUSH_take(siridb_flush_t * flush, siridb_series_t * series)
+{
+    FLUSH_space_t * space;
+
+    if (    series->flushing == NULL ||
+            (series->flags & SIRIDB_SERIES_IS_DROPPED))
+    {
+        return 0;
+    }
+
+    space = malloc(sizeof(FLUSH_space_t));
+    if (space == NULL || vec_append_safe(&flush->release, space))
+    {
+        /* the points stay in the buffer file */
+        free(space);
+        ERR_ALLOC
+        return -1;
+    }
+
+    space->points = series->flushing;
+    space->bf_flush = series->bf_flush;
+    series->flushing = NULL;
+
+    return 0;
+}
@@ -39,6 +39,7 @@ siridb_group_t * siridb_group_new(
         group->name = NULL;
         group->source = strndup(source, source_len);
         group->series = vec_new(VEC_DEFAULT_SIZE);
+        group->set = NULL;
         group->regex = NULL;
         group->match_data = NULL;
 
@@ -174,6 +175,10 @@ void siridb_group_cleanup(siridb_group_t * group)
 
         if (series->flags & SIRIDB_SERIES_IS_DROPPED)
         {
+            if (group->set != NULL)
+            {
+                (void) imap_pop(group->set, series->id);
+            }
             siridb_series_decref(series);
             dropped++;
         }
@@ -217,12 +222,58 @@ int siridb_group_test_series(siridb_group_t * group, siridb_series_t * series)
         {
             siridb_series_incref(series);
             rc = 0;
+
+            if (    group->set != NULL &&
+                    imap_add(group->set, series->id, series))
+            {
+                /* the set will be re-created when used */
+                imap_free(group->set, NULL);
+                group->set = NULL;
+            }
         }
     }
 
     return rc;
 }
 
+/*
+ * Returns the series for a group as a map by series id, or NULL in case of
+ * an allocation error. The map is created on first use and is kept up-to-date
+ * together with group->series so queries can use the map without building
+ * a new one. The map only holds borrowed references.
+ *
+ * (groups->mutex must be locked)
+ */
+imap_t * siridb_group_series_set(siridb_group_t * group)
+{
+    siridb_series_t * series;
+    size_t i;
+
+    if (group->set != NULL)
+    {
+        return group->set;
+    }
+
+    group->set = imap_new();
+    if (group->set == NULL)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < group->series->len; i++)
+    {
+        series = (siridb_series_t *) group->series->data[i];
+        if (imap_add(group->set, series->id, series))
+        {
+            imap_free(group->set, NULL);
+            group->set = NULL;
+            return NULL;
+        }
+    }
+
+    return group->set;
+}
+
 /*
  * Returns 0 when successful or -1 in case or an error.
  *
@@ -281,6 +332,12 @@ int siridb_group_update_expression(
 
     vec_compact(&group->series);
 
+    if (group->set != NULL)
+    {
+        imap_free(group->set, NULL);
+        group->set = NULL;
+    }
+
     if (~group->flags & GROUP_FLAG_INIT)
     {
         group->flags |= GROUP_FLAG_INIT;
@@ -371,6 +428,11 @@ void siridb__group_free(siridb_group_t * group)
         vec_free(group->series);
     }
 
+    if (group->set != NULL)
+    {
+        imap_free(group->set, NULL);
+    }
+
     pcre2_code_free(group->regex);
     pcre2_match_data_free(group->match_data);
     free(group);
@@ -450,7 +450,8 @@ static void GROUPS_loop(void * arg)
             {
                 siridb_tags_dropped_series(siridb->tags);
             }
-            if (siridb->tags->flags & TAGS_FLAG_REQUIRE_SAVE)
+            if (siridb->tags->flags & (
+                    TAGS_FLAG_REQUIRE_SAVE | TAGS_FLAG_REQUIRE_COMPACT))
             {
                 siridb_tags_save(siridb->tags);
             }
@@ -12,6 +12,7 @@
 #include <siri/db/replicate.h>
 #include <siri/db/series.h>
 #include <siri/db/servers.h>
+#include <siri/db/subscriptions.h>
 #include <siri/err.h>
 #include <siri/net/promises.h>
 #include <siri/net/protocol.h>
@@ -38,6 +39,11 @@ if (*ts > series->end)              \
 }
 
 static void INSERT_free(uv_handle_t * handle);
+static inline int INSERT_pcache_run(
+        siridb_series_t * series,
+        qp_unpacker_t * unpacker,
+        siridb_pcache_t * pcache,
+        int * n);
 static void INSERT_points_to_pools(uv_async_t * handle);
 static void INSERT_on_response(vec_t * promises, uv_async_t * handle);
 static uint16_t INSERT_get_pool(siridb_t * siridb, qp_obj_t * qp_series_name);
@@ -347,7 +353,7 @@ int insert_init_backend_local(
 
     if (siridb_tee_is_connected(siridb->tee))
     {
-        siridb_tee_write(siridb->tee, promise);
+        siridb_tee_write(siridb->tee, siridb, promise);
     }
 
     uv_async_init(siri.loop, handle, INSERT_local_task);
@@ -486,6 +492,44 @@ static void INSERT_local_free_cb(uv_async_t * handle)
     free(handle);
 }
 
+/*
+ * Fast path which adds a run of points with an integer or double value to
+ * the pcache. Stops at the first point with another shape, the caller should
+ * continue with qp_next().
+ *
+ * Returns 0 if successful or -1 and a signal is raised in case of an error.
+ */
+static inline int INSERT_pcache_run(
+        siridb_series_t * series,
+        qp_unpacker_t * unpacker,
+        siridb_pcache_t * pcache,
+        int * n)
+{
+    qp_obj_t qp_val;
+    int64_t its;
+    uint64_t * ts = (uint64_t *) &its;
+
+    if (series->tp == TP_STRING)
+    {
+        return 0;
+    }
+
+    while (qp_next_point(unpacker, &its, &qp_val) == 0)
+    {
+        siridb_series_ensure_type(series, &qp_val);
+        SERIES_UPDATE_TS(series)
+
+        if (siridb_pcache_add_point(pcache, ts, &qp_val.via))
+        {
+            return -1;  /* signal is raised */
+        }
+
+        (*n)--;
+    }
+
+    return 0;
+}
+
 /*
  * Returns insert->status
  */
@@ -548,6 +592,15 @@ static int8_t INSERT_local_work(
         if ((tp = qp_next(unpacker, qp_series_name)) != QP_ARRAY2 &&
                 series->buffer != NULL)
         {
+            if (series->subs)
+            {
+                siridb_subscriptions_point(
+                        siridb->subscriptions,
+                        series,
+                        *ts,
+                        &qp_series_val);
+            }
+
             if (siridb_series_add_point(
                     siridb,
                     series,
@@ -614,7 +667,8 @@ static int8_t INSERT_local_work(
                 if (siridb_pcache_add_point(
                         *pcache,
                         ts,
-                        val))
+                        val) ||
+                    INSERT_pcache_run(series, unpacker, *pcache, &n))
                 {
                     return INSERT_LOCAL_ERROR;  /* signal is raised */
                 }
@@ -623,6 +677,14 @@ static int8_t INSERT_local_work(
             }
             while ((tp = qp_next(unpacker, qp_series_name)) == QP_ARRAY2);
 
+            if (series->subs)
+            {
+                siridb_subscriptions_pcache(
+                        siridb->subscriptions,
+                        series,
+                        *pcache);
+            }
+
             if (siridb_series_add_pcache(
                     siridb,
                     series,
@@ -633,7 +695,7 @@ static int8_t INSERT_local_work(
 
             if ((*pcache)->tp == TP_STRING)
             {
-                siridb_points_free((siridb_points_t *) *pcache);
+                siridb_pcache_free(*pcache);
                 *pcache = NULL;
             }
         }
@@ -773,6 +835,15 @@ static int INSERT_local_work_test(
         if ((tp = qp_next(unpacker, qp_series_name)) != QP_ARRAY2 &&
                 series->buffer != NULL)
         {
+            if (series->subs)
+            {
+                siridb_subscriptions_point(
+                        siridb->subscriptions,
+                        series,
+                        *ts,
+                        &qp_series_val);
+            }
+
             if (siridb_series_add_point(
                     siridb,
                     series,
@@ -838,7 +909,8 @@ static int INSERT_local_work_test(
                 if (siridb_pcache_add_point(
                         *pcache,
                         ts,
-                        val))
+                        val) ||
+                    INSERT_pcache_run(series, unpacker, *pcache, &n))
                 {
                     return INSERT_LOCAL_ERROR;  /* signal is raised */
                 }
@@ -847,6 +919,14 @@ static int INSERT_local_work_test(
             }
             while ((tp = qp_next(unpacker, qp_series_name)) == QP_ARRAY2);
 
+            if (series->subs)
+            {
+                siridb_subscriptions_pcache(
+                        siridb->subscriptions,
+                        series,
+                        *pcache);
+            }
+
             if (siridb_series_add_pcache(
                     siridb,
                     series,
@@ -857,7 +937,7 @@ static int INSERT_local_work_test(
 
             if ((*pcache)->tp == TP_STRING)
             {
-                siridb_points_free((siridb_points_t *) *pcache);
+                siridb_pcache_free(*pcache);
                 *pcache = NULL;
             }
 
@@ -957,6 +1037,9 @@ static void INSERT_local_task(uv_async_t * handle)
         }
     }
 
+    /* push the inserted points to subscribed clients */
+    siridb_subscriptions_flush(siridb->subscriptions);
+
     if (siri.buffersync == NULL)
     {
         if (siridb_buffer_fsync(siridb->buffer))
@@ -1077,7 +1160,7 @@ static int INSERT_init_local(
 
     if (siridb_tee_is_connected(siridb->tee))
     {
-        siridb_tee_write(siridb->tee, promise);
+        siridb_tee_write(siridb->tee, siridb, promise);
     }
 
     uv_async_init(siri.loop, handle, INSERT_local_task);
@@ -1413,6 +1496,9 @@ static int INSERT_read_points(
         ssize_t * count)
 {
     qp_types_t tp;
+    unsigned char * pt;
+    ssize_t n = 0;
+    int64_t ts;
 
     if (!qp_is_array(qp_next(unpacker, NULL)))
     {
@@ -1421,15 +1507,37 @@ static int INSERT_read_points(
 
     qp_add_type(packer, QP_ARRAY_OPEN);
 
-    if ((tp = qp_next(unpacker, NULL)) != QP_ARRAY2 && tp != QP_ARRAY_OPEN)
+    while (1)
     {
-        return ERR_EXPECTING_AT_LEAST_ONE_POINT;
-    }
+        /*
+         * Fast path: points with an integer or double value are validated
+         * and copied to the packer at once.
+         */
+        for (   pt = unpacker->pt;
+                qp_next_point(unpacker, &ts, qp_obj) == 0;
+                n++)
+        {
+            if (!siridb_int64_valid_ts(siridb->time, ts))
+            {
+                return ERR_TIMESTAMP_OUT_OF_RANGE;
+            }
+        }
+
+        if (unpacker->pt != pt)
+        {
+            qp_packer_extend_bytes(packer, pt, unpacker->pt - pt);
+        }
+
+        if ((tp = qp_next(unpacker, qp_obj)) != QP_ARRAY2 &&
+                tp != QP_ARRAY_OPEN)
+        {
+            if (!n)
+            {
+                return ERR_EXPECTING_AT_LEAST_ONE_POINT;
+            }
+            break;
+        }
 
-    for (;
-            tp == QP_ARRAY2 || tp == QP_ARRAY_OPEN;
-            (*count)++, tp = qp_next(unpacker, qp_obj))
-    {
         qp_add_type(packer, QP_ARRAY2);
 
         if (qp_next(unpacker, qp_obj) != QP_INT64)
@@ -1468,8 +1576,12 @@ static int INSERT_read_points(
 
         if (tp == QP_ARRAY_OPEN && qp_next(unpacker, NULL) != QP_ARRAY_CLOSE)
             break;
+
+        n++;
     }
 
+    *count += n;
+
     if (tp == QP_ARRAY_CLOSE)
     {
         tp = qp_next(unpacker, qp_obj);
@@ -8,19 +8,23 @@
 #include <qpack/qpack.h>
 #include <siri/async.h>
 #include <siri/db/aggregate.h>
+#include <siri/db/cursor.h>
 #include <siri/db/group.h>
 #include <siri/db/groups.h>
+#include <siri/db/mselect.h>
 #include <siri/db/nodes.h>
 #include <siri/db/presuf.h>
 #include <siri/db/props.h>
 #include <siri/db/props.h>
 #include <siri/db/query.h>
 #include <siri/db/re.h>
+#include <siri/db/scan.h>
 #include <siri/db/series.h>
 #include <siri/db/server.h>
 #include <siri/db/servers.h>
 #include <siri/db/shard.h>
 #include <siri/db/shards.h>
+#include <siri/db/subscriptions.h>
 #include <siri/db/tags.h>
 #include <siri/db/user.h>
 #include <siri/db/users.h>
@@ -30,6 +34,7 @@
 #include <siri/err.h>
 #include <siri/grammar/gramp.h>
 #include <siri/help/help.h>
+#include <siri/mem.h>
 #include <siri/net/promises.h>
 #include <siri/net/protocol.h>
 #include <siri/net/clserver.h>
@@ -234,6 +239,7 @@ static void enter_series_re(uv_async_t * handle);
 static void enter_series_setopr(uv_async_t * handle);
 static void enter_tag_series(uv_async_t * handle);
 static void enter_timeit_stmt(uv_async_t * handle);
+static void enter_top_expr(uv_async_t * handle);
 static void enter_untag_series(uv_async_t * handle);
 static void enter_where_xxx(uv_async_t * handle);
 static void enter_xxx_columns(uv_async_t * handle);
@@ -304,6 +310,7 @@ static void async_list_series(uv_async_t * handle);
 static void async_no_points_aggregate(uv_async_t * handle);
 static void async_select_aggregate(uv_async_t * handle);
 static void async_series_re(uv_async_t * handle);
+static void async_top_series(uv_async_t * handle);
 
 /* on response functions */
 static void on_ack_response(
@@ -318,22 +325,14 @@ static void on_groups_response(vec_t * promises, uv_async_t * handle);
 static void on_tags_response(vec_t * promises, uv_async_t * handle);
 static void on_list_xxx_response(vec_t * promises, uv_async_t * handle);
 static void on_select_response(vec_t * promises, uv_async_t * handle);
+static int on_select_each(
+        sirinet_promise_t * promise,
+        sirinet_pkg_t * pkg,
+        uv_async_t * handle);
 static void on_update_xxx_response(vec_t * promises, uv_async_t * handle);
 static void on_tag_response(vec_t * promises, uv_async_t * handle);
 
 /* helper functions */
-static void master_select_work(uv_work_t * handle);
-static void master_select_work_finish(uv_work_t * work, int status);
-static int items_select_master(
-        const char * name,
-        size_t len,
-        siridb_points_t * points,
-        uv_async_t * handle);
-static int items_select_master_merge(
-        const char * name,
-        size_t len,
-        vec_t * plist,
-        uv_async_t * handle);
 static int items_select_other(
         const char * name,
         size_t len,
@@ -344,6 +343,12 @@ static int items_select_other_merge(
         size_t len,
         vec_t * plist,
         uv_async_t * handle);
+static int LISTENER_cursor_start(
+        query_select_t * q_select,
+        siridb_series_t * series,
+        uint64_t * start);
+static void LISTENER_points_crop(siridb_points_t * points, uint64_t start);
+static int LISTENER_top_series(query_select_t * q_select, siridb_t * siridb);
 static void on_select_unpack_points(
         qp_unpacker_t * unpacker,
         query_select_t * q_select,
@@ -484,6 +489,7 @@ void siridb_init_listener(void)
     SIRIDB_NODE_ENTER[CLERI_GID_TAG_COLUMNS] = enter_xxx_columns;
     SIRIDB_NODE_ENTER[CLERI_GID_TAG_SERIES] = enter_tag_series;
     SIRIDB_NODE_ENTER[CLERI_GID_TIMEIT_STMT] = enter_timeit_stmt;
+    SIRIDB_NODE_ENTER[CLERI_GID_TOP_EXPR] = enter_top_expr;
     SIRIDB_NODE_ENTER[CLERI_GID_UNTAG_SERIES] = enter_untag_series;
     SIRIDB_NODE_ENTER[CLERI_GID_USER_COLUMNS] = enter_xxx_columns;
     SIRIDB_NODE_ENTER[CLERI_GID_WHERE_GROUP] = enter_where_xxx;
@@ -876,6 +882,22 @@ static void enter_grant_user(uv_async_t * handle)
         SIRIPARSER_NEXT_NODE
     }
 }
+
+/*
+ * Returns the set operation which leaves the source map intact for a given
+ * query update call-back. (NULL means this is the first series source)
+ */
+static imap_update_cb LISTENER_src_cb(imap_update_cb update_cb)
+{
+    return (update_cb == &imap_intersection_ref)
+            ? &imap_intersection_src
+            : (update_cb == &imap_difference_ref)
+            ? &imap_difference_src
+            : (update_cb == &imap_symmetric_difference_ref)
+            ? &imap_symmetric_difference_src
+            : &imap_union_src;
+}
+
 static void enter_group_tag_match(uv_async_t * handle)
 {
     siridb_query_t * query = handle->data;
@@ -909,70 +931,31 @@ static void enter_group_tag_match(uv_async_t * handle)
     }
     else
     {
-        siridb_series_t * series;
-        size_t i;
-
-        q_wrapper->series_tmp = (q_wrapper->update_cb == NULL) ?
-                q_wrapper->series_map : imap_new();
-
-        if (q_wrapper->series_tmp == NULL)
-        {
-            MEM_ERR_RET
-        }
+        uv_mutex_t * mutex = (group != NULL)
+                ? &siridb->groups->mutex
+                : &siridb->tags->mutex;
+        imap_t * set;
 
-        if (group)
-        {
-            uv_mutex_lock(&siridb->groups->mutex);
+        uv_mutex_lock(mutex);
 
-            for (i = 0; i < group->series->len; i++)
-            {
-                series = (siridb_series_t *) group->series->data[i];
-                siridb_series_incref(series);
-                if (imap_add(q_wrapper->series_tmp, series->id, series))
-                {
-                    log_critical("Cannot add series to temporary map.");
-                    siridb_series_decref(series);
-                }
-            }
+        /*
+         * Both groups and tags keep their series in a map which is combined
+         * with the query series map without making a temporary copy.
+         */
+        set = (group != NULL) ? siridb_group_series_set(group) : tag->series;
 
-            uv_mutex_unlock(&siridb->groups->mutex);
-        }
-        else if (tag)  /* check to prevent compile warning */
+        if (set == NULL)
         {
-            vec_t * tag_series;
-
-            assert (tag != NULL);
-
-            uv_mutex_lock(&siridb->tags->mutex);
-
-            tag_series = imap_vec(tag->series);
-
-            if (tag_series != NULL)
-            {
-                for (i = 0; i < tag_series->len; i++)
-                {
-                    series = (siridb_series_t *) tag_series->data[i];
-                    siridb_series_incref(series);
-                    if (imap_add(q_wrapper->series_tmp, series->id, series))
-                    {
-                        log_critical("Cannot add series to temporary map.");
-                        siridb_series_decref(series);
-                    }
-                }
-            }
-
-            uv_mutex_unlock(&siridb->tags->mutex);
+            uv_mutex_unlock(mutex);
+            MEM_ERR_RET
         }
 
-        if (q_wrapper->update_cb != NULL)
-        {
-            (*q_wrapper->update_cb)(
-                    q_wrapper->series_map,
-                    q_wrapper->series_tmp,
-                    (imap_free_cb) &siridb__series_decref);
-        }
+        (*LISTENER_src_cb(q_wrapper->update_cb))(
+                q_wrapper->series_map,
+                set,
+                (imap_free_cb) &siridb__series_decref);
 
-        q_wrapper->series_tmp = NULL;
+        uv_mutex_unlock(mutex);
 
         SIRIPARSER_ASYNC_NEXT_NODE
     }
@@ -1069,6 +1052,12 @@ static void enter_merge_as(uv_async_t * handle)
 
     xstr_extract_string(q_select->merge_as, node->str, node->len);
 
+    /* the last group of a merge aggregation is unknown to the pools */
+    if (query->nodes->node->children->next->next->next != NULL)
+    {
+        q_select->flags |= QUERIES_IGNORE_CURSOR;
+    }
+
     if (IS_MASTER && query->nodes->node->children->next->next->next != NULL)
     {
         q_select->mlist = siridb_aggregate_list(
@@ -1176,6 +1165,22 @@ static void enter_select_stmt(uv_async_t * handle)
     }
 
     query->free_cb = (uv_close_cb) query_select_free;
+
+    /* share decoded chunks with other running select queries */
+    q_select->share_gen = siridb_share_enter(siridb->share);
+
+    if (query->cursor != NULL)
+    {
+        q_select->cursor = siridb_cursor_load(query->cursor, query->cursor_len);
+
+        if (q_select->cursor == NULL)
+        {
+            sprintf(query->err_msg, "Invalid cursor.");
+            siridb_query_send_error(handle, CPROTO_ERR_QUERY);
+            return;
+        }
+    }
+
     query->packer = sirinet_packer_new(QP_SUGGESTED_SIZE);
 
     if (query->packer == NULL)
@@ -1575,6 +1580,51 @@ static void enter_series_re(uv_async_t * handle)
         q_wrapper->pmap = NULL;
     }
 
+    /* the series might be resolved before by another query in the batch */
+    if (query->batch != NULL && (
+            q_wrapper->update_cb == NULL ||
+            q_wrapper->update_cb == &imap_union_ref ||
+            q_wrapper->update_cb == &imap_symmetric_difference_ref))
+    {
+        imap_t * series_tmp = (q_wrapper->update_cb == NULL) ?
+                q_wrapper->series_map : imap_new();
+        int rc;
+
+        if (series_tmp == NULL)
+        {
+            MEM_ERR_RET
+        }
+
+        rc = siridb_batch_series_re_get(
+                query->batch,
+                node->str,
+                node->len,
+                series_tmp);
+
+        if (rc == 1 && q_wrapper->update_cb != NULL)
+        {
+            (*q_wrapper->update_cb)(
+                    q_wrapper->series_map,
+                    series_tmp,
+                    (imap_free_cb) &siridb__series_decref);
+        }
+        else if (series_tmp != q_wrapper->series_map)
+        {
+            imap_free(series_tmp, (imap_free_cb) &siridb__series_decref);
+        }
+
+        if (rc == -1)
+        {
+            MEM_ERR_RET
+        }
+
+        if (rc == 1)
+        {
+            SIRIPARSER_NEXT_NODE
+            return;
+        }
+    }
+
     /* extract and compile regular expression */
     if (siridb_re_compile(
             &q_wrapper->regex,
@@ -1670,6 +1720,15 @@ static int LISTENER_tag__cb(siridb_series_t * series, LISTENER_tag_t * w)
     {
         siridb_series_decref(series);
     }
+    else
+    {
+        (void) siridb_tags_journal(w->tag, TAGS_JOURNAL_ADD, series->id);
+        siridb_subscriptions_tag(
+                series->siridb->subscriptions,
+                w->tag,
+                series);
+        siridb_tee_forget(series->siridb->tee, series->siridb, series);
+    }
     return rc;
 }
 
@@ -1682,6 +1741,12 @@ static int LISTENER_untag__cb(siridb_series_t * series, LISTENER_tag_t * w)
 
     if (rc == 1 && imap_pop(w->tag->series, series->id) == series)
     {
+        (void) siridb_tags_journal(w->tag, TAGS_JOURNAL_DEL, series->id);
+        siridb_subscriptions_untag(
+                series->siridb->subscriptions,
+                w->tag,
+                series);
+        siridb_tee_forget(series->siridb->tee, series->siridb, series);
         siridb_series_decref(series);
     }
 
@@ -1739,6 +1804,9 @@ static void enter_tag_series(uv_async_t * handle)
             siridb_query_send_error(handle, CPROTO_ERR_QUERY);
             return;
         }
+
+        /* a new tag requires a tag file */
+        siridb_tags_set_require_save(siridb->tags, tag);
     }
     else
     {
@@ -1749,6 +1817,11 @@ static void enter_tag_series(uv_async_t * handle)
     {
         q_alter->n = q_alter->series_map->len;
 
+        (void) siridb_tags_journal_map(
+                tag,
+                TAGS_JOURNAL_ADD,
+                q_alter->series_map);
+
         imap_union_ref(
                 tag->series,
                 q_alter->series_map,
@@ -1767,7 +1840,7 @@ static void enter_tag_series(uv_async_t * handle)
         imap_free(q_alter->series_map, NULL);
     }
 
-    siridb_tags_set_require_save(siridb->tags, tag);
+    (void) siridb_tags_journal_flush(siridb->tags);
 
     uv_mutex_unlock(&siridb->tags->mutex);
 
@@ -1807,6 +1880,41 @@ static void enter_timeit_stmt(uv_async_t * handle)
     SIRIPARSER_NEXT_NODE
 }
 
+static void enter_top_expr(uv_async_t * handle)
+{
+    siridb_query_t * query = handle->data;
+    siridb_t * siridb = query->client->siridb;
+    query_select_t * q_select = query->data;
+    cleri_children_t * children = query->nodes->node->children;
+    int64_t k = CLERI_NODE_DATA(children->next->next->node);
+
+    if (k <= 0 || k > siridb->list_limit)
+    {
+        snprintf(query->err_msg, SIRIDB_MAX_SIZE_ERR_MSG,
+                "Top and bottom require a value between 1 and %" PRIu32
+                " but received: %" PRId64
+                " (optionally the limit can be changed, "
+                "see 'help alter database')",
+                siridb->list_limit,
+                k);
+        siridb_query_send_error(handle, CPROTO_ERR_QUERY);
+        return;
+    }
+
+    q_select->topk = siridb_topk_new(
+            children->next->next->next->next->node->children->node->
+                cl_obj->gid,
+            (size_t) k,
+            children->node->children->node->cl_obj->gid == CLERI_GID_K_BOTTOM);
+
+    if (q_select->topk == NULL)
+    {
+        MEM_ERR_RET
+    }
+
+    SIRIPARSER_NEXT_NODE
+}
+
 static void enter_untag_series(uv_async_t * handle)
 {
     siridb_query_t * query = (siridb_query_t *) handle->data;
@@ -1843,6 +1951,11 @@ static void enter_untag_series(uv_async_t * handle)
     {
         q_alter->n = q_alter->series_map->len;
 
+        (void) siridb_tags_journal_map(
+                tag,
+                TAGS_JOURNAL_DEL,
+                q_alter->series_map);
+
         imap_difference_ref(
                 tag->series,
                 q_alter->series_map,
@@ -1861,8 +1974,7 @@ static void enter_untag_series(uv_async_t * handle)
         imap_free(q_alter->series_map, NULL);
     }
 
-
-    siridb_tags_set_require_save(siridb->tags, tag);
+    (void) siridb_tags_journal_flush(siridb->tags);
 
     uv_mutex_unlock(&siridb->tags->mutex);
 
@@ -2137,6 +2249,7 @@ static void exit_count_groups(uv_async_t * handle)
                     pkg,
                     0,
                     (sirinet_promises_cb) on_groups_response,
+                    NULL,
                     handle,
                     0);
         }
@@ -2245,7 +2358,11 @@ static void exit_count_series(uv_async_t * handle)
                 siri.loop,
                 next,
                 (uv_async_cb) async_count_series);
-        uv_async_send(next);
+
+        if (siridb_scan_start(next, SIRIDB_SCAN_COUNT, &q_count->n, 0))
+        {
+            uv_async_send(next);
+        }
 
         uv_close((uv_handle_t *) handle, (uv_close_cb) free);
     }
@@ -2263,29 +2380,31 @@ static void exit_count_series_length(uv_async_t * handle)
 
     if (q_count->where_expr == NULL)
     {
-        size_t i;
-        vec_t * vec;
-        siridb_series_t * series;
-
-        uv_mutex_lock(&siridb->series_mutex);
-
-        vec = imap_2vec((q_count->series_map == NULL) ?
-                siridb->series_map : q_count->series_map);
-
-        uv_mutex_unlock(&siridb->series_mutex);
-
-        if (vec == NULL)
+        if (q_count->series_map == NULL)
         {
-            MEM_ERR_RET
+            /* all series, use the maintained total */
+            q_count->n = __atomic_load_n(
+                    &siridb->points_total,
+                    __ATOMIC_RELAXED);
         }
-
-        for (i = 0; i < vec->len; i++)
+        else
         {
-            series = (siridb_series_t *) vec->data[i];
-            q_count->n += series->length;
-        }
+            size_t i;
+            vec_t * vec;
+            siridb_series_t * series;
+
+            vec = imap_vec(q_count->series_map);
+            if (vec == NULL)
+            {
+                MEM_ERR_RET
+            }
 
-        vec_free(vec);
+            for (i = 0; i < vec->len; i++)
+            {
+                series = (siridb_series_t *) vec->data[i];
+                q_count->n += series->length;
+            }
+        }
 
         if (IS_MASTER)
         {
@@ -2332,7 +2451,11 @@ static void exit_count_series_length(uv_async_t * handle)
                 siri.loop,
                 next,
                 (uv_async_cb) async_count_series_length);
-        uv_async_send(next);
+
+        if (siridb_scan_start(next, SIRIDB_SCAN_LENGTH, &q_count->n, 0))
+        {
+            uv_async_send(next);
+        }
 
         uv_close((uv_handle_t *) handle, (uv_close_cb) free);
     }
@@ -2537,48 +2660,63 @@ static void exit_count_shards_size(uv_async_t * handle)
     siridb_query_t * query = handle->data;
     siridb_t * siridb = query->client->siridb;
     query_count_t * q_count = (query_count_t *) query->data;
-    uint64_t duration;
-    size_t i;
-    vec_t * shards_list;
-    siridb_shard_view_t vshard = {
-            .server=siridb->server
-    };
 
     qp_add_raw(query->packer, (const unsigned char *) "shards_size", 11);
 
-    uv_mutex_lock(&siridb->shards_mutex);
-
-    shards_list = siridb_shards_vec(siridb);
-
-    uv_mutex_unlock(&siridb->shards_mutex);
-
-    if (shards_list == NULL)
+    if (q_count->where_expr == NULL)
     {
-        MEM_ERR_RET
+        /* no filter, use the maintained totals */
+        q_count->n =
+            __atomic_load_n(
+                &siridb->shards_size[SIRIDB_SHARD_TP_NUMBER],
+                __ATOMIC_RELAXED) +
+            __atomic_load_n(
+                &siridb->shards_size[SIRIDB_SHARD_TP_LOG],
+                __ATOMIC_RELAXED);
     }
-
-    for (i = 0; i < shards_list->len; i++)
+    else
     {
-        vshard.shard = (siridb_shard_t *) shards_list->data[i];
+        uint64_t duration;
+        size_t i;
+        vec_t * shards_list;
+        siridb_shard_view_t vshard = {
+                .server=siridb->server
+        };
 
-        /* set start and end properties */
-        duration = vshard.shard->duration;
+        uv_mutex_lock(&siridb->shards_mutex);
 
-        vshard.start = vshard.shard->id - vshard.shard->id % duration;
-        vshard.end = vshard.start + duration;
+        shards_list = siridb_shards_vec(siridb);
 
-        if (q_count->where_expr == NULL || cexpr_run(
-                q_count->where_expr,
-                (cexpr_cb_t) siridb_shard_cexpr_cb,
-                &vshard))
+        uv_mutex_unlock(&siridb->shards_mutex);
+
+        if (shards_list == NULL)
         {
-            q_count->n += vshard.shard->len;
+            MEM_ERR_RET
         }
 
-        siridb_shard_decref(vshard.shard);
-    }
+        for (i = 0; i < shards_list->len; i++)
+        {
+            vshard.shard = (siridb_shard_t *) shards_list->data[i];
 
-    vec_free(shards_list);
+            /* set start and end properties */
+            duration = vshard.shard->duration;
+
+            vshard.start = vshard.shard->id - vshard.shard->id % duration;
+            vshard.end = vshard.start + duration;
+
+            if (cexpr_run(
+                    q_count->where_expr,
+                    (cexpr_cb_t) siridb_shard_cexpr_cb,
+                    &vshard))
+            {
+                q_count->n += vshard.shard->len;
+            }
+
+            siridb_shard_decref(vshard.shard);
+        }
+
+        vec_free(shards_list);
+    }
 
     if (IS_MASTER)
     {
@@ -2622,6 +2760,7 @@ static void exit_count_tags(uv_async_t * handle)
                     pkg,
                     0,
                     (sirinet_promises_cb) on_tags_response,
+                    NULL,
                     handle,
                     0);
         }
@@ -2878,7 +3017,11 @@ static void exit_drop_series(uv_async_t * handle)
                 siri.loop,
                 next,
                 (uv_async_cb) async_filter_series);
-        uv_async_send(next);
+
+        if (siridb_scan_start(next, SIRIDB_SCAN_MATCH, NULL, SIZE_MAX))
+        {
+            uv_async_send(next);
+        }
 
         uv_close((uv_handle_t *) handle, (uv_close_cb) free);
 
@@ -3121,6 +3264,9 @@ static void exit_drop_tag(uv_async_t * handle)
     }
     else
     {
+        siridb_subscriptions_drop_tag(siridb, name);
+        siridb_tee_drop_tag(siridb->tee, siridb, name);
+
         QP_ADD_SUCCESS
         log_info(MSG_SUCCESS_DROP_TAG, name);
         qp_add_fmt_safe(query->packer, MSG_SUCCESS_DROP_TAG, name);
@@ -3310,6 +3456,7 @@ static void exit_list_groups(uv_async_t * handle)
                     pkg,
                     0,
                     (sirinet_promises_cb) on_groups_response,
+                    NULL,
                     handle,
                     0);
         }
@@ -3446,7 +3593,15 @@ static void exit_list_series(uv_async_t * handle)
             siri.loop,
             next,
             (uv_async_cb) async_list_series);
-    uv_async_send(next);
+
+    if (q_list->where_expr == NULL || siridb_scan_start(
+            next,
+            SIRIDB_SCAN_MATCH,
+            NULL,
+            q_list->limit))
+    {
+        uv_async_send(next);
+    }
 
     uv_close((uv_handle_t *) handle, (uv_close_cb) free);
 }
@@ -3722,6 +3877,7 @@ static void exit_list_tags(uv_async_t * handle)
                     pkg,
                     0,
                     (sirinet_promises_cb) on_tags_response,
+                    NULL,
                     handle,
                     0);
         }
@@ -3926,11 +4082,41 @@ static void exit_select_aggregate(uv_async_t * handle)
                 siri.loop,
                 next,
                 (uv_async_cb) async_filter_series);
-        uv_async_send(next);
+
+        if (siridb_scan_start(next, SIRIDB_SCAN_MATCH, NULL, SIZE_MAX))
+        {
+            uv_async_send(next);
+        }
 
         uv_close((uv_handle_t *) handle, (uv_close_cb) free);
 
     }
+    else if (   q_select->topk != NULL &&
+                !q_select->topk->is_ranked &&
+                q_select->series_map->len)
+    {
+        /* rank the series first so only the candidates are selected */
+        q_select->vec = imap_2vec_ref(q_select->series_map);
+
+        if (q_select->vec == NULL)
+        {
+            MEM_ERR_RET
+        }
+
+        uv_async_t * next = malloc(sizeof(uv_async_t));
+
+        if (next == NULL)
+        {
+            MEM_ERR_RET
+        }
+
+        next->data = handle->data;
+
+        uv_async_init(siri.loop, next, (uv_async_cb) async_top_series);
+        uv_async_send(next);
+
+        uv_close((uv_handle_t *) handle, (uv_close_cb) free);
+    }
     else if (siridb_presuf_add(&q_select->presuf, query->nodes->node) == NULL)
     {
         MEM_ERR_RET
@@ -4025,26 +4211,20 @@ static void exit_select_stmt(uv_async_t * handle)
         if (q_select->pmap == NULL || q_select->pmap->len)
         {
             /* we have not reached the limit, send the query to other pools */
-            siridb_query_forward(
+            siridb_query_forward_each(
                     handle,
                     (q_select->pmap == NULL) ?
                             SIRIDB_QUERY_FWD_POOLS :
                             SIRIDB_QUERY_FWD_SOME_POOLS,
                     (sirinet_promises_cb) on_select_response,
+                    (sirinet_promises_each_cb) on_select_each,
                     0);
         }
         else
         {
-            uv_work_t * work = malloc(sizeof(uv_work_t));
-            if (work == NULL)
-            {
-                MEM_ERR_RET
-            }
-
             uv_async_t * next = malloc(sizeof(uv_async_t));
             if (next == NULL)
             {
-                free(work);
                 MEM_ERR_RET
             }
 
@@ -4061,13 +4241,13 @@ static void exit_select_stmt(uv_async_t * handle)
                             (uv_async_cb) siridb_send_query_result :
                             (uv_async_cb) query->nodes->cb);
 
-            siri_async_incref(handle);
-            work->data = handle;
-            uv_queue_work(
-                        siri.loop,
-                        work,
-                        &master_select_work,
-                        &master_select_work_finish);
+            if ((q_select->topk != NULL && siridb_topk_crop(
+                    q_select->topk,
+                    &q_select->result,
+                    q_select->presuf)) || siridb_mselect_start(handle))
+            {
+                MEM_ERR_RET
+            }
         }
     }
     else
@@ -4081,7 +4261,10 @@ static void exit_select_stmt(uv_async_t * handle)
                             :
                             (ct_item_cb) &items_select_other_merge,
                     handle) ||
-            qp_add_type(query->packer, QP_MAP_CLOSE))
+            qp_add_type(query->packer, QP_MAP_CLOSE) ||
+            (q_select->topk != NULL && siridb_topk_pack(
+                    q_select->topk,
+                    query->packer)))
         {
             MEM_ERR_RET
         }
@@ -4742,8 +4925,11 @@ static void exit_set_tee_pipe_name(uv_async_t * handle)
 
     assert (query->data != NULL);
 
-    cleri_node_t * node =
-            query->nodes->node->children->next->next->node->children->node;
+    cleri_children_t * children = query->nodes->node->children->next->next;
+    cleri_node_t * node = children->node->children->node;
+    cleri_node_t * filter_node = NULL;
+    siridb_tee_filter_t filter_tp = SIRIDB_TEE_FILTER_NONE;
+    siridb_tee_format_t format = SIRIDB_TEE_FORMAT_INSERT;
 
     char pipe_name[node->len - 1];
     char * p_pipe_name = NULL;
@@ -4754,6 +4940,73 @@ static void exit_set_tee_pipe_name(uv_async_t * handle)
         p_pipe_name = pipe_name;
     }
 
+    /* optional filter and format, both are ignored when the tee is disabled */
+    for (children = children->next; children; children = children->next)
+    {
+        cleri_node_t * opt_node = children->node->children->node;
+        cleri_node_t * choice_node =
+                opt_node->children->next->node->children->node;
+
+        if (opt_node->cl_obj->gid == CLERI_GID_TEE_FORMAT)
+        {
+            format = (choice_node->cl_obj->gid == CLERI_GID_K_COLUMNAR)
+                    ? SIRIDB_TEE_FORMAT_COLUMNAR
+                    : SIRIDB_TEE_FORMAT_INSERT;
+        }
+        else if (choice_node->cl_obj->gid == CLERI_GID_R_REGEX)
+        {
+            filter_tp = SIRIDB_TEE_FILTER_REGEX;
+            filter_node = choice_node;
+        }
+        else
+        {
+            filter_tp = (choice_node->children->node->cl_obj->gid ==
+                    CLERI_GID_K_TAG)
+                    ? SIRIDB_TEE_FILTER_TAG
+                    : SIRIDB_TEE_FILTER_GROUP;
+            filter_node = choice_node->children->next->node;
+        }
+    }
+
+    if (p_pipe_name == NULL)
+    {
+        filter_tp = SIRIDB_TEE_FILTER_NONE;
+        format = SIRIDB_TEE_FORMAT_INSERT;
+        filter_node = NULL;
+    }
+
+    char filter[filter_node == NULL ? 1 : filter_node->len + 1];
+    char * p_filter = NULL;
+
+    if (filter_tp == SIRIDB_TEE_FILTER_REGEX)
+    {
+        pcre2_code * regex;
+        pcre2_match_data * match_data;
+
+        memcpy(filter, filter_node->str, filter_node->len);
+        filter[filter_node->len] = '\0';
+        p_filter = filter;
+
+        /* check the regular expression before anything is changed */
+        if (siridb_re_compile(
+                &regex,
+                &match_data,
+                filter,
+                filter_node->len,
+                query->err_msg))
+        {
+            siridb_query_send_error(handle, CPROTO_ERR_QUERY);
+            return;
+        }
+        pcre2_match_data_free(match_data);
+        pcre2_code_free(regex);
+    }
+    else if (filter_node != NULL)
+    {
+        xstr_extract_string(filter, filter_node->str, filter_node->len);
+        p_filter = filter;
+    }
+
     if (q_alter->alter_tp == QUERY_ALTER_SERVERS)
     {
         /*
@@ -4771,6 +5024,13 @@ static void exit_set_tee_pipe_name(uv_async_t * handle)
                 &wserver))
         {
             (void) siridb_tee_set_pipe_name(siridb->tee, p_pipe_name);
+            (void) siridb_tee_set_filter(
+                    siridb->tee,
+                    siridb,
+                    filter_tp,
+                    p_filter,
+                    format,
+                    query->err_msg);
             if (siridb_save(siridb))
             {
                 log_critical("Could not save database changes (database: '%s')",
@@ -4818,6 +5078,13 @@ static void exit_set_tee_pipe_name(uv_async_t * handle)
         if (server == siridb->server)
         {
             (void) siridb_tee_set_pipe_name(siridb->tee, p_pipe_name);
+            (void) siridb_tee_set_filter(
+                    siridb->tee,
+                    siridb,
+                    filter_tp,
+                    p_filter,
+                    format,
+                    query->err_msg);
             if (siridb_save(siridb))
             {
                 log_critical("Could not save database changes (database: '%s')",
@@ -4831,11 +5098,20 @@ static void exit_set_tee_pipe_name(uv_async_t * handle)
 
             if (siridb_server_is_online(server))
             {
-                sirinet_pkg_t * pkg = sirinet_pkg_new(
+                /* servers without filter support only know the pipe name */
+                sirinet_pkg_t * pkg = (
+                        filter_tp == SIRIDB_TEE_FILTER_NONE &&
+                        format == SIRIDB_TEE_FORMAT_INSERT)
+                    ? sirinet_pkg_new(
                         0,
                         p_pipe_name ? strlen(p_pipe_name) : 0,
                         BPROTO_TEE_PIPE_NAME_UPDATE,
-                        (unsigned char *) p_pipe_name);
+                        (unsigned char *) p_pipe_name)
+                    : siridb_tee_update_pkg(
+                        p_pipe_name,
+                        filter_tp,
+                        p_filter,
+                        format);
                 if (pkg != NULL)
                 {
                     /* handle will be bound to a timer so we should increment */
@@ -5292,7 +5568,8 @@ static void async_filter_series(uv_async_t * handle)
         series = (siridb_series_t *)
                 q_wrapper->vec->data[q_wrapper->vec_index];
 
-        if (cexpr_run(
+        /* where_expr is NULL when the series are filtered by a scan */
+        if (where_expr == NULL || cexpr_run(
                 where_expr,
                 (cexpr_cb_t) siridb_series_cexpr_cb,
                 series))
@@ -5322,8 +5599,11 @@ static void async_filter_series(uv_async_t * handle)
         q_wrapper->vec_index = 0;
 
         /* cleanup where statement since we do not need it anymore */
-        cexpr_free(q_wrapper->where_expr);
-        q_wrapper->where_expr = NULL;
+        if (q_wrapper->where_expr != NULL)
+        {
+            cexpr_free(q_wrapper->where_expr);
+            q_wrapper->where_expr = NULL;
+        }
 
         /* we now processed the where statement, continue... */
         switch (q_wrapper->tp)
@@ -5520,6 +5800,9 @@ static void async_no_points_aggregate(uv_async_t * handle)
         }
 
         q_select->n += points->len;
+        siri_mem_add(
+                SIRI_MEM_QUERIES,
+                points->len * sizeof(siridb_point_t));
 
         if (q_select->merge_as == NULL)
         {
@@ -5587,6 +5870,8 @@ static void async_select_aggregate(uv_async_t * handle)
     siridb_series_t * series;
     siridb_points_t * points;
     siridb_points_t * aggr_points;
+    uint64_t * start_ts, * read_ts;
+    uint64_t cursor_ts;
 
     if (q_select->n > siridb->select_points_limit)
     {
@@ -5617,6 +5902,20 @@ static void async_select_aggregate(uv_async_t * handle)
         async_more = 1;
     }
 
+    /* with a cursor only points newer than the cursor are required */
+    start_ts = q_select->start_ts;
+    if (    q_select->cursor != NULL &&
+            (~q_select->flags & QUERIES_IGNORE_CURSOR) &&
+            LISTENER_cursor_start(q_select, series, &cursor_ts) &&
+            (start_ts == NULL || *start_ts < cursor_ts))
+    {
+        start_ts = &cursor_ts;
+    }
+
+    /* points which are shared with others are read for the full range */
+    read_ts = (q_select->points_map == NULL && query->batch == NULL) ?
+            start_ts : q_select->start_ts;
+
     /* We try to read the points from the cache in case a cache is created.
      * If there are more select functions left we create a copy of the cache.
      * When this is the last select function we pop from the cache since the
@@ -5628,6 +5927,16 @@ static void async_select_aggregate(uv_async_t * handle)
                 siridb_points_copy(imap_get(q_select->points_map, series->id)):
                 imap_pop(q_select->points_map, series->id);
 
+    /* points might be read before by another query in the batch */
+    if (points == NULL && query->batch != NULL)
+    {
+        points = siridb_batch_get_points(
+                query->batch,
+                series,
+                q_select->start_ts,
+                q_select->end_ts);
+    }
+
     if (points == NULL)
     {
         uv_mutex_lock(&siridb->series_mutex);
@@ -5635,10 +5944,20 @@ static void async_select_aggregate(uv_async_t * handle)
         points = (series->flags & SIRIDB_SERIES_IS_DROPPED) ?
                 NULL : siridb_series_get_points(
                         series,
-                        q_select->start_ts,
+                        read_ts,
                         q_select->end_ts);
         uv_mutex_unlock(&siridb->series_mutex);
 
+        if (points != NULL && query->batch != NULL)
+        {
+            siridb_batch_add_points(
+                    query->batch,
+                    series,
+                    q_select->start_ts,
+                    q_select->end_ts,
+                    points);
+        }
+
         /* when having a cache and points, add a copy of points to the cache */
         if (q_select->points_map != NULL && points != NULL)
         {
@@ -5651,6 +5970,11 @@ static void async_select_aggregate(uv_async_t * handle)
         }
     }
 
+    if (points != NULL && read_ts != start_ts)
+    {
+        LISTENER_points_crop(points, *start_ts);
+    }
+
     if (points != NULL)
     {
         const char * name;
@@ -5678,6 +6002,9 @@ static void async_select_aggregate(uv_async_t * handle)
         }
 
         q_select->n += points->len;
+        siri_mem_add(
+                SIRI_MEM_QUERIES,
+                points->len * sizeof(siridb_point_t));
 
         if (q_select->merge_as == NULL)
         {
@@ -5793,6 +6120,19 @@ static void async_series_re(uv_async_t * handle)
         q_wrapper->vec = NULL;
         q_wrapper->vec_index = 0;
 
+        /* share the series with other queries in the batch */
+        if (query->batch != NULL && (
+                q_wrapper->update_cb == NULL ||
+                q_wrapper->update_cb == &imap_union_ref ||
+                q_wrapper->update_cb == &imap_symmetric_difference_ref))
+        {
+            siridb_batch_series_re_set(
+                    query->batch,
+                    query->nodes->node->str,
+                    query->nodes->node->len,
+                    q_wrapper->series_tmp);
+        }
+
         if (q_wrapper->update_cb != NULL)
         {
             (*q_wrapper->update_cb)(
@@ -5806,6 +6146,74 @@ static void async_series_re(uv_async_t * handle)
     }
 }
 
+static void async_top_series(uv_async_t * handle)
+{
+    siridb_query_t * query = handle->data;
+    query_select_t * q_select = query->data;
+    siridb_t * siridb = query->client->siridb;
+    siridb_series_t * series;
+    siridb_points_t * points;
+    double score;
+    int rc = 1;
+
+    series = (siridb_series_t *)
+            q_select->vec->data[q_select->vec_index];
+
+    /* the series will not be freed since 'series_map' has a reference */
+    siridb_series_decref(series);
+
+    uv_mutex_lock(&siridb->series_mutex);
+
+    points = (series->flags & SIRIDB_SERIES_IS_DROPPED) ?
+            NULL : siridb_series_get_points(
+                    series,
+                    q_select->start_ts,
+                    q_select->end_ts);
+
+    uv_mutex_unlock(&siridb->series_mutex);
+
+    if (points != NULL)
+    {
+        rc = siridb_topk_score(
+                q_select->topk,
+                points,
+                &score,
+                query->err_msg);
+        siridb_points_free(points);
+    }
+
+    if (rc < 0)
+    {
+        q_select->vec_index++;
+        siridb_query_send_error(handle, CPROTO_ERR_QUERY);
+        return;
+    }
+
+    if (rc == 0 && siridb_topk_push(q_select->topk, series->name, score))
+    {
+        q_select->vec_index++;
+        MEM_ERR_RET
+    }
+
+    if ((++q_select->vec_index) < q_select->vec->len)
+    {
+        uv_async_send(handle);
+        return;
+    }
+
+    vec_free(q_select->vec);
+    q_select->vec = NULL;
+    q_select->vec_index = 0;
+
+    if (LISTENER_top_series(q_select, siridb))
+    {
+        MEM_ERR_RET
+    }
+
+    /* the series are ranked, continue... */
+    exit_select_aggregate(handle);
+}
+
 /******************************************************************************
  * On Response functions
  *****************************************************************************/
@@ -6350,10 +6758,6 @@ static void on_select_response(vec_t * promises, uv_async_t * handle)
     siridb_t * siridb = query->client->siridb;
     size_t err_count = 0;
     query_select_t * q_select = query->data;
-    qp_obj_t qp_name;
-    qp_obj_t qp_tp;
-    qp_obj_t qp_len;
-    qp_obj_t qp_points;
     qp_obj_t qp_err_msg;
     size_t i;
 
@@ -6409,44 +6813,10 @@ static void on_select_response(vec_t * promises, uv_async_t * handle)
                             promise->server->name);
                 }
             }
-            else
+            else if (pkg->len)
             {
-                qp_unpacker_init(&unpacker, pkg->data, pkg->len);
-
-                if (    qp_is_map(qp_next(&unpacker, NULL)) &&
-                        qp_is_raw(qp_next(&unpacker, NULL)) && /* select */
-                        qp_is_map(qp_next(&unpacker, NULL)))
-                {
-                    if (q_select->merge_as == NULL)
-                    {
-                        on_select_unpack_points(
-                                &unpacker,
-                                q_select,
-                                &qp_name,
-                                &qp_tp,
-                                &qp_len,
-                                &qp_points,
-                                siridb->select_points_limit);
-                    }
-                    else
-                    {
-                        on_select_unpack_merged_points(
-                                &unpacker,
-                                q_select,
-                                &qp_name,
-                                &qp_tp,
-                                &qp_len,
-                                &qp_points,
-                                siridb->select_points_limit);
-                    }
-
-
-                    /* extract time-it info if needed */
-                    if (query->timeit != NULL)
-                    {
-                        siridb_query_timeit_from_unpacker(query, &unpacker);
-                    }
-                }
+                /* not yet unpacked by on_select_each() */
+                on_select_each(promise, pkg, handle);
             }
 
             /* make sure we free the promise and data */
@@ -6472,17 +6842,9 @@ static void on_select_response(vec_t * promises, uv_async_t * handle)
     }
     else
     {
-        uv_async_t * next;
-        uv_work_t * work = malloc(sizeof(uv_work_t));
-        if (work == NULL)
-        {
-            MEM_ERR_RET
-        }
-
-        next = malloc(sizeof(uv_async_t));
+        uv_async_t * next = malloc(sizeof(uv_async_t));
         if (next == NULL)
         {
-            free(work);
             MEM_ERR_RET
         }
 
@@ -6499,15 +6861,91 @@ static void on_select_response(vec_t * promises, uv_async_t * handle)
                         (uv_async_cb) siridb_send_query_result :
                         (uv_async_cb) query->nodes->cb);
 
-        siri_async_incref(handle);
-        work->data = handle;
-        uv_queue_work(
-                    siri.loop,
-                    work,
-                    &master_select_work,
-                    &master_select_work_finish);
+        /* keep only the results for the best candidates of all pools */
+        if ((q_select->topk != NULL && siridb_topk_crop(
+                q_select->topk,
+                &q_select->result,
+                q_select->presuf)) || siridb_mselect_start(handle))
+        {
+            MEM_ERR_RET
+        }
+    }
+}
 
+/*
+ * Call-back function: sirinet_promises_each_cb
+ *
+ * Unpack a select response as soon as it arrives so the package can be
+ * released and a slow pool does not delay unpacking the other responses.
+ * Error responses are not handled and will be checked by
+ * on_select_response().
+ *
+ * Returns 1 (true) if the package is handled or 0 if not.
+ */
+static int on_select_each(
+        sirinet_promise_t * promise,
+        sirinet_pkg_t * pkg,
+        uv_async_t * handle)
+{
+    siridb_query_t * query = handle->data;
+    siridb_t * siridb = query->client->siridb;
+    query_select_t * q_select = query->data;
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_name;
+    qp_obj_t qp_tp;
+    qp_obj_t qp_len;
+    qp_obj_t qp_points;
+
+    if (pkg->tp != BPROTO_RES_QUERY)
+    {
+        return 0;
     }
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+
+    if (    qp_is_map(qp_next(&unpacker, NULL)) &&
+            qp_is_raw(qp_next(&unpacker, NULL)) && /* select */
+            qp_is_map(qp_next(&unpacker, NULL)))
+    {
+        if (q_select->merge_as == NULL)
+        {
+            on_select_unpack_points(
+                    &unpacker,
+                    q_select,
+                    &qp_name,
+                    &qp_tp,
+                    &qp_len,
+                    &qp_points,
+                    siridb->select_points_limit);
+        }
+        else
+        {
+            on_select_unpack_merged_points(
+                    &unpacker,
+                    q_select,
+                    &qp_name,
+                    &qp_tp,
+                    &qp_len,
+                    &qp_points,
+                    siridb->select_points_limit);
+        }
+
+        if (    q_select->topk != NULL &&
+                q_select->n <= siridb->select_points_limit &&
+                siridb_topk_unpack(q_select->topk, &unpacker))
+        {
+            log_error("Invalid top candidates received from '%s'",
+                    promise->server->name);
+        }
+
+        /* extract time-it info if needed */
+        if (query->timeit != NULL)
+        {
+            siridb_query_timeit_from_unpacker(query, &unpacker);
+        }
+    }
+
+    return 1;
 }
 
 /*
@@ -6635,175 +7073,6 @@ static void on_tag_response(vec_t * promises, uv_async_t * handle)
  *****************************************************************************/
 
 
-static void master_select_work(uv_work_t * work)
-{
-    uv_async_t * handle = (uv_async_t *) work->data;
-    siridb_query_t * query = handle->data;
-    query_select_t * q_select = query->data;
-    siridb_t * siridb = query->client->siridb;
-    siridb->selected_points += q_select->n;
-    int rc = ct_items(
-            q_select->result,
-            (q_select->merge_as == NULL) ?
-                    (ct_item_cb) &items_select_master
-                    :
-                    (ct_item_cb) &items_select_master_merge,
-            handle);
-
-    /* Do not set an error message when rc==1 since in that case the message
-     * is already set.
-     */
-    switch (rc)
-    {
-    case -1:
-        sprintf(query->err_msg, "Memory allocation error.");
-        /* FALLTHRU */
-        /* fall through */
-    case 1:
-        query->flags |= SIRIDB_QUERY_FLAG_ERR;
-    }
-}
-
-static void master_select_work_finish(uv_work_t * work, int status)
-{
-    if (status)
-    {
-        log_error("Select work failed (error: %s)", uv_strerror(status));
-    }
-    else if (!siri_err)
-    {
-        /*
-         * We need to check for SiriDB errors because this task is running in
-         * another thread. In case a siri_err is set, this means we are in forced
-         * closing state and we should not use the handle but let siri close it.
-         */
-
-        uv_async_t * handle = (uv_async_t *) work->data;
-        siridb_query_t * query = handle->data;
-
-        if (query->flags & SIRIDB_QUERY_FLAG_ERR)
-        {
-            siridb_query_send_error(handle, CPROTO_ERR_QUERY);
-        }
-        else
-        {
-            uv_async_send(handle);
-        }
-    }
-
-    siri_async_decref((uv_async_t **) &work->data);
-
-    free(work);
-}
-
-static int items_select_master(
-        const char * name,
-        size_t len,
-        siridb_points_t * points,
-        uv_async_t * handle)
-{
-    siridb_query_t * query = handle->data;
-
-    if (query->factor)
-    {
-        siridb_points_ts_correction(points, (double) query->factor);
-    }
-
-    if (    qp_add_raw(query->packer, (const unsigned char *) name, len) ||
-            siridb_points_pack(points, query->packer))
-    {
-        sprintf(query->err_msg, "Memory allocation error.");
-        return -1;
-    }
-
-    return 0;
-}
-
-static int items_select_master_merge(
-        const char * name,
-        size_t len,
-        vec_t * plist,
-        uv_async_t * handle)
-{
-    siridb_query_t * query = handle->data;
-    query_select_t * q_select = query->data;
-    siridb_points_t * points;
-
-    if (qp_add_raw(query->packer, (const unsigned char *) name, len))
-    {
-        sprintf(query->err_msg, "Memory allocation error.");
-        return -1;
-    }
-
-    switch (plist->len)
-    {
-    case 0:
-        points = siridb_points_new(0, TP_INT);
-        if (points == NULL)
-        {
-            sprintf(query->err_msg, "Memory allocation error.");
-        }
-        break;
-    case 1:
-        points = vec_pop(plist);
-        break;
-    default:
-        points = siridb_points_merge(plist, query->err_msg);
-        break;
-    }
-
-    if (q_select->mlist != NULL && points != NULL)
-    {
-        siridb_points_t * aggr_points;
-        size_t i;
-
-        for (i = 0; points->len && i < q_select->mlist->len; i++)
-        {
-            aggr_points = siridb_aggregate_run(
-                    points,
-                    (siridb_aggr_t *) q_select->mlist->data[i],
-                    query->err_msg);
-
-            if (aggr_points != points)
-            {
-                siridb_points_free(points);
-            }
-
-            if (aggr_points == NULL)
-            {
-                return -1;  /* (error message is set)  */
-            }
-
-            points = aggr_points;
-        }
-    }
-
-    if (points == NULL)
-    {
-        /*
-         * The list will be cleared including the points since 'merge_as'
-         * is still not NULL. (error message is set)
-         */
-        return -1;
-    }
-
-    if (query->factor)
-    {
-        siridb_points_ts_correction(points, (double) query->factor);
-    }
-
-    if (siridb_points_pack(points, query->packer))
-    {
-        sprintf(query->err_msg, "Memory allocation error.");
-        siridb_points_free(points);
-        return -1;
-    }
-
-    siridb_points_free(points);
-
-    return 0;
-}
-
 /*
  * Returns 0 when successful and -1 in case of an error.
  * (a SIGNAL is raised in case of an error)
@@ -6847,6 +7116,103 @@ static int items_select_other_merge(
     return -(rc || qp_add_type(query->packer, QP_ARRAY_CLOSE));
 }
 
+/*
+ * Set start to the first timestamp which is required for a series when
+ * using a cursor.
+ *
+ * Returns 1 when start is set or 0 if all points must be read.
+ */
+static int LISTENER_cursor_start(
+        query_select_t * q_select,
+        siridb_series_t * series,
+        uint64_t * start)
+{
+    const char * name = (q_select->merge_as == NULL) ?
+            siridb_presuf_name(
+                    q_select->presuf,
+                    series->name,
+                    series->name_len) :
+            siridb_presuf_name(
+                    q_select->presuf,
+                    q_select->merge_as,
+                    strlen(q_select->merge_as));
+
+    return name != NULL && siridb_cursor_start(
+            q_select->cursor,
+            name,
+            q_select->alist,
+            start);
+}
+
+/*
+ * Remove the points before start.
+ */
+static void LISTENER_points_crop(siridb_points_t * points, uint64_t start)
+{
+    size_t i;
+
+    for (i = 0; i < points->len && points->data[i].ts < start; i++)
+    {
+        if (points->tp == TP_STRING)
+        {
+            free(points->data[i].val.str);
+        }
+    }
+
+    if (i)
+    {
+        points->len -= i;
+        memmove(
+                points->data,
+                points->data + i,
+                points->len * sizeof(siridb_point_t));
+    }
+}
+
+/*
+ * Replace the series map with a map containing only the series which are
+ * candidates for top() or bottom().
+ *
+ * Returns 0 if successful or -1 in case of an allocation error.
+ */
+static int LISTENER_top_series(query_select_t * q_select, siridb_t * siridb)
+{
+    siridb_topk_t * topk = q_select->topk;
+    siridb_series_t * series;
+    imap_t * series_map = imap_new();
+    size_t i;
+
+    if (series_map == NULL)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < topk->len; i++)
+    {
+        series = ct_get(siridb->series, topk->items[i].name);
+
+        if (    series == NULL ||
+                imap_get(q_select->series_map, series->id) != series)
+        {
+            continue;
+        }
+
+        siridb_series_incref(series);
+
+        if (imap_add(series_map, series->id, series))
+        {
+            log_critical("Cannot add top series to internal map.");
+            siridb_series_decref(series);
+        }
+    }
+
+    imap_free(q_select->series_map, (imap_free_cb) &siridb__series_decref);
+    q_select->series_map = series_map;
+    topk->is_ranked = 1;
+
+    return 0;
+}
+
 static void on_select_unpack_points(
         qp_unpacker_t * unpacker,
         query_select_t * q_select,
@@ -6900,6 +7266,9 @@ static void on_select_unpack_points(
             else
             {
                 q_select->n += points->len;
+                siri_mem_add(
+                        SIRI_MEM_QUERIES,
+                        points->len * sizeof(siridb_point_t));
             }
         }
 
@@ -6968,6 +7337,9 @@ static void on_select_unpack_merged_points(
                 else
                 {
                     q_select->n += points->len;
+                    siri_mem_add(
+                            SIRI_MEM_QUERIES,
+                            points->len * sizeof(siridb_point_t));
                 }
             }
 
@@ -0,0 +1,547 @@
+/*
+ * mselect.c - Parallel processing of select results on the master.
+ *
+ * When all pools have responded to a select query, the master packs the
+ * points for each series or, when using 'merge as', merges the points and
+ * runs the merge aggregation list for each group. Large results are split
+ * in parts by series (or group) which are processed by the libuv thread
+ * pool. Each part packs into its own packer and the packers are
+ * concatenated in order on the main thread when all parts are finished, so
+ * the result is equal to processing all series on a single thread.
+ */
+#include <logger/logger.h>
+#include <siri/async.h>
+#include <siri/db/aggregate.h>
+#include <siri/db/cursor.h>
+#include <siri/db/mselect.h>
+#include <siri/db/points.h>
+#include <siri/db/queries.h>
+#include <siri/db/query.h>
+#include <siri/err.h>
+#include <siri/siri.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* do not split in parts with less points than this number */
+#define MSELECT_MIN_PART_POINTS 250000
+
+/* maximum number of parts, equal to the default libuv thread pool size */
+#define MSELECT_MAX_PARTS 4
+
+/* initial size for the buffer with series names */
+#define MSELECT_NAMES_SZ 8192
+
+typedef struct mselect_s mselect_t;
+
+typedef struct
+{
+    size_t offset;      /* offset of the name in mselect->names */
+    size_t len;
+    void * data;        /* points or a list of points for 'merge as' */
+    uint64_t last_ts;   /* timestamp of the last packed point */
+    int has_last;
+} mselect_item_t;
+
+typedef struct
+{
+    uv_work_t work;
+    mselect_t * mselect;
+    size_t start;
+    size_t end;
+    qp_packer_t * packer;
+    int done;
+    int rc;
+    char err_msg[SIRIDB_MAX_SIZE_ERR_MSG];
+} mselect_part_t;
+
+struct mselect_s
+{
+    uv_async_t * handle;
+    char * names;
+    size_t names_sz;
+    size_t names_len;
+    mselect_item_t * items;
+    size_t nitems;
+    size_t pending;
+    size_t nparts;
+    mselect_part_t parts[];
+};
+
+static size_t MSELECT_nparts(query_select_t * q_select);
+static int MSELECT_collect(
+        const char * name,
+        size_t len,
+        void * data,
+        mselect_t * mselect);
+static void MSELECT_work(uv_work_t * work);
+static void MSELECT_work_finish(uv_work_t * work, int status);
+static int MSELECT_pack(
+        mselect_part_t * part,
+        mselect_item_t * item,
+        const char * name,
+        siridb_points_t * points);
+static int MSELECT_pack_merge(
+        mselect_part_t * part,
+        mselect_item_t * item,
+        const char * name,
+        vec_t * plist);
+static int MSELECT_pack_cursor(mselect_t * mselect);
+static void MSELECT_free(mselect_t * mselect);
+
+/*
+ * Start processing the select result for the query attached to the handle.
+ * The handle must be initialized with the async call-back which continues
+ * the query and will be called using uv_async_send() when the result is
+ * packed into query->packer.
+ *
+ * Returns 0 if successful or -1 in case of an error. In case of an error
+ * nothing is started and the caller should send an error.
+ */
+int siridb_mselect_start(uv_async_t * handle)
+{
+    siridb_query_t * query = handle->data;
+    query_select_t * q_select = query->data;
+    siridb_t * siridb = query->client->siridb;
+    size_t i, nparts, part_sz;
+    mselect_t * mselect;
+
+    nparts = MSELECT_nparts(q_select);
+
+    mselect = malloc(sizeof(mselect_t) + nparts * sizeof(mselect_part_t));
+    if (mselect == NULL)
+    {
+        ERR_ALLOC
+        return -1;
+    }
+
+    mselect->handle = handle;
+    mselect->names_sz = MSELECT_NAMES_SZ;
+    mselect->names_len = 0;
+    mselect->names = malloc(mselect->names_sz);
+    mselect->nitems = 0;
+    mselect->items = malloc(
+            (q_select->result->len ? q_select->result->len : 1) *
+            sizeof(mselect_item_t));
+    mselect->nparts = 0;
+
+    if (    mselect->names == NULL ||
+            mselect->items == NULL ||
+            ct_items(
+                q_select->result,
+                (ct_item_cb) MSELECT_collect,
+                mselect))
+    {
+        ERR_ALLOC
+        MSELECT_free(mselect);
+        return -1;
+    }
+
+    if (nparts > mselect->nitems)
+    {
+        nparts = mselect->nitems ? mselect->nitems : 1;
+    }
+
+    part_sz = mselect->nitems / nparts;
+
+    for (i = 0; i < nparts; i++)
+    {
+        mselect_part_t * part = mselect->parts + i;
+        part->work.data = part;
+        part->mselect = mselect;
+        part->start = i * part_sz;
+        part->end = (i == nparts - 1)
+                ? mselect->nitems
+                : part->start + part_sz;
+        part->done = 0;
+        part->rc = 0;
+        *part->err_msg = '\0';
+        part->packer = qp_packer_new(QP_SUGGESTED_SIZE);
+
+        if (part->packer == NULL)
+        {
+            ERR_ALLOC
+            MSELECT_free(mselect);
+            return -1;
+        }
+        mselect->nparts++;
+    }
+
+    siridb->selected_points += q_select->n;
+
+    mselect->pending = nparts;
+
+    /* the handle must stay alive until all parts are finished */
+    siri_async_incref(handle);
+
+    for (i = 0; i < nparts; i++)
+    {
+        uv_queue_work(
+                siri.loop,
+                &mselect->parts[i].work,
+                MSELECT_work,
+                MSELECT_work_finish);
+    }
+
+    return 0;
+}
+
+/*
+ * Returns the number of parts for the result, at least 1.
+ */
+static size_t MSELECT_nparts(query_select_t * q_select)
+{
+    size_t nparts = q_select->n / MSELECT_MIN_PART_POINTS;
+
+    if (q_select->mlist != NULL)
+    {
+        size_t i;
+        for (i = 0; i < q_select->mlist->len; i++)
+        {
+            siridb_aggr_t * aggr = q_select->mlist->data[i];
+
+            /* regular expression match data cannot be shared by threads */
+            if (aggr->regex != NULL)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return (nparts < 1) ? 1 :
+           (nparts > MSELECT_MAX_PARTS) ? MSELECT_MAX_PARTS : nparts;
+}
+
+/*
+ * Main thread. The name is only valid during the call-back so a copy is
+ * stored in mselect->names.
+ */
+static int MSELECT_collect(
+        const char * name,
+        size_t len,
+        void * data,
+        mselect_t * mselect)
+{
+    mselect_item_t * item;
+
+    if (mselect->names_len + len > mselect->names_sz)
+    {
+        size_t sz = mselect->names_sz * 2 + len;
+        char * tmp = realloc(mselect->names, sz);
+        if (tmp == NULL)
+        {
+            return -1;
+        }
+        mselect->names = tmp;
+        mselect->names_sz = sz;
+    }
+
+    memcpy(mselect->names + mselect->names_len, name, len);
+
+    item = mselect->items + mselect->nitems++;
+    item->offset = mselect->names_len;
+    item->len = len;
+    item->data = data;
+    item->has_last = 0;
+
+    mselect->names_len += len;
+
+    return 0;
+}
+
+/*
+ * Work thread. Each part only uses its own items, packer and error message
+ * so no lock is required.
+ */
+static void MSELECT_work(uv_work_t * work)
+{
+    mselect_part_t * part = work->data;
+    mselect_t * mselect = part->mselect;
+    siridb_query_t * query = mselect->handle->data;
+    query_select_t * q_select = query->data;
+    mselect_item_t * item;
+    size_t i;
+
+    for (i = part->start; !part->rc && i < part->end; i++)
+    {
+        item = mselect->items + i;
+
+        part->rc = (q_select->merge_as == NULL) ?
+                MSELECT_pack(
+                        part,
+                        item,
+                        mselect->names + item->offset,
+                        (siridb_points_t *) item->data) :
+                MSELECT_pack_merge(
+                        part,
+                        item,
+                        mselect->names + item->offset,
+                        (vec_t *) item->data);
+    }
+
+    part->done = 1;
+}
+
+/*
+ * Main thread.
+ */
+static void MSELECT_work_finish(uv_work_t * work, int status)
+{
+    mselect_part_t * part = work->data;
+    mselect_t * mselect = part->mselect;
+    siridb_query_t * query = mselect->handle->data;
+    size_t i;
+
+    if (status)
+    {
+        log_error("Select work failed (error: %s)", uv_strerror(status));
+    }
+
+    if (--mselect->pending)
+    {
+        return;
+    }
+
+    for (i = 0; i < mselect->nparts; i++)
+    {
+        part = mselect->parts + i;
+
+        if (!part->done || part->rc)
+        {
+            if (part->rc && *part->err_msg)
+            {
+                memcpy(query->err_msg, part->err_msg, SIRIDB_MAX_SIZE_ERR_MSG);
+            }
+            else
+            {
+                sprintf(query->err_msg, "Error while processing the result.");
+            }
+            query->flags |= SIRIDB_QUERY_FLAG_ERR;
+            break;
+        }
+
+        if (qp_packer_extend(query->packer, part->packer))
+        {
+            sprintf(query->err_msg, "Memory allocation error.");
+            query->flags |= SIRIDB_QUERY_FLAG_ERR;
+            break;
+        }
+    }
+
+    if (    query->cursor != NULL &&
+            (~query->flags & SIRIDB_QUERY_FLAG_ERR) &&
+            MSELECT_pack_cursor(mselect))
+    {
+        sprintf(query->err_msg, "Memory allocation error.");
+        query->flags |= SIRIDB_QUERY_FLAG_ERR;
+    }
+
+    /*
+     * In case a siri_err is set, we are in forced closing state and we
+     * should not use the handle but let siri close it.
+     */
+    if (!siri_err)
+    {
+        if (query->flags & SIRIDB_QUERY_FLAG_ERR)
+        {
+            siridb_query_send_error(mselect->handle, CPROTO_ERR_QUERY);
+        }
+        else
+        {
+            uv_async_send(mselect->handle);
+        }
+    }
+
+    siri_async_decref(&mselect->handle);
+
+    MSELECT_free(mselect);
+}
+
+static int MSELECT_pack(
+        mselect_part_t * part,
+        mselect_item_t * item,
+        const char * name,
+        siridb_points_t * points)
+{
+    siridb_query_t * query = part->mselect->handle->data;
+
+    if (points->len)
+    {
+        item->last_ts = points->data[points->len - 1].ts;
+        item->has_last = 1;
+    }
+
+    if (    qp_add_raw(part->packer, (const unsigned char *) name, item->len) ||
+            siridb_points_pack_factor(
+                    points,
+                    part->packer,
+                    (double) query->factor))
+    {
+        sprintf(part->err_msg, "Memory allocation error.");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int MSELECT_pack_merge(
+        mselect_part_t * part,
+        mselect_item_t * item,
+        const char * name,
+        vec_t * plist)
+{
+    siridb_query_t * query = part->mselect->handle->data;
+    query_select_t * q_select = query->data;
+    siridb_points_t * points;
+
+    if (qp_add_raw(part->packer, (const unsigned char *) name, item->len))
+    {
+        sprintf(part->err_msg, "Memory allocation error.");
+        return -1;
+    }
+
+    switch (plist->len)
+    {
+    case 0:
+        points = siridb_points_new(0, TP_INT);
+        if (points == NULL)
+        {
+            sprintf(part->err_msg, "Memory allocation error.");
+        }
+        break;
+    case 1:
+        points = vec_pop(plist);
+        break;
+    default:
+        points = siridb_points_merge(plist, part->err_msg);
+        break;
+    }
+
+    if (q_select->mlist != NULL && points != NULL)
+    {
+        siridb_points_t * aggr_points;
+        size_t i;
+
+        for (i = 0; points->len && i < q_select->mlist->len; i++)
+        {
+            aggr_points = siridb_aggregate_run(
+                    points,
+                    (siridb_aggr_t *) q_select->mlist->data[i],
+                    part->err_msg);
+
+            if (aggr_points != points)
+            {
+                siridb_points_free(points);
+            }
+
+            if (aggr_points == NULL)
+            {
+                return -1;  /* (error message is set)  */
+            }
+
+            points = aggr_points;
+        }
+    }
+
+    if (points == NULL)
+    {
+        /*
+         * The list will be cleared including the points since 'merge_as'
+         * is still not NULL. (error message is set)
+         */
+        return -1;
+    }
+
+    if (points->len)
+    {
+        item->last_ts = points->data[points->len - 1].ts;
+        item->has_last = 1;
+    }
+
+    if (siridb_points_pack_factor(
+            points,
+            part->packer,
+            (double) query->factor))
+    {
+        sprintf(part->err_msg, "Memory allocation error.");
+        siridb_points_free(points);
+        return -1;
+    }
+
+    siridb_points_free(points);
+
+    return 0;
+}
+
+/*
+ * Main thread. Add a new cursor to the result. Names without new points
+ * keep the timestamp from the cursor which was received with the query.
+ *
+ * Returns 0 if successful or -1 in case of an allocation error.
+ */
+static int MSELECT_pack_cursor(mselect_t * mselect)
+{
+    siridb_query_t * query = mselect->handle->data;
+    query_select_t * q_select = query->data;
+    mselect_item_t * item;
+    uint64_t * ts;
+    size_t i;
+    int rc;
+    qp_packer_t * packer = qp_packer_new(
+            mselect->names_len + mselect->nitems * 12 + 16);
+
+    if (packer == NULL)
+    {
+        return -1;
+    }
+
+    rc = qp_add_type(packer, QP_MAP_OPEN);
+
+    for (i = 0; !rc && i < mselect->nitems; i++)
+    {
+        item = mselect->items + i;
+
+        ts = (item->has_last) ? &item->last_ts :
+             (q_select->cursor == NULL) ? NULL : ct_getn(
+                    q_select->cursor,
+                    mselect->names + item->offset,
+                    item->len);
+
+        if (ts != NULL)
+        {
+            rc = siridb_cursor_pack(
+                    packer,
+                    mselect->names + item->offset,
+                    item->len,
+                    *ts);
+        }
+    }
+
+    rc = (  rc ||
+            qp_add_type(packer, QP_MAP_CLOSE) ||
+            qp_add_raw(
+                    query->packer,
+                    (const unsigned char *) SIRIDB_CURSOR_KEY,
+                    SIRIDB_CURSOR_KEY_LEN) ||
+            qp_add_raw(
+                    query->packer,
+                    (const unsigned char *) packer->buffer,
+                    packer->len));
+
+    qp_packer_free(packer);
+
+    return rc ? -1 : 0;
+}
+
+static void MSELECT_free(mselect_t * mselect)
+{
+    size_t i;
+
+    for (i = 0; i < mselect->nparts; i++)
+    {
+        qp_packer_free(mselect->parts[i].packer);
+    }
+
+    free(mselect->names);
+    free(mselect->items);
+    free(mselect);
+}
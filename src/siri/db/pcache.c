@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <siri/db/pcache.h>
 #include <siri/err.h>
+#include <siri/mem.h>
 #include <stddef.h>
 
 #define PCACHE_DEFAULT_SIZE 64
@@ -32,10 +33,28 @@ siridb_pcache_t * siridb_pcache_new(points_tp tp)
             free(pcache);
             pcache = NULL;
         }
+        else
+        {
+            siri_mem_add(
+                    SIRI_MEM_CACHES,
+                    sizeof(siridb_pcache_t) +
+                    sizeof(siridb_point_t) * PCACHE_DEFAULT_SIZE);
+        }
     }
     return pcache;
 }
 
+/*
+ * Destroy a pcache object. (parsing NULL is not allowed)
+ */
+void siridb_pcache_free(siridb_pcache_t * pcache)
+{
+    siri_mem_sub(
+            SIRI_MEM_CACHES,
+            sizeof(siridb_pcache_t) + sizeof(siridb_point_t) * pcache->size);
+    siridb_points_free((siridb_points_t *) pcache);
+}
+
 /*
  * Add a point to points. (points are sorted by timestamp so the new point
  * will be inserted at the correct position.
@@ -64,6 +83,9 @@ int siridb_pcache_add_point(
             return -1;
         }
         pcache->data = tmp;
+        siri_mem_add(
+                SIRI_MEM_CACHES,
+                sizeof(siridb_point_t) * (pcache->size / 2));
     }
 
     siridb_points_add_point((siridb_points_t *) pcache, ts, val);
@@ -57,6 +57,11 @@ static int POINTS_set_cinfo_size(uint16_t * cinfo, size_t * size);
 inline static uint16_t POINTS_hash(uint32_t h);
 static void POINTS_destroy(siridb_points_t * points);
 
+static inline int64_t POINTS_ts(uint64_t ts, double factor)
+{
+    return (int64_t) (factor ? (uint64_t) (ts * factor) : ts);
+}
+
 static uint8_t * dictionary[DICT_SZ + 1];
 
 void siridb_points_init(void)
@@ -192,52 +197,69 @@ void siridb_points_add_point(
  */
 int siridb_points_pack(siridb_points_t * points, qp_packer_t * packer)
 {
-    qp_add_type(packer, QP_ARRAY_OPEN);
-    if (points->len)
+    return siridb_points_pack_factor(points, packer, 0.0);
+}
+
+/*
+ * Same as siridb_points_pack() but each timestamp is multiplied with the
+ * time precision `factor` while packing. A factor of 0.0 means no correction.
+ * The points itself are not changed.
+ *
+ * For integer and double points the packer is resized only once, for the
+ * worst case size, so all points can be written using the unchecked
+ * qp_put_*() functions.
+ *
+ * Returns siri_err and raises a SIGNAL in case an error has occurred.
+ */
+int siridb_points_pack_factor(
+        siridb_points_t * points,
+        qp_packer_t * packer,
+        double factor)
+{
+    size_t i;
+    siridb_point_t * point = points->data;
+
+    if (points->tp == TP_STRING)
     {
-        size_t i;
-        siridb_point_t * point = points->data;
-        switch (points->tp)
+        qp_add_type(packer, QP_ARRAY_OPEN);
+        for (i = 0; i < points->len; i++, point++)
         {
-        case TP_INT:
-            for (i = 0; i < points->len; i++, point++)
-            {
-                qp_add_type(packer, QP_ARRAY2);
-                qp_add_int64(packer, (int64_t) point->ts);
-                qp_add_int64(packer, point->val.int64);
-            }
-            break;
-        case TP_DOUBLE:
-            for (i = 0; i < points->len; i++, point++)
-            {
-                qp_add_type(packer, QP_ARRAY2);
-                qp_add_int64(packer, (int64_t) point->ts);
-                qp_add_double(packer, point->val.real);
-            }
-            break;
-        case TP_STRING:
-            for (i = 0; i < points->len; i++, point++)
-            {
-                qp_add_type(packer, QP_ARRAY2);
-                qp_add_int64(packer, (int64_t) point->ts);
-                qp_add_string(packer, point->val.str);
-            }
-            break;
+            qp_add_type(packer, QP_ARRAY2);
+            qp_add_int64(packer, POINTS_ts(point->ts, factor));
+            qp_add_string(packer, point->val.str);
         }
+        qp_add_type(packer, QP_ARRAY_CLOSE);
+        return siri_err;
     }
-    qp_add_type(packer, QP_ARRAY_CLOSE);
 
-    return siri_err;
-}
+    /* array open and close + for each point an array2 type and two numbers */
+    if (qp_packer_reserve(packer, 2 + points->len * (1 + 2 * QP_MAX_NUM_SZ)))
+    {
+        return siri_err;
+    }
 
-void siridb_points_ts_correction(siridb_points_t * points, double factor)
-{
-    siridb_point_t * point = points->data;
-    size_t i;
-    for (i = 0; i < points->len; i++, point++)
+    qp_put_type(packer, QP_ARRAY_OPEN);
+    if (points->tp == TP_INT)
     {
-        point->ts *= factor;
+        for (i = 0; i < points->len; i++, point++)
+        {
+            qp_put_type(packer, QP_ARRAY2);
+            qp_put_int64(packer, POINTS_ts(point->ts, factor));
+            qp_put_int64(packer, point->val.int64);
+        }
     }
+    else
+    {
+        for (i = 0; i < points->len; i++, point++)
+        {
+            qp_put_type(packer, QP_ARRAY2);
+            qp_put_int64(packer, POINTS_ts(point->ts, factor));
+            qp_put_double(packer, point->val.real);
+        }
+    }
+    qp_put_type(packer, QP_ARRAY_CLOSE);
+
+    return siri_err;
 }
 
 /*
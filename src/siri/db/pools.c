@@ -189,6 +189,7 @@ int siridb_pools_accessible(siridb_t * siridb)
  * This function will send a package to one accessible server in each pool,
  * 'this' pool not included. The promises call-back function should be
  * used to check if the package has been send successfully to all pools.
+ * The optional 'each_cb' is called for each response as soon as it arrives.
  *
  * This function can raise a SIGNAL when allocation errors occur.
  *
@@ -202,6 +203,7 @@ void siridb_pools_send_pkg(
         sirinet_pkg_t * pkg,
         uint64_t timeout,
         sirinet_promises_cb cb,
+        sirinet_promises_each_cb each_cb,
         void * data,
         int flags)
 {
@@ -219,6 +221,8 @@ void siridb_pools_send_pkg(
         siridb_pool_t * pool;
         uint16_t pid;
 
+        promises->each_cb = each_cb;
+
         for (pid = 0; pid < siridb->pools->len; pid++)
         {
             if (pid == siridb->server->pool)
@@ -269,6 +273,7 @@ void siridb_pools_send_pkg_2some(
         sirinet_pkg_t * pkg,
         uint64_t timeout,
         sirinet_promises_cb cb,
+        sirinet_promises_each_cb each_cb,
         void * data,
         int flags)
 {
@@ -286,6 +291,8 @@ void siridb_pools_send_pkg_2some(
         siridb_pool_t * pool;
         size_t i;
 
+        promises->each_cb = each_cb;
+
         for (i = 0; i < vec->len; i++)
         {
             pool = vec->data[i];
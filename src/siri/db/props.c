@@ -9,6 +9,7 @@
 #include <siri/db/reindex.h>
 #include <siri/db/time.h>
 #include <siri/grammar/grammar.h>
+#include <siri/mem.h>
 #include <siri/db/fifo.h>
 #include <siri/db/tee.h>
 #include <siri/net/tcp.h>
@@ -128,6 +129,42 @@ static void prop_max_open_files(
         siridb_t * siridb,
         qp_packer_t * packer,
         int map);
+static void prop_mem_buffers(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
+static void prop_mem_caches(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
+static void prop_mem_groups(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
+static void prop_mem_index(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
+static void prop_mem_names(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
+static void prop_mem_network(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
+static void prop_mem_queries(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
+static void prop_mem_series(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
+static void prop_mem_tags(
+        siridb_t * siridb,
+        qp_packer_t * packer,
+        int map);
 static void prop_mem_usage(
         siridb_t * siridb,
         qp_packer_t * packer,
@@ -246,6 +283,24 @@ void siridb_init_props(void)
             prop_list_limit);
     props_set_cb(CLERI_GID_K_MAX_OPEN_FILES - KW_OFFSET,
             prop_max_open_files);
+    props_set_cb(CLERI_GID_K_MEM_BUFFERS - KW_OFFSET,
+            prop_mem_buffers);
+    props_set_cb(CLERI_GID_K_MEM_CACHES - KW_OFFSET,
+            prop_mem_caches);
+    props_set_cb(CLERI_GID_K_MEM_GROUPS - KW_OFFSET,
+            prop_mem_groups);
+    props_set_cb(CLERI_GID_K_MEM_INDEX - KW_OFFSET,
+            prop_mem_index);
+    props_set_cb(CLERI_GID_K_MEM_NAMES - KW_OFFSET,
+            prop_mem_names);
+    props_set_cb(CLERI_GID_K_MEM_NETWORK - KW_OFFSET,
+            prop_mem_network);
+    props_set_cb(CLERI_GID_K_MEM_QUERIES - KW_OFFSET,
+            prop_mem_queries);
+    props_set_cb(CLERI_GID_K_MEM_SERIES - KW_OFFSET,
+            prop_mem_series);
+    props_set_cb(CLERI_GID_K_MEM_TAGS - KW_OFFSET,
+            prop_mem_tags);
     props_set_cb(CLERI_GID_K_MEM_USAGE - KW_OFFSET,
             prop_mem_usage);
     props_set_cb(CLERI_GID_K_LOG_LEVEL - KW_OFFSET,
@@ -471,6 +526,87 @@ static void prop_max_open_files(
     qp_add_int64(packer, (int64_t) siri.cfg->max_open_files);
 }
 
+static void prop_mem_buffers(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_buffers", 11)
+    qp_add_int64(packer, (int64_t) siri_mem_get(SIRI_MEM_BUFFERS));
+}
+
+static void prop_mem_caches(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_caches", 10)
+    qp_add_int64(packer, (int64_t) siri_mem_get(SIRI_MEM_CACHES));
+}
+
+static void prop_mem_groups(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_groups", 10)
+    qp_add_int64(packer, (int64_t) siri_mem_groups());
+}
+
+static void prop_mem_index(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_index", 9)
+    qp_add_int64(packer, (int64_t) siri_mem_get(SIRI_MEM_INDEX));
+}
+
+static void prop_mem_names(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_names", 9)
+    qp_add_int64(packer, (int64_t) siri_mem_names());
+}
+
+static void prop_mem_network(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_network", 11)
+    qp_add_int64(packer, (int64_t) siri_mem_get(SIRI_MEM_NETWORK));
+}
+
+static void prop_mem_queries(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_queries", 11)
+    qp_add_int64(packer, (int64_t) siri_mem_get(SIRI_MEM_QUERIES));
+}
+
+static void prop_mem_series(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_series", 10)
+    qp_add_int64(packer, (int64_t) siri_mem_get(SIRI_MEM_SERIES));
+}
+
+static void prop_mem_tags(
+        siridb_t * siridb __attribute__((unused)),
+        qp_packer_t * packer,
+        int map)
+{
+    SIRIDB_PROP_MAP("mem_tags", 8)
+    qp_add_int64(packer, (int64_t) siri_mem_tags());
+}
+
 static void prop_mem_usage(
         siridb_t * siridb __attribute__((unused)),
         qp_packer_t * packer,
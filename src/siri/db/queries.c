@@ -4,10 +4,13 @@
 #include <assert.h>
 #include <logger/logger.h>
 #include <siri/db/aggregate.h>
+#include <siri/db/cursor.h>
 #include <siri/db/query.h>
+#include <siri/db/share.h>
 #include <siri/db/shard.h>
 #include <siri/db/queries.h>
 #include <siri/db/sset.h>
+#include <siri/mem.h>
 #include <stddef.h>
 #include <stdlib.h>
 
@@ -84,6 +87,9 @@ query_select_t * query_select_new(void)
     q_select->n = 0;
     q_select->nselects = 1;  /* we have at least one select function  */
     q_select->points_map = NULL;
+    q_select->cursor = NULL;
+    q_select->topk = NULL;
+    q_select->share_gen = 0;
     q_select->alist = NULL;
     q_select->mlist = NULL;
     q_select->result = ct_new();
@@ -240,7 +246,12 @@ void query_list_free(uv_handle_t * handle)
 
 void query_select_free(uv_handle_t * handle)
 {
-    query_select_t * q_select = ((siridb_query_t *) handle->data)->data;
+    siridb_query_t * query = (siridb_query_t *) handle->data;
+    query_select_t * q_select = query->data;
+
+    siridb_share_leave(query->client->siridb->share, q_select->share_gen);
+
+    siri_mem_sub(SIRI_MEM_QUERIES, q_select->n * sizeof(siridb_point_t));
 
     siridb_presuf_free(q_select->presuf);
 
@@ -263,6 +274,16 @@ void query_select_free(uv_handle_t * handle)
 
     free(q_select->merge_as);
 
+    if (q_select->cursor != NULL)
+    {
+        siridb_cursor_free(q_select->cursor);
+    }
+
+    if (q_select->topk != NULL)
+    {
+        siridb_topk_free(q_select->topk);
+    }
+
     if (q_select->alist != NULL)
     {
         siridb_aggregate_list_free(q_select->alist);
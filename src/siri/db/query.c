@@ -57,6 +57,17 @@ static int QUERY_rebuild(
         size_t * size,
         const size_t max_size);
 static void QUERY_send_no_query(uv_async_t * handle);
+static void QUERY_run(
+        uint16_t pid,
+        sirinet_stream_t * client,
+        siridb_batch_t * batch,
+        const char * q,
+        size_t q_len,
+        const char * cursor,
+        size_t cursor_len,
+        float factor,
+        int flags);
+static void QUERY_send_pkg(siridb_query_t * query, sirinet_pkg_t * pkg);
 
 /*
  * This function can raise a SIGNAL.
@@ -68,6 +79,57 @@ void siridb_query_run(
         size_t q_len,
         float factor,
         int flags)
+{
+    QUERY_run(pid, client, NULL, q, q_len, NULL, 0, factor, flags);
+}
+
+/*
+ * Run a query with a cursor. Select queries only return points which are
+ * newer than the cursor and add a new cursor to the result. An empty cursor
+ * is allowed and starts a new cursor.
+ *
+ * This function can raise a SIGNAL.
+ */
+void siridb_query_run_cursor(
+        uint16_t pid,
+        sirinet_stream_t * client,
+        const char * q,
+        size_t q_len,
+        const char * cursor,
+        size_t cursor_len,
+        float factor,
+        int flags)
+{
+    QUERY_run(pid, client, NULL, q, q_len, cursor, cursor_len, factor, flags);
+}
+
+/*
+ * Run a query as part of a batch. The result is added to the batch at the
+ * given index instead of being sent to the client.
+ *
+ * This function can raise a SIGNAL.
+ */
+void siridb_query_run_batch(
+        siridb_batch_t * batch,
+        uint16_t idx,
+        const char * q,
+        size_t q_len,
+        float factor,
+        int flags)
+{
+    QUERY_run(idx, batch->client, batch, q, q_len, NULL, 0, factor, flags);
+}
+
+static void QUERY_run(
+        uint16_t pid,
+        sirinet_stream_t * client,
+        siridb_batch_t * batch,
+        const char * q,
+        size_t q_len,
+        const char * cursor,
+        size_t cursor_len,
+        float factor,
+        int flags)
 {
     uv_async_t * handle = malloc(sizeof(uv_async_t));
     if (handle == NULL)
@@ -92,10 +154,27 @@ void siridb_query_run(
         return;
     }
 
+    /* set cursor, an empty cursor is allowed */
+    query->cursor = NULL;
+    query->cursor_len = cursor_len;
+    if (cursor != NULL)
+    {
+        if ((query->cursor = malloc(cursor_len ? cursor_len : 1)) == NULL)
+        {
+            ERR_ALLOC
+            free(query->q);
+            free(query);
+            free(handle);
+            return;
+        }
+        memcpy(query->cursor, cursor, cursor_len);
+    }
+
     #if SIRIDB_EXPR_ALLOC
     if ((query->expr_cache = llist_new()) == NULL)
     {
         ERR_ALLOC
+        free(query->cursor);
         free(query->q);
         free(query);
         free(handle);
@@ -118,6 +197,13 @@ void siridb_query_run(
     query->client = client;
     query->flags = flags;
 
+    /* bind the batch, the result will be added to the batch */
+    query->batch = batch;
+    if (batch != NULL)
+    {
+        siridb_batch_incref(batch);
+    }
+
     /* bind time precision factor */
     query->factor = factor;
 
@@ -160,6 +246,7 @@ void siridb_query_free(uv_handle_t * handle)
 
     /* free query */
     free(query->q);
+    free(query->cursor);
 
     /* free qpack buffers */
     if (query->packer != NULL)
@@ -188,6 +275,12 @@ void siridb_query_free(uv_handle_t * handle)
     }
     #endif
 
+    /* a query without a result gets an error result in the batch */
+    if (query->batch != NULL)
+    {
+        siridb_batch_finish(query->batch, query->pid);
+    }
+
     /* decrement client reference counter */
     sirinet_stream_decref(query->client);
 
@@ -213,7 +306,7 @@ void siridb_send_query_result(uv_async_t * handle)
             query->pid,
             CPROTO_RES_QUERY);
 
-    sirinet_pkg_send(query->client, pkg);
+    QUERY_send_pkg(query, pkg);
 
     query->packer = NULL;
 
@@ -245,7 +338,7 @@ void siridb_query_send_error(
     if (package != NULL)
     {
         /* ignore result code, signal can be raised */
-        sirinet_pkg_send(query->client, package);
+        QUERY_send_pkg(query, package);
     }
     uv_close((uv_handle_t *) handle, siri_async_close);
 }
@@ -263,6 +356,21 @@ void siridb_query_forward(
         siridb_query_fwd_t fwd,
         sirinet_promises_cb cb,
         int flags)
+{
+    siridb_query_forward_each(handle, fwd, cb, NULL, flags);
+}
+
+/*
+ * Like siridb_query_forward() but with an optional 'each_cb' which is called
+ * for each response as soon as it arrives. This is only supported when
+ * forwarding to pools, the 'each_cb' is ignored for other servers.
+ */
+void siridb_query_forward_each(
+        uv_async_t * handle,
+        siridb_query_fwd_t fwd,
+        sirinet_promises_cb cb,
+        sirinet_promises_each_cb each_cb,
+        int flags)
 {
     siridb_query_t * query = (siridb_query_t *) handle->data;
     siridb_t * siridb = query->client->siridb;
@@ -284,12 +392,36 @@ void siridb_query_forward(
      * For backwards compatibility with SiriDB version < 2.0.24 we send an
      * extra value SIRIDB_TIME_DEFAULT.
      */
-    qp_add_type(packer, QP_ARRAY2);
+    qp_add_type(packer, (query->cursor == NULL) ? QP_ARRAY2 : QP_ARRAY3);
 
     /* add the query to the packer */
     QUERY_to_packer(packer, query);
     qp_add_int64(packer, SIRIDB_TIME_DEFAULT);  /* Only for version < 2.0.24 */
 
+    /* other servers use the cursor to read only the required points */
+    if (query->cursor != NULL)
+    {
+        qp_add_raw(
+                packer,
+                (const unsigned char *) query->cursor,
+                query->cursor_len);
+    }
+
+
+    /* queries in a batch use a combined forward to all pools */
+    if (    query->batch != NULL &&
+            fwd == SIRIDB_QUERY_FWD_POOLS &&
+            siridb_batch_forward(
+                    query->batch,
+                    handle,
+                    packer,
+                    cb,
+                    each_cb,
+                    flags) == 0)
+    {
+        qp_packer_free(packer);
+        return;
+    }
 
     sirinet_pkg_t * pkg = sirinet_pkg_new(0, packer->len, 0, packer->buffer);
 
@@ -329,6 +461,7 @@ void siridb_query_forward(
                     pkg,
                     0,
                     cb,
+                    each_cb,
                     handle,
                     flags);
             break;
@@ -350,6 +483,7 @@ void siridb_query_forward(
                             pkg,
                             0,
                             cb,
+                            each_cb,
                             handle,
                             flags);
                 }
@@ -372,6 +506,7 @@ void siridb_query_forward(
                     pkg,
                     0,
                     cb,
+                    each_cb,
                     handle,
                     flags);
             break;
@@ -434,6 +569,22 @@ void siridb_query_timeit_from_unpacker(
     }
 }
 
+/*
+ * Send a result or error package for a query to the client, or add the
+ * package to the batch when the query is part of a batch.
+ */
+static void QUERY_send_pkg(siridb_query_t * query, sirinet_pkg_t * pkg)
+{
+    if (query->batch != NULL)
+    {
+        siridb_batch_set_result(query->batch, query->pid, pkg);
+    }
+    else
+    {
+        sirinet_pkg_send(query->client, pkg);
+    }
+}
+
 static void QUERY_unique(cleri_olist_t * olist)
 {
     while (olist != NULL && olist->next != NULL)
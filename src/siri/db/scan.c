@@ -0,0 +1,319 @@
+/*
+ * scan.c - Parallel scan over the series of a query.
+ *
+ * Count, list and filter statements evaluate a where expression on every
+ * series in q_wrapper->vec. For large databases the vec is split in parts
+ * which are evaluated by the libuv thread pool. Each part moves the series
+ * it keeps to the start of its own slice and the others to the end, so no
+ * extra memory is required. The series properties are read while holding
+ * the series_mutex, which is released every SCAN_LOCK_SZ series so inserts
+ * are not blocked for the whole scan. When all parts are finished the
+ * slices are merged on the main thread, where the references to the series
+ * which are not kept are released, and the query continues with the async
+ * call-back of the handle.
+ */
+#include <logger/logger.h>
+#include <siri/async.h>
+#include <siri/db/queries.h>
+#include <siri/db/query.h>
+#include <siri/db/scan.h>
+#include <siri/db/series.h>
+#include <siri/err.h>
+#include <siri/siri.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* do not use the thread pool for less series than this number */
+#define SCAN_MIN_PART_SZ 100000
+
+/* maximum number of parts, equal to the default libuv thread pool size */
+#define SCAN_MAX_PARTS 4
+
+/* number of series evaluated while holding the series_mutex */
+#define SCAN_LOCK_SZ 10000
+
+typedef struct scan_s scan_t;
+
+typedef struct
+{
+    uv_work_t work;
+    scan_t * scan;
+    size_t start;
+    size_t end;
+    size_t kept;        /* number of series kept at the start of the slice */
+    size_t n;           /* count or length for this part */
+    int done;
+} scan_part_t;
+
+struct scan_s
+{
+    uv_async_t * handle;
+    siridb_scan_tp tp;
+    size_t * n;
+    size_t limit;
+    size_t pending;
+    size_t nparts;
+    scan_part_t parts[];
+};
+
+static void SCAN_work(uv_work_t * work);
+static void SCAN_work_finish(uv_work_t * work, int status);
+static void SCAN_merge(scan_t * scan);
+
+/*
+ * Start a parallel scan for the query attached to the handle. The handle
+ * must be initialized with the async call-back which continues the query.
+ * The call-back will be called using uv_async_send() when the scan is
+ * finished and is responsible for handling what is left in q_wrapper->vec.
+ *
+ * - SIRIDB_SCAN_COUNT/LENGTH:  the result is added to 'n' and the vec will
+ *                              be empty.
+ * - SIRIDB_SCAN_MATCH:         the vec will contain only the first 'limit'
+ *                              matching series (in order) and the where
+ *                              expression is removed from the query.
+ *
+ * Returns 0 if the scan is started, 1 if the number of series is too small
+ * for a parallel scan or -1 in case of an error. In the last two cases
+ * nothing is changed and the caller should process the vec itself.
+ */
+int siridb_scan_start(
+        uv_async_t * handle,
+        siridb_scan_tp tp,
+        size_t * n,
+        size_t limit)
+{
+    siridb_query_t * query = handle->data;
+    query_wrapper_t * q_wrapper = query->data;
+    size_t i, nparts, part_sz;
+    scan_t * scan;
+
+    nparts = q_wrapper->vec->len / SCAN_MIN_PART_SZ;
+
+    if (nparts < 2)
+    {
+        return 1;
+    }
+
+    if (nparts > SCAN_MAX_PARTS)
+    {
+        nparts = SCAN_MAX_PARTS;
+    }
+
+    scan = malloc(sizeof(scan_t) + nparts * sizeof(scan_part_t));
+    if (scan == NULL)
+    {
+        ERR_ALLOC
+        return -1;
+    }
+
+    scan->handle = handle;
+    scan->tp = tp;
+    scan->n = n;
+    scan->limit = limit;
+    scan->pending = nparts;
+    scan->nparts = nparts;
+
+    part_sz = q_wrapper->vec->len / nparts;
+
+    for (i = 0; i < nparts; i++)
+    {
+        scan_part_t * part = scan->parts + i;
+        part->work.data = part;
+        part->scan = scan;
+        part->start = i * part_sz;
+        part->end = (i == nparts - 1)
+                ? q_wrapper->vec->len
+                : part->start + part_sz;
+        part->kept = part->end - part->start;
+        part->n = 0;
+        part->done = 0;
+    }
+
+    /* the handle must stay alive until all parts are finished */
+    siri_async_incref(handle);
+
+    for (i = 0; i < nparts; i++)
+    {
+        uv_queue_work(
+                siri.loop,
+                &scan->parts[i].work,
+                SCAN_work,
+                SCAN_work_finish);
+    }
+
+    return 0;
+}
+
+/*
+ * Work thread. Only the slice of the vec which belongs to this part is
+ * changed. The series are read while holding the series_mutex since they
+ * can be changed by inserts on the main thread. References are not released
+ * here since that could free a series outside the main thread.
+ */
+static void SCAN_work(uv_work_t * work)
+{
+    scan_part_t * part = work->data;
+    scan_t * scan = part->scan;
+    siridb_query_t * query = scan->handle->data;
+    query_wrapper_t * q_wrapper = query->data;
+    siridb_t * siridb = query->client->siridb;
+    cexpr_t * where_expr = q_wrapper->where_expr;
+    void ** data = q_wrapper->vec->data;
+    siridb_series_t * series;
+    size_t i, kept = 0, n = 0;
+    int match;
+
+    uv_mutex_lock(&siridb->series_mutex);
+
+    for (i = part->start; i < part->end; i++)
+    {
+        if (i > part->start && (i - part->start) % SCAN_LOCK_SZ == 0)
+        {
+            uv_mutex_unlock(&siridb->series_mutex);
+            uv_mutex_lock(&siridb->series_mutex);
+        }
+
+        series = (siridb_series_t *) data[i];
+
+        match = where_expr == NULL || cexpr_run(
+                where_expr,
+                (cexpr_cb_t) siridb_series_cexpr_cb,
+                series);
+
+        switch (scan->tp)
+        {
+        case SIRIDB_SCAN_COUNT:
+            n += match;
+            break;
+        case SIRIDB_SCAN_LENGTH:
+            n += match ? series->length : 0;
+            break;
+        case SIRIDB_SCAN_MATCH:
+            if (match && kept < scan->limit)
+            {
+                /* swap so the series which are not kept end up at the end */
+                data[i] = data[part->start + kept];
+                data[part->start + kept++] = series;
+            }
+            break;
+        }
+    }
+
+    uv_mutex_unlock(&siridb->series_mutex);
+
+    part->kept = kept;
+    part->n = n;
+    part->done = 1;
+}
+
+/*
+ * Main thread.
+ */
+static void SCAN_work_finish(uv_work_t * work, int status)
+{
+    scan_part_t * part = work->data;
+    scan_t * scan = part->scan;
+
+    if (status)
+    {
+        log_error("Scan work failed (error: %s)", uv_strerror(status));
+    }
+
+    if (--scan->pending)
+    {
+        return;
+    }
+
+    SCAN_merge(scan);
+
+    /*
+     * In case a siri_err is set, we are in forced closing state and we
+     * should not use the handle but let siri close it.
+     */
+    if (!siri_err)
+    {
+        siridb_query_t * query = scan->handle->data;
+
+        if (query->flags & SIRIDB_QUERY_FLAG_ERR)
+        {
+            siridb_query_send_error(scan->handle, CPROTO_ERR_QUERY);
+        }
+        else
+        {
+            uv_async_send(scan->handle);
+        }
+    }
+
+    siri_async_decref(&scan->handle);
+
+    free(scan);
+}
+
+/*
+ * Main thread. Release the series which are not kept and move the series
+ * which are kept by each part together so the vec is valid again. Parts
+ * which did not run keep their full slice which makes sure all references
+ * are released when the query is destroyed.
+ */
+static void SCAN_merge(scan_t * scan)
+{
+    siridb_query_t * query = scan->handle->data;
+    query_wrapper_t * q_wrapper = query->data;
+    void ** data = q_wrapper->vec->data;
+    size_t i, len = 0, n = 0, limit = scan->limit;
+    int completed = 1;
+
+    for (i = 0; i < scan->nparts; i++)
+    {
+        scan_part_t * part = scan->parts + i;
+        size_t kept = part->kept;
+
+        if (!part->done)
+        {
+            completed = 0;
+        }
+        else
+        {
+            /* release the series which are not kept or exceed the limit */
+            size_t j;
+
+            if (scan->tp == SIRIDB_SCAN_MATCH)
+            {
+                kept = (kept < limit) ? kept : limit;
+                limit -= kept;
+            }
+
+            for (j = part->start + kept; j < part->end; j++)
+            {
+                siridb_series_t * series = data[j];
+                siridb_series_decref(series);
+            }
+        }
+
+        memmove(data + len, data + part->start, kept * sizeof(void *));
+        len += kept;
+        n += part->n;
+    }
+
+    q_wrapper->vec->len = len;
+    q_wrapper->vec_index = 0;
+
+    if (!completed)
+    {
+        sprintf(query->err_msg, "Error while scanning series.");
+        query->flags |= SIRIDB_QUERY_FLAG_ERR;
+        return;
+    }
+
+    if (scan->tp == SIRIDB_SCAN_MATCH)
+    {
+        /* the where expression is applied to all series in the vec */
+        cexpr_free(q_wrapper->where_expr);
+        q_wrapper->where_expr = NULL;
+    }
+    else
+    {
+        *scan->n += n;
+    }
+}
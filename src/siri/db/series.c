@@ -24,11 +24,15 @@
 #include <logger/logger.h>
 #include <siri/db/buffer.h>
 #include <siri/db/db.h>
+#include <siri/db/flush.h>
 #include <siri/db/misc.h>
+#include <siri/db/share.h>
 #include <siri/db/series.h>
 #include <siri/db/shard.h>
 #include <siri/db/shards.h>
+#include <siri/db/subscriptions.h>
 #include <siri/err.h>
+#include <siri/mem.h>
 #include <siri/siri.h>
 #include <xpath/xpath.h>
 
@@ -138,7 +142,19 @@ int siridb_series_add_point(
     assert (series->buffer != NULL);
     int rc = 0;
 
-    series->length++;
+    siridb_series_length_add(series, 1);
+
+    /*
+     * The buffer space on disk is full, swap the buffer and flush in the
+     * background. When a previous flush is not finished yet, the buffer will
+     * be flushed synchronous once the buffer in memory is full too.
+     */
+    if (    series->flushing == NULL &&
+            series->buffer->len == siridb->buffer->len - 1 &&
+            siridb_flush_series(siridb, series))
+    {
+        return -1;  /* signal is raised */
+    }
 
     /* add point in memory
      * (memory can hold 1 more point than we can hold on disk)
@@ -150,7 +166,8 @@ int siridb_series_add_point(
         if (siridb_shards_add_points(
                 siridb,
                 series,
-                series->buffer))
+                series->buffer,
+                NULL))
         {
             rc = -1;  /* signal is raised */
         }
@@ -193,19 +210,31 @@ int siridb_series_add_pcache(
         siridb_series_t *__restrict series,
         siridb_pcache_t *__restrict pcache)
 {
+    /*
+     * Points which do not fit in a buffer are written to the shards at once
+     * since they cannot be kept in the buffer file while they are flushed.
+     */
     if (pcache->len > siridb->buffer->len || series->buffer == NULL)
     {
-        series->length += pcache->len;
+        siridb_series_length_add(series, pcache->len);
 
         return siridb_shards_add_points(
                 siridb,
                 series,
-                (siridb_points_t *) pcache);
+                (siridb_points_t *) pcache,
+                NULL);
     }
 
-    if (pcache->len + series->buffer->len > siridb->buffer->len)
+    /*
+     * When the points fit in a buffer but overflow the current buffer, they
+     * are added one by one so the full buffer is flushed in the background.
+     * Only when a previous flush is not finished yet, the buffer and points
+     * are written to the shards at once.
+     */
+    if (    series->flushing != NULL &&
+            pcache->len + series->buffer->len > siridb->buffer->len)
     {
-        series->length += pcache->len;
+        siridb_series_length_add(series, pcache->len);
 
         siridb_points_t *__restrict points = series->buffer;
         size_t i = points->len;
@@ -223,7 +252,8 @@ int siridb_series_add_pcache(
         if (siridb_shards_add_points(
                 siridb,
                 series,
-                (siridb_points_t *) pcache))
+                (siridb_points_t *) pcache,
+                NULL))
         {
             return -1;  /* signal is raised */
         }
@@ -327,6 +357,9 @@ siridb_series_t * siridb_series_new(
         return NULL;
     }
 
+    /* set the bit for each subscription which matches the new series */
+    series->subs = siridb_subscriptions_match(siridb->subscriptions, series);
+
     /* we can ignore the result code since this is not critical and logging
      * is done by the function.
      */
@@ -355,6 +388,9 @@ void siridb__series_free(siridb_series_t *__restrict series)
 
     if (series->buffer != NULL)
     {
+        siri_mem_sub(
+                SIRI_MEM_BUFFERS,
+                siridb_buffer_mem(series->siridb->buffer));
         siridb_points_free(series->buffer);
         if (series->flags & SIRIDB_SERIES_IS_DROPPED)
         {
@@ -364,6 +400,25 @@ void siridb__series_free(siridb_series_t *__restrict series)
         }
     }
 
+    if (series->flushing != NULL)
+    {
+        siri_mem_sub(
+                SIRI_MEM_BUFFERS,
+                siridb_buffer_mem(series->siridb->buffer));
+        siridb_points_free(series->flushing);
+        if (series->flags & SIRIDB_SERIES_IS_DROPPED)
+        {
+            vec_append_safe(
+                &series->siridb->buffer->empty,
+                (void *) series->bf_flush);
+        }
+    }
+
+    siri_mem_sub(SIRI_MEM_INDEX, series->idx_len * sizeof(idx_t));
+    siri_mem_sub(
+            SIRI_MEM_SERIES,
+            sizeof(siridb_series_t) + series->name_len + 1);
+
     free(series->idx);
     free(series->name);
     free(series);
@@ -438,6 +493,7 @@ int siridb_series_add_idx(
         return -1;
     }
     series->idx = idx;
+    siri_mem_add(SIRI_MEM_INDEX, sizeof(idx_t));
 
     for (; i && start_ts < series->idx[i - 1].start_ts; i--)
     {
@@ -489,6 +545,9 @@ void siridb_series_drop_prepare(siridb_t * siridb, siridb_series_t * series)
     /* remove series from tree */
     ct_pop(siridb->series, series->name);
 
+    /* points of the series are no longer part of the total */
+    siridb_points_total_sub(siridb, series->length);
+
     series->flags |= SIRIDB_SERIES_IS_DROPPED;
 }
 
@@ -606,7 +665,7 @@ void siridb_series_remove_shard(
         {
             siridb_shard_decref(shard);
             offset++;
-            series->length -= idx->len;
+            siridb_series_length_sub(series, idx->len);
         }
         else if (offset)
         {
@@ -618,6 +677,7 @@ void siridb_series_remove_shard(
     {
         if (!series->length)
         {
+            siri_mem_sub(SIRI_MEM_INDEX, series->idx_len * sizeof(idx_t));
             series->idx_len = 0;
 
             if (siridb_series_drop(siridb, series))
@@ -628,6 +688,7 @@ void siridb_series_remove_shard(
         else
         {
             series->idx_len -= offset;
+            siri_mem_sub(SIRI_MEM_INDEX, offset * sizeof(idx_t));
             idx = (idx_t *) realloc(
                         series->idx,
                         series->idx_len * sizeof(idx_t));
@@ -683,6 +744,42 @@ void siridb_series_update_props(siridb_t * siridb, siridb_series_t * series)
     }
 }
 
+/*
+ * Add buffered points within the given range to points.
+ */
+static void SERIES_add_buffer_points(
+        siridb_points_t *__restrict points,
+        siridb_points_t *__restrict buf,
+        uint64_t *__restrict start_ts,
+        uint64_t *__restrict end_ts)
+{
+    /* create pointer to buffer and get current length */
+    siridb_point_t *__restrict point = buf->data;
+    size_t len = buf->len;
+
+    /* crop start buffer if needed */
+    if (start_ts != NULL)
+    {
+        for (; len && point->ts < *start_ts; point++, len--);
+    }
+
+    /* crop end buffer if needed */
+    if (end_ts != NULL && len)
+    {
+        siridb_point_t *__restrict p;
+
+        for (   p = point + len - 1;
+                len && p->ts >= *end_ts;
+                p--, len--);
+    }
+
+    /* add buffer points */
+    for (; len; point++, len--)
+    {
+        siridb_points_add_point(points, &point->ts, &point->val);
+    }
+}
+
 /*
  * Returns NULL and raises a SIGNAL in case an error has occurred.
  */
@@ -693,7 +790,6 @@ siridb_points_t * siridb_series_get_points(
 {
     idx_t *__restrict idx;
     siridb_points_t *__restrict points;
-    siridb_point_t *__restrict point;
     size_t len, size;
     uint32_t i;
     uint32_t indexes[series->idx_len];
@@ -713,6 +809,7 @@ siridb_points_t * siridb_series_get_points(
     }
 
     size += (series->buffer == NULL) ? 0 : series->buffer->len;
+    size += (series->flushing == NULL) ? 0 : series->flushing->len;
     points = siridb_points_new(size, series->tp);
 
     if (points == NULL)
@@ -721,45 +818,29 @@ siridb_points_t * siridb_series_get_points(
         return NULL;
     }
 
+    siridb_shard_read_ahead(series, indexes, len);
+
     for (i = 0; i < len; i++)
     {
         idx = series->idx + indexes[i];
-        siridb_shard_get_points_callback(idx->shard->flags, series)(
+        siridb_share_get_points(
+                series->siridb->share,
                 points,
+                series,
                 idx,
                 start_ts,
-                end_ts,
-                series->flags & SIRIDB_SERIES_HAS_OVERLAP);
+                end_ts);
         /* errors can be ignored here */
     }
 
     if (series->buffer != NULL)
     {
-        /* create pointer to buffer and get current length */
-        point = series->buffer->data;
-        len = series->buffer->len;
-
-        /* crop start buffer if needed */
-        if (start_ts != NULL)
-        {
-            for (; len && point->ts < *start_ts; point++, len--);
-        }
-
-        /* crop end buffer if needed */
-        if (end_ts != NULL && len)
-        {
-            siridb_point_t *__restrict p;
-
-            for (   p = point + len - 1;
-                    len && p->ts >= *end_ts;
-                    p--, len--);
-        }
+        SERIES_add_buffer_points(points, series->buffer, start_ts, end_ts);
+    }
 
-        /* add buffer points */
-        for (; len; point++, len--)
-        {
-            siridb_points_add_point(points, &point->ts, &point->val);
-        }
+    if (series->flushing != NULL)
+    {
+        SERIES_add_buffer_points(points, series->flushing, start_ts, end_ts);
     }
 
     if (points->len < size && siridb_points_resize(points, points->len))
@@ -778,16 +859,53 @@ void siridb__series_decref(siridb_series_t * series)
     siridb_series_decref(series);
 }
 
+/*
+ * Returns the buffer (or the points waiting for a flush) which contains the
+ * first point of the series, or NULL if the point must be read from a shard.
+ */
+static siridb_points_t * SERIES_buffer_first(siridb_series_t * series)
+{
+    siridb_points_t * buf = series->buffer;
+
+    if (buf != NULL && buf->len && buf->data->ts == series->start)
+    {
+        return buf;
+    }
+
+    buf = series->flushing;
+
+    return (buf != NULL && buf->len && buf->data->ts == series->start) ?
+            buf : NULL;
+}
+
+/*
+ * Returns the buffer (or the points waiting for a flush) which contains the
+ * last point of the series, or NULL if the point must be read from a shard.
+ */
+static siridb_points_t * SERIES_buffer_last(siridb_series_t * series)
+{
+    siridb_points_t * buf = series->buffer;
+
+    if (buf != NULL && buf->len && buf->data[buf->len - 1].ts == series->end)
+    {
+        return buf;
+    }
+
+    buf = series->flushing;
+
+    return (buf != NULL &&
+            buf->len &&
+            buf->data[buf->len - 1].ts == series->end) ? buf : NULL;
+}
+
 siridb_points_t * siridb_series_get_first(
         siridb_series_t * series, int * required_shard)
 {
-    siridb_points_t * buf = series->buffer;
+    siridb_points_t * buf = SERIES_buffer_first(series);
     siridb_points_t * points;
     uint64_t start;
 
-    if (buf != NULL &&
-        buf->len &&
-        buf->data->ts == series->start)
+    if (buf != NULL)
     {
         points = siridb_points_new(1, series->tp);
         if (points == NULL)
@@ -843,14 +961,13 @@ siridb_points_t * siridb_series_get_first(
 siridb_points_t * siridb_series_get_last(
         siridb_series_t * series, int * required_shard)
 {
-    siridb_points_t * buf = series->buffer;
+    siridb_points_t * buf = SERIES_buffer_last(series);
     siridb_points_t * points;
     siridb_point_t * point;
 
-    if (buf != NULL &&
-        buf->len &&
-        (point = buf->data + (buf->len - 1))->ts == series->end)
+    if (buf != NULL)
     {
+        point = buf->data + (buf->len - 1);
         points = siridb_points_new(1, series->tp);
         if (points == NULL)
         {
@@ -1190,6 +1307,7 @@ int siridb_series_optimize_shard(
 
         /* new length is current length minus difference */
         series->idx_len -= diff;
+        siri_mem_sub(SIRI_MEM_INDEX, diff * sizeof(idx_t));
 
         for (; i < series->idx_len; i++)
         {
@@ -1349,11 +1467,14 @@ static siridb_series_t * SERIES_new(
             series->start = -1;
             series->end = 0;
             series->buffer = NULL;
+            series->flushing = NULL;
+            series->bf_flush = 0;
             series->pool = pool;
             series->flags = 0;
             series->idx_len = 0;
             series->idx = NULL;
             series->siridb = siridb;
+            series->subs = 0;
 
             /* get sum series name to calculate series mask (for sharding) */
             for (n = 0; *name; name++)
@@ -1378,6 +1499,10 @@ static siridb_series_t * SERIES_new(
             {
                 series->flags |= SIRIDB_SERIES_IS_32BIT_TS;
             }
+
+            siri_mem_add(
+                    SIRI_MEM_SERIES,
+                    sizeof(siridb_series_t) + series->name_len + 1);
         }
     }
     return series;
@@ -1795,6 +1920,15 @@ static void SERIES_update_start(siridb_series_t *__restrict series)
             series->start = point->ts;
         }
     }
+
+    if (series->flushing && series->flushing->len)
+    {
+        siridb_point_t * point = series->flushing->data;
+        if (point->ts < series->start)
+        {
+            series->start = point->ts;
+        }
+    }
 }
 
 /*
@@ -1838,6 +1972,16 @@ static void SERIES_update_end(siridb_series_t *__restrict series)
             series->end = point->ts;
         }
     }
+
+    if (series->flushing && series->flushing->len)
+    {
+        siridb_point_t * point = series->flushing->data +
+                series->flushing->len - 1;
+        if (point->ts > series->end)
+        {
+            series->end = point->ts;
+        }
+    }
 }
 
 
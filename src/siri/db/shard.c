@@ -5,7 +5,9 @@
 #define _GNU_SOURCE
 #endif
 #include <assert.h>
+#include <crc32c/crc32c.h>
 #include <ctree/ctree.h>
+#include <fcntl.h>
 #include <imap/imap.h>
 #include <limits.h>
 #include <logger/logger.h>
@@ -29,8 +31,21 @@
 /* growing with this block size */
 #define SHARD_GROW_SZ 131072
 
+/* initial and maximum size of a shard write buffer for batched writes */
+#define SHARD_WBUF_INIT_SZ 65536
+#define SHARD_WBUF_MAX_SZ 1048576
+
 /* shard schema (schemas below 20 are reserved for Python SiriDB) */
-#define SIRIDB_SHARD_SHEMA 21
+#define SIRIDB_SHARD_SHEMA 22
+
+/* first shard schema where each chunk is followed by a CRC-32C checksum */
+#define SHARD_SCHEMA_CRC 22
+
+/* bytes of chunk data which are read ahead while optimizing a shard */
+#define SHARD_OPTIMIZE_READ_SZ 8388608
+
+/* chunks with a smaller gap are read ahead using a single read */
+#define SHARD_OPTIMIZE_GAP_SZ 65536
 
 /* optimal points in a single shard */
 #define OPTIMAL_POINTS_PER_SHARD 2000
@@ -75,6 +90,14 @@
 #define IDX64_SZ 22  /* or 24 when log/compressed */
 #define IDX64E_SZ 24
 
+/*
+ * Starting with schema 22, the data of each chunk is followed by a CRC-32C
+ * checksum of the chunk data:
+ *
+ * 0    (uint32_t)  CRC
+ */
+#define CRC_SZ 4
+
 #define SHARD_STATUS_SIZE 8
 
 /*
@@ -101,6 +124,18 @@ static const siridb_shard_flags_repr_t flags_map[SHARD_STATUS_SIZE] = {
         {.repr="compressed", .flag=SIRIDB_SHARD_IS_COMPRESSED},
 };
 
+typedef struct
+{
+    siridb_series_t * series;
+    size_t pos;             /* position of the first chunk in the shard */
+} SHARD_plan_t;
+
+typedef struct
+{
+    size_t pos;
+    size_t end;
+} SHARD_range_t;
+
 const char shard_type_map[2][7] = {
         "number",
         "log"
@@ -131,7 +166,71 @@ static size_t SHARD_write_header(
         uint_fast32_t end,
         uint16_t * cinfo,
         FILE * fp);
+static size_t SHARD_pack_header(
+        siridb_t * siridb,
+        siridb_series_t * series,
+        siridb_points_t * points,
+        uint_fast32_t start,
+        uint_fast32_t end,
+        uint16_t * cinfo,
+        char * buf);
+static int SHARD_wbuf_flush(siridb_shard_t * shard);
+static size_t SHARD_wbuf_append(
+        siridb_t * siridb,
+        siridb_series_t * series,
+        siridb_shard_t * shard,
+        siridb_points_t * points,
+        uint_fast32_t start,
+        uint_fast32_t end,
+        uint16_t * cinfo,
+        unsigned char * cdata,
+        size_t dsize,
+        uint32_t * crc);
 static int SHARD_remove(siridb_shard_t * shard);
+static SHARD_plan_t * SHARD_optimize_plan(
+        siridb_shard_t * shard,
+        vec_t * vec,
+        size_t * n);
+static size_t SHARD_optimize_readahead(
+        siridb_shard_t * shard,
+        SHARD_plan_t * plan,
+        size_t start,
+        size_t n,
+        int fd);
+static void SHARD_optimize_drop_written(int fd, size_t * dropped, size_t len);
+static int SHARD_check_crc(idx_t * idx, uint32_t crc);
+
+static inline int SHARD_has_crc(siridb_shard_t * shard)
+{
+    return shard->schema >= SHARD_SCHEMA_CRC;
+}
+
+/*
+ * Returns the size of the chunk data in a shard, without index header and
+ * without a checksum.
+ */
+static inline size_t SHARD_chunk_size(
+        siridb_shard_t * shard,
+        uint16_t len,
+        uint16_t cinfo,
+        int is_ts64)
+{
+    if (shard->tp == SIRIDB_SHARD_TP_LOG)
+    {
+        return siridb_points_get_size_log(cinfo) + len * (
+                shard->flags & SIRIDB_SHARD_IS_COMPRESSED ?
+                        (len < POINTS_ZIP_THRESHOLD ?
+                                sizeof(uint64_t) :
+                                0) : is_ts64 ?
+                                        sizeof(uint64_t) :
+                                        sizeof(uint32_t));
+    }
+    if (shard->flags & SIRIDB_SHARD_IS_COMPRESSED)
+    {
+        return siridb_points_get_size_zipped(cinfo, len);
+    }
+    return len * (is_ts64 ? 16 : 12);
+}
 
 uint64_t siridb_shard_duration_from_interval(siridb_t * siridb, uint64_t interval)
 {
@@ -290,7 +389,11 @@ int siridb_shard_load(siridb_t * siridb, uint64_t id, uint64_t duration)
     shard->id = id;
     shard->ref = 1;
     shard->len = HEADER_SIZE;
+    shard->replaced = 0;
     shard->replacing = NULL;
+    shard->wbuf = NULL;
+    shard->wbuf_len = 0;
+    shard->wbuf_sz = 0;
     shard->duration = duration;
 
     if (SHARD_init_fn(siridb, shard) < 0)
@@ -345,7 +448,8 @@ int siridb_shard_load(siridb_t * siridb, uint64_t id, uint64_t duration)
         return -1;
     }
 
-    /* set shard type, flags and max_chunk_sz */
+    /* set shard schema, type, flags and max_chunk_sz */
+    shard->schema = schema;
     shard->tp = (uint8_t) header[HEADER_TP];
     shard->flags = (uint8_t) header[HEADER_FLAGS] | SIRIDB_SHARD_IS_LOADING;
     shard->max_chunk_sz = *((uint16_t *) (header + HEADER_MAX_CHUNK_SZ));
@@ -424,6 +528,8 @@ int siridb_shard_load(siridb_t * siridb, uint64_t id, uint64_t duration)
         return -1;
     }
 
+    siridb_shards_size_add(siridb, shard->tp, shard->len);
+
     /* remove LOADING flag from shard status */
     shard->flags &= ~SIRIDB_SHARD_IS_LOADING;
 
@@ -459,8 +565,13 @@ siridb_shard_t *  siridb_shard_create(
     shard->id = id;
     shard->ref = 1;
     shard->tp = tp;
+    shard->schema = SIRIDB_SHARD_SHEMA;
+    shard->replaced = 0;
     shard->replacing = replacing;
     shard->len = shard->size = HEADER_SIZE;
+    shard->wbuf = NULL;
+    shard->wbuf_len = 0;
+    shard->wbuf_sz = 0;
     shard->duration = duration;
     shard->max_chunk_sz = (replacing == NULL) ?
             (tp == SIRIDB_SHARD_TP_NUMBER ?
@@ -533,6 +644,18 @@ siridb_shard_t *  siridb_shard_create(
         return NULL;
     }
 
+    /*
+     * The new shard takes the place of the shard it is replacing. Points
+     * which are written to the replaced shard while optimizing are written
+     * to the new shard as well, so they should not be counted twice.
+     */
+    siridb_shards_size_add(siridb, shard->tp, shard->len);
+    if (replacing != NULL)
+    {
+        siridb_shards_size_sub(siridb, replacing->tp, replacing->len);
+        replacing->replaced = 1;
+    }
+
     /*
      * This is not critical at this point and it's hard to imagine this
      * fails if all the above was successful
@@ -631,54 +754,87 @@ size_t siridb_shard_write_points(
 {
     FILE * fp;
     uint16_t len = end - start;
-    size_t dsize;
+    size_t dsize, crc_sz = SHARD_has_crc(shard) ? CRC_SZ : 0;
+    uint32_t crc = 0;
     unsigned char * cdata = NULL;
 
     uint_fast32_t i;
     size_t pos, header_sz;
 
-    if (shard->fp->fp == NULL)
-    {
-        if (siri_fopen(siri.fh, shard->fp, shard->fn, "r+"))
-        {
-            char buf[1024];
-            log_critical("Cannot open file '%s' (%s)",
-                    shard->fn, strerror_r(errno, buf, 1024));
-            ERR_FILE
-            return 0;
-        }
-    }
-    fp = shard->fp->fp;
-
     if (shard->flags & SIRIDB_SHARD_IS_COMPRESSED)
     {
         cdata = siridb_points_zip(points, start, end, cinfo, &dsize);
-        if (cdata == NULL)
-        {
-            ERR_ALLOC
-            log_critical("Memory allocation error while compressing points");
-            return 0;
-        }
     }
     else if (series->tp == TP_STRING)
     {
         dsize = siridb->time->ts_sz;
         cdata = siridb_points_raw_string(points, start, end, cinfo, &dsize);
-        if (cdata == NULL)
-        {
-            ERR_ALLOC
-            log_critical("Memory allocation error while compressing points");
-            return 0;
-        }
     }
     else
     {
+        size_t p = 0;
+        size_t ts_sz = siridb->time->ts_sz;
+
         /* no compression, ignore c-info */
         cinfo = NULL;
-        dsize = (siridb->time->ts_sz + 8) * len;
+        dsize = (ts_sz + 8) * len;
+        cdata = malloc(dsize);
+
+        for (i = start; cdata != NULL && i < end; i++)
+        {
+            memcpy(cdata + p, &points->data[i].ts, ts_sz);
+            p += ts_sz;
+            memcpy(cdata + p, &points->data[i].val, 8);
+            p += 8;
+        }
+    }
+
+    if (cdata == NULL)
+    {
+        ERR_ALLOC
+        log_critical("Memory allocation error while compressing points");
+        return 0;
+    }
+
+    if (crc_sz)
+    {
+        crc = crc32c(0, cdata, dsize);
     }
 
-    if (shard->len > SHARD_GROW_SZ && (shard->len + dsize + 64 > shard->size))
+    if (idx_fp == NULL && shard->wbuf != NULL)
+    {
+        /* batched write, see siridb_shard_wbuf_start() */
+        pos = SHARD_wbuf_append(
+                siridb,
+                series,
+                shard,
+                points,
+                start,
+                end,
+                cinfo,
+                cdata,
+                dsize,
+                crc_sz ? &crc : NULL);
+        free(cdata);
+        return pos;
+    }
+
+    if (shard->fp->fp == NULL)
+    {
+        if (siri_fopen(siri.fh, shard->fp, shard->fn, "r+"))
+        {
+            char buf[1024];
+            log_critical("Cannot open file '%s' (%s)",
+                    shard->fn, strerror_r(errno, buf, 1024));
+            ERR_FILE
+            free(cdata);
+            return 0;
+        }
+    }
+    fp = shard->fp->fp;
+
+    if (shard->len > SHARD_GROW_SZ &&
+        (shard->len + dsize + crc_sz + 64 > shard->size))
     {
         SHARD_grow(shard);
     }
@@ -686,6 +842,7 @@ size_t siridb_shard_write_points(
     if (fseeko(fp, shard->len, SEEK_SET))
     {
         log_critical("Seek error in: '%s'", shard->fn);
+        free(cdata);
         return 0;
     }
 
@@ -725,29 +882,14 @@ size_t siridb_shard_write_points(
         return 0;
     }
 
-    if (cdata == NULL)
-    {
-        size_t p = 0;
-        size_t ts_sz = siridb->time->ts_sz;
-
-        cdata = malloc(dsize);
-        if (cdata == NULL)
-        {
-            ERR_ALLOC
-            log_critical("Memory allocation error while compressing points");
-            return 0;
-        }
+    long int rc = fwrite(cdata, dsize, 1, fp);
 
-        for (i = start; i < end; i++)
-        {
-            memcpy(cdata + p, &points->data[i].ts, ts_sz);
-            p += ts_sz;
-            memcpy(cdata + p, &points->data[i].val, 8);
-            p += 8;
-        }
+    if (rc == 1 && crc_sz)
+    {
+        rc = fwrite(&crc, crc_sz, 1, fp);
     }
 
-    long int rc = fwrite(cdata, dsize, 1, fp);
+    free(cdata);
 
     if (rc != 1 || fflush(fp))
     {
@@ -758,12 +900,65 @@ size_t siridb_shard_write_points(
         return 0;
     }
 
-    free(cdata);
+    if ((~shard->flags & SIRIDB_SHARD_IS_REMOVED) && !shard->replaced)
+    {
+        siridb_shards_size_add(
+                siridb,
+                shard->tp,
+                pos + dsize + crc_sz - shard->len);
+    }
 
-    shard->len = pos + dsize;
+    shard->len = pos + dsize + crc_sz;
     return pos;
 }
 
+/*
+ * Start a batched write for a shard. Chunks which are written to the shard
+ * using siridb_shard_write_points() without an index file are collected in
+ * the shard write buffer and written to disk at once by
+ * siridb_shard_wbuf_write(). The position for each chunk is reserved when
+ * the chunk is added, so the returned position can be used for the series
+ * index right away.
+ *
+ * Warning: the series and shards lock must be held until the write buffer
+ * is written, since chunks in the buffer are not on disk yet.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+int siridb_shard_wbuf_start(siridb_shard_t * shard)
+{
+    assert (shard->wbuf == NULL);
+
+    shard->wbuf = malloc(SHARD_WBUF_INIT_SZ);
+    if (shard->wbuf == NULL)
+    {
+        ERR_ALLOC
+        return -1;
+    }
+    shard->wbuf_len = 0;
+    shard->wbuf_sz = SHARD_WBUF_INIT_SZ;
+
+    return 0;
+}
+
+/*
+ * Write the chunks in the shard write buffer to disk and end the batched
+ * write for the shard.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+int siridb_shard_wbuf_write(siridb_shard_t * shard)
+{
+    int rc = SHARD_wbuf_flush(shard);
+
+    free(shard->wbuf);
+    shard->wbuf = NULL;
+    shard->wbuf_len = 0;
+    shard->wbuf_sz = 0;
+
+    return rc;
+}
+
 /*
  * Returns 0 if successful or -1 in case of an error. SiriDB might recover
  * from this error so we do not consider this critical.
@@ -820,6 +1015,13 @@ int siridb_shard_get_points_num32(
         return -1;
     }
 
+    if (    SHARD_has_crc(idx->shard) &&
+            SHARD_check_crc(idx, crc32c(0, temp, 12 * idx->len)))
+    {
+        free(temp);
+        return -1;
+    }
+
     /* set pointer to start */
     pt = temp;
 
@@ -917,6 +1119,13 @@ int siridb_shard_get_points_num64(
         return -1;
     }
 
+    if (    SHARD_has_crc(idx->shard) &&
+            SHARD_check_crc(idx, crc32c(0, temp, 16 * idx->len)))
+    {
+        free(temp);
+        return -1;
+    }
+
     /* set pointer to start */
     pt = temp;
 
@@ -1009,6 +1218,13 @@ int siridb_shard_get_points_num_compressed(
         return -1;
     }
 
+    if (    SHARD_has_crc(idx->shard) &&
+            SHARD_check_crc(idx, crc32c(0, bits, size)))
+    {
+        free(bits);
+        return -1;
+    }
+
     switch (points->tp)
     {
     case TP_INT:
@@ -1097,6 +1313,13 @@ int siridb_shard_get_points_log_compressed(
         return -1;
     }
 
+    if (    SHARD_has_crc(idx->shard) &&
+            SHARD_check_crc(idx, crc32c(0, bits, size)))
+    {
+        free(bits);
+        return -1;
+    }
+
     rc = siridb_points_unzip_string(
             points,
             bits,
@@ -1174,6 +1397,17 @@ int siridb_shard_get_points_log32(
         return -1;
     }
 
+    if (    SHARD_has_crc(idx->shard) &&
+            SHARD_check_crc(idx, crc32c(
+                    crc32c(0, tdata, sizeof(uint32_t) * idx->len),
+                    cdata,
+                    dsize)))
+    {
+        free(tdata);
+        free(cdata);
+        return -1;
+    }
+
     /* set pointer to start */
     tpt = tdata;
     cpt = cdata;
@@ -1291,6 +1525,17 @@ int siridb_shard_get_points_log64(
         return -1;
     }
 
+    if (    SHARD_has_crc(idx->shard) &&
+            SHARD_check_crc(idx, crc32c(
+                    crc32c(0, tdata, sizeof(uint64_t) * idx->len),
+                    cdata,
+                    dsize)))
+    {
+        free(tdata);
+        free(cdata);
+        return -1;
+    }
+
     /* set pointer to start */
     tpt = tdata;
     cpt = cdata;
@@ -1343,6 +1588,70 @@ int siridb_shard_get_points_log64(
     return 0;
 }
 
+/*
+ * Verify the checksum of a chunk. Returns the number of bytes which are
+ * verified, 0 when the shard has no checksums or -1 in case of a read error
+ * or checksum mismatch. (the shard will be marked as corrupt)
+ *
+ * This function must be called while holding the series_mutex.
+ */
+ssize_t siridb_shard_verify_chunk(siridb_series_t * series, idx_t * idx)
+{
+    unsigned char * data;
+    size_t size;
+    int rc;
+
+    if (!SHARD_has_crc(idx->shard))
+    {
+        return 0;
+    }
+
+    if (idx->shard->fp->fp == NULL)
+    {
+        if (siri_fopen(siri.fh, idx->shard->fp, idx->shard->fn, "r+"))
+        {
+            log_critical(
+                    "Cannot open file '%s', skip verifying chunk",
+                    idx->shard->fn);
+            return -1;
+        }
+    }
+
+    size = SHARD_chunk_size(
+            idx->shard,
+            idx->len,
+            idx->cinfo,
+            !(series->flags & SIRIDB_SERIES_IS_32BIT_TS));
+
+    data = malloc(size);
+    if (data == NULL)
+    {
+        log_critical("Memory allocation error");
+        return -1;
+    }
+
+    if (fseeko(idx->shard->fp->fp, idx->pos, SEEK_SET) ||
+        fread(data, size, 1, idx->shard->fp->fp) != 1)
+    {
+        if (~idx->shard->flags & SIRIDB_SHARD_IS_CORRUPT)
+        {
+            log_critical(
+                    "Cannot read from shard id %" PRIu64
+                    ". The next optimize cycle "
+                    "will fix this shard but you might loose some data.",
+                    idx->shard->id);
+            idx->shard->flags |= SIRIDB_SHARD_IS_CORRUPT;
+        }
+        free(data);
+        return -1;
+    }
+
+    rc = SHARD_check_crc(idx, crc32c(0, data, size));
+    free(data);
+
+    return rc ? -1 : (ssize_t) size;
+}
+
 /*
  * This function will be called from the 'optimize' thread.
  *
@@ -1353,7 +1662,10 @@ int siridb_shard_optimize(siridb_shard_t * shard, siridb_t * siridb)
     int rc = 0;
     siridb_shard_t * new_shard = NULL;
     siridb_series_t * series;
-    size_t i;
+    SHARD_plan_t * plan;
+    size_t i, n, next, released, written, dropped;
+    uint8_t drop_cache = siri.cfg->optimize_drop_cache;
+    int fd, wfd;
 
     uv_mutex_lock(&siridb->shards_mutex);
 
@@ -1428,26 +1740,58 @@ int siridb_shard_optimize(siridb_shard_t * shard, siridb_t * siridb)
         return -1;
     }
 
-    sleep(1);
+    /*
+     * Series are optimized in the order of their first chunk in the shard
+     * so the shard is read from start to end, instead of in random order.
+     */
+    uv_mutex_lock(&siridb->series_mutex);
 
-    for (i = 0; i < vec->len; i++)
+    plan = SHARD_optimize_plan(shard, vec, &n);
+
+    uv_mutex_unlock(&siridb->series_mutex);
+
+    if (plan == NULL)
     {
-        /* its possible that another database is paused, but we wait anyway */
+        vec_destroy(vec, (vec_destroy_cb) siridb__series_decref);
+        ERR_ALLOC
+        return -1;
+    }
+
+    /* separate descriptors are used for page cache hints only */
+    fd = open(shard->fn, O_RDONLY);
+    if (fd == -1)
+    {
+        log_debug(
+                "Cannot open '%s' for read ahead while optimizing",
+                shard->fn);
+    }
+
+    wfd = drop_cache ? open(new_shard->fn, O_RDONLY) : -1;
+
+    sleep(1);
+
+    for (i = 0, next = 0, released = 0, dropped = 0; i < n; i++)
+    {
+        /* its possible that another database is paused, but we wait anyway */
         if (siri.optimize->pause)
         {
             siri_optimize_wait();
         }
 
-        series = vec->data[i];
+        series = plan[i].series;
 
         if (    !siri_err &&
                 siri.optimize->status != SIRI_OPTIMIZE_CANCELLED &&
-                shard->id % shard->duration == series->mask &&
                 (~series->flags & SIRIDB_SERIES_IS_DROPPED) &&
                 (~new_shard->flags & SIRIDB_SHARD_IS_REMOVED))
         {
             uv_mutex_lock(&siridb->series_mutex);
 
+            if (i >= next)
+            {
+                next = SHARD_optimize_readahead(shard, plan, i, n, fd);
+            }
+
             if (    (~new_shard->flags & SIRIDB_SHARD_IS_REMOVED) &&
                     siridb_series_optimize_shard(
                         siridb,
@@ -1459,17 +1803,55 @@ int siridb_shard_optimize(siridb_shard_t * shard, siridb_t * siridb)
                         "error", shard->fn);
             }
 
+            written = new_shard->len;
+
             uv_mutex_unlock(&siridb->series_mutex);
 
+            /*
+             * Chunks of the remaining series are all located after the first
+             * chunk of the next series, so the pages before are not used
+             * anymore for optimizing.
+             */
+            if (    drop_cache &&
+                    fd != -1 &&
+                    i + 1 < n &&
+                    plan[i + 1].pos > released)
+            {
+                (void) posix_fadvise(
+                        fd,
+                        released,
+                        plan[i + 1].pos - released,
+                        POSIX_FADV_DONTNEED);
+                released = plan[i + 1].pos;
+            }
+
+            if (wfd != -1 && i + 1 >= next)
+            {
+                SHARD_optimize_drop_written(wfd, &dropped, written);
+            }
+
             /* make this sleep depending on the active_tasks
              * (50ms per active task) */
             usleep( 50000 * siridb->tasks.active + 100 );
         }
+    }
 
-        siridb_series_decref(series);
+    if (fd != -1)
+    {
+        if (drop_cache)
+        {
+            (void) posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+        close(fd);
+    }
+
+    if (wfd != -1)
+    {
+        close(wfd);
     }
 
-    vec_free(vec);
+    free(plan);
+    vec_destroy(vec, (vec_destroy_cb) siridb__series_decref);
 
     if (new_shard->flags & SIRIDB_SHARD_IS_REMOVED)
     {
@@ -1598,6 +1980,7 @@ void siridb_shard_drop(siridb_shard_t * shard, siridb_t * siridb)
      */
     if (pop_shard != NULL && (~pop_shard->flags & SIRIDB_SHARD_IS_REMOVED))
     {
+        siridb_shards_size_sub(siridb, pop_shard->tp, pop_shard->len);
         pop_shard->flags |= SIRIDB_SHARD_IS_REMOVED;
         SHARD_remove(pop_shard);
 
@@ -1699,10 +2082,48 @@ void siridb__shard_free(siridb_shard_t * shard)
     /* this will close the file, even when other references exist */
     siri_fp_decref(shard->fp);
 
+    free(shard->wbuf);
     free(shard->fn);
     free(shard);
 }
 
+/*
+ * Read the checksum which follows the chunk data and compare the checksum
+ * with the given 'crc'. The file pointer must be positioned at the end of the
+ * chunk data.
+ *
+ * Returns 0 if the checksum matches or -1 if not. In case of a mismatch the
+ * shard is marked as corrupt.
+ */
+static int SHARD_check_crc(idx_t * idx, uint32_t crc)
+{
+    uint32_t chk;
+
+    if (fread(&chk, CRC_SZ, 1, idx->shard->fp->fp) == 1 && chk == crc)
+    {
+        return 0;
+    }
+
+    if (idx->shard->flags & SIRIDB_SHARD_IS_CORRUPT)
+    {
+        log_error(
+                "Checksum mismatch in shard id %" PRIu64 " at position %u",
+                idx->shard->id,
+                idx->pos);
+    }
+    else
+    {
+        log_critical(
+                "Checksum mismatch in shard id %" PRIu64 " at position %u. "
+                "The next optimize cycle will fix this shard but you might "
+                "loose some data.",
+                idx->shard->id,
+                idx->pos);
+        idx->shard->flags |= SIRIDB_SHARD_IS_CORRUPT;
+    }
+    return -1;
+}
+
 /*
  * Returns 0 when successful or a negative value in case of an error.
  */
@@ -1783,26 +2204,17 @@ static ssize_t SHARD_apply_idx(
     len = *((uint16_t *) (pt + (is_ts64 ? 20 : 12)));  /* LEN POS IN INDEX  */
     series = imap_get(siridb->series_map, series_id);
 
-    if (shard->tp == SIRIDB_SHARD_TP_LOG)
+    if (    shard->tp == SIRIDB_SHARD_TP_LOG ||
+            (shard->flags & SIRIDB_SHARD_IS_COMPRESSED))
     {
         cinfo = *((uint16_t *)(pt + (is_ts64 ? IDX64_SZ : IDX32_SZ)));
-        size = (ssize_t) siridb_points_get_size_log(cinfo);
-        size += len * (
-                shard->flags & SIRIDB_SHARD_IS_COMPRESSED ?
-                        (len < POINTS_ZIP_THRESHOLD ?
-                                sizeof(uint64_t) :
-                                0) : is_ts64 ?
-                                        sizeof(uint64_t) :
-                                        sizeof(uint32_t));
     }
-    else if (shard->flags & SIRIDB_SHARD_IS_COMPRESSED)
-    {
-        cinfo = *((uint16_t *)(pt + (is_ts64 ? IDX64_SZ : IDX32_SZ)));
-        size = (ssize_t) siridb_points_get_size_zipped(cinfo, len);
-    }
-    else
+
+    size = (ssize_t) SHARD_chunk_size(shard, len, cinfo, is_ts64);
+
+    if (SHARD_has_crc(shard))
     {
-        size = len * (is_ts64 ? 16 : 12);
+        size += CRC_SZ;
     }
 
     if (series == NULL)
@@ -1874,7 +2286,7 @@ static ssize_t SHARD_apply_idx(
                 cinfo) == 0)
         {
             /* update the series length property */
-            series->length += len;
+            siridb_series_length_add(series, len);
         }
         else
         {
@@ -2041,24 +2453,148 @@ static inline int SHARD_init_fn(siridb_t * siridb, siridb_shard_t * shard)
 }
 
 /*
- * Write a header for a chunk of points. The header can be written to argument
- * fp which should be a pointer to the index, or the shard file.
+ * Write the chunks in the shard write buffer at the position which is
+ * reserved for them. The write buffer is empty after this call.
  *
- * In case of an error the function returns 0, otherwise the size which is
- * written.
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
  */
-static size_t SHARD_write_header(
+static int SHARD_wbuf_flush(siridb_shard_t * shard)
+{
+    FILE * fp;
+    char buf[1024];
+
+    if (!shard->wbuf_len)
+    {
+        return 0;
+    }
+
+    if (shard->fp->fp == NULL &&
+        siri_fopen(siri.fh, shard->fp, shard->fn, "r+"))
+    {
+        log_critical("Cannot open file '%s' (%s)",
+                shard->fn, strerror_r(errno, buf, 1024));
+        ERR_FILE
+        return -1;
+    }
+    fp = shard->fp->fp;
+
+    if (shard->len > SHARD_GROW_SZ && shard->len + 64 > shard->size)
+    {
+        SHARD_grow(shard);
+    }
+
+    if (fseeko(fp, shard->len - shard->wbuf_len, SEEK_SET) ||
+        fwrite(shard->wbuf, shard->wbuf_len, 1, fp) != 1 ||
+        fflush(fp))
+    {
+        log_critical("Cannot write points to file '%s' (%s)",
+                shard->fn, strerror_r(errno, buf, 1024));
+        ERR_FILE
+        return -1;
+    }
+
+    shard->wbuf_len = 0;
+    return 0;
+}
+
+/*
+ * Add a chunk with header and checksum to the shard write buffer. The write
+ * buffer is written first when the chunk does not fit within
+ * SHARD_WBUF_MAX_SZ.
+ *
+ * Returns the position of the chunk data in the shard or 0 in case of an
+ * error. (a SIGNAL is raised in case of an error)
+ */
+static size_t SHARD_wbuf_append(
         siridb_t * siridb,
         siridb_series_t * series,
+        siridb_shard_t * shard,
         siridb_points_t * points,
         uint_fast32_t start,
         uint_fast32_t end,
         uint16_t * cinfo,
-        FILE * fp)
+        unsigned char * cdata,
+        size_t dsize,
+        uint32_t * crc)
+{
+    char header[24];
+    char * pt;
+    size_t pos, n;
+    size_t crc_sz = (crc == NULL) ? 0 : CRC_SZ;
+    size_t header_sz = SHARD_pack_header(
+            siridb,
+            series,
+            points,
+            start,
+            end,
+            cinfo,
+            header);
+
+    n = header_sz + dsize + crc_sz;
+
+    if (    shard->wbuf_len &&
+            shard->wbuf_len + n > SHARD_WBUF_MAX_SZ &&
+            SHARD_wbuf_flush(shard))
+    {
+        return 0;  /* signal is raised */
+    }
+
+    if (shard->wbuf_len + n > shard->wbuf_sz)
+    {
+        size_t sz = shard->wbuf_sz;
+
+        while (shard->wbuf_len + n > sz)
+        {
+            sz <<= 1;
+        }
+
+        pt = realloc(shard->wbuf, sz);
+        if (pt == NULL)
+        {
+            ERR_ALLOC
+            return 0;
+        }
+        shard->wbuf = pt;
+        shard->wbuf_sz = sz;
+    }
+
+    pt = shard->wbuf + shard->wbuf_len;
+    memcpy(pt, header, header_sz);
+    memcpy(pt + header_sz, cdata, dsize);
+    if (crc_sz)
+    {
+        memcpy(pt + header_sz + dsize, crc, crc_sz);
+    }
+    shard->wbuf_len += n;
+
+    pos = shard->len + header_sz;
+
+    if ((~shard->flags & SIRIDB_SHARD_IS_REMOVED) && !shard->replaced)
+    {
+        siridb_shards_size_add(siridb, shard->tp, n);
+    }
+
+    shard->len += n;
+    return pos;
+}
+
+/*
+ * Pack a header for a chunk of points into the given buffer which must have
+ * room for at least 24 bytes.
+ *
+ * Returns the size of the header.
+ */
+static size_t SHARD_pack_header(
+        siridb_t * siridb,
+        siridb_series_t * series,
+        siridb_points_t * points,
+        uint_fast32_t start,
+        uint_fast32_t end,
+        uint16_t * cinfo,
+        char * buf)
 {
     uint16_t len = end - start;
     size_t size = sizeof(uint32_t);
-    char buf[24];
     memcpy(buf, &series->id, sizeof(uint32_t));
 
     switch (siridb->time->ts_sz)
@@ -2095,6 +2631,35 @@ static size_t SHARD_write_header(
         size += sizeof(uint16_t);
     }
 
+    return size;
+}
+
+/*
+ * Write a header for a chunk of points. The header can be written to argument
+ * fp which should be a pointer to the index, or the shard file.
+ *
+ * In case of an error the function returns 0, otherwise the size which is
+ * written.
+ */
+static size_t SHARD_write_header(
+        siridb_t * siridb,
+        siridb_series_t * series,
+        siridb_points_t * points,
+        uint_fast32_t start,
+        uint_fast32_t end,
+        uint16_t * cinfo,
+        FILE * fp)
+{
+    char buf[24];
+    size_t size = SHARD_pack_header(
+            siridb,
+            series,
+            points,
+            start,
+            end,
+            cinfo,
+            buf);
+
     if (fwrite(buf, size, 1, fp) != 1)
     {
         return 0;
@@ -2126,3 +2691,265 @@ static int SHARD_grow(siridb_shard_t * shard)
 
     return 0;
 }
+
+static int SHARD_plan_cmp(const void * a, const void * b)
+{
+    size_t pa = ((const SHARD_plan_t *) a)->pos;
+    size_t pb = ((const SHARD_plan_t *) b)->pos;
+    return (pa > pb) - (pa < pb);
+}
+
+static int SHARD_range_cmp(const void * a, const void * b)
+{
+    size_t pa = ((const SHARD_range_t *) a)->pos;
+    size_t pb = ((const SHARD_range_t *) b)->pos;
+    return (pa > pb) - (pa < pb);
+}
+
+/*
+ * Returns a plan with the series in vec which have chunks in the given shard,
+ * ordered by the position of their first chunk. The number of series in the
+ * plan is set to n. The series are not referenced by the plan.
+ *
+ * This function must be called while holding the series_mutex.
+ *
+ * Returns NULL in case of an allocation error.
+ */
+static SHARD_plan_t * SHARD_optimize_plan(
+        siridb_shard_t * shard,
+        vec_t * vec,
+        size_t * n)
+{
+    SHARD_plan_t * plan = malloc(sizeof(SHARD_plan_t) * (vec->len + 1));
+    siridb_series_t * series;
+    idx_t * idx;
+    size_t i, pos;
+    uint_fast32_t j;
+
+    if (plan == NULL)
+    {
+        return NULL;
+    }
+
+    *n = 0;
+
+    for (i = 0; i < vec->len; i++)
+    {
+        series = vec->data[i];
+
+        if (    shard->id % shard->duration != series->mask ||
+                (series->flags & SIRIDB_SERIES_IS_DROPPED))
+        {
+            continue;
+        }
+
+        pos = SIZE_MAX;
+
+        for (j = 0, idx = series->idx; j < series->idx_len; j++, idx++)
+        {
+            if (idx->shard == shard && idx->pos < pos)
+            {
+                pos = idx->pos;
+            }
+        }
+
+        if (pos != SIZE_MAX)
+        {
+            plan[*n].series = series;
+            plan[*n].pos = pos;
+            (*n)++;
+        }
+    }
+
+    qsort(plan, *n, sizeof(SHARD_plan_t), SHARD_plan_cmp);
+
+    return plan;
+}
+
+/*
+ * Ask the kernel to read the chunks for the series in the plan starting at
+ * start, until at least SHARD_OPTIMIZE_READ_SZ bytes of chunk data are
+ * included. Chunks are sorted by position and close chunks are merged so
+ * the shard is read sequentially in large blocks. Nothing is read ahead
+ * when fd is -1 or in case of an allocation error.
+ *
+ * This function must be called while holding the series_mutex.
+ *
+ * Returns the end of the read ahead group in the plan.
+ */
+static size_t SHARD_optimize_readahead(
+        siridb_shard_t * shard,
+        SHARD_plan_t * plan,
+        size_t start,
+        size_t n,
+        int fd)
+{
+    siridb_series_t * series;
+    SHARD_range_t * ranges = NULL, * tmp, * range;
+    size_t i, k, size, total = 0, num = 0, sz = 0;
+    size_t crc_sz = SHARD_has_crc(shard) ? CRC_SZ : 0;
+    idx_t * idx;
+    uint_fast32_t j;
+
+    for (   i = start;
+            i < n && (i == start || total < SHARD_OPTIMIZE_READ_SZ);
+            i++)
+    {
+        series = plan[i].series;
+
+        if (series->flags & SIRIDB_SERIES_IS_DROPPED)
+        {
+            continue;
+        }
+
+        for (j = 0, idx = series->idx; j < series->idx_len; j++, idx++)
+        {
+            if (idx->shard != shard)
+            {
+                continue;
+            }
+
+            size = SHARD_chunk_size(
+                    shard,
+                    idx->len,
+                    idx->cinfo,
+                    !(series->flags & SIRIDB_SERIES_IS_32BIT_TS)) + crc_sz;
+            total += size;
+
+            if (fd == -1)
+            {
+                continue;
+            }
+
+            if (num == sz)
+            {
+                sz = sz ? sz << 1 : 64;
+                tmp = realloc(ranges, sizeof(SHARD_range_t) * sz);
+                if (tmp == NULL)
+                {
+                    /* read ahead is only a hint */
+                    fd = -1;
+                    continue;
+                }
+                ranges = tmp;
+            }
+
+            ranges[num].pos = idx->pos;
+            ranges[num].end = idx->pos + size;
+            num++;
+        }
+    }
+
+    if (fd != -1 && num)
+    {
+        qsort(ranges, num, sizeof(SHARD_range_t), SHARD_range_cmp);
+
+        for (k = 1, range = ranges; k <= num; k++)
+        {
+            if (k < num && ranges[k].pos <= range->end + SHARD_OPTIMIZE_GAP_SZ)
+            {
+                if (ranges[k].end > range->end)
+                {
+                    range->end = ranges[k].end;
+                }
+                continue;
+            }
+
+            (void) posix_fadvise(
+                    fd,
+                    range->pos,
+                    range->end - range->pos,
+                    POSIX_FADV_WILLNEED);
+
+            if (k < num)
+            {
+                range = ranges + k;
+            }
+        }
+    }
+
+    free(ranges);
+
+    return i;
+}
+
+/*
+ * Write the pages of a new shard up to len to disk and drop them from the
+ * page cache, so optimize does not fill the cache with shard data which is
+ * not queried. Dirty pages cannot be dropped, hence the sync. The position
+ * up to where pages are dropped is set to dropped.
+ *
+ * This function should be called without holding a lock.
+ */
+static void SHARD_optimize_drop_written(int fd, size_t * dropped, size_t len)
+{
+    if (len > *dropped && fdatasync(fd) == 0)
+    {
+        (void) posix_fadvise(
+                fd,
+                *dropped,
+                len - *dropped,
+                POSIX_FADV_DONTNEED);
+        *dropped = len;
+    }
+}
+
+/*
+ * Ask the kernel to read the given chunks of a series, so the chunks are
+ * read in parallel and close chunks in the same shard are read using a
+ * single read. The indexes are positions in series->idx, in order. Nothing
+ * happens when read ahead for selects is disabled or for a single chunk.
+ *
+ * This function must be called while holding the series_mutex.
+ */
+void siridb_shard_read_ahead(
+        siridb_series_t * series,
+        uint32_t * indexes,
+        size_t len)
+{
+    idx_t * idx;
+    siridb_shard_t * shard = NULL;
+    size_t i, pos = 0, end = 0, size;
+    int is_ts64 = !(series->flags & SIRIDB_SERIES_IS_32BIT_TS);
+
+    if (!siri.cfg->select_read_ahead || len < 2)
+    {
+        return;
+    }
+
+    for (i = 0; i <= len; i++)
+    {
+        idx = (i < len) ? series->idx + indexes[i] : NULL;
+
+        if (    idx != NULL &&
+                idx->shard == shard &&
+                idx->pos >= pos &&
+                idx->pos <= end + SHARD_OPTIMIZE_GAP_SZ)
+        {
+            size = SHARD_chunk_size(shard, idx->len, idx->cinfo, is_ts64);
+            if (idx->pos + size > end)
+            {
+                end = idx->pos + size;
+            }
+            continue;
+        }
+
+        if (shard != NULL && (
+                shard->fp->fp != NULL ||
+                siri_fopen(siri.fh, shard->fp, shard->fn, "r+") == 0))
+        {
+            (void) posix_fadvise(
+                    fileno(shard->fp->fp),
+                    pos,
+                    end - pos,
+                    POSIX_FADV_WILLNEED);
+        }
+
+        if (idx != NULL)
+        {
+            shard = idx->shard;
+            pos = idx->pos;
+            end = pos + SHARD_chunk_size(shard, idx->len, idx->cinfo, is_ts64);
+        }
+    }
+}
@@ -265,7 +265,8 @@ void siridb_shards_destroy_cb(omap_t * shards)
 int siridb_shards_add_points(
         siridb_t * siridb,
         siridb_series_t * series,
-        siridb_points_t * points)
+        siridb_points_t * points,
+        vec_t ** batch)
 {
     bool is_num = siridb_series_isnum(series);
     siridb_shard_t * shard;
@@ -309,7 +310,7 @@ int siridb_shards_add_points(
 
         if (shard_end < expire_at)
         {
-            series->length -= end - start;
+            siridb_series_length_sub(series, end - start);
             series_update_start_end(series);
             continue;
         }
@@ -348,6 +349,21 @@ int siridb_shards_add_points(
 
         if (start != end)
         {
+            if (batch != NULL && shard->wbuf == NULL)
+            {
+                if (vec_append_safe(batch, shard))
+                {
+                    ERR_ALLOC
+                    return -1;
+                }
+                if (siridb_shard_wbuf_start(shard))
+                {
+                    --(*batch)->len;
+                    return -1;  /* signal is raised */
+                }
+                siridb_shard_incref(shard);
+            }
+
             size = end - start;
 
             num_chunks = (size - 1) / shard->max_chunk_sz + 1;
@@ -404,6 +420,31 @@ int siridb_shards_add_points(
     return siri_err;
 }
 
+/*
+ * Write the chunks which are collected by siridb_shards_add_points() using
+ * a batch. Each shard in the batch is written using a single write and the
+ * batch is empty after this call.
+ *
+ * Returns 0 if successful; -1 and a SIGNAL is raised in case an error occurred.
+ */
+int siridb_shards_write_batch(vec_t * batch)
+{
+    int rc = 0;
+    siridb_shard_t * shard;
+
+    while (batch->len)
+    {
+        shard = (siridb_shard_t *) vec_pop(batch);
+        if (siridb_shard_wbuf_write(shard))
+        {
+            rc = -1;  /* signal is raised */
+        }
+        siridb_shard_decref(shard);
+    }
+
+    return rc;
+}
+
 static inline int SHARDS_count_cb(omap_t * omap, size_t * n)
 {
     *n += omap->n;
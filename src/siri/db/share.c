@@ -0,0 +1,391 @@
+/*
+ * share.c - Share decoded chunks between concurrent select queries.
+ *
+ * When multiple select queries are running at the same time, for example
+ * when dashboards refresh at the same moment, they usually read the same
+ * chunks. Each select query is registered as a reader and while there are at
+ * least two readers, a chunk is read and decoded only once; the decoded
+ * chunk is kept by shard and position so the other running queries can use
+ * the chunk instead of reading and decoding it again.
+ *
+ * Each select query gets a generation when it starts and a chunk remembers
+ * the last generation at the moment it was used. When a query leaves, the
+ * chunks which are last used before the oldest running query has started
+ * are released, since all queries which could use them are finished. All
+ * chunks are released as soon as less than two select queries are running,
+ * so this is not a cache and nothing is kept when queries run one at a time.
+ *
+ * Chunks are never changed after they are written to a shard. A chunk holds
+ * a reference to the shard so the shard and position cannot be re-used as
+ * long as the chunk exists. Only numeric series are shared since string
+ * points own their values.
+ *
+ * The registry is only used from the main thread.
+ */
+#include <logger/logger.h>
+#include <siri/db/share.h>
+#include <siri/db/shard.h>
+#include <stdlib.h>
+
+typedef struct
+{
+    siridb_shard_t * shard;
+    uint32_t pos;
+    uint16_t len;
+    uint64_t used;          /* share generation when last used */
+    siridb_points_t * points;
+} SHARE_chunk_t;
+
+typedef struct
+{
+    uint64_t oldest;
+    vec_t * keys;
+} SHARE_evict_t;
+
+static siridb_points_t * SHARE_read(
+        siridb_share_t * share,
+        siridb_series_t * series,
+        idx_t * idx,
+        uint8_t * is_shared);
+static void SHARE_add_points(
+        siridb_points_t * points,
+        siridb_points_t * chunk,
+        idx_t * idx,
+        uint64_t * start_ts,
+        uint64_t * end_ts,
+        uint8_t has_overlap);
+static void SHARE_chunk_free(SHARE_chunk_t * chunk);
+static void SHARE_clear(siridb_share_t * share);
+static void SHARE_evict(siridb_share_t * share);
+
+static inline uint64_t SHARE_key(siridb_shard_t * shard, uint32_t pos)
+{
+    return (shard->id * 0x9E3779B97F4A7C15ULL) ^ pos;
+}
+
+/*
+ * Returns NULL in case of an allocation error.
+ */
+siridb_share_t * siridb_share_new(void)
+{
+    siridb_share_t * share = malloc(sizeof(siridb_share_t));
+    if (share == NULL)
+    {
+        return NULL;
+    }
+
+    share->readers = 0;
+    share->npoints = 0;
+    share->gen = 0;
+    share->active = vec_new(VEC_DEFAULT_SIZE);
+    share->chunks = imap_new();
+
+    if (share->active == NULL || share->chunks == NULL)
+    {
+        vec_free(share->active);
+        if (share->chunks != NULL)
+        {
+            imap_free(share->chunks, NULL);
+        }
+        free(share);
+        return NULL;
+    }
+
+    return share;
+}
+
+void siridb_share_free(siridb_share_t * share)
+{
+    imap_free(share->chunks, (imap_free_cb) SHARE_chunk_free);
+    vec_free(share->active);
+    free(share);
+}
+
+/*
+ * Register a running select query.
+ *
+ * Returns the generation for the query which must be used to leave.
+ */
+uint64_t siridb_share_enter(siridb_share_t * share)
+{
+    uint64_t gen = ++share->gen;
+
+    share->readers++;
+
+    if (vec_append_safe(&share->active, (void *) gen))
+    {
+        /* without the generation, chunks are only released by a clear */
+        log_error("Cannot register a select query for sharing chunks");
+    }
+
+    return gen;
+}
+
+/*
+ * Unregister a select query. Decoded chunks which cannot be used by the
+ * running select queries are released, and all chunks are released when
+ * less than two select queries are running.
+ */
+void siridb_share_leave(siridb_share_t * share, uint64_t gen)
+{
+    size_t i;
+
+    for (i = 0; i < share->active->len; i++)
+    {
+        if ((uint64_t) share->active->data[i] == gen)
+        {
+            share->active->data[i] = vec_pop(share->active);
+            break;
+        }
+    }
+
+    if (!share->npoints)
+    {
+        --share->readers;
+    }
+    else if (--share->readers < 2)
+    {
+        SHARE_clear(share);
+    }
+    else
+    {
+        SHARE_evict(share);
+    }
+}
+
+/*
+ * Add the points of a chunk to points, like the shard get points call-back
+ * does. The decoded chunk is shared with other running select queries when
+ * possible.
+ *
+ * Returns 0 if successful or -1 in case of an error. (errors are logged)
+ */
+int siridb_share_get_points(
+        siridb_share_t * share,
+        siridb_points_t * points,
+        siridb_series_t * series,
+        idx_t * idx,
+        uint64_t * start_ts,
+        uint64_t * end_ts)
+{
+    uint8_t has_overlap = series->flags & SIRIDB_SERIES_HAS_OVERLAP;
+    SHARE_chunk_t * chunk;
+    siridb_points_t * cpoints;
+    uint8_t is_shared = 1;
+
+    if (share->readers < 2 || series->tp == TP_STRING)
+    {
+        return siridb_shard_get_points_callback(idx->shard->flags, series)(
+                points,
+                idx,
+                start_ts,
+                end_ts,
+                has_overlap);
+    }
+
+    chunk = imap_get(share->chunks, SHARE_key(idx->shard, idx->pos));
+
+    if (    chunk != NULL &&
+            chunk->shard == idx->shard &&
+            chunk->pos == idx->pos &&
+            chunk->len == idx->len)
+    {
+        chunk->used = share->gen;
+        cpoints = chunk->points;
+    }
+    else
+    {
+        cpoints = SHARE_read(share, series, idx, &is_shared);
+    }
+
+    if (cpoints == NULL)
+    {
+        return -1;
+    }
+
+    SHARE_add_points(points, cpoints, idx, start_ts, end_ts, has_overlap);
+
+    if (!is_shared)
+    {
+        siridb_points_free(cpoints);
+    }
+
+    return 0;
+}
+
+/*
+ * Read and decode a complete chunk and store the chunk for sharing as long
+ * as SIRIDB_SHARE_MAX_POINTS is not reached. When the chunk is not stored,
+ * is_shared is set to 0 and the caller must free the returned points.
+ *
+ * Returns the decoded points or NULL in case of an error.
+ */
+static siridb_points_t * SHARE_read(
+        siridb_share_t * share,
+        siridb_series_t * series,
+        idx_t * idx,
+        uint8_t * is_shared)
+{
+    uint64_t key = SHARE_key(idx->shard, idx->pos);
+    siridb_points_t * points = siridb_points_new(idx->len, series->tp);
+    SHARE_chunk_t * chunk;
+
+    if (points == NULL)
+    {
+        log_critical("Memory allocation error");
+        return NULL;
+    }
+
+    if (siridb_shard_get_points_callback(idx->shard->flags, series)(
+            points,
+            idx,
+            NULL,
+            NULL,
+            0))
+    {
+        siridb_points_free(points);
+        return NULL;
+    }
+
+    *is_shared = 0;
+
+    if (    share->npoints + points->len > SIRIDB_SHARE_MAX_POINTS ||
+            imap_get(share->chunks, key) != NULL ||
+            (chunk = malloc(sizeof(SHARE_chunk_t))) == NULL)
+    {
+        return points;
+    }
+
+    chunk->shard = idx->shard;
+    chunk->pos = idx->pos;
+    chunk->len = idx->len;
+    chunk->used = share->gen;
+    chunk->points = points;
+
+    if (imap_add(share->chunks, key, chunk))
+    {
+        free(chunk);
+        return points;
+    }
+
+    siridb_shard_incref(chunk->shard);
+    share->npoints += points->len;
+    *is_shared = 1;
+
+    return points;
+}
+
+/*
+ * Add the points of a decoded chunk within the time range to points. Points
+ * must be large enough to hold the chunk.
+ */
+static void SHARE_add_points(
+        siridb_points_t * points,
+        siridb_points_t * chunk,
+        idx_t * idx,
+        uint64_t * start_ts,
+        uint64_t * end_ts,
+        uint8_t has_overlap)
+{
+    siridb_point_t * pt = chunk->data;
+    siridb_point_t * end = chunk->data + chunk->len;
+
+    /* crop from start if needed */
+    if (start_ts != NULL)
+    {
+        for (; pt < end && pt->ts < *start_ts; pt++);
+    }
+
+    /* crop from end if needed */
+    if (end_ts != NULL)
+    {
+        for (; end > pt && (end - 1)->ts >= *end_ts; end--);
+    }
+
+    if (    has_overlap &&
+            points->len &&
+            (idx->shard->flags & SIRIDB_SHARD_HAS_OVERLAP))
+    {
+        for (; pt < end; pt++)
+        {
+            siridb_points_add_point(points, &pt->ts, &pt->val);
+        }
+    }
+    else
+    {
+        for (; pt < end; pt++, points->len++)
+        {
+            points->data[points->len] = *pt;
+        }
+    }
+}
+
+static void SHARE_chunk_free(SHARE_chunk_t * chunk)
+{
+    siridb_shard_decref(chunk->shard);
+    siridb_points_free(chunk->points);
+    free(chunk);
+}
+
+static void SHARE_clear(siridb_share_t * share)
+{
+    imap_t * chunks = imap_new();
+
+    if (chunks == NULL)
+    {
+        /* keep the chunks, they are released with the next leave */
+        log_error("Cannot release the shared chunks");
+        return;
+    }
+
+    imap_free(share->chunks, (imap_free_cb) SHARE_chunk_free);
+    share->chunks = chunks;
+    share->npoints = 0;
+}
+
+static int SHARE_evict_cb(SHARE_chunk_t * chunk, SHARE_evict_t * evict)
+{
+    return (chunk->used < evict->oldest && vec_append_safe(
+            &evict->keys,
+            (void *) SHARE_key(chunk->shard, chunk->pos))) ? -1 : 0;
+}
+
+/*
+ * Release the chunks which are last used before the oldest running select
+ * query has started. Those chunks are only used by finished queries.
+ */
+static void SHARE_evict(siridb_share_t * share)
+{
+    SHARE_evict_t evict;
+    SHARE_chunk_t * chunk;
+    size_t i;
+
+    evict.oldest = share->gen;
+    for (i = 0; i < share->active->len; i++)
+    {
+        if ((uint64_t) share->active->data[i] < evict.oldest)
+        {
+            evict.oldest = (uint64_t) share->active->data[i];
+        }
+    }
+
+    evict.keys = vec_new(VEC_DEFAULT_SIZE);
+    if (evict.keys == NULL)
+    {
+        return;  /* chunks are released with the next leave */
+    }
+
+    (void) imap_walk(share->chunks, (imap_cb) SHARE_evict_cb, &evict);
+
+    for (i = 0; i < evict.keys->len; i++)
+    {
+        chunk = imap_pop(share->chunks, (uint64_t) evict.keys->data[i]);
+        if (chunk != NULL)
+        {
+            share->npoints -= chunk->points->len;
+            SHARE_chunk_free(chunk);
+        }
+    }
+
+    vec_free(evict.keys);
+}
@@ -0,0 +1,711 @@
+/*
+ * subscriptions.c - Push new points to subscribed clients.
+ *
+ * A client can subscribe to a series name, regular expression, tag or group.
+ * Each subscription has a bit in the 'subs' field of a series so the insert
+ * path only has to check this field for each series. Bits are set when the
+ * subscription is created, when a new series is created and when series are
+ * tagged or untagged. A client can use at most SIRIDB_SUBSCRIPTIONS_MAX_CLIENT
+ * subscriptions so a single client cannot take all of them.
+ *
+ * Points are collected per subscription while an insert package is handled
+ * and are pushed to the client when the package is processed. Points are
+ * dropped when too much data is waiting to be sent to the client; the next
+ * push package contains the number of dropped points.
+ *
+ * Only points for series on 'this' server are pushed. Subscriptions are only
+ * used from the main thread.
+ */
+#include <assert.h>
+#include <logger/logger.h>
+#include <siri/db/group.h>
+#include <siri/db/groups.h>
+#include <siri/db/re.h>
+#include <siri/db/subscriptions.h>
+#include <siri/db/tags.h>
+#include <siri/err.h>
+#include <siri/net/pkg.h>
+#include <siri/net/protocol.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SUBSCRIPTIONS_PACKER_SIZE 8192
+
+static int SUBSCRIPTIONS_test(
+        siridb_subscription_t * sub,
+        siridb_series_t * series);
+static int SUBSCRIPTIONS_set_cb(
+        siridb_series_t * series,
+        siridb_subscription_t * sub);
+static int SUBSCRIPTIONS_tag_cb(
+        siridb_series_t * series,
+        siridb_subscription_t * sub);
+static int SUBSCRIPTIONS_clear_cb(
+        siridb_series_t * series,
+        siridb_subscription_t * sub);
+static void SUBSCRIPTIONS_drop(
+        siridb_t * siridb,
+        siridb_subscription_t * sub);
+static qp_packer_t * SUBSCRIPTIONS_packer(
+        siridb_subscriptions_t * subscriptions,
+        siridb_subscription_t * sub,
+        siridb_series_t * series,
+        size_t n);
+static void SUBSCRIPTIONS_free(siridb_subscription_t * sub);
+
+static inline int64_t SUBSCRIPTIONS_ts(uint64_t ts, double factor)
+{
+    return (int64_t) (factor ? (uint64_t) (ts * factor) : ts);
+}
+
+/*
+ * Returns NULL in case of an allocation error.
+ */
+siridb_subscriptions_t * siridb_subscriptions_new(void)
+{
+    siridb_subscriptions_t * subscriptions =
+            calloc(1, sizeof(siridb_subscriptions_t));
+    return subscriptions;
+}
+
+void siridb_subscriptions_free(siridb_subscriptions_t * subscriptions)
+{
+    uint16_t i;
+    for (i = 0; i < SIRIDB_SUBSCRIPTIONS_MAX; i++)
+    {
+        if (subscriptions->subs[i] != NULL)
+        {
+            SUBSCRIPTIONS_free(subscriptions->subs[i]);
+        }
+    }
+    free(subscriptions);
+}
+
+/*
+ * Returns the subscription id if successful or -1 in case of an error.
+ * In case of an error, err_msg is set and a SIGNAL is raised when the error
+ * is caused by an allocation error.
+ */
+int siridb_subscriptions_subscribe(
+        siridb_t * siridb,
+        sirinet_stream_t * client,
+        siridb_subscription_tp tp,
+        const char * expr,
+        size_t len,
+        double factor,
+        char * err_msg)
+{
+    siridb_subscriptions_t * subscriptions = siridb->subscriptions;
+    siridb_subscription_t * sub;
+    siridb_tag_t * tag;
+    siridb_group_t * group;
+    char * source = NULL;
+    uint64_t used = subscriptions->used;
+    uint16_t id, n = 0;
+
+    if (used == UINT64_MAX)
+    {
+        snprintf(err_msg,
+                SIRIDB_MAX_SIZE_ERR_MSG,
+                "Maximum number of subscriptions reached (%d).",
+                SIRIDB_SUBSCRIPTIONS_MAX);
+        return -1;
+    }
+
+    /* a single client cannot take all subscriptions */
+    while (used)
+    {
+        id = __builtin_ctzll(used);
+        used &= used - 1;
+        n += subscriptions->subs[id]->client == client;
+    }
+
+    if (n >= SIRIDB_SUBSCRIPTIONS_MAX_CLIENT)
+    {
+        snprintf(err_msg,
+                SIRIDB_MAX_SIZE_ERR_MSG,
+                "Maximum number of subscriptions for a client reached (%d).",
+                SIRIDB_SUBSCRIPTIONS_MAX_CLIENT);
+        return -1;
+    }
+
+    for (id = 0; subscriptions->used & (1ULL << id); id++);
+
+    sub = malloc(sizeof(siridb_subscription_t));
+    if (sub == NULL || (sub->expr = strndup(expr, len)) == NULL)
+    {
+        ERR_ALLOC
+        free(sub);
+        sprintf(err_msg, "Memory allocation error.");
+        return -1;
+    }
+
+    sub->id = id;
+    sub->tp = tp;
+    sub->is_full = 0;
+    sub->factor = factor;
+    sub->tag_id = 0;
+    sub->dropped = 0;
+    sub->regex = NULL;
+    sub->match_data = NULL;
+    sub->client = client;
+    sub->packer = NULL;
+
+    switch (tp)
+    {
+    case SUBSCRIPTION_SERIES:
+        break;
+    case SUBSCRIPTION_REGEX:
+        if (siridb_re_compile(
+                &sub->regex,
+                &sub->match_data,
+                expr,
+                len,
+                err_msg))
+        {
+            SUBSCRIPTIONS_free(sub);
+            return -1;
+        }
+        break;
+    case SUBSCRIPTION_TAG:
+        uv_mutex_lock(&siridb->tags->mutex);
+
+        tag = ct_get(siridb->tags->tags, sub->expr);
+        if (tag != NULL)
+        {
+            sub->tag_id = tag->id;
+            (void) imap_walk(
+                    tag->series,
+                    (imap_cb) SUBSCRIPTIONS_tag_cb,
+                    sub);
+        }
+
+        uv_mutex_unlock(&siridb->tags->mutex);
+
+        if (tag == NULL)
+        {
+            snprintf(err_msg,
+                    SIRIDB_MAX_SIZE_ERR_MSG,
+                    "Cannot find tag: '%s'",
+                    sub->expr);
+            SUBSCRIPTIONS_free(sub);
+            return -1;
+        }
+        break;
+    case SUBSCRIPTION_GROUP:
+        uv_mutex_lock(&siridb->groups->mutex);
+
+        group = ct_get(siridb->groups->groups, sub->expr);
+        if (group != NULL && (source = strdup(group->source)) == NULL)
+        {
+            ERR_ALLOC
+        }
+
+        uv_mutex_unlock(&siridb->groups->mutex);
+
+        if (source == NULL)
+        {
+            snprintf(err_msg,
+                    SIRIDB_MAX_SIZE_ERR_MSG,
+                    "Cannot find group: '%s'",
+                    sub->expr);
+            SUBSCRIPTIONS_free(sub);
+            return -1;
+        }
+
+        /* the group can change so we use a copy of the expression */
+        if (siridb_re_compile(
+                &sub->regex,
+                &sub->match_data,
+                source,
+                strlen(source),
+                err_msg))
+        {
+            free(source);
+            SUBSCRIPTIONS_free(sub);
+            return -1;
+        }
+        free(source);
+        break;
+    default:
+        assert (0);
+    }
+
+    subscriptions->subs[id] = sub;
+    subscriptions->used |= 1ULL << id;
+
+    if (tp != SUBSCRIPTION_TAG)
+    {
+        uv_mutex_lock(&siridb->series_mutex);
+
+        (void) imap_walk(
+                siridb->series_map,
+                (imap_cb) SUBSCRIPTIONS_set_cb,
+                sub);
+
+        uv_mutex_unlock(&siridb->series_mutex);
+    }
+
+    log_debug("New subscription (id: %u) for '%s'", id, sub->expr);
+
+    return id;
+}
+
+/*
+ * Returns 0 if successful or -1 when the client has no subscription with
+ * the given id.
+ */
+int siridb_subscriptions_unsubscribe(
+        siridb_t * siridb,
+        sirinet_stream_t * client,
+        uint16_t id)
+{
+    siridb_subscription_t * sub = (id < SIRIDB_SUBSCRIPTIONS_MAX) ?
+            siridb->subscriptions->subs[id] : NULL;
+
+    if (sub == NULL || sub->client != client)
+    {
+        return -1;
+    }
+
+    SUBSCRIPTIONS_drop(siridb, sub);
+    return 0;
+}
+
+/*
+ * Remove all subscriptions for a client. Must be called before the client
+ * is destroyed.
+ */
+void siridb_subscriptions_drop_client(
+        siridb_t * siridb,
+        sirinet_stream_t * client)
+{
+    siridb_subscriptions_t * subscriptions = siridb->subscriptions;
+    siridb_subscription_t * sub;
+    uint16_t i;
+
+    for (i = 0; subscriptions->used && i < SIRIDB_SUBSCRIPTIONS_MAX; i++)
+    {
+        sub = subscriptions->subs[i];
+        if (sub != NULL && sub->client == client)
+        {
+            SUBSCRIPTIONS_drop(siridb, sub);
+        }
+    }
+}
+
+/*
+ * Returns the subscription bits for a new series.
+ */
+uint64_t siridb_subscriptions_match(
+        siridb_subscriptions_t * subscriptions,
+        siridb_series_t * series)
+{
+    uint64_t subs = 0;
+    uint64_t used = subscriptions->used;
+    uint16_t i;
+
+    while (used)
+    {
+        i = __builtin_ctzll(used);
+        used &= used - 1;
+
+        if (SUBSCRIPTIONS_test(subscriptions->subs[i], series))
+        {
+            subs |= 1ULL << i;
+        }
+    }
+    return subs;
+}
+
+/*
+ * Must be called when a series is added to a tag.
+ */
+void siridb_subscriptions_tag(
+        siridb_subscriptions_t * subscriptions,
+        siridb_tag_t * tag,
+        siridb_series_t * series)
+{
+    siridb_subscription_t * sub;
+    uint64_t used = subscriptions->used;
+    uint16_t i;
+
+    while (used)
+    {
+        i = __builtin_ctzll(used);
+        used &= used - 1;
+
+        sub = subscriptions->subs[i];
+        if (sub->tp == SUBSCRIPTION_TAG && sub->tag_id == tag->id)
+        {
+            series->subs |= 1ULL << i;
+        }
+    }
+}
+
+/*
+ * Must be called when a series is removed from a tag.
+ */
+void siridb_subscriptions_untag(
+        siridb_subscriptions_t * subscriptions,
+        siridb_tag_t * tag,
+        siridb_series_t * series)
+{
+    siridb_subscription_t * sub;
+    uint64_t used = series->subs & subscriptions->used;
+    uint16_t i;
+
+    while (used)
+    {
+        i = __builtin_ctzll(used);
+        used &= used - 1;
+
+        sub = subscriptions->subs[i];
+        if (sub->tp == SUBSCRIPTION_TAG && sub->tag_id == tag->id)
+        {
+            series->subs &= ~(1ULL << i);
+        }
+    }
+}
+
+/*
+ * Must be called when a tag is dropped. Tag subscriptions for the tag stay
+ * but no longer match any series.
+ */
+void siridb_subscriptions_drop_tag(siridb_t * siridb, const char * name)
+{
+    siridb_subscriptions_t * subscriptions = siridb->subscriptions;
+    siridb_subscription_t * sub;
+    uint64_t used = subscriptions->used;
+    uint16_t i;
+
+    while (used)
+    {
+        i = __builtin_ctzll(used);
+        used &= used - 1;
+
+        sub = subscriptions->subs[i];
+        if (sub->tp == SUBSCRIPTION_TAG && strcmp(sub->expr, name) == 0)
+        {
+            uv_mutex_lock(&siridb->series_mutex);
+
+            (void) imap_walk(
+                    siridb->series_map,
+                    (imap_cb) SUBSCRIPTIONS_clear_cb,
+                    sub);
+
+            uv_mutex_unlock(&siridb->series_mutex);
+        }
+    }
+}
+
+/*
+ * Add a single point for a series with subscriptions. The value must have
+ * the type of the series.
+ *
+ * This function can raise a SIGNAL.
+ */
+void siridb_subscriptions_point(
+        siridb_subscriptions_t * subscriptions,
+        siridb_series_t * series,
+        uint64_t ts,
+        qp_obj_t * val)
+{
+    siridb_subscription_t * sub;
+    qp_packer_t * packer;
+    uint64_t subs = series->subs & subscriptions->used;
+    uint16_t i;
+
+    while (subs)
+    {
+        i = __builtin_ctzll(subs);
+        subs &= subs - 1;
+
+        sub = subscriptions->subs[i];
+        packer = SUBSCRIPTIONS_packer(subscriptions, sub, series, 1);
+        if (packer == NULL)
+        {
+            continue;
+        }
+
+        if (qp_add_type(packer, QP_ARRAY_OPEN) ||
+            qp_add_type(packer, QP_ARRAY2) ||
+            qp_add_int64(packer, SUBSCRIPTIONS_ts(ts, sub->factor)) ||
+            (series->tp == TP_INT ?
+                    qp_add_int64(packer, val->via.int64) :
+             series->tp == TP_DOUBLE ?
+                    qp_add_double(packer, val->via.real) :
+                    qp_add_raw(
+                            packer,
+                            (const unsigned char *) val->via.str,
+                            val->len)) ||
+            qp_add_type(packer, QP_ARRAY_CLOSE))
+        {
+            ERR_ALLOC
+        }
+    }
+}
+
+/*
+ * Add points for a series with subscriptions. This function must be called
+ * before the points are added to the series.
+ *
+ * This function can raise a SIGNAL.
+ */
+void siridb_subscriptions_pcache(
+        siridb_subscriptions_t * subscriptions,
+        siridb_series_t * series,
+        siridb_pcache_t * pcache)
+{
+    siridb_subscription_t * sub;
+    siridb_point_t * point;
+    qp_packer_t * packer;
+    uint64_t subs = series->subs & subscriptions->used;
+    uint16_t i;
+    size_t n;
+    int rc;
+
+    while (subs)
+    {
+        i = __builtin_ctzll(subs);
+        subs &= subs - 1;
+
+        sub = subscriptions->subs[i];
+        packer = SUBSCRIPTIONS_packer(subscriptions, sub, series, pcache->len);
+        if (packer == NULL)
+        {
+            continue;
+        }
+
+        rc = qp_add_type(packer, QP_ARRAY_OPEN);
+
+        for (n = 0; !rc && n < pcache->len; n++)
+        {
+            point = pcache->data + n;
+            rc = qp_add_type(packer, QP_ARRAY2) || qp_add_int64(
+                    packer,
+                    SUBSCRIPTIONS_ts(point->ts, sub->factor));
+
+            switch ((points_tp) pcache->tp)
+            {
+            case TP_INT:
+                rc = rc || qp_add_int64(packer, point->val.int64);
+                break;
+            case TP_DOUBLE:
+                rc = rc || qp_add_double(packer, point->val.real);
+                break;
+            case TP_STRING:
+                rc = rc || qp_add_string(packer, point->val.str);
+                break;
+            }
+        }
+
+        if (rc || qp_add_type(packer, QP_ARRAY_CLOSE))
+        {
+            ERR_ALLOC
+        }
+    }
+}
+
+/*
+ * Send the collected points to the subscribed clients. Should be called
+ * after each part of an insert package is processed.
+ *
+ * This function can raise a SIGNAL.
+ */
+void siridb_subscriptions_flush(siridb_subscriptions_t * subscriptions)
+{
+    siridb_subscription_t * sub;
+    sirinet_pkg_t * pkg;
+    uint64_t pending = subscriptions->pending;
+    uint16_t i;
+
+    subscriptions->pending = 0;
+
+    while (pending)
+    {
+        i = __builtin_ctzll(pending);
+        pending &= pending - 1;
+
+        sub = subscriptions->subs[i];
+        sub->is_full = 0;
+
+        if (sub->packer == NULL)
+        {
+            continue;
+        }
+
+        if (sub->dropped && (
+                qp_add_raw(
+                    sub->packer,
+                    (const unsigned char *) SIRIDB_SUBSCRIPTIONS_DROPPED_KEY,
+                    SIRIDB_SUBSCRIPTIONS_DROPPED_KEY_LEN) ||
+                qp_add_int64(sub->packer, (int64_t) sub->dropped)))
+        {
+            ERR_ALLOC
+            qp_packer_free(sub->packer);
+            sub->packer = NULL;
+            continue;
+        }
+
+        sub->dropped = 0;
+
+        pkg = sirinet_packer2pkg(sub->packer, sub->id, CPROTO_PUSH_POINTS);
+        sub->packer = NULL;
+
+        /* ignore result code, signal can be raised */
+        sirinet_pkg_send(sub->client, pkg);
+    }
+}
+
+static int SUBSCRIPTIONS_test(
+        siridb_subscription_t * sub,
+        siridb_series_t * series)
+{
+    switch ((siridb_subscription_tp) sub->tp)
+    {
+    case SUBSCRIPTION_SERIES:
+        return strcmp(sub->expr, series->name) == 0;
+    case SUBSCRIPTION_REGEX:
+    case SUBSCRIPTION_GROUP:
+        return pcre2_match(
+                sub->regex,
+                (PCRE2_SPTR8) series->name,
+                series->name_len,
+                0,                     /* start looking at this point   */
+                0,                     /* OPTIONS                       */
+                sub->match_data,
+                NULL) >= 0;
+    case SUBSCRIPTION_TAG:
+        break;
+    }
+    return 0;
+}
+
+static int SUBSCRIPTIONS_set_cb(
+        siridb_series_t * series,
+        siridb_subscription_t * sub)
+{
+    if (SUBSCRIPTIONS_test(sub, series))
+    {
+        series->subs |= 1ULL << sub->id;
+    }
+    return 0;
+}
+
+static int SUBSCRIPTIONS_tag_cb(
+        siridb_series_t * series,
+        siridb_subscription_t * sub)
+{
+    series->subs |= 1ULL << sub->id;
+    return 0;
+}
+
+static int SUBSCRIPTIONS_clear_cb(
+        siridb_series_t * series,
+        siridb_subscription_t * sub)
+{
+    series->subs &= ~(1ULL << sub->id);
+    return 0;
+}
+
+static void SUBSCRIPTIONS_drop(
+        siridb_t * siridb,
+        siridb_subscription_t * sub)
+{
+    siridb_subscriptions_t * subscriptions = siridb->subscriptions;
+    uint64_t bit = 1ULL << sub->id;
+
+    uv_mutex_lock(&siridb->series_mutex);
+
+    (void) imap_walk(
+            siridb->series_map,
+            (imap_cb) SUBSCRIPTIONS_clear_cb,
+            sub);
+
+    uv_mutex_unlock(&siridb->series_mutex);
+
+    log_debug("Drop subscription (id: %u) for '%s'", sub->id, sub->expr);
+
+    subscriptions->used &= ~bit;
+    subscriptions->pending &= ~bit;
+    subscriptions->subs[sub->id] = NULL;
+
+    SUBSCRIPTIONS_free(sub);
+}
+
+/*
+ * Returns the packer to which points for the given series can be added or
+ * NULL when the points are dropped. The series name is already added to the
+ * packer.
+ */
+static qp_packer_t * SUBSCRIPTIONS_packer(
+        siridb_subscriptions_t * subscriptions,
+        siridb_subscription_t * sub,
+        siridb_series_t * series,
+        size_t n)
+{
+    if (sub->packer == NULL && !sub->is_full)
+    {
+        /* the client is closing or cannot keep up with the points */
+        if (    sub->client->on_data == NULL ||
+                sub->client->stream->write_queue_size >
+                        SIRIDB_SUBSCRIPTIONS_MAX_QUEUE)
+        {
+            sub->is_full = 1;
+        }
+        else
+        {
+            sub->packer = sirinet_packer_new(SUBSCRIPTIONS_PACKER_SIZE);
+            if (sub->packer == NULL)
+            {
+                sub->is_full = 1;  /* signal is raised */
+            }
+            else if (qp_add_type(sub->packer, QP_MAP_OPEN))
+            {
+                ERR_ALLOC
+                qp_packer_free(sub->packer);
+                sub->packer = NULL;
+                sub->is_full = 1;
+            }
+        }
+        subscriptions->pending |= 1ULL << sub->id;
+    }
+
+    if (sub->is_full)
+    {
+        sub->dropped += n;
+        return NULL;
+    }
+
+    if (qp_add_raw(
+            sub->packer,
+            (const unsigned char *) series->name,
+            series->name_len))
+    {
+        ERR_ALLOC
+        sub->dropped += n;
+        return NULL;
+    }
+
+    return sub->packer;
+}
+
+static void SUBSCRIPTIONS_free(siridb_subscription_t * sub)
+{
+    if (sub->packer != NULL)
+    {
+        qp_packer_free(sub->packer);
+    }
+    if (sub->regex != NULL)
+    {
+        pcre2_code_free(sub->regex);
+    }
+    if (sub->match_data != NULL)
+    {
+        pcre2_match_data_free(sub->match_data);
+    }
+    free(sub->expr);
+    free(sub);
+}
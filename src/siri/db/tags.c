@@ -15,12 +15,23 @@
 #include <siri/db/tags.h>
 #include <stdlib.h>
 #include <vec/vec.h>
+#include <siri/db/misc.h>
 #include <siri/db/series.h>
 #include <siri/net/protocol.h>
 #include <unistd.h>
 #include <siri/siri.h>
 
+#define SIRIDB_TAGS_JOURNAL_FN "journal.dat"
+
+/* journal record: tag id (8 bytes), series id (4 bytes) and type (4 bytes) */
+#define TAGS_JOURNAL_RECORD_SZ 16
+
+/* compact the journal into the tag files when it exceeds this size */
+#define TAGS_JOURNAL_COMPACT_SZ 4194304
+
 static int TAGS_load(siridb_t * siridb);
+static int TAGS_replay_journal(siridb_t * siridb);
+static int TAGS_open_journal(siridb_tags_t * tags, const char * mode);
 static int TAGS_dropped_series(
         siridb_tag_t * tag,
         void * data __attribute__((unused)));
@@ -42,6 +53,8 @@ int siridb_tags_init(siridb_t * siridb)
     siridb->tags->flags = 0;
     siridb->tags->ref = 1;
     siridb->tags->next_id = 0;
+    siridb->tags->journal = NULL;
+    siridb->tags->journal_sz = 0;
     siridb->tags->tags = ct_new();
 
     uv_mutex_init(&siridb->tags->mutex);
@@ -52,7 +65,8 @@ int siridb_tags_init(siridb_t * siridb)
             siridb->dbpath,
             SIRIDB_TAGS_PATH) < 0 ||
             siridb->tags->tags == NULL ||
-            TAGS_load(siridb))
+            TAGS_load(siridb) ||
+            TAGS_replay_journal(siridb))
     {
         siridb__tags_free(siridb->tags);
         siridb->tags = NULL;
@@ -147,29 +161,166 @@ void siridb_tags_dropped_series(siridb_tags_t * tags)
     uv_mutex_unlock(&tags->mutex);
 }
 
-static int TAGS__save_cb(
-        siridb_tag_t * tag,
-        void * data __attribute__((unused)))
+/*
+ * Save a tag when required. When compacting, tags with changes in the
+ * journal are saved as well.
+ */
+static int TAGS__save_cb(siridb_tag_t * tag, uint16_t * flags)
 {
+    uint16_t save = (*flags & TAGS_FLAG_REQUIRE_COMPACT)
+            ? TAG_FLAG_REQUIRE_SAVE | TAG_FLAG_JOURNALED
+            : TAG_FLAG_REQUIRE_SAVE;
+
+    if ((~tag->flags & save) == save)
+    {
+        return 0;  /* nothing to save */
+    }
+
     if (siridb_tag_save(tag) == 0)
     {
-        tag->flags &= ~ TAG_FLAG_REQUIRE_SAVE;
-        usleep(10000);  // 10ms
+        /* the tag file includes all changes from the journal */
+        tag->flags &= ~(TAG_FLAG_REQUIRE_SAVE | TAG_FLAG_JOURNALED);
         return 0;
     }
     return 1;
 }
 
+/*
+ * Save changed tags. Changes which are written to the journal are saved only
+ * when the journal needs to be compacted, after which the journal is
+ * truncated.
+ */
 void siridb_tags_save(siridb_tags_t * tags)
 {
+    uint16_t flags;
+
     uv_mutex_lock(&tags->mutex);
 
-    if (ct_values(tags->tags, (ct_val_cb) TAGS__save_cb, NULL) == 0)
+    flags = tags->flags;
+
+    if (ct_values(tags->tags, (ct_val_cb) TAGS__save_cb, &flags) == 0)
     {
         tags->flags &= ~TAGS_FLAG_REQUIRE_SAVE;
+
+        if (flags & TAGS_FLAG_REQUIRE_COMPACT)
+        {
+            if (TAGS_open_journal(tags, "w") == 0)
+            {
+                tags->flags &= ~TAGS_FLAG_REQUIRE_COMPACT;
+                log_debug("Tag journal is compacted");
+            }
+        }
+    }
+
+    uv_mutex_unlock(&tags->mutex);
+}
+
+/*
+ * Append a tag or untag change for a single series to the journal.
+ * Do not forget to call siridb_tags_journal_flush() after writing changes.
+ *
+ * Lock is required.
+ *
+ * Returns 0 if successful or -1 in case of an error. In case of an error the
+ * tag is flagged for a save so the change is not lost.
+ */
+int siridb_tags_journal(
+        siridb_tag_t * tag,
+        siridb_tags_journal_tp tp,
+        uint32_t series_id)
+{
+    siridb_tags_t * tags = tag->tags;
+    char buf[TAGS_JOURNAL_RECORD_SZ];
+    uint32_t utp = (uint32_t) tp;
+
+    memcpy(buf, &tag->id, sizeof(uint64_t));
+    memcpy(buf + sizeof(uint64_t), &series_id, sizeof(uint32_t));
+    memcpy(buf + sizeof(uint64_t) + sizeof(uint32_t), &utp, sizeof(uint32_t));
+
+    if ((tags->journal == NULL && TAGS_open_journal(tags, "a")) ||
+        fwrite(buf, TAGS_JOURNAL_RECORD_SZ, 1, tags->journal) != 1)
+    {
+        log_critical("Cannot write to tag journal");
+        siridb_tags_set_require_save(tags, tag);
+        return -1;
+    }
+
+    tag->flags |= TAG_FLAG_JOURNALED;
+    tags->journal_sz += TAGS_JOURNAL_RECORD_SZ;
+
+    if (tags->journal_sz > TAGS_JOURNAL_COMPACT_SZ)
+    {
+        tags->flags |= TAGS_FLAG_REQUIRE_COMPACT;
+    }
+
+    return 0;
+}
+
+typedef struct
+{
+    siridb_tag_t * tag;
+    siridb_tags_journal_tp tp;
+} TAGS_journal_t;
+
+static int TAGS_journal_cb(siridb_series_t * series, TAGS_journal_t * w)
+{
+    return siridb_tags_journal(w->tag, w->tp, series->id) ? 1 : 0;
+}
+
+/*
+ * Append a tag or untag change for each series in the given map.
+ *
+ * Lock is required.
+ *
+ * Returns 0 if successful or -1 in case of an error.
+ */
+int siridb_tags_journal_map(
+        siridb_tag_t * tag,
+        siridb_tags_journal_tp tp,
+        imap_t * series_map)
+{
+    TAGS_journal_t w = {
+            .tag = tag,
+            .tp = tp,
+    };
+    return imap_walk(series_map, (imap_cb) TAGS_journal_cb, &w) ? -1 : 0;
+}
+
+/*
+ * Lock is required.
+ *
+ * Returns 0 if successful or EOF in case of an error.
+ */
+int siridb_tags_journal_flush(siridb_tags_t * tags)
+{
+    if (tags->journal != NULL && fflush(tags->journal))
+    {
+        log_critical("Could not flush the tag journal");
+        return EOF;
+    }
+    return 0;
+}
+
+/*
+ * Close the journal, it will be opened again on the next change.
+ *
+ * Returns 0 if successful or EOF in case of an error.
+ */
+int siridb_tags_journal_close(siridb_tags_t * tags)
+{
+    int rc = 0;
+
+    uv_mutex_lock(&tags->mutex);
+
+    if (tags->journal != NULL)
+    {
+        rc = fclose(tags->journal);
+        tags->journal = NULL;
     }
 
     uv_mutex_unlock(&tags->mutex);
+
+    return rc;
 }
 
 /*
@@ -332,12 +483,13 @@ static int TAGS_dropped_series(
             if ((series->flags & SIRIDB_SERIES_IS_DROPPED) &&
                 imap_pop(tag->series, series->id))
             {
+                (void) siridb_tags_journal(tag, TAGS_JOURNAL_DEL, series->id);
                 siridb_series_decref(series);
-                siridb_tags_set_require_save(tag->tags, tag);
             }
         }
 
         vec_free(tag_series);
+        (void) siridb_tags_journal_flush(tag->tags);
     }
 
     usleep(10000);  // 10ms
@@ -415,13 +567,139 @@ static int TAGS_load(siridb_t * siridb)
     return rc;
 }
 
+/*
+ * Open the journal using the given mode. ("a" for appending or "w" to
+ * truncate the journal)
+ *
+ * Returns 0 if successful or -1 in case of an error.
+ */
+static int TAGS_open_journal(siridb_tags_t * tags, const char * mode)
+{
+    siridb_misc_get_fn(fn, tags->path, SIRIDB_TAGS_JOURNAL_FN)
+
+    if (tags->journal != NULL)
+    {
+        (void) fclose(tags->journal);
+    }
+
+    if ((tags->journal = fopen(fn, mode)) == NULL)
+    {
+        log_critical("Cannot open tag journal '%s'", fn);
+        return -1;
+    }
+
+    if (*mode == 'w')
+    {
+        tags->journal_sz = 0;
+    }
+
+    return 0;
+}
+
+static int TAGS_map_cb(siridb_tag_t * tag, imap_t * tags_map)
+{
+    return imap_add(tags_map, tag->id, tag) ? 1 : 0;
+}
+
+/*
+ * Apply the changes from the journal on the loaded tags and compact the
+ * journal into the tag files.
+ *
+ * Returns 0 if successful or -1 in case of an error.
+ */
+static int TAGS_replay_journal(siridb_t * siridb)
+{
+    siridb_tags_t * tags = siridb->tags;
+    siridb_tag_t * tag;
+    siridb_series_t * series;
+    char buf[TAGS_JOURNAL_RECORD_SZ];
+    uint64_t tag_id;
+    uint32_t series_id, tp;
+    size_t n = 0;
+    imap_t * tags_map;
+    FILE * fp;
+    siridb_misc_get_fn(fn, tags->path, SIRIDB_TAGS_JOURNAL_FN)
+
+    if ((fp = fopen(fn, "r")) == NULL)
+    {
+        /* no journal, we have nothing to do */
+        return 0;
+    }
+
+    tags_map = imap_new();
+    if (tags_map == NULL ||
+        ct_values(tags->tags, (ct_val_cb) TAGS_map_cb, tags_map))
+    {
+        log_critical("Cannot create tag map for reading the tag journal");
+        if (tags_map != NULL)
+        {
+            imap_free(tags_map, NULL);
+        }
+        fclose(fp);
+        return -1;
+    }
+
+    /* an incomplete record at the end of the journal is ignored */
+    while (fread(buf, TAGS_JOURNAL_RECORD_SZ, 1, fp) == 1)
+    {
+        memcpy(&tag_id, buf, sizeof(uint64_t));
+        memcpy(&series_id, buf + sizeof(uint64_t), sizeof(uint32_t));
+        memcpy(&tp, buf + sizeof(uint64_t) + sizeof(uint32_t), sizeof(uint32_t));
+
+        n++;
+
+        /* the tag might be dropped */
+        if ((tag = imap_get(tags_map, tag_id)) == NULL)
+        {
+            continue;
+        }
+
+        tag->flags |= TAG_FLAG_JOURNALED;
+
+        if (tp == TAGS_JOURNAL_ADD)
+        {
+            series = imap_get(siridb->series_map, series_id);
+            if (series != NULL && imap_add(tag->series, series_id, series) == 0)
+            {
+                siridb_series_incref(series);
+            }
+        }
+        else if ((series = imap_pop(tag->series, series_id)) != NULL)
+        {
+            siridb_series_decref(series);
+        }
+    }
+
+    imap_free(tags_map, NULL);
+    fclose(fp);
+
+    log_debug("Replayed %zu change(s) from the tag journal", n);
+
+    /* compact the journal so tag id's are never re-used in the journal */
+    tags->flags |= TAGS_FLAG_REQUIRE_COMPACT;
+    siridb_tags_save(tags);
+
+    if (tags->flags & TAGS_FLAG_REQUIRE_COMPACT)
+    {
+        log_critical("Cannot compact the tag journal '%s'", fn);
+        return -1;
+    }
+
+    return 0;
+}
+
 void siridb__tags_free(siridb_tags_t * tags)
 {
-    if (tags->flags & TAGS_FLAG_REQUIRE_SAVE)
+    if (tags->flags & (TAGS_FLAG_REQUIRE_SAVE | TAGS_FLAG_REQUIRE_COMPACT))
     {
         siridb_tags_save(tags);
     }
 
+    if (tags->journal != NULL)
+    {
+        (void) fclose(tags->journal);
+    }
+
     uv_mutex_lock(&tags->mutex);
 
     if (tags->tags != NULL)
@@ -1,13 +1,30 @@
 /*
  * tee.c - To tee the data for a SiriDB database.
+ *
+ * By default insert packages are written to the tee as they are received.
+ * A tee can have a filter (regular expression, tag or group) so only the
+ * matching series are written, and can use a columnar format where the
+ * timestamps and values for a series are written as two separate arrays.
+ *
+ * The result of the filter is cached in the flags of a series on this pool
+ * and is cleared when the filter changes. Cached results for a tag filter
+ * are cleared when series are tagged or untagged or when the tag is dropped;
+ * group filters are evaluated using the group expression at the time a
+ * series is first written to the tee. Series which are not on this pool are
+ * tested each time.
  */
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
 #endif
 #include <assert.h>
+#include <siri/db/group.h>
+#include <siri/db/groups.h>
+#include <siri/db/re.h>
 #include <siri/db/tee.h>
+#include <siri/db/tags.h>
 #include <siri/siri.h>
 #include <siri/net/pipe.h>
+#include <siri/net/protocol.h>
 #include <logger/logger.h>
 
 #define TEE__BUF_SZ 512
@@ -15,6 +32,24 @@ static char tee__buf[TEE__BUF_SZ];
 
 static void tee__runtime_init(uv_pipe_t * pipe);
 static void tee__write_cb(uv_write_t * req, int status);
+static void tee__write_pkg_cb(uv_write_t * req, int status);
+static sirinet_pkg_t * tee__filter_pkg(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        sirinet_pkg_t * pkg);
+static int tee__match(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        const char * series_name);
+static int tee__test(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        siridb_series_t * series,
+        const char * series_name);
+static void tee__reset(siridb_t * siridb);
+static int tee__reset_cb(siridb_series_t * series, void * data);
+static int tee__pack_columnar(qp_packer_t * packer, qp_unpacker_t * unpacker);
+static void tee__clear_filter(siridb_tee_t * tee);
 static void tee__on_connect(uv_connect_t * req, int status);
 static void tee__close_cb(uv_pipe_t * pipe);
 static void tee__alloc_buffer(
@@ -35,6 +70,11 @@ siridb_tee_t * siridb_tee_new(void)
     }
     tee->pipe_name_ = NULL;
     tee->err_msg_ = NULL;
+    tee->filter_tp_ = SIRIDB_TEE_FILTER_NONE;
+    tee->format_ = SIRIDB_TEE_FORMAT_INSERT;
+    tee->filter_ = NULL;
+    tee->regex_ = NULL;
+    tee->match_data_ = NULL;
     tee->pipe.data = tee;
     tee->flags = SIRIDB_TEE_FLAG;
     return tee;
@@ -42,6 +82,7 @@ siridb_tee_t * siridb_tee_new(void)
 
 void siridb_tee_free(siridb_tee_t * tee)
 {
+    tee__clear_filter(tee);
     free(tee->err_msg_);
     free(tee->pipe_name_);
     free(tee);
@@ -108,8 +149,156 @@ int siridb_tee_set_pipe_name(siridb_tee_t * tee, const char * pipe_name)
     return 0;
 }
 
-void siridb_tee_write(siridb_tee_t * tee, sirinet_promise_t * promise)
+/*
+ * Set the series filter and output format. The filter is a regular
+ * expression, tag name or group name and is required unless the filter type
+ * is SIRIDB_TEE_FILTER_NONE.
+ *
+ * Returns 0 if successful or -1 in case of an error. (err_msg is set and
+ * a SIGNAL is raised in case of an allocation error)
+ */
+int siridb_tee_set_filter(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        siridb_tee_filter_t filter_tp,
+        const char * filter,
+        siridb_tee_format_t format,
+        char * err_msg)
+{
+    pcre2_code * regex = NULL;
+    pcre2_match_data * match_data = NULL;
+    char * filter_ = NULL;
+
+    if (    filter_tp < SIRIDB_TEE_FILTER_NONE ||
+            filter_tp > SIRIDB_TEE_FILTER_GROUP ||
+            format < SIRIDB_TEE_FORMAT_INSERT ||
+            format > SIRIDB_TEE_FORMAT_COLUMNAR ||
+            (filter_tp != SIRIDB_TEE_FILTER_NONE && filter == NULL))
+    {
+        sprintf(err_msg, "Invalid tee filter or format.");
+        return -1;
+    }
+
+    if (filter_tp != SIRIDB_TEE_FILTER_NONE)
+    {
+        if (    filter_tp == SIRIDB_TEE_FILTER_REGEX &&
+                siridb_re_compile(
+                        &regex,
+                        &match_data,
+                        filter,
+                        strlen(filter),
+                        err_msg))
+        {
+            return -1;
+        }
+
+        filter_ = strdup(filter);
+
+        if (filter_ == NULL)
+        {
+            ERR_ALLOC
+            sprintf(err_msg, "Memory allocation error.");
+            if (regex != NULL)
+            {
+                pcre2_code_free(regex);
+                pcre2_match_data_free(match_data);
+            }
+            return -1;
+        }
+    }
+
+    tee__clear_filter(tee);
+
+    tee->filter_tp_ = filter_tp;
+    tee->format_ = format;
+    tee->filter_ = filter_;
+    tee->regex_ = regex;
+    tee->match_data_ = match_data;
+
+    tee__reset(siridb);
+
+    return 0;
+}
+
+/*
+ * Returns a back-end package for updating the tee on another server, using
+ * [pipe_name or nil, filter_tp, filter or nil, format].
+ *
+ * Returns NULL and raises a signal in case of an error.
+ */
+sirinet_pkg_t * siridb_tee_update_pkg(
+        const char * pipe_name,
+        siridb_tee_filter_t filter_tp,
+        const char * filter,
+        siridb_tee_format_t format)
+{
+    qp_packer_t * packer = sirinet_packer_new(
+            64 +
+            (pipe_name ? strlen(pipe_name) : 0) +
+            (filter ? strlen(filter) : 0));
+
+    if (packer == NULL)
+    {
+        return NULL;  /* signal is raised */
+    }
+
+    if (    qp_add_type(packer, QP_ARRAY4) ||
+            (pipe_name
+                ? qp_add_string(packer, pipe_name)
+                : qp_add_null(packer)) ||
+            qp_add_int64(packer, (int64_t) filter_tp) ||
+            (filter
+                ? qp_add_string(packer, filter)
+                : qp_add_null(packer)) ||
+            qp_add_int64(packer, (int64_t) format))
+    {
+        ERR_ALLOC
+        qp_packer_free(packer);
+        return NULL;
+    }
+
+    return sirinet_packer2pkg(packer, 0, BPROTO_TEE_UPDATE);
+}
+
+/*
+ * Remove the cached filter result for a series. Must be called when a
+ * series is tagged or untagged.
+ */
+void siridb_tee_forget(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        siridb_series_t * series)
+{
+    if (    tee->filter_tp_ == SIRIDB_TEE_FILTER_TAG &&
+            (series->flags & SIRIDB_SERIES_TEE_CHECKED))
+    {
+        uv_mutex_lock(&siridb->series_mutex);
+        series->flags &= ~SIRIDB_SERIES_TEE_CHECKED;
+        uv_mutex_unlock(&siridb->series_mutex);
+    }
+}
+
+/*
+ * Remove all cached filter results when the tag for the filter is dropped.
+ */
+void siridb_tee_drop_tag(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        const char * name)
 {
+    if (    tee->filter_tp_ == SIRIDB_TEE_FILTER_TAG &&
+            strcmp(tee->filter_, name) == 0)
+    {
+        tee__reset(siridb);
+    }
+}
+
+void siridb_tee_write(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        sirinet_promise_t * promise)
+{
+    sirinet_pkg_t * pkg;
     uv_write_t * req = malloc(sizeof(uv_write_t));
     if (!req)
     {
@@ -117,6 +306,37 @@ void siridb_tee_write(siridb_tee_t * tee, sirinet_promise_t * promise)
         return;
     }
 
+    if (    tee->filter_tp_ != SIRIDB_TEE_FILTER_NONE ||
+            tee->format_ != SIRIDB_TEE_FORMAT_INSERT)
+    {
+        /* pkg is NULL when no series should be written to the tee */
+        pkg = tee__filter_pkg(tee, siridb, promise->pkg);
+        if (pkg == NULL)
+        {
+            free(req);
+            return;
+        }
+
+        req->data = pkg;
+
+        uv_buf_t wrbuf = uv_buf_init(
+                (char *) pkg,
+                sizeof(sirinet_pkg_t) + pkg->len);
+
+        if (uv_write(
+                req,
+                (uv_stream_t *) &tee->pipe,
+                &wrbuf,
+                1,
+                tee__write_pkg_cb))
+        {
+            log_error("Cannot write to tee");
+            free(pkg);
+            free(req);
+        }
+        return;
+    }
+
     req->data = promise;
     sirinet_promise_incref(promise);
 
@@ -179,6 +399,311 @@ static void tee__write_cb(uv_write_t * req, int status)
     free(req);
 }
 
+static void tee__write_pkg_cb(uv_write_t * req, int status)
+{
+    sirinet_pkg_t * pkg = req->data;
+    free(pkg);
+    if (status)
+    {
+        log_error("Socket (tee) write error: %s", uv_strerror(status));
+    }
+    free(req);
+}
+
+/*
+ * Returns a new package with only the series matching the filter, using
+ * the format of the tee, or NULL when no series are matching. NULL is also
+ * returned in case of an error.
+ */
+static sirinet_pkg_t * tee__filter_pkg(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        sirinet_pkg_t * pkg)
+{
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_series_name;
+    qp_packer_t * packer;
+    sirinet_pkg_t * tee_pkg;
+    uint8_t tp;
+    size_t n = 0;
+    int rc = 0;
+
+    packer = sirinet_packer_new(sizeof(sirinet_pkg_t) + pkg->len);
+    if (packer == NULL)
+    {
+        return NULL;  /* signal is raised */
+    }
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+
+    if (!qp_is_map(qp_next(&unpacker, NULL)) ||
+        qp_add_type(packer, QP_MAP_OPEN))
+    {
+        qp_packer_free(packer);
+        return NULL;
+    }
+
+    while ( !rc &&
+            qp_next(&unpacker, &qp_series_name) == QP_RAW &&
+            qp_is_raw_term(&qp_series_name))
+    {
+        if (!tee__match(tee, siridb, (const char *) qp_series_name.via.raw))
+        {
+            qp_skip_next(&unpacker);
+            continue;
+        }
+
+        if (tee->format_ == SIRIDB_TEE_FORMAT_COLUMNAR)
+        {
+            /* the terminator is not included in the columnar format */
+            rc = qp_add_raw(
+                    packer,
+                    qp_series_name.via.raw,
+                    qp_series_name.len - 1) ||
+                tee__pack_columnar(packer, &unpacker);
+        }
+        else
+        {
+            rc = qp_add_raw(
+                    packer,
+                    qp_series_name.via.raw,
+                    qp_series_name.len) ||
+                qp_packer_extend_fu(packer, &unpacker);
+        }
+        n++;
+    }
+
+    if (rc)
+    {
+        log_error("Cannot create a package for the tee");
+        qp_packer_free(packer);
+        return NULL;
+    }
+
+    if (!n)
+    {
+        qp_packer_free(packer);
+        return NULL;
+    }
+
+    tp = (tee->format_ == SIRIDB_TEE_FORMAT_COLUMNAR) ?
+            CPROTO_TEE_COLUMNAR : pkg->tp;
+
+    tee_pkg = sirinet_packer2pkg(packer, pkg->pid, tp);
+    tee_pkg->checkbit = tee_pkg->tp ^ 255;
+
+    return tee_pkg;
+}
+
+/*
+ * Returns 1 if the series must be written to the tee or 0 if not.
+ */
+static int tee__match(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        const char * series_name)
+{
+    siridb_series_t * series;
+    int rc;
+
+    if (tee->filter_tp_ == SIRIDB_TEE_FILTER_NONE)
+    {
+        return 1;
+    }
+
+    series = ct_get(siridb->series, series_name);
+    if (series == NULL)
+    {
+        /* not on this pool (or a new series) so nothing is cached */
+        return tee__test(tee, siridb, NULL, series_name);
+    }
+
+    if (series->flags & SIRIDB_SERIES_TEE_CHECKED)
+    {
+        return (series->flags & SIRIDB_SERIES_TEE_MATCH) ? 1 : 0;
+    }
+
+    rc = tee__test(tee, siridb, series, series_name);
+
+    /* series flags are protected by the series lock */
+    uv_mutex_lock(&siridb->series_mutex);
+
+    series->flags |= SIRIDB_SERIES_TEE_CHECKED;
+    if (rc)
+    {
+        series->flags |= SIRIDB_SERIES_TEE_MATCH;
+    }
+    else
+    {
+        series->flags &= ~SIRIDB_SERIES_TEE_MATCH;
+    }
+
+    uv_mutex_unlock(&siridb->series_mutex);
+
+    return rc;
+}
+
+static int tee__test(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        siridb_series_t * series,
+        const char * series_name)
+{
+    siridb_group_t * group;
+    siridb_tag_t * tag;
+    int rc = 0;
+
+    switch ((siridb_tee_filter_t) tee->filter_tp_)
+    {
+    case SIRIDB_TEE_FILTER_NONE:
+        return 1;
+
+    case SIRIDB_TEE_FILTER_REGEX:
+        return pcre2_match(
+                tee->regex_,
+                (PCRE2_SPTR8) series_name,
+                strlen(series_name),
+                0,                     /* start looking at this point   */
+                0,                     /* OPTIONS                       */
+                tee->match_data_,
+                NULL) >= 0;
+
+    case SIRIDB_TEE_FILTER_TAG:
+        if (series == NULL)
+        {
+            return 0;  /* a new series is not tagged */
+        }
+        uv_mutex_lock(&siridb->tags->mutex);
+
+        tag = ct_get(siridb->tags->tags, tee->filter_);
+        rc = tag != NULL && imap_get(tag->series, series->id) != NULL;
+
+        uv_mutex_unlock(&siridb->tags->mutex);
+        return rc;
+
+    case SIRIDB_TEE_FILTER_GROUP:
+        if (siridb->groups == NULL)
+        {
+            return 0;
+        }
+        uv_mutex_lock(&siridb->groups->mutex);
+
+        group = ct_get(siridb->groups->groups, tee->filter_);
+        rc = group != NULL && pcre2_match(
+                group->regex,
+                (PCRE2_SPTR8) series_name,
+                strlen(series_name),
+                0,                     /* start looking at this point   */
+                0,                     /* OPTIONS                       */
+                group->match_data,
+                NULL) >= 0;
+
+        uv_mutex_unlock(&siridb->groups->mutex);
+        return rc;
+    }
+
+    return rc;
+}
+
+/*
+ * Pack the points for a series as two arrays, one with the timestamps and
+ * one with the values. The unpacker must be at the points for the series
+ * and is moved to the next series.
+ *
+ * Returns 0 if successful or -1 in case of an error.
+ */
+static int tee__pack_columnar(qp_packer_t * packer, qp_unpacker_t * unpacker)
+{
+    unsigned char * pt = unpacker->pt;
+    qp_obj_t qp_ts;
+    qp_obj_t qp_val;
+    int rc;
+
+    rc = qp_add_type(packer, QP_ARRAY2) || qp_add_type(packer, QP_ARRAY_OPEN);
+
+    /* first all timestamps */
+    qp_next(unpacker, NULL);  /* array */
+    while ( !rc &&
+            qp_next(unpacker, NULL) == QP_ARRAY2 &&
+            qp_next(unpacker, &qp_ts) == QP_INT64)
+    {
+        qp_next(unpacker, NULL);  /* value */
+        rc = qp_add_int64(packer, qp_ts.via.int64);
+    }
+
+    rc = rc ||
+        qp_add_type(packer, QP_ARRAY_CLOSE) ||
+        qp_add_type(packer, QP_ARRAY_OPEN);
+
+    /* and now the values */
+    unpacker->pt = pt;
+    qp_next(unpacker, NULL);  /* array */
+    while ( !rc &&
+            qp_next(unpacker, NULL) == QP_ARRAY2 &&
+            qp_next(unpacker, NULL) == QP_INT64)
+    {
+        switch (qp_next(unpacker, &qp_val))
+        {
+        case QP_INT64:
+            rc = qp_add_int64(packer, qp_val.via.int64);
+            break;
+        case QP_DOUBLE:
+            rc = qp_add_double(packer, qp_val.via.real);
+            break;
+        case QP_RAW:
+            rc = qp_add_raw(packer, qp_val.via.raw, qp_val.len);
+            break;
+        default:
+            rc = -1;
+        }
+    }
+
+    /* restore the position and skip the points */
+    unpacker->pt = pt;
+    qp_skip_next(unpacker);
+
+    return (rc || qp_add_type(packer, QP_ARRAY_CLOSE)) ? -1 : 0;
+}
+
+/*
+ * Clear the cached filter result for all series.
+ */
+static void tee__reset(siridb_t * siridb)
+{
+    uv_mutex_lock(&siridb->series_mutex);
+
+    (void) imap_walk(siridb->series_map, (imap_cb) tee__reset_cb, NULL);
+
+    uv_mutex_unlock(&siridb->series_mutex);
+}
+
+static int tee__reset_cb(
+        siridb_series_t * series,
+        void * data __attribute__((unused)))
+{
+    series->flags &= ~(SIRIDB_SERIES_TEE_CHECKED|SIRIDB_SERIES_TEE_MATCH);
+    return 0;
+}
+
+static void tee__clear_filter(siridb_tee_t * tee)
+{
+    if (tee->regex_ != NULL)
+    {
+        pcre2_code_free(tee->regex_);
+    }
+    if (tee->match_data_ != NULL)
+    {
+        pcre2_match_data_free(tee->match_data_);
+    }
+    free(tee->filter_);
+
+    tee->filter_tp_ = SIRIDB_TEE_FILTER_NONE;
+    tee->format_ = SIRIDB_TEE_FORMAT_INSERT;
+    tee->filter_ = NULL;
+    tee->regex_ = NULL;
+    tee->match_data_ = NULL;
+}
+
 static void tee__on_connect(uv_connect_t * req, int status)
 {
     siridb_tee_t * tee = req->data;
@@ -0,0 +1,374 @@
+/*
+ * topk.c - Top-k and bottom-k series for select queries.
+ *
+ * With top(k, fn) or bottom(k, fn) a select query returns only the k series
+ * with the highest (or lowest) value for fn over the selected time range.
+ * Each pool computes the score for its own series and keeps a bounded heap
+ * with at most k candidates, so only the selections for these candidates
+ * are computed and returned. A pool adds the scores for the candidates to
+ * the response using key '__top__'. The server receiving the query pushes
+ * these scores into its own heap and crops the result to the k winners.
+ *
+ * Series without points, and series with a score which is not a number,
+ * are not included in the result.
+ */
+#include <assert.h>
+#include <logger/logger.h>
+#include <math.h>
+#include <siri/db/topk.h>
+#include <siri/err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TOPK__MIN_SIZE 64
+
+/* true when score a must be dropped before score b */
+#define TOPK__worse(topk__, a__, b__) \
+    ((topk__)->bottom ? (a__) > (b__) : (a__) < (b__))
+
+static void TOPK_sift_up(siridb_topk_t * topk, size_t i);
+static void TOPK_sift_down(siridb_topk_t * topk, size_t i);
+
+/*
+ * Returns a new top-k object using the function for a keyword (for example
+ * CLERI_GID_K_MAX) or NULL in case of an allocation error.
+ * (a SIGNAL is raised in case of an allocation error)
+ */
+siridb_topk_t * siridb_topk_new(uint32_t gid, size_t k, int bottom)
+{
+    siridb_topk_t * topk = malloc(sizeof(siridb_topk_t));
+
+    if (topk == NULL)
+    {
+        ERR_ALLOC
+        return NULL;
+    }
+
+    assert (k);
+
+    topk->bottom = (uint8_t) !!bottom;
+    topk->is_ranked = 0;
+    topk->k = k;
+    topk->len = 0;
+    topk->size = (k < TOPK__MIN_SIZE) ? k : TOPK__MIN_SIZE;
+    topk->aggr = siridb_aggregate_new(gid);
+    topk->items = malloc(topk->size * sizeof(siridb_topk_item_t));
+
+    if (topk->aggr == NULL || topk->items == NULL)
+    {
+        ERR_ALLOC
+        siridb_topk_free(topk);
+        return NULL;
+    }
+
+    return topk;
+}
+
+void siridb_topk_free(siridb_topk_t * topk)
+{
+    size_t i;
+
+    for (i = 0; i < topk->len; i++)
+    {
+        free(topk->items[i].name);
+    }
+
+    if (topk->aggr != NULL)
+    {
+        siridb_aggregate_free(topk->aggr);
+    }
+
+    free(topk->items);
+    free(topk);
+}
+
+/*
+ * Set the score for points.
+ *
+ * Returns 0 if successful, 1 if the points have no score or -1 in case of
+ * an error. (err_msg is set in case of an error)
+ */
+int siridb_topk_score(
+        siridb_topk_t * topk,
+        siridb_points_t * points,
+        double * score,
+        char * err_msg)
+{
+    siridb_points_t * aggr_points;
+    int rc = 1;
+
+    if (!points->len)
+    {
+        return 1;
+    }
+
+    aggr_points = siridb_aggregate_run(points, topk->aggr, err_msg);
+
+    if (aggr_points == NULL)
+    {
+        return -1;
+    }
+
+    if (aggr_points->len)
+    {
+        switch (aggr_points->tp)
+        {
+        case TP_INT:
+            *score = (double) aggr_points->data->val.int64;
+            rc = 0;
+            break;
+        case TP_DOUBLE:
+            *score = aggr_points->data->val.real;
+            rc = isnan(*score) ? 1 : 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (aggr_points != points)
+    {
+        siridb_points_free(aggr_points);
+    }
+
+    return rc;
+}
+
+/*
+ * Push a candidate to the heap. The candidate is ignored when the heap
+ * already contains k candidates with a better score.
+ *
+ * Returns 0 if successful or -1 in case of an allocation error.
+ * (a SIGNAL is raised in case of an allocation error)
+ */
+int siridb_topk_push(siridb_topk_t * topk, const char * name, double score)
+{
+    char * dup;
+
+    if (isnan(score) || (
+            topk->len == topk->k &&
+            !TOPK__worse(topk, topk->items->score, score)))
+    {
+        return 0;
+    }
+
+    dup = strdup(name);
+
+    if (dup == NULL)
+    {
+        ERR_ALLOC
+        return -1;
+    }
+
+    if (topk->len == topk->k)
+    {
+        /* replace the worst candidate */
+        free(topk->items->name);
+        topk->items->name = dup;
+        topk->items->score = score;
+        TOPK_sift_down(topk, 0);
+        return 0;
+    }
+
+    if (topk->len == topk->size)
+    {
+        size_t size = (topk->size > topk->k / 2) ? topk->k : topk->size * 2;
+        siridb_topk_item_t * tmp = realloc(
+                topk->items,
+                size * sizeof(siridb_topk_item_t));
+
+        if (tmp == NULL)
+        {
+            ERR_ALLOC
+            free(dup);
+            return -1;
+        }
+
+        topk->items = tmp;
+        topk->size = size;
+    }
+
+    topk->items[topk->len].name = dup;
+    topk->items[topk->len].score = score;
+    TOPK_sift_up(topk, topk->len++);
+
+    return 0;
+}
+
+/*
+ * Pack the candidates as '__top__': {name: score, ...}
+ *
+ * Returns 0 if successful or -1 in case of an allocation error.
+ */
+int siridb_topk_pack(siridb_topk_t * topk, qp_packer_t * packer)
+{
+    size_t i;
+    int rc = (
+        qp_add_raw(
+            packer,
+            (const unsigned char *) SIRIDB_TOPK_KEY,
+            SIRIDB_TOPK_KEY_LEN) ||
+        qp_add_type(packer, QP_MAP_OPEN));
+
+    for (i = 0; !rc && i < topk->len; i++)
+    {
+        rc = (
+            qp_add_string_term(packer, topk->items[i].name) ||
+            qp_add_double(packer, topk->items[i].score));
+    }
+
+    return -(rc || qp_add_type(packer, QP_MAP_CLOSE));
+}
+
+/*
+ * Push the candidates packed by siridb_topk_pack() to the heap.
+ *
+ * Returns 0 if successful or -1 in case of an invalid package or an
+ * allocation error. (a SIGNAL is raised in case of an allocation error)
+ */
+int siridb_topk_unpack(siridb_topk_t * topk, qp_unpacker_t * unpacker)
+{
+    qp_obj_t qp_name, qp_score;
+    qp_types_t tp;
+
+    if (    !qp_is_raw(qp_next(unpacker, &qp_name)) ||
+            qp_name.len != SIRIDB_TOPK_KEY_LEN ||
+            memcmp(qp_name.via.raw, SIRIDB_TOPK_KEY, SIRIDB_TOPK_KEY_LEN) ||
+            !qp_is_map(qp_next(unpacker, NULL)))
+    {
+        return -1;
+    }
+
+    while (qp_is_raw(tp = qp_next(unpacker, &qp_name)))
+    {
+        if (    !qp_is_raw_term(&qp_name) ||
+                qp_next(unpacker, &qp_score) != QP_DOUBLE ||
+                siridb_topk_push(
+                        topk,
+                        (const char *) qp_name.via.raw,
+                        qp_score.via.real))
+        {
+            return -1;
+        }
+    }
+
+    return (tp == QP_MAP_CLOSE || tp == QP_END) ? 0 : -1;
+}
+
+/*
+ * Replace the result with a new result containing only the names for the
+ * candidates in the heap, using each prefix and suffix for the names.
+ *
+ * Returns 0 if successful or -1 in case of an allocation error.
+ * (a SIGNAL is raised in case of an allocation error)
+ */
+int siridb_topk_crop(
+        siridb_topk_t * topk,
+        ct_t ** result,
+        siridb_presuf_t * presuf)
+{
+    siridb_presuf_t * ps;
+    siridb_points_t * points;
+    const char * name;
+    ct_t * cropped = ct_new();
+    size_t i;
+
+    if (cropped == NULL)
+    {
+        ERR_ALLOC
+        return -1;
+    }
+
+    for (i = 0; i < topk->len; i++)
+    {
+        for (ps = presuf; ps != NULL; ps = ps->prev)
+        {
+            name = siridb_presuf_name(
+                    ps,
+                    topk->items[i].name,
+                    strlen(topk->items[i].name));
+
+            if (name == NULL)
+            {
+                ct_free(cropped, (ct_free_cb) siridb_points_free);
+                return -1;  /* signal is raised */
+            }
+
+            points = ct_pop(*result, name);
+
+            if (points != NULL && ct_add(cropped, name, points))
+            {
+                ERR_ALLOC
+                siridb_points_free(points);
+                ct_free(cropped, (ct_free_cb) siridb_points_free);
+                return -1;
+            }
+        }
+    }
+
+    ct_free(*result, (ct_free_cb) siridb_points_free);
+    *result = cropped;
+
+    return 0;
+}
+
+static void TOPK_sift_up(siridb_topk_t * topk, size_t i)
+{
+    siridb_topk_item_t tmp;
+    size_t parent;
+
+    while (i)
+    {
+        parent = (i - 1) / 2;
+
+        if (!TOPK__worse(topk, topk->items[i].score, topk->items[parent].score))
+        {
+            break;
+        }
+
+        tmp = topk->items[i];
+        topk->items[i] = topk->items[parent];
+        topk->items[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void TOPK_sift_down(siridb_topk_t * topk, size_t i)
+{
+    siridb_topk_item_t tmp;
+    size_t child, worst;
+
+    while (1)
+    {
+        worst = i;
+        child = 2 * i + 1;
+
+        if (    child < topk->len &&
+                TOPK__worse(
+                    topk,
+                    topk->items[child].score,
+                    topk->items[worst].score))
+        {
+            worst = child;
+        }
+
+        if (    ++child < topk->len &&
+                TOPK__worse(
+                    topk,
+                    topk->items[child].score,
+                    topk->items[worst].score))
+        {
+            worst = child;
+        }
+
+        if (worst == i)
+        {
+            break;
+        }
+
+        tmp = topk->items[i];
+        topk->items[i] = topk->items[worst];
+        topk->items[worst] = tmp;
+        i = worst;
+    }
+}
@@ -10,6 +10,7 @@
 #include <siri/db/db.h>
 #include <siri/db/user.h>
 #include <siri/db/users.h>
+#include <siri/auth.h>
 #include <siri/err.h>
 #include <siri/grammar/grammar.h>
 #include <xstr/xstr.h>
@@ -127,6 +128,9 @@ int siridb_user_set_password(
         return -1;
     }
 
+    /* cached credentials and tokens are no longer valid */
+    siri_auth_drop_user(user);
+
     return 0;
 }
 
@@ -184,6 +188,9 @@ int siridb_user_set_name(
         return -1;
     }
 
+    /* cached credentials and tokens are no longer valid */
+    siri_auth_drop_user(user);
+
     return 0;
 }
 
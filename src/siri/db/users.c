@@ -8,6 +8,7 @@
 #include <logger/logger.h>
 #include <qpack/qpack.h>
 #include <siri/db/query.h>
+#include <siri/auth.h>
 #include <siri/db/users.h>
 #include <siri/db/misc.h>
 #include <siri/err.h>
@@ -303,6 +304,9 @@ int siridb_users_drop_user(
         return -1;
     }
 
+    /* drop cached credentials and tokens for the user */
+    siri_auth_drop_user(user);
+
     /* decrement reference for user object */
     siridb_user_decref(user);
 
@@ -5,7 +5,7 @@
  * should be used with the libcleri module.
  *
  * Source class: SiriGrammar
- * Created at: 2020-09-25 10:57:26
+ * Created at: 2026-10-18 11:02:41
  */
 
 #include "siri/grammar/grammar.h"
@@ -43,6 +43,8 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
     cleri_t * k_buffer_size = cleri_keyword(CLERI_GID_K_BUFFER_SIZE, "buffer_size", CLERI_CASE_SENSITIVE);
     cleri_t * k_buffer_path = cleri_keyword(CLERI_GID_K_BUFFER_PATH, "buffer_path", CLERI_CASE_SENSITIVE);
     cleri_t * k_between = cleri_keyword(CLERI_GID_K_BETWEEN, "between", CLERI_CASE_SENSITIVE);
+    cleri_t * k_bottom = cleri_keyword(CLERI_GID_K_BOTTOM, "bottom", CLERI_CASE_SENSITIVE);
+    cleri_t * k_columnar = cleri_keyword(CLERI_GID_K_COLUMNAR, "columnar", CLERI_CASE_SENSITIVE);
     cleri_t * k_count = cleri_keyword(CLERI_GID_K_COUNT, "count", CLERI_CASE_SENSITIVE);
     cleri_t * k_create = cleri_keyword(CLERI_GID_K_CREATE, "create", CLERI_CASE_SENSITIVE);
     cleri_t * k_critical = cleri_keyword(CLERI_GID_K_CRITICAL, "critical", CLERI_CASE_SENSITIVE);
@@ -52,12 +54,14 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
     cleri_t * k_debug = cleri_keyword(CLERI_GID_K_DEBUG, "debug", CLERI_CASE_SENSITIVE);
     cleri_t * k_derivative = cleri_keyword(CLERI_GID_K_DERIVATIVE, "derivative", CLERI_CASE_SENSITIVE);
     cleri_t * k_difference = cleri_keyword(CLERI_GID_K_DIFFERENCE, "difference", CLERI_CASE_SENSITIVE);
+    cleri_t * k_downsample = cleri_keyword(CLERI_GID_K_DOWNSAMPLE, "downsample", CLERI_CASE_SENSITIVE);
     cleri_t * k_drop = cleri_keyword(CLERI_GID_K_DROP, "drop", CLERI_CASE_SENSITIVE);
     cleri_t * k_drop_threshold = cleri_keyword(CLERI_GID_K_DROP_THRESHOLD, "drop_threshold", CLERI_CASE_SENSITIVE);
     cleri_t * k_duration_log = cleri_keyword(CLERI_GID_K_DURATION_LOG, "duration_log", CLERI_CASE_SENSITIVE);
     cleri_t * k_duration_num = cleri_keyword(CLERI_GID_K_DURATION_NUM, "duration_num", CLERI_CASE_SENSITIVE);
     cleri_t * k_end = cleri_keyword(CLERI_GID_K_END, "end", CLERI_CASE_SENSITIVE);
     cleri_t * k_error = cleri_keyword(CLERI_GID_K_ERROR, "error", CLERI_CASE_SENSITIVE);
+    cleri_t * k_ewma = cleri_keyword(CLERI_GID_K_EWMA, "ewma", CLERI_CASE_SENSITIVE);
     cleri_t * k_expiration_log = cleri_keyword(CLERI_GID_K_EXPIRATION_LOG, "expiration_log", CLERI_CASE_SENSITIVE);
     cleri_t * k_expiration_num = cleri_keyword(CLERI_GID_K_EXPIRATION_NUM, "expiration_num", CLERI_CASE_SENSITIVE);
     cleri_t * k_expression = cleri_keyword(CLERI_GID_K_EXPRESSION, "expression", CLERI_CASE_SENSITIVE);
@@ -67,6 +71,7 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
     cleri_t * k_first = cleri_keyword(CLERI_GID_K_FIRST, "first", CLERI_CASE_SENSITIVE);
     cleri_t * k_float = cleri_keyword(CLERI_GID_K_FLOAT, "float", CLERI_CASE_SENSITIVE);
     cleri_t * k_for = cleri_keyword(CLERI_GID_K_FOR, "for", CLERI_CASE_SENSITIVE);
+    cleri_t * k_format = cleri_keyword(CLERI_GID_K_FORMAT, "format", CLERI_CASE_SENSITIVE);
     cleri_t * k_from = cleri_keyword(CLERI_GID_K_FROM, "from", CLERI_CASE_SENSITIVE);
     cleri_t * k_full = cleri_keyword(CLERI_GID_K_FULL, "full", CLERI_CASE_SENSITIVE);
     cleri_t * k_grant = cleri_keyword(CLERI_GID_K_GRANT, "grant", CLERI_CASE_SENSITIVE);
@@ -109,10 +114,21 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
     cleri_t * k_median = cleri_keyword(CLERI_GID_K_MEDIAN, "median", CLERI_CASE_SENSITIVE);
     cleri_t * k_median_high = cleri_keyword(CLERI_GID_K_MEDIAN_HIGH, "median_high", CLERI_CASE_SENSITIVE);
     cleri_t * k_median_low = cleri_keyword(CLERI_GID_K_MEDIAN_LOW, "median_low", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_buffers = cleri_keyword(CLERI_GID_K_MEM_BUFFERS, "mem_buffers", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_caches = cleri_keyword(CLERI_GID_K_MEM_CACHES, "mem_caches", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_groups = cleri_keyword(CLERI_GID_K_MEM_GROUPS, "mem_groups", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_index = cleri_keyword(CLERI_GID_K_MEM_INDEX, "mem_index", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_names = cleri_keyword(CLERI_GID_K_MEM_NAMES, "mem_names", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_network = cleri_keyword(CLERI_GID_K_MEM_NETWORK, "mem_network", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_queries = cleri_keyword(CLERI_GID_K_MEM_QUERIES, "mem_queries", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_series = cleri_keyword(CLERI_GID_K_MEM_SERIES, "mem_series", CLERI_CASE_SENSITIVE);
+    cleri_t * k_mem_tags = cleri_keyword(CLERI_GID_K_MEM_TAGS, "mem_tags", CLERI_CASE_SENSITIVE);
     cleri_t * k_mem_usage = cleri_keyword(CLERI_GID_K_MEM_USAGE, "mem_usage", CLERI_CASE_SENSITIVE);
     cleri_t * k_merge = cleri_keyword(CLERI_GID_K_MERGE, "merge", CLERI_CASE_SENSITIVE);
     cleri_t * k_min = cleri_keyword(CLERI_GID_K_MIN, "min", CLERI_CASE_SENSITIVE);
+    cleri_t * k_minmax = cleri_keyword(CLERI_GID_K_MINMAX, "minmax", CLERI_CASE_SENSITIVE);
     cleri_t * k_modify = cleri_keyword(CLERI_GID_K_MODIFY, "modify", CLERI_CASE_SENSITIVE);
+    cleri_t * k_moving = cleri_keyword(CLERI_GID_K_MOVING, "moving", CLERI_CASE_SENSITIVE);
     cleri_t * k_name = cleri_keyword(CLERI_GID_K_NAME, "name", CLERI_CASE_SENSITIVE);
     cleri_t * k_nan = cleri_keyword(CLERI_GID_K_NAN, "nan", CLERI_CASE_SENSITIVE);
     cleri_t * k_ninf = cleri_sequence(
@@ -172,6 +188,7 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
     cleri_t * k_timeval = cleri_keyword(CLERI_GID_K_TIMEVAL, "timeval", CLERI_CASE_SENSITIVE);
     cleri_t * k_timezone = cleri_keyword(CLERI_GID_K_TIMEZONE, "timezone", CLERI_CASE_SENSITIVE);
     cleri_t * k_to = cleri_keyword(CLERI_GID_K_TO, "to", CLERI_CASE_SENSITIVE);
+    cleri_t * k_top = cleri_keyword(CLERI_GID_K_TOP, "top", CLERI_CASE_SENSITIVE);
     cleri_t * k_true = cleri_keyword(CLERI_GID_K_TRUE, "true", CLERI_CASE_SENSITIVE);
     cleri_t * k_type = cleri_keyword(CLERI_GID_K_TYPE, "type", CLERI_CASE_SENSITIVE);
     cleri_t * k_union = cleri_choice(
@@ -1099,10 +1116,55 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
         ),
         cleri_token(CLERI_NONE, ")")
     );
+    cleri_t * f_moving = cleri_sequence(
+        CLERI_GID_F_MOVING,
+        6,
+        k_moving,
+        cleri_token(CLERI_NONE, "("),
+        time_expr,
+        cleri_token(CLERI_NONE, ","),
+        cleri_choice(
+            CLERI_NONE,
+            CLERI_FIRST_MATCH,
+            9,
+            k_mean,
+            k_sum,
+            k_min,
+            k_max,
+            k_count,
+            k_variance,
+            k_pvariance,
+            k_stddev,
+            k_derivative
+        ),
+        cleri_token(CLERI_NONE, ")")
+    );
+    cleri_t * f_ewma = cleri_sequence(
+        CLERI_GID_F_EWMA,
+        4,
+        k_ewma,
+        cleri_token(CLERI_NONE, "("),
+        time_expr,
+        cleri_token(CLERI_NONE, ")")
+    );
+    cleri_t * f_downsample = cleri_sequence(
+        CLERI_GID_F_DOWNSAMPLE,
+        5,
+        k_downsample,
+        cleri_token(CLERI_NONE, "("),
+        int_expr,
+        cleri_optional(CLERI_NONE, cleri_sequence(
+            CLERI_NONE,
+            2,
+            cleri_token(CLERI_NONE, ","),
+            k_minmax
+        )),
+        cleri_token(CLERI_NONE, ")")
+    );
     cleri_t * aggregate_functions = cleri_list(CLERI_GID_AGGREGATE_FUNCTIONS, cleri_choice(
         CLERI_NONE,
         CLERI_FIRST_MATCH,
-        21,
+        24,
         f_all,
         f_limit,
         f_mean,
@@ -1122,6 +1184,9 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
         f_interval,
         f_difference,
         f_derivative,
+        f_moving,
+        f_ewma,
+        f_downsample,
         f_filter,
         f_points
     ), cleri_token(CLERI_NONE, "=>"), 1, 0, 0);
@@ -1146,6 +1211,39 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
             aggregate_functions
         ))
     );
+    cleri_t * top_expr = cleri_sequence(
+        CLERI_GID_TOP_EXPR,
+        6,
+        cleri_choice(
+            CLERI_NONE,
+            CLERI_FIRST_MATCH,
+            2,
+            k_top,
+            k_bottom
+        ),
+        cleri_token(CLERI_NONE, "("),
+        int_expr,
+        cleri_token(CLERI_NONE, ","),
+        cleri_choice(
+            CLERI_NONE,
+            CLERI_FIRST_MATCH,
+            13,
+            k_mean,
+            k_median,
+            k_median_high,
+            k_median_low,
+            k_sum,
+            k_min,
+            k_max,
+            k_count,
+            k_variance,
+            k_pvariance,
+            k_stddev,
+            k_first,
+            k_last
+        ),
+        cleri_token(CLERI_NONE, ")")
+    );
     cleri_t * set_address = cleri_sequence(
         CLERI_GID_SET_ADDRESS,
         3,
@@ -1153,9 +1251,44 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
         k_address,
         string
     );
+    cleri_t * tee_filter = cleri_sequence(
+        CLERI_GID_TEE_FILTER,
+        2,
+        k_filter,
+        cleri_choice(
+            CLERI_NONE,
+            CLERI_FIRST_MATCH,
+            3,
+            r_regex,
+            cleri_sequence(
+                CLERI_NONE,
+                2,
+                k_tag,
+                r_grave_str
+            ),
+            cleri_sequence(
+                CLERI_NONE,
+                2,
+                k_group,
+                r_grave_str
+            )
+        )
+    );
+    cleri_t * tee_format = cleri_sequence(
+        CLERI_GID_TEE_FORMAT,
+        2,
+        k_format,
+        cleri_choice(
+            CLERI_NONE,
+            CLERI_FIRST_MATCH,
+            2,
+            k_insert,
+            k_columnar
+        )
+    );
     cleri_t * set_tee_pipe_name = cleri_sequence(
         CLERI_GID_SET_TEE_PIPE_NAME,
-        3,
+        5,
         k_set,
         k_tee_pipe_name,
         cleri_choice(
@@ -1164,7 +1297,9 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
             2,
             k_false,
             string
-        )
+        ),
+        cleri_optional(CLERI_NONE, tee_filter),
+        cleri_optional(CLERI_NONE, tee_format)
     );
     cleri_t * set_backup_mode = cleri_sequence(
         CLERI_GID_SET_BACKUP_MODE,
@@ -1684,7 +1819,13 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
             between_expr,
             before_expr
         )),
-        cleri_optional(CLERI_NONE, merge_as)
+        cleri_optional(CLERI_NONE, cleri_choice(
+            CLERI_NONE,
+            CLERI_FIRST_MATCH,
+            2,
+            merge_as,
+            top_expr
+        ))
     );
     cleri_t * show_stmt = cleri_sequence(
         CLERI_GID_SHOW_STMT,
@@ -1693,7 +1834,7 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
         cleri_list(CLERI_NONE, cleri_choice(
             CLERI_NONE,
             CLERI_FIRST_MATCH,
-            37,
+            46,
             k_active_handles,
             k_active_tasks,
             k_buffer_path,
@@ -1713,6 +1854,15 @@ cleri_grammar_t * compile_siri_grammar_grammar(void)
             k_list_limit,
             k_log_level,
             k_max_open_files,
+            k_mem_buffers,
+            k_mem_caches,
+            k_mem_groups,
+            k_mem_index,
+            k_mem_names,
+            k_mem_network,
+            k_mem_queries,
+            k_mem_series,
+            k_mem_tags,
             k_mem_usage,
             k_open_files,
             k_pool,
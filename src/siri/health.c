@@ -2,9 +2,12 @@
  * health.c
  */
 #include <siri/health.h>
+#include <siri/mem.h>
 #include <siri/siri.h>
 #include <siri/net/tcp.h>
 #include <logger/logger.h>
+#include <procinfo/procinfo.h>
+#include <stdio.h>
 
 #define OK_RESPONSE \
     "HTTP/1.1 200 OK\r\n" \
@@ -55,6 +58,15 @@
     "\r\n" \
     "BACKUP MODE\n"
 
+#define METRICS_HEADER \
+    "HTTP/1.1 200 OK\r\n" \
+    "Content-Type: text/plain; version=0.0.4\r\n" \
+    "Content-Length: %zu\r\n" \
+    "\r\n"
+
+/* large enough for the header and all metrics */
+#define METRICS_BUF_SZ 2048
+
 /* static response buffers */
 static uv_buf_t health__uv_ok_buf;
 static uv_buf_t health__uv_nok_buf;
@@ -70,6 +82,7 @@ static http_parser_settings health__settings;
 static void health__close_cb(uv_handle_t * handle)
 {
     siri_health_request_t * web_request = handle->data;
+    free(web_request->dyn.base);
     free(web_request);
 }
 
@@ -209,6 +222,75 @@ static uv_buf_t * health__get_ready_response(void)
     return &health__uv_nok_buf;
 }
 
+/*
+ * Returns the memory usage per subsystem in the Prometheus text format.
+ * In case of an allocation error the `NOK` response is returned.
+ */
+static uv_buf_t * health__get_metrics_response(
+        siri_health_request_t * web_request)
+{
+    char body[METRICS_BUF_SZ];
+    size_t n, i;
+    int rc;
+    struct
+    {
+        const char * name;
+        size_t size;
+    } mem[] = {
+        {"series", siri_mem_get(SIRI_MEM_SERIES)},
+        {"index", siri_mem_get(SIRI_MEM_INDEX)},
+        {"buffers", siri_mem_get(SIRI_MEM_BUFFERS)},
+        {"names", siri_mem_names()},
+        {"groups", siri_mem_groups()},
+        {"tags", siri_mem_tags()},
+        {"queries", siri_mem_get(SIRI_MEM_QUERIES)},
+        {"network", siri_mem_get(SIRI_MEM_NETWORK)},
+        {"caches", siri_mem_get(SIRI_MEM_CACHES)},
+    };
+
+    n = (size_t) snprintf(
+            body,
+            METRICS_BUF_SZ,
+            "# HELP siridb_mem_bytes Memory used per subsystem in bytes.\n"
+            "# TYPE siridb_mem_bytes gauge\n");
+
+    for (i = 0; i < sizeof(mem) / sizeof(mem[0]); i++)
+    {
+        n += (size_t) snprintf(
+                body + n,
+                METRICS_BUF_SZ - n,
+                "siridb_mem_bytes{subsystem=\"%s\"} %zu\n",
+                mem[i].name,
+                mem[i].size);
+    }
+
+    n += (size_t) snprintf(
+            body + n,
+            METRICS_BUF_SZ - n,
+            "# HELP siridb_mem_resident_bytes Resident memory in bytes.\n"
+            "# TYPE siridb_mem_resident_bytes gauge\n"
+            "siridb_mem_resident_bytes %ld\n",
+            procinfo_total_physical_memory() * 1024);
+
+    free(web_request->dyn.base);
+    web_request->dyn.base = malloc(METRICS_BUF_SZ);
+    if (web_request->dyn.base == NULL)
+    {
+        ERR_ALLOC
+        return &health__uv_nok_buf;
+    }
+
+    rc = snprintf(
+            web_request->dyn.base,
+            METRICS_BUF_SZ,
+            METRICS_HEADER "%s",
+            n,
+            body);
+
+    web_request->dyn.len = (rc > 0 && rc < METRICS_BUF_SZ) ? (size_t) rc : 0;
+    return &web_request->dyn;
+}
+
 static int health__url_cb(http_parser * parser, const char * at, size_t length)
 {
     siri_health_request_t * web_request = parser->data;
@@ -228,6 +310,10 @@ static int health__url_cb(http_parser * parser, const char * at, size_t length)
         : (length == 8 && memcmp(at, "/healthy", 8) == 0)
         ? &health__uv_ok_buf
 
+        /* memory metrics response */
+        : (length == 8 && memcmp(at, "/metrics", 8) == 0)
+        ? health__get_metrics_response(web_request)
+
         /* everything else */
         : &health__uv_nfound_buf;
 
@@ -284,6 +370,8 @@ static void health__connection_cb(uv_stream_t * server, int status)
 
     web_request->flags = SIRIDB_HEALTH_FLAG;
     web_request->is_closed = false;
+    web_request->dyn.base = NULL;
+    web_request->dyn.len = 0;
     web_request->uvstream.data = web_request;
     web_request->parser.data = web_request;
 
@@ -0,0 +1,99 @@
+/*
+ * mem.c - Memory accounting per subsystem.
+ *
+ * The siri_mem_names(), siri_mem_groups() and siri_mem_tags() functions
+ * should only be called from the main thread.
+ */
+#include <ctree/ctree.h>
+#include <siri/db/group.h>
+#include <siri/db/groups.h>
+#include <siri/db/tag.h>
+#include <siri/db/tags.h>
+#include <siri/mem.h>
+#include <siri/siri.h>
+
+size_t siri_mem[SIRI_MEM_TRACKED] = {0};
+
+static int MEM_group_cb(siridb_group_t * group, size_t * size);
+static int MEM_tag_cb(siridb_tag_t * tag, size_t * size);
+
+/*
+ * Returns the memory used by the series name index of all databases.
+ */
+size_t siri_mem_names(void)
+{
+    size_t size = 0;
+    llist_node_t * siridb_node = siri.siridb_list->first;
+
+    for (; siridb_node != NULL; siridb_node = siridb_node->next)
+    {
+        siridb_t * siridb = (siridb_t *) siridb_node->data;
+        size += ct_mem_usage(siridb->series);
+    }
+    return size;
+}
+
+/*
+ * Returns the memory used by groups of all databases.
+ */
+size_t siri_mem_groups(void)
+{
+    size_t size = 0;
+    llist_node_t * siridb_node = siri.siridb_list->first;
+
+    for (; siridb_node != NULL; siridb_node = siridb_node->next)
+    {
+        siridb_t * siridb = (siridb_t *) siridb_node->data;
+        if (siridb->groups == NULL)
+        {
+            continue;
+        }
+        uv_mutex_lock(&siridb->groups->mutex);
+        size += ct_mem_usage(siridb->groups->groups);
+        ct_values(siridb->groups->groups, (ct_val_cb) MEM_group_cb, &size);
+        uv_mutex_unlock(&siridb->groups->mutex);
+    }
+    return size;
+}
+
+/*
+ * Returns the memory used by tags of all databases.
+ */
+size_t siri_mem_tags(void)
+{
+    size_t size = 0;
+    llist_node_t * siridb_node = siri.siridb_list->first;
+
+    for (; siridb_node != NULL; siridb_node = siridb_node->next)
+    {
+        siridb_t * siridb = (siridb_t *) siridb_node->data;
+        if (siridb->tags == NULL)
+        {
+            continue;
+        }
+        uv_mutex_lock(&siridb->tags->mutex);
+        size += ct_mem_usage(siridb->tags->tags);
+        ct_values(siridb->tags->tags, (ct_val_cb) MEM_tag_cb, &size);
+        uv_mutex_unlock(&siridb->tags->mutex);
+    }
+    return size;
+}
+
+static int MEM_group_cb(siridb_group_t * group, size_t * size)
+{
+    *size += sizeof(siridb_group_t) + (group->series == NULL ? 0 :
+            sizeof(vec_t) + group->series->size * sizeof(void *));
+    *size += group->set == NULL ? 0 : group->set->len * sizeof(void *);
+    return 0;
+}
+
+/*
+ * The series of a tag are stored in an imap, we count a pointer per series
+ * and ignore the overhead of the imap nodes.
+ */
+static int MEM_tag_cb(siridb_tag_t * tag, size_t * size)
+{
+    *size += sizeof(siridb_tag_t) + (tag->series == NULL ? 0 :
+            tag->series->len * sizeof(void *));
+    return 0;
+}
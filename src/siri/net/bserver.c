@@ -10,6 +10,7 @@
 #include <siri/db/replicate.h>
 #include <siri/db/server.h>
 #include <siri/db/servers.h>
+#include <siri/db/subscriptions.h>
 #include <siri/net/bserver.h>
 #include <siri/net/pkg.h>
 #include <siri/net/protocol.h>
@@ -46,11 +47,13 @@ static void on_log_level_update(
 static void on_tee_pipe_name_update(
         sirinet_stream_t * client,
         sirinet_pkg_t * pkg);
+static void on_tee_update(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_drop_database(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_repl_finished(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_query(
         sirinet_stream_t * client,
         sirinet_pkg_t * pkg, int flags);
+static void on_query_batch(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_insert(
         sirinet_stream_t * client,
         sirinet_pkg_t * pkg, int flags);
@@ -295,6 +298,12 @@ static void on_data(sirinet_stream_t * client, sirinet_pkg_t * pkg)
     case BPROTO_EMPTY_TAGS:
         on_empty_tags(client, pkg);
         break;
+    case BPROTO_QUERY_BATCH_SERVER:
+        on_query_batch(client, pkg);
+        break;
+    case BPROTO_TEE_UPDATE:
+        on_tee_update(client, pkg);
+        break;
     }
 
 }
@@ -457,6 +466,7 @@ static void on_tee_pipe_name_update(
     SERVER_CHECK_AUTHENTICATED(client, server);
     siridb_t * siridb = client->siridb;
     sirinet_pkg_t * package;
+    char err_msg[SIRIDB_MAX_SIZE_ERR_MSG];
 
     char * pipe_name = pkg->len
             ? strndup((const char *) pkg->data, pkg->len)
@@ -466,6 +476,100 @@ static void on_tee_pipe_name_update(
 
     free(pipe_name);
 
+    /* this package is only sent when no filter and format are used */
+    if (    siridb->tee->filter_tp_ != SIRIDB_TEE_FILTER_NONE ||
+            siridb->tee->format_ != SIRIDB_TEE_FORMAT_INSERT)
+    {
+        (void) siridb_tee_set_filter(
+                siridb->tee,
+                siridb,
+                SIRIDB_TEE_FILTER_NONE,
+                NULL,
+                SIRIDB_TEE_FORMAT_INSERT,
+                err_msg);
+
+        if (siridb_save(siridb))
+        {
+            log_critical("Could not save database changes (database: '%s')",
+                    siridb->dbname);
+        }
+    }
+
+    package = sirinet_pkg_new(pkg->pid, 0, BPROTO_ACK_TEE_PIPE_NAME, NULL);
+    if (package != NULL)
+    {
+        /* ignore result code, signal can be raised */
+        sirinet_pkg_send(client, package);
+    }
+}
+
+static void on_tee_update(sirinet_stream_t * client, sirinet_pkg_t * pkg)
+{
+    SERVER_CHECK_AUTHENTICATED(client, server)
+
+    siridb_t * siridb = client->siridb;
+    sirinet_pkg_t * package;
+    qp_unpacker_t unpacker;
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+    qp_obj_t qp_pipe_name;
+    qp_obj_t qp_filter_tp;
+    qp_obj_t qp_filter;
+    qp_obj_t qp_format;
+    char * pipe_name = NULL;
+    char * filter = NULL;
+    char err_msg[SIRIDB_MAX_SIZE_ERR_MSG];
+
+    if (!(  qp_is_array(qp_next(&unpacker, NULL)) &&
+            (qp_next(&unpacker, &qp_pipe_name) == QP_RAW ||
+                qp_pipe_name.tp == QP_NULL) &&
+            qp_next(&unpacker, &qp_filter_tp) == QP_INT64 &&
+            qp_filter_tp.via.int64 >= SIRIDB_TEE_FILTER_NONE &&
+            qp_filter_tp.via.int64 <= SIRIDB_TEE_FILTER_GROUP &&
+            (qp_next(&unpacker, &qp_filter) == QP_RAW ||
+                qp_filter.tp == QP_NULL) &&
+            (qp_filter.tp == QP_RAW ||
+                qp_filter_tp.via.int64 == SIRIDB_TEE_FILTER_NONE) &&
+            qp_next(&unpacker, &qp_format) == QP_INT64 &&
+            qp_format.via.int64 >= SIRIDB_TEE_FORMAT_INSERT &&
+            qp_format.via.int64 <= SIRIDB_TEE_FORMAT_COLUMNAR))
+    {
+        log_error("Invalid back-end 'on_tee_update' received.");
+        return;
+    }
+
+    if (    (qp_pipe_name.tp == QP_RAW && (pipe_name = strndup(
+                (const char *) qp_pipe_name.via.raw,
+                qp_pipe_name.len)) == NULL) ||
+            (qp_filter.tp == QP_RAW && (filter = strndup(
+                (const char *) qp_filter.via.raw,
+                qp_filter.len)) == NULL))
+    {
+        ERR_ALLOC
+        free(pipe_name);
+        return;
+    }
+
+    (void) siridb_tee_set_pipe_name(siridb->tee, pipe_name);
+
+    if (siridb_tee_set_filter(
+            siridb->tee,
+            siridb,
+            (siridb_tee_filter_t) qp_filter_tp.via.int64,
+            filter,
+            (siridb_tee_format_t) qp_format.via.int64,
+            err_msg))
+    {
+        log_error("Cannot set tee filter: %s", err_msg);
+    }
+    else if (siridb_save(siridb))
+    {
+        log_critical("Could not save database changes (database: '%s')",
+                siridb->dbname);
+    }
+
+    free(pipe_name);
+    free(filter);
+
     package = sirinet_pkg_new(pkg->pid, 0, BPROTO_ACK_TEE_PIPE_NAME, NULL);
     if (package != NULL)
     {
@@ -530,6 +634,7 @@ static void on_query(sirinet_stream_t * client, sirinet_pkg_t * pkg, int flags)
     qp_unpacker_init(&unpacker, pkg->data, pkg->len);
 
     qp_obj_t qp_query;
+    qp_obj_t qp_cursor;
 
     if (flags & SIRIDB_QUERY_FLAG_UPDATE_REPLICA)
     {
@@ -544,13 +649,30 @@ static void on_query(sirinet_stream_t * client, sirinet_pkg_t * pkg, int flags)
     if (    qp_is_array(qp_next(&unpacker, NULL)) &&
             qp_next(&unpacker, &qp_query) == QP_RAW)
     {
-        siridb_query_run(
-                pkg->pid,
-                client,
-                (const char *) qp_query.via.raw,
-                qp_query.len,
-                0.0,
-                0);
+        /* skip the time precision, a cursor is optional */
+        if (    qp_next(&unpacker, NULL) == QP_INT64 &&
+                qp_next(&unpacker, &qp_cursor) == QP_RAW)
+        {
+            siridb_query_run_cursor(
+                    pkg->pid,
+                    client,
+                    (const char *) qp_query.via.raw,
+                    qp_query.len,
+                    (const char *) qp_cursor.via.raw,
+                    qp_cursor.len,
+                    0.0,
+                    0);
+        }
+        else
+        {
+            siridb_query_run(
+                    pkg->pid,
+                    client,
+                    (const char *) qp_query.via.raw,
+                    qp_query.len,
+                    0.0,
+                    0);
+        }
     }
     else
     {
@@ -558,6 +680,29 @@ static void on_query(sirinet_stream_t * client, sirinet_pkg_t * pkg, int flags)
     }
 }
 
+static void on_query_batch(sirinet_stream_t * client, sirinet_pkg_t * pkg)
+{
+    SERVER_CHECK_AUTHENTICATED(client, server)
+
+    sirinet_pkg_t * package;
+
+    if (siridb_batch_run(client, pkg, BPROTO_RES_QUERY_BATCH, 0))
+    {
+        log_error("Invalid back-end 'on_query_batch' received.");
+
+        package = sirinet_pkg_err(
+                pkg->pid,
+                19,
+                BPROTO_ERR_QUERY,
+                "Invalid query batch");
+
+        if (package != NULL)
+        {
+            sirinet_pkg_send(client, package);
+        }
+    }
+}
+
 static void on_insert(
         sirinet_stream_t * client,
         sirinet_pkg_t * pkg,
@@ -901,16 +1046,33 @@ static void on_series_tags(sirinet_stream_t * client, sirinet_pkg_t * pkg)
                                 siridb->tags,
                                 qp_tag_name.via.str,
                                 qp_tag_name.len);
+
+                        if (tag == NULL)
+                        {
+                            continue;
+                        }
+
+                        /* a new tag requires a tag file */
+                        siridb_tags_set_require_save(siridb->tags, tag);
                     }
 
-                    if (tag && imap_add(tag->series, series->id, series) == 0)
+                    if (imap_add(tag->series, series->id, series) == 0)
                     {
                         siridb_series_incref(series);
+                        (void) siridb_tags_journal(
+                                tag,
+                                TAGS_JOURNAL_ADD,
+                                series->id);
+                        siridb_subscriptions_tag(
+                                siridb->subscriptions,
+                                tag,
+                                series);
+                        siridb_tee_forget(siridb->tee, siridb, series);
                     }
-
-                    siridb_tags_set_require_save(siridb->tags, tag);
                 }
 
+                (void) siridb_tags_journal_flush(siridb->tags);
+
                 uv_mutex_unlock(&siridb->tags->mutex);
 
                 siridb_series_decref(series);
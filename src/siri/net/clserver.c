@@ -19,6 +19,7 @@
 #include <siri/db/replicate.h>
 #include <siri/db/server.h>
 #include <siri/db/servers.h>
+#include <siri/db/subscriptions.h>
 #include <siri/db/users.h>
 #include <siri/err.h>
 #include <siri/net/clserver.h>
@@ -69,8 +70,11 @@ static void on_data(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_stream_data(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_auth_request(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_query(sirinet_stream_t * client, sirinet_pkg_t * pkg);
+static void on_query_batch(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_insert(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 static void on_ping(sirinet_stream_t * client, sirinet_pkg_t * pkg);
+static void on_subscribe(sirinet_stream_t * client, sirinet_pkg_t * pkg);
+static void on_unsubscribe(sirinet_stream_t * client, sirinet_pkg_t * pkg);
 
 static void on_reqfile(
         sirinet_stream_t * client,
@@ -85,6 +89,12 @@ static void CLSERVER_send_server_error(
 static void CLSERVER_send_pool_error(
         sirinet_stream_t * client,
         sirinet_pkg_t * pkg);
+static void CLSERVER_send_err_msg(
+        sirinet_stream_t * client,
+        sirinet_pkg_t * pkg,
+        uint8_t tp,
+        const char * err_msg);
+static int CLSERVER_subscription_tp(qp_obj_t * qp_kind);
 static void CLSERVER_on_register_server_response(
         vec_t * promises,
         siridb_server_async_t * server_reg);
@@ -283,6 +293,15 @@ static void on_data(sirinet_stream_t * client, sirinet_pkg_t * pkg)
         case CPROTO_REQ_PING:
             on_ping(client, pkg);
             break;
+        case CPROTO_REQ_QUERY_BATCH:
+            on_query_batch(client, pkg);
+            break;
+        case CPROTO_REQ_SUBSCRIBE:
+            on_subscribe(client, pkg);
+            break;
+        case CPROTO_REQ_UNSUBSCRIBE:
+            on_unsubscribe(client, pkg);
+            break;
         case CPROTO_REQ_REGISTER_SERVER:
             on_register_server(client, pkg);
             break;
@@ -478,6 +497,7 @@ static void on_query(sirinet_stream_t * client, sirinet_pkg_t * pkg)
     qp_unpacker_t unpacker;
     qp_obj_t qp_query;
     qp_obj_t qp_time_precision;
+    qp_obj_t qp_cursor;
     float factor;
     siridb_timep_t tp = SIRIDB_TIME_DEFAULT;
 
@@ -497,13 +517,29 @@ static void on_query(sirinet_stream_t * client, sirinet_pkg_t * pkg)
         factor = (tp == SIRIDB_TIME_DEFAULT) ? 0.0 :
                 pow(1000.0, tp - siridb->time->precision);
 
-        siridb_query_run(
-                pkg->pid,
-                client,
-                (const char *) qp_query.via.raw,
-                qp_query.len,
-                factor,
-                SIRIDB_QUERY_FLAG_MASTER);
+        /* an optional cursor is used for incremental select queries */
+        if (qp_next(&unpacker, &qp_cursor) == QP_RAW)
+        {
+            siridb_query_run_cursor(
+                    pkg->pid,
+                    client,
+                    (const char *) qp_query.via.raw,
+                    qp_query.len,
+                    (const char *) qp_cursor.via.raw,
+                    qp_cursor.len,
+                    factor,
+                    SIRIDB_QUERY_FLAG_MASTER);
+        }
+        else
+        {
+            siridb_query_run(
+                    pkg->pid,
+                    client,
+                    (const char *) qp_query.via.raw,
+                    qp_query.len,
+                    factor,
+                    SIRIDB_QUERY_FLAG_MASTER);
+        }
     }
     else
     {
@@ -511,6 +547,39 @@ static void on_query(sirinet_stream_t * client, sirinet_pkg_t * pkg)
     }
 }
 
+static void on_query_batch(sirinet_stream_t * client, sirinet_pkg_t * pkg)
+{
+    CHECK_SIRIDB(client, siridb)
+
+    sirinet_pkg_t * package;
+
+    (void) siridb;  /* only used to check authentication */
+
+    if (    pkg->len > MAX_QUERY_PKG_SIZE * 4 ||
+            siridb_batch_run(
+                client,
+                pkg,
+                CPROTO_RES_QUERY_BATCH,
+                SIRIDB_QUERY_FLAG_MASTER))
+    {
+        log_error(
+                "Incorrect package received: 'on_query_batch' "
+                "(len: %" PRIu32 ")",
+                pkg->len);
+
+        package = sirinet_pkg_err(
+                pkg->pid,
+                19,
+                CPROTO_ERR_QUERY,
+                "Invalid query batch");
+
+        if (package != NULL)
+        {
+            sirinet_pkg_send(client, package);
+        }
+    }
+}
+
 static void on_insert(sirinet_stream_t * client, sirinet_pkg_t * pkg)
 {
     CHECK_SIRIDB(client, siridb)
@@ -629,6 +698,128 @@ static void on_ping(sirinet_stream_t * client, sirinet_pkg_t * pkg)
     }
 }
 
+/*
+ * Subscribe to new points for series matching an expression. The kind of
+ * expression must be 'series', 'regex', 'tag' or 'group'.
+ *
+ * This function can raise a SIGNAL.
+ */
+static void on_subscribe(sirinet_stream_t * client, sirinet_pkg_t * pkg)
+{
+    CHECK_SIRIDB(client, siridb)
+
+    char err_msg[SIRIDB_MAX_SIZE_ERR_MSG];
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_kind;
+    qp_obj_t qp_expr;
+    qp_obj_t qp_time_precision;
+    qp_packer_t * packer;
+    sirinet_pkg_t * package;
+    siridb_timep_t time_tp = SIRIDB_TIME_DEFAULT;
+    double factor;
+    int tp, id;
+
+    if (!siridb_user_check_access(
+                (siridb_user_t *) client->origin,
+                SIRIDB_ACCESS_SELECT,
+                err_msg))
+    {
+        CLSERVER_send_err_msg(client, pkg, CPROTO_ERR_USER_ACCESS, err_msg);
+        return;
+    }
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+
+    if (    !qp_is_array(qp_next(&unpacker, NULL)) ||
+            qp_next(&unpacker, &qp_kind) != QP_RAW ||
+            qp_next(&unpacker, &qp_expr) != QP_RAW ||
+            (tp = CLSERVER_subscription_tp(&qp_kind)) < 0)
+    {
+        log_error("Incorrect package received: 'on_subscribe'");
+        CLSERVER_send_err_msg(
+                client,
+                pkg,
+                CPROTO_ERR_MSG,
+                "Invalid subscribe request.");
+        return;
+    }
+
+    if (    qp_next(&unpacker, &qp_time_precision) == QP_INT64 &&
+            (time_tp = (siridb_timep_t) qp_time_precision.via.int64) !=
+            siridb->time->precision)
+    {
+        time_tp %= SIRIDB_TIME_END;
+    }
+    factor = (time_tp == SIRIDB_TIME_DEFAULT) ? 0.0 :
+            pow(1000.0, time_tp - siridb->time->precision);
+
+    id = siridb_subscriptions_subscribe(
+            siridb,
+            client,
+            (siridb_subscription_tp) tp,
+            (const char *) qp_expr.via.raw,
+            qp_expr.len,
+            factor,
+            err_msg);
+
+    if (id < 0)
+    {
+        CLSERVER_send_err_msg(client, pkg, CPROTO_ERR_MSG, err_msg);
+        return;
+    }
+
+    packer = sirinet_packer_new(64);
+    if (packer == NULL)
+    {
+        return;  /* signal is raised */
+    }
+
+    (void) qp_add_int64(packer, id);
+
+    package = sirinet_packer2pkg(packer, pkg->pid, CPROTO_RES_SUBSCRIBE);
+
+    /* ignore result code, signal can be raised */
+    sirinet_pkg_send(client, package);
+}
+
+/*
+ * This function can raise a SIGNAL.
+ */
+static void on_unsubscribe(sirinet_stream_t * client, sirinet_pkg_t * pkg)
+{
+    CHECK_SIRIDB(client, siridb)
+
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_id;
+    sirinet_pkg_t * package;
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+
+    if (    qp_next(&unpacker, &qp_id) != QP_INT64 ||
+            qp_id.via.int64 < 0 ||
+            qp_id.via.int64 >= SIRIDB_SUBSCRIPTIONS_MAX ||
+            siridb_subscriptions_unsubscribe(
+                    siridb,
+                    client,
+                    (uint16_t) qp_id.via.int64))
+    {
+        CLSERVER_send_err_msg(
+                client,
+                pkg,
+                CPROTO_ERR_MSG,
+                "Unknown subscription.");
+        return;
+    }
+
+    package = sirinet_pkg_new(pkg->pid, 0, CPROTO_RES_ACK, NULL);
+
+    if (package != NULL)
+    {
+        /* ignore result code, signal can be raised */
+        sirinet_pkg_send(client, package);
+    }
+}
+
 /*
  * This function can raise a SIGNAL.
  */
@@ -958,3 +1149,52 @@ static void CLSERVER_on_register_server_response(
     /* free server register object */
     free(server_reg);
 }
+
+/*
+ * Send an error message package to the client.
+ *
+ * This function can raise a SIGNAL.
+ */
+static void CLSERVER_send_err_msg(
+        sirinet_stream_t * client,
+        sirinet_pkg_t * pkg,
+        uint8_t tp,
+        const char * err_msg)
+{
+    sirinet_pkg_t * package = sirinet_pkg_err(
+            pkg->pid,
+            strlen(err_msg),
+            tp,
+            err_msg);
+
+    if (package != NULL)
+    {
+        /* ignore result code, signal can be raised */
+        sirinet_pkg_send(client, package);
+    }
+}
+
+/*
+ * Returns the subscription type for the kind of expression or -1 when the
+ * kind is unknown.
+ */
+static int CLSERVER_subscription_tp(qp_obj_t * qp_kind)
+{
+    if (qp_kind->len == 6 && memcmp(qp_kind->via.raw, "series", 6) == 0)
+    {
+        return SUBSCRIPTION_SERIES;
+    }
+    if (qp_kind->len == 5 && memcmp(qp_kind->via.raw, "regex", 5) == 0)
+    {
+        return SUBSCRIPTION_REGEX;
+    }
+    if (qp_kind->len == 3 && memcmp(qp_kind->via.raw, "tag", 3) == 0)
+    {
+        return SUBSCRIPTION_TAG;
+    }
+    if (qp_kind->len == 5 && memcmp(qp_kind->via.raw, "group", 5) == 0)
+    {
+        return SUBSCRIPTION_GROUP;
+    }
+    return -1;
+}
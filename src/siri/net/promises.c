@@ -25,6 +25,7 @@ sirinet_promises_t * sirinet_promises_new(
     {
 
         promises->cb = cb;
+        promises->each_cb = NULL;
         promises->data = data;
         promises->promises = vec_new(size);
         promises->pkg = pkg;
@@ -83,6 +84,12 @@ void sirinet_promises_on_response(
                 sirinet_promise_strstatus((sirinet_promise_status_t) status));
         promise->data = NULL;
     }
+    else if (   promises->each_cb != NULL &&
+                promises->each_cb(promise, pkg, promises->data))
+    {
+        /* the package is handled, keep only the header */
+        promise->data = (void *) sirinet_pkg_new(pkg->pid, 0, pkg->tp, NULL);
+    }
     else
     {
         /* we can ignore errors from sirinet_pkg_dup() */
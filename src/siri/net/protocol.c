@@ -14,6 +14,7 @@ const char * sirinet_cproto_client_str(cproto_client_t n)
     case CPROTO_REQ_INSERT: return "CPROTO_REQ_INSERT";
     case CPROTO_REQ_AUTH: return "CPROTO_REQ_AUTH";
     case CPROTO_REQ_PING: return "CPROTO_REQ_PING";
+    case CPROTO_REQ_QUERY_BATCH: return "CPROTO_REQ_QUERY_BATCH";
 
     /* start internal usage */
     case CPROTO_REQ_REGISTER_SERVER: return "CPROTO_REQ_REGISTER_SERVER";
@@ -23,6 +24,9 @@ const char * sirinet_cproto_client_str(cproto_client_t n)
     case CPROTO_REQ_FILE_DATABASE: return "CPROTO_REQ_FILE_DATABASE";
     /* end internal usage */
 
+    case CPROTO_REQ_SUBSCRIBE: return "CPROTO_REQ_SUBSCRIBE";
+    case CPROTO_REQ_UNSUBSCRIBE: return "CPROTO_REQ_UNSUBSCRIBE";
+
     case CPROTO_REQ_SERVICE: return "CPROTO_REQ_SERVICE";
 
     default:
@@ -39,7 +43,11 @@ const char * sirinet_cproto_server_str(cproto_server_t n)
     case CPROTO_RES_INSERT: return "CPROTO_RES_INSERT";
     case CPROTO_RES_AUTH_SUCCESS: return "CPROTO_RES_AUTH_SUCCESS";
     case CPROTO_RES_ACK: return "CPROTO_RES_ACK";
+    case CPROTO_RES_QUERY_BATCH: return "CPROTO_RES_QUERY_BATCH";
     case CPROTO_RES_FILE: return "CPROTO_RES_FILE";
+    case CPROTO_RES_SUBSCRIBE: return "CPROTO_RES_SUBSCRIBE";
+    case CPROTO_PUSH_POINTS: return "CPROTO_PUSH_POINTS";
+    case CPROTO_TEE_COLUMNAR: return "CPROTO_TEE_COLUMNAR";
 
     case CPROTO_ACK_SERVICE: return "CPROTO_ACK_SERVICE";
     case CPROTO_ACK_SERVICE_DATA: return "CPROTO_ACK_SERVICE_DATA";
@@ -89,6 +97,8 @@ const char * sirinet_bproto_client_str(bproto_client_t n)
     case BPROTO_REQ_TAGS: return "BPROTO_REQ_TAGS";
     case BPROTO_SERIES_TAGS: return "BPROTO_SERIES_TAGS";
     case BPROTO_EMPTY_TAGS: return "BPROTO_EMPTY_TAGS";
+    case BPROTO_QUERY_BATCH_SERVER: return "BPROTO_QUERY_BATCH_SERVER";
+    case BPROTO_TEE_UPDATE: return "BPROTO_TEE_UPDATE";
     default:
         sprintf(protocol_str, "BPROTO_CLIENT_TYPE_UNKNOWN (%d)", n);
         return protocol_str;
@@ -129,6 +139,7 @@ const char * sirinet_bproto_server_str(bproto_server_t n)
     case BPROTO_RES_TAGS: return "BPROTO_RES_TAGS";
     case BPROTO_ACK_SERIES_TAGS: return "BPROTO_ACK_SERIES_TAGS";
     case BPROTO_ACK_EMPTY_TAGS: return "BPROTO_ACK_EMPTY_TAGS";
+    case BPROTO_RES_QUERY_BATCH: return "BPROTO_RES_QUERY_BATCH";
     default:
         sprintf(protocol_str, "BPROTO_SERVER_TYPE_UNKNOWN (%d)", n);
         return protocol_str;
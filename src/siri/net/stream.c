@@ -3,8 +3,10 @@
  */
 #include <assert.h>
 #include <logger/logger.h>
+#include <siri/db/subscriptions.h>
 #include <siri/service/client.h>
 #include <siri/err.h>
+#include <siri/mem.h>
 #include <siri/net/protocol.h>
 #include <siri/net/stream.h>
 #include <siri/net/pipe.h>
@@ -15,7 +17,14 @@
 
 #define MAX_ALLOWED_PKG_SIZE 41943040      /* 40 MB  */
 
+/* allocated read buffer size, client->size is -1 until the first read */
+#define STREAM_BUF_SZ(client__) \
+    ((client__)->buf == NULL ? 0 : (client__)->size)
+
 #define QUIT_STREAM                     \
+    siri_mem_sub(                       \
+        SIRI_MEM_NETWORK,               \
+        STREAM_BUF_SZ(client));         \
     free(client->buf);                  \
     client->buf = NULL;                 \
     client->len = 0;                    \
@@ -112,6 +121,7 @@ void sirinet_stream_alloc_buffer(
 
     if (!client->len && client->size > RESET_BUF_SIZE)
     {
+        siri_mem_sub(SIRI_MEM_NETWORK, STREAM_BUF_SZ(client));
         free(client->buf);
         client->buf = malloc(suggested_size);
         if (client->buf == NULL)
@@ -122,6 +132,7 @@ void sirinet_stream_alloc_buffer(
         }
         client->size = suggested_size;
         client->len = 0;
+        siri_mem_add(SIRI_MEM_NETWORK, suggested_size);
     }
     buf->base = client->buf + client->len;
     buf->len = client->size - client->len;
@@ -212,6 +223,7 @@ void sirinet_stream_on_data(
                     pkg->pid, pkg->len, pkg->tp);
                 QUIT_STREAM
             }
+            siri_mem_add(SIRI_MEM_NETWORK, total_sz - client->size);
             client->buf = tmp;
             client->size = total_sz;
         }
@@ -282,8 +294,15 @@ void sirinet__stream_free(uv_stream_t * uvclient)
     }
     if (client->siridb)
     {
+        if (    client->tp == STREAM_TCP_CLIENT ||
+                client->tp == STREAM_PIPE_CLIENT)
+        {
+            /* subscriptions cannot be used after the client is destroyed */
+            siridb_subscriptions_drop_client(client->siridb, client);
+        }
         siridb_decref(client->siridb);
     }
+    siri_mem_sub(SIRI_MEM_NETWORK, STREAM_BUF_SZ(client));
     free(client->buf);
     free(client);
     free(uvclient);
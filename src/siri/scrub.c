@@ -0,0 +1,291 @@
+/*
+ * scrub.c - Scrub task SiriDB.
+ *
+ * The scrub task runs in the background and verifies the checksums of shard
+ * chunks which are no longer written to. Each run reads at most
+ * SCRUB_MAX_BYTES per database and continues where the previous run has
+ * stopped, so a full pass over a large database is spread over several runs.
+ *
+ * Only shards with schema 22 or higher have checksums, older shards will get
+ * checksums once they are re-written by the optimize task.
+ */
+#include <logger/logger.h>
+#include <siri/db/series.h>
+#include <siri/db/shard.h>
+#include <siri/db/time.h>
+#include <siri/scrub.h>
+#include <siri/siri.h>
+#include <time.h>
+#include <unistd.h>
+#include <vec/vec.h>
+
+/* maximum bytes to verify per database in a single run */
+#define SCRUB_MAX_BYTES 33554432
+
+/* wait at least this amount of seconds before the first run */
+#define SCRUB_INIT_TIMEOUT 300
+
+static siri_scrub_t scrub = {
+        .status=SIRI_SCRUB_PENDING,
+        .verified=0,
+        .corrupt=0
+};
+
+static void SCRUB_work(uv_work_t * work);
+static void SCRUB_database(siridb_t * siridb);
+static void SCRUB_cleanup(vec_t * slsiridb);
+static void SCRUB_work_finish(uv_work_t * work, int status);
+static void SCRUB_cb(uv_timer_t * handle);
+
+void siri_scrub_init(siri_t * siri)
+{
+    /*
+     * Main Thread
+     */
+    uint64_t timeout = siri->cfg->scrub_interval * 1000;
+
+    if (timeout == 0)
+    {
+        siri->scrub = NULL;
+        return;
+    }
+
+    siri->scrub = &scrub;
+    uv_timer_init(siri->loop, &scrub.timer);
+    uv_timer_start(
+            &scrub.timer,
+            SCRUB_cb,
+            timeout < SCRUB_INIT_TIMEOUT * 1000 ?
+                    SCRUB_INIT_TIMEOUT * 1000 : timeout,
+            timeout);
+}
+
+void siri_scrub_stop(siri_t * siri)
+{
+    /*
+     * Main Thread
+     */
+    if (siri->scrub != NULL)
+    {
+        /* uv_cancel will only be successful when the task is not started */
+        scrub.status = SIRI_SCRUB_CANCELLED;
+        uv_cancel((uv_req_t *) &scrub.work);
+
+        /* stop the timer so it will not run again */
+        uv_timer_stop(&scrub.timer);
+        uv_close((uv_handle_t *) &scrub.timer, NULL);
+        siri->scrub = NULL;
+    }
+}
+
+static void SCRUB_work(uv_work_t * work __attribute__((unused)))
+{
+    /*
+     * Scrub Thread
+     */
+    vec_t * slsiridb;
+    size_t i;
+
+    uv_mutex_lock(&siri.siridb_mutex);
+
+    slsiridb = llist2vec(siri.siridb_list);
+    if (slsiridb != NULL)
+    {
+        for (i = 0; i < slsiridb->len; i++)
+        {
+            siridb_incref((siridb_t *) slsiridb->data[i]);
+        }
+    }
+
+    uv_mutex_unlock(&siri.siridb_mutex);
+
+    if (slsiridb == NULL)
+    {
+        log_error("Error creating reference list for databases.");
+        return;
+    }
+
+    for (i = 0; i < slsiridb->len && scrub.status == SIRI_SCRUB_RUNNING; i++)
+    {
+        SCRUB_database((siridb_t *) slsiridb->data[i]);
+    }
+
+    SCRUB_cleanup(slsiridb);
+}
+
+/*
+ * Verify chunks of 'cold' shards for a single database, starting at series
+ * siridb->scrub_series_id.
+ */
+static void SCRUB_database(siridb_t * siridb)
+{
+    /*
+     * Scrub Thread
+     */
+    siridb_series_t * series;
+    struct timespec now;
+    uint64_t ts;
+    size_t i, bytes = 0;
+    uint32_t j;
+    ssize_t n;
+    vec_t * vec;
+
+    log_debug(
+            "Start scrubbing database '%s' at series id %" PRIu32,
+            siridb->dbname,
+            siridb->scrub_series_id);
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    ts = siridb_time_now(siridb, now);
+
+    uv_mutex_lock(&siridb->series_mutex);
+
+    vec = imap_2vec_ref(siridb->series_map);
+
+    uv_mutex_unlock(&siridb->series_mutex);
+
+    if (vec == NULL)
+    {
+        log_error("Error creating reference list for series.");
+        return;
+    }
+
+    for (i = 0; i < vec->len; i++)
+    {
+        series = (siridb_series_t *) vec->data[i];
+
+        if (    series->id < siridb->scrub_series_id ||
+                bytes >= SCRUB_MAX_BYTES ||
+                scrub.status != SIRI_SCRUB_RUNNING ||
+                (series->flags & SIRIDB_SERIES_IS_DROPPED))
+        {
+            siridb_series_decref(series);
+            continue;
+        }
+
+        uv_mutex_lock(&siridb->series_mutex);
+
+        for (j = 0; j < series->idx_len; j++)
+        {
+            idx_t * idx = series->idx + j;
+            siridb_shard_t * shard = idx->shard;
+
+            if (    (shard->flags & (
+                        SIRIDB_SHARD_IS_REMOVED |
+                        SIRIDB_SHARD_IS_CORRUPT)) ||
+                    shard->id - series->mask + shard->duration > ts)
+            {
+                continue;
+            }
+
+            n = siridb_shard_verify_chunk(series, idx);
+            if (n < 0)
+            {
+                scrub.corrupt++;
+            }
+            else
+            {
+                bytes += n;
+            }
+        }
+
+        uv_mutex_unlock(&siridb->series_mutex);
+
+        siridb->scrub_series_id = series->id + 1;
+        siridb_series_decref(series);
+
+        /* give other threads the opportunity to read from disk */
+        usleep(50000 * siridb->tasks.active + 100);
+    }
+
+    vec_free(vec);
+
+    if (bytes < SCRUB_MAX_BYTES && scrub.status == SIRI_SCRUB_RUNNING)
+    {
+        /* a full pass is completed, start over on the next run */
+        siridb->scrub_series_id = 0;
+    }
+
+    scrub.verified += bytes;
+
+    log_debug(
+            "Finished scrubbing database '%s' (%zu bytes verified)",
+            siridb->dbname,
+            bytes);
+}
+
+static void SCRUB_cleanup(vec_t * slsiridb)
+{
+    siridb_t * siridb;
+    size_t i;
+
+    for (i = 0; i < slsiridb->len; i++)
+    {
+        siridb = (siridb_t *) slsiridb->data[i];
+        siridb_decref(siridb);
+    }
+
+    vec_free(slsiridb);
+}
+
+static void SCRUB_work_finish(
+        uv_work_t * work __attribute__((unused)),
+        int status)
+{
+    /*
+     * Main Thread
+     */
+    if (scrub.corrupt)
+    {
+        log_warning(
+                "Scrub task has found %zu corrupt chunk(s), the next "
+                "optimize cycle will repair the affected shards",
+                scrub.corrupt);
+    }
+
+    log_info(
+            "Finished scrub task in %d seconds "
+            "(%zu bytes verified) with status: %d",
+            time(NULL) - scrub.start,
+            scrub.verified,
+            status);
+
+    /* reset scrub status to pending if and only if the status is RUNNING */
+    if (scrub.status == SIRI_SCRUB_RUNNING)
+    {
+        scrub.status = SIRI_SCRUB_PENDING;
+    }
+}
+
+/*
+ * Start the scrub task. (will start a new thread performing the work)
+ */
+static void SCRUB_cb(uv_timer_t * handle __attribute__((unused)))
+{
+    /*
+     * Main Thread
+     */
+    if (scrub.status != SIRI_SCRUB_PENDING)
+    {
+        log_debug("Skip scrub task because of having status: %d",
+                scrub.status);
+        return;
+    }
+
+    if (siri.optimize->status != SIRI_OPTIMIZE_PENDING)
+    {
+        log_debug("Skip scrub task because the optimize task is active");
+        return;
+    }
+
+    scrub.status = SIRI_SCRUB_RUNNING;
+    scrub.start = time(NULL);
+    scrub.verified = 0;
+    scrub.corrupt = 0;
+
+    uv_queue_work(
+            siri.loop,
+            &scrub.work,
+            SCRUB_work,
+            SCRUB_work_finish);
+}
@@ -1,6 +1,7 @@
 /*
  * account.c - SiriDB Service Account.
  */
+#include <siri/auth.h>
 #include <siri/service/account.h>
 #include <stddef.h>
 #include <owcrypt/owcrypt.h>
@@ -292,6 +293,9 @@ int siri_service_account_change_password(
     free(account->password);
     account->password = password;
 
+    /* cached credentials are no longer valid */
+    siri_auth_drop_service();
+
     return 0;
 }
 
@@ -364,6 +368,9 @@ int siri_service_account_drop(
     }
 
     ACCOUNT_free(account, NULL);
+
+    /* cached credentials are no longer valid */
+    siri_auth_drop_service();
     return 0;
 }
 
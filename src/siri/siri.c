@@ -31,6 +31,7 @@
 #include <siri/db/servers.h>
 #include <siri/db/users.h>
 #include <siri/api.h>
+#include <siri/auth.h>
 #include <siri/err.h>
 #include <siri/health.h>
 #include <siri/help/help.h>
@@ -38,6 +39,7 @@
 #include <siri/net/clserver.h>
 #include <siri/net/pipe.h>
 #include <siri/net/stream.h>
+#include <siri/scrub.h>
 #include <siri/service/account.h>
 #include <siri/service/request.h>
 #include <siri/siri.h>
@@ -85,6 +87,7 @@ siri_t siri = {
         .optimize=NULL,
         .heartbeat=NULL,
         .buffersync=NULL,
+        .scrub=NULL,
         .cfg=NULL,
         .args=NULL,
         .status=SIRI_STATUS_LOADING,
@@ -322,6 +325,9 @@ int siri_start(void)
     /* initialize buffer-sync task (bind siri.buffersync) */
     siri_buffersync_init(&siri);
 
+    /* initialize scrub task (bind siri.scrub) */
+    siri_scrub_init(&siri);
+
     /* initialize backup (bind siri.backup) */
     if (siri_backup_init(&siri))
     {
@@ -360,6 +366,9 @@ void siri_free(void)
     /* first free the File Handler. (this will close all open shard files) */
     siri_fh_free(siri.fh);
 
+    /* release cached credentials and tokens */
+    siri_auth_destroy();
+
     /* this will free each SiriDB database and the list */
     llist_free_cb(siri.siridb_list, (llist_cb) siridb_decref_cb, NULL);
 
@@ -579,6 +588,9 @@ static void SIRI_signal_handler(
         /* stop buffer-sync task */
         siri_buffersync_stop(&siri);
 
+        /* stop scrub task */
+        siri_scrub_stop(&siri);
+
         /* destroy backup (mode) task */
         siri_backup_destroy(&siri);
 
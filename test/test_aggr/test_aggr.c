@@ -368,6 +368,171 @@ static int test_variance(void)
     return test_end();
 }
 
+static int test_moving(void)
+{
+    test_start("aggr (moving)");
+
+    siridb_points_t * aggrp, * points = prepare_points();
+
+    aggr.gid = CLERI_GID_F_MOVING;
+    aggr.group_by = 0;
+    aggr.limit = 0;
+    aggr.offset = 0;
+    aggr.window = 5;
+
+    aggr.moving_gid = CLERI_GID_F_MAX;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert (aggrp->len == 10);
+    _assert (aggrp->tp == TP_INT);
+    _assert (aggrp->data->ts == 3 && aggrp->data->val.int64 == 1);
+    _assert ((aggrp->data + 4)->ts == 11 &&
+            (aggrp->data + 4)->val.int64 == 4);
+    _assert ((aggrp->data + 7)->ts == 15 &&
+            (aggrp->data + 7)->val.int64 == 8);
+    _assert ((aggrp->data + 9)->ts == 27 &&
+            (aggrp->data + 9)->val.int64 == 6);
+    siridb_points_free(aggrp);
+
+    aggr.moving_gid = CLERI_GID_F_MIN;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert ((aggrp->data + 4)->val.int64 == 0);
+    _assert ((aggrp->data + 7)->val.int64 == 3);
+    _assert ((aggrp->data + 9)->val.int64 == 3);
+    siridb_points_free(aggrp);
+
+    aggr.moving_gid = CLERI_GID_F_SUM;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert (aggrp->tp == TP_INT);
+    _assert ((aggrp->data + 3)->val.int64 == 5);
+    _assert ((aggrp->data + 7)->val.int64 == 20);
+    _assert ((aggrp->data + 9)->val.int64 == 9);
+    siridb_points_free(aggrp);
+
+    aggr.moving_gid = CLERI_GID_F_COUNT;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert ((aggrp->data + 7)->val.int64 == 4);
+    _assert ((aggrp->data + 8)->val.int64 == 1);
+    siridb_points_free(aggrp);
+
+    aggr.moving_gid = CLERI_GID_F_MEAN;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert (aggrp->tp == TP_DOUBLE);
+    _assert ((aggrp->data + 7)->val.real == 5.0);
+    _assert ((aggrp->data + 9)->val.real == 4.5);
+    siridb_points_free(aggrp);
+
+    aggr.moving_gid = CLERI_GID_F_STDDEV;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert (aggrp->data->val.real == 0.0);
+    _assert (fabs((aggrp->data + 9)->val.real - sqrt(4.5)) < 1e-9);
+    siridb_points_free(aggrp);
+
+    aggr.moving_gid = CLERI_GID_F_DERIVATIVE;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert (aggrp->len == 8);
+    _assert (aggrp->data->ts == 6 &&
+            fabs(aggrp->data->val.real - 2.0 / 3.0) < 1e-9);
+    _assert ((aggrp->data + 7)->ts == 27 &&
+            (aggrp->data + 7)->val.real == -1.5);
+    siridb_points_free(aggrp);
+
+    siridb_points_free(points);
+
+    return test_end();
+}
+
+static int test_ewma(void)
+{
+    test_start("aggr (ewma)");
+
+    siridb_points_t * aggrp, * points = prepare_points();
+
+    aggr.gid = CLERI_GID_F_EWMA;
+    aggr.group_by = 0;
+    aggr.limit = 0;
+    aggr.offset = 0;
+    aggr.window = 3;
+
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert (aggrp->len == 10);
+    _assert (aggrp->tp == TP_DOUBLE);
+    _assert (aggrp->data->ts == 3 && aggrp->data->val.real == 1.0);
+    _assert ((aggrp->data + 1)->ts == 6 && fabs(
+            (aggrp->data + 1)->val.real - (3.0 - 2.0 * exp(-1.0))) < 1e-9);
+
+    siridb_points_free(aggrp);
+    siridb_points_free(points);
+
+    return test_end();
+}
+
+static int test_downsample(void)
+{
+    test_start("aggr (downsample)");
+
+    siridb_points_t * aggrp, * points = prepare_points();
+
+    aggr.gid = CLERI_GID_F_DOWNSAMPLE;
+    aggr.group_by = 0;
+    aggr.limit = 0;
+    aggr.offset = 0;
+    aggr.max_points = 4;
+
+    aggr.minmax = 0;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert (aggrp->len == 4);
+    _assert (aggrp->tp == TP_INT);
+    _assert (aggrp->data->ts == 3 && aggrp->data->val.int64 == 1);
+    _assert ((aggrp->data + 1)->ts == 7 &&
+            (aggrp->data + 1)->val.int64 == 0);
+    _assert ((aggrp->data + 2)->ts == 13 &&
+            (aggrp->data + 2)->val.int64 == 8);
+    _assert ((aggrp->data + 3)->ts == 27 &&
+            (aggrp->data + 3)->val.int64 == 3);
+    siridb_points_free(aggrp);
+
+    aggr.minmax = 1;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp != NULL);
+    _assert (aggrp->len == 4);
+    _assert (aggrp->data->ts == 7 && aggrp->data->val.int64 == 0);
+    _assert ((aggrp->data + 1)->ts == 13 &&
+            (aggrp->data + 1)->val.int64 == 8);
+    _assert ((aggrp->data + 2)->ts == 25 &&
+            (aggrp->data + 2)->val.int64 == 6);
+    _assert ((aggrp->data + 3)->ts == 27 &&
+            (aggrp->data + 3)->val.int64 == 3);
+    siridb_points_free(aggrp);
+
+    aggr.max_points = 10;
+    aggrp = siridb_aggregate_run(points, &aggr, err_msg);
+
+    _assert (aggrp == points);
+
+    siridb_points_free(points);
+
+    return test_end();
+}
+
 int main()
 {
     return (
@@ -384,6 +549,9 @@ int main()
         test_stddev() ||
         test_sum() ||
         test_variance() ||
+        test_moving() ||
+        test_ewma() ||
+        test_downsample() ||
         0
     );
 }
@@ -0,0 +1,32 @@
+#include "../test.h"
+#include <crc32c/crc32c.h>
+
+
+int main()
+{
+    test_start("crc32c");
+
+    const char * check = "123456789";
+    unsigned char zeros[32] = {0};
+    unsigned char buf[1024];
+    unsigned int i;
+
+    /* known test vectors */
+    _assert (crc32c(0, "", 0) == 0);
+    _assert (crc32c(0, check, strlen(check)) == 0xe3069283);
+    _assert (crc32c(0, zeros, sizeof(zeros)) == 0x8a9136aa);
+
+    /* continue a checksum over multiple buffers */
+    for (i = 0; i < sizeof(buf); i++)
+    {
+        buf[i] = (unsigned char) (i * 31 + 7);
+    }
+    for (i = 0; i < sizeof(buf); i += 37)
+    {
+        uint32_t crc = crc32c(0, buf, i);
+        _assert (crc32c(crc, buf + i, sizeof(buf) - i) ==
+                crc32c(0, buf, sizeof(buf)));
+    }
+
+    return test_end();
+}
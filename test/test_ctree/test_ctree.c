@@ -75,6 +75,16 @@ int main()
         }
     }
 
+    /* test memory usage */
+    {
+        char * key = "mem_usage";
+        size_t empty = ct_mem_usage(ctree);
+        _assert (empty >= sizeof(ct_t));
+        _assert (ct_add(ctree, key, key) == CT_OK);
+        _assert (ct_mem_usage(ctree) > empty);
+        _assert (ct_pop(ctree, key) == key);
+    }
+
     /* test pop value */
     {
         unsigned int i;
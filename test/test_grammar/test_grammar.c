@@ -34,6 +34,11 @@ int main()
         "select mean(1h + 1m) from \"series-001\", \"series-002\", "
         "\"series-003\" between 1360152000 and 1360152000 + 1d merge as "
         "\"series\" using mean(1)");
+    assert_valid(grammar,
+        "select max(5m) from /cpu.*/ after now - 1h top(10, max)");
+    assert_valid(grammar, "select * from * bottom(3, mean)");
+    assert_invalid(grammar,
+        "select * from * top(3, max) merge as \"series\"");
 
     cleri_grammar_free(grammar);
 
@@ -284,6 +284,75 @@ static int test_imap_symmetric_difference(void)
     return test_end();
 }
 
+static int test_imap_src(void)
+{
+    test_start("imap (src set operations)");
+
+    test__imap_setup();
+
+    /* union with an empty map must result in a copy */
+    imap_t * imap = imap_new();
+    imap_union_src(imap, imap_tmp, (imap_free_cb) test__imap_decref_cb);
+
+    _assert (imap->len == 4);
+    _assert (imap_get(imap, series_e.id) == &series_e);
+    _assert (imap_get(imap, series_b.id) == &series_b);
+    _assert (series_e.ref == 2);
+
+    imap_free(imap, (imap_free_cb) test__imap_decref_cb);
+
+    imap_intersection_src(
+            imap_dst,
+            imap_tmp,
+            (imap_free_cb) test__imap_decref_cb);
+
+    _assert (imap_dst->len == 2);
+    _assert (imap_tmp->len == 4);
+    _assert (imap_walk(
+                imap_dst,
+                (imap_cb) &test__imap_id_count_cb,
+                NULL) == (int) (
+            series_b.id +
+            series_c.id));
+
+    imap_symmetric_difference_src(
+            imap_dst,
+            imap_tmp,
+            (imap_free_cb) test__imap_decref_cb);
+
+    _assert (imap_dst->len == 2);
+    _assert (imap_walk(
+                imap_dst,
+                (imap_cb) &test__imap_id_count_cb,
+                NULL) == (int) (
+            series_d.id +
+            series_e.id));
+
+    imap_union_src(
+            imap_dst,
+            imap_tmp,
+            (imap_free_cb) test__imap_decref_cb);
+
+    _assert (imap_dst->len == 4);
+
+    imap_difference_src(
+            imap_dst,
+            imap_tmp,
+            (imap_free_cb) test__imap_decref_cb);
+
+    _assert (imap_dst->len == 0);
+
+    imap_free(imap_dst, (imap_free_cb) test__imap_decref_cb);
+    imap_free(imap_tmp, (imap_free_cb) test__imap_decref_cb);
+    _assert (series_a.ref == 0);
+    _assert (series_b.ref == 0);
+    _assert (series_c.ref == 0);
+    _assert (series_d.ref == 0);
+    _assert (series_e.ref == 0);
+
+    return test_end();
+}
+
 int main()
 {
     return (
@@ -292,6 +361,7 @@ int main()
         test_imap_intersection() ||
         test_imap_difference() ||
         test_imap_symmetric_difference() ||
+        test_imap_src() ||
         0
     );
 }
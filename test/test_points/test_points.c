@@ -0,0 +1,180 @@
+#include "../test.h"
+#include <siri/db/points.h>
+
+
+static siridb_points_t * prepare_points(points_tp tp)
+{
+    uint64_t timestamps[8] =    {0, 3, 63, 64, 300, 70000, 5000000000, 7};
+    int64_t values[8] =         {-1, 0, 63, -60, -61, 40000, 5000000000, 1};
+    double reals[8] =           {-1.0, 0.0, 1.0, 0.5, -2.5, 3.14, 1e10, 2.0};
+    siridb_points_t * points = siridb_points_new(8, tp);
+    qp_via_t val;
+    unsigned int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        if (tp == TP_INT)
+        {
+            val.int64 = values[i];
+        }
+        else
+        {
+            val.real = reals[i];
+        }
+        siridb_points_add_point(points, &timestamps[i], &val);
+    }
+
+    return points;
+}
+
+static int check_packed(
+        siridb_points_t * points,
+        qp_packer_t * packer,
+        uint64_t factor)
+{
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_ts, qp_val;
+    siridb_point_t * point = points->data;
+    size_t i;
+
+    qp_unpacker_init(&unpacker, packer->buffer, packer->len);
+
+    if (qp_next(&unpacker, NULL) != QP_ARRAY_OPEN)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < points->len; i++, point++)
+    {
+        if (    qp_next(&unpacker, NULL) != QP_ARRAY2 ||
+                qp_next(&unpacker, &qp_ts) != QP_INT64 ||
+                qp_ts.via.int64 != (int64_t) (point->ts * factor))
+        {
+            return -1;
+        }
+        qp_next(&unpacker, &qp_val);
+        if (points->tp == TP_INT
+                ? (qp_val.tp != QP_INT64 ||
+                        qp_val.via.int64 != point->val.int64)
+                : (qp_val.tp != QP_DOUBLE ||
+                        qp_val.via.real != point->val.real))
+        {
+            return -1;
+        }
+    }
+
+    return (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE &&
+            qp_next(&unpacker, NULL) == QP_END) ? 0 : -1;
+}
+
+static int test_pack(void)
+{
+    test_start("points (pack)");
+
+    {
+        siridb_points_t * points = prepare_points(TP_INT);
+        qp_packer_t * packer = qp_packer_new(8);
+
+        _assert (siridb_points_pack(points, packer) == 0);
+        _assert (check_packed(points, packer, 1) == 0);
+
+        qp_packer_free(packer);
+        siridb_points_free(points);
+    }
+
+    {
+        siridb_points_t * points = prepare_points(TP_DOUBLE);
+        qp_packer_t * packer = qp_packer_new(8);
+
+        _assert (siridb_points_pack(points, packer) == 0);
+        _assert (check_packed(points, packer, 1) == 0);
+
+        qp_packer_free(packer);
+        siridb_points_free(points);
+    }
+
+    {
+        siridb_points_t * points = prepare_points(TP_INT);
+        qp_packer_t * packer = qp_packer_new(8);
+
+        _assert (siridb_points_pack_factor(points, packer, 1000.0) == 0);
+        _assert (check_packed(points, packer, 1000) == 0);
+        /* points itself should not be changed by the factor */
+        _assert (points->data[7].ts == 5000000000);
+
+        qp_packer_free(packer);
+        siridb_points_free(points);
+    }
+
+    {
+        siridb_points_t * points = siridb_points_new(0, TP_DOUBLE);
+        qp_packer_t * packer = qp_packer_new(8);
+
+        _assert (siridb_points_pack(points, packer) == 0);
+        _assert (packer->len == 2);
+        _assert (check_packed(points, packer, 1) == 0);
+
+        qp_packer_free(packer);
+        siridb_points_free(points);
+    }
+
+    return test_end();
+}
+
+static int test_next_point(void)
+{
+    test_start("points (next point)");
+
+    qp_packer_t * packer = qp_packer_new(8);
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_val;
+    int64_t ts;
+
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 1);
+    qp_add_int64(packer, -60);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 5000000000);
+    qp_add_double(packer, 0.5);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 300);
+    qp_add_double(packer, -1.0);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 70000);
+    qp_add_string(packer, "string");
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 2);
+
+    qp_unpacker_init(&unpacker, packer->buffer, packer->len);
+
+    _assert (qp_next_point(&unpacker, &ts, &qp_val) == 0);
+    _assert (ts == 1 && qp_val.tp == QP_INT64 && qp_val.via.int64 == -60);
+    _assert (qp_next_point(&unpacker, &ts, &qp_val) == 0);
+    _assert (ts == 5000000000 && qp_val.tp == QP_DOUBLE);
+    _assert (qp_val.via.real == 0.5);
+    _assert (qp_next_point(&unpacker, &ts, &qp_val) == 0);
+    _assert (ts == 300 && qp_val.tp == QP_DOUBLE && qp_val.via.real == -1.0);
+
+    /* string values should fall back to qp_next() */
+    _assert (qp_next_point(&unpacker, &ts, &qp_val) == -1);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY2);
+    _assert (qp_next(&unpacker, &qp_val) == QP_INT64);
+    _assert (qp_next(&unpacker, &qp_val) == QP_RAW);
+
+    /* incomplete point */
+    _assert (qp_next_point(&unpacker, &ts, &qp_val) == -1);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY2);
+
+    qp_packer_free(packer);
+
+    return test_end();
+}
+
+int main()
+{
+    return (
+        test_pack() ||
+        test_next_point() ||
+        0
+    );
+}
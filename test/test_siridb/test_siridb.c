@@ -1,7 +1,38 @@
 #include "../test.h"
+#include <cexpr/cexpr.h>
+#include <fcntl.h>
 #include <locale.h>
+#include <logger/logger.h>
+#include <math.h>
+#include <omap/omap.h>
+#include <siri/db/aggregate.h>
+#include <siri/db/batch.h>
+#include <siri/db/buffer.h>
+#include <siri/db/cursor.h>
+#include <siri/db/flush.h>
+#include <siri/db/queries.h>
+#include <siri/db/query.h>
+#include <siri/db/scan.h>
 #include <siri/db/series.h>
 #include <siri/db/shard.h>
+#include <siri/db/shards.h>
+#include <siri/db/share.h>
+#include <siri/db/subscriptions.h>
+#include <siri/db/tags.h>
+#include <siri/db/tee.h>
+#include <siri/db/time.h>
+#include <siri/db/topk.h>
+#include <siri/net/pkg.h>
+#include <siri/net/promise.h>
+#include <siri/net/promises.h>
+#include <siri/net/protocol.h>
+#include <siri/net/stream.h>
+#include <siri/grammar/grammar.h>
+#include <siri/optimize.h>
+#include <siri/siri.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 static int test_series_ensure_type(void)
@@ -113,10 +144,2294 @@ static int test_series_ensure_type(void)
     return test_end();
 };
 
+static sirinet_pkg_t * test_batch_pkg(const char * queries[], size_t n)
+{
+    qp_packer_t * packer = sirinet_packer_new(256);
+    size_t i;
+
+    qp_add_type(packer, QP_ARRAY_OPEN);
+    for (i = 0; i < n; i++)
+    {
+        qp_add_type(packer, (i % 2) ? QP_ARRAY1 : QP_ARRAY2);
+        qp_add_string(packer, queries[i]);
+        if (i % 2 == 0)
+        {
+            qp_add_int64(packer, 3);  /* time precision */
+        }
+    }
+    qp_add_type(packer, QP_ARRAY_CLOSE);
+
+    return sirinet_packer2pkg(packer, 0, CPROTO_REQ_QUERY_BATCH);
+}
+
+static int test_batch_count(void)
+{
+    test_start("siridb (batch_count)");
+
+    const char * queries[] = {
+        "select * from 'a'",
+        "list series",
+        "count series"
+    };
+    sirinet_pkg_t * pkg;
+    qp_packer_t * packer;
+    size_t i;
+
+    /* valid batches */
+    {
+        pkg = test_batch_pkg(queries, 3);
+        _assert (siridb_batch_count(pkg) == 3);
+        free(pkg);
+
+        pkg = test_batch_pkg(queries, 0);
+        _assert (siridb_batch_count(pkg) == 0);
+        free(pkg);
+
+        packer = sirinet_packer_new(64);
+        qp_add_type(packer, QP_ARRAY1);
+        qp_add_type(packer, QP_ARRAY1);
+        qp_add_string(packer, queries[0]);
+        pkg = sirinet_packer2pkg(packer, 0, CPROTO_REQ_QUERY_BATCH);
+        _assert (siridb_batch_count(pkg) == 1);
+        free(pkg);
+    }
+
+    /* not a batch */
+    {
+        packer = sirinet_packer_new(64);
+        qp_add_string(packer, queries[0]);
+        pkg = sirinet_packer2pkg(packer, 0, CPROTO_REQ_QUERY_BATCH);
+        _assert (siridb_batch_count(pkg) == -1);
+        free(pkg);
+
+        pkg = sirinet_pkg_new(0, 0, CPROTO_REQ_QUERY_BATCH, NULL);
+        _assert (siridb_batch_count(pkg) == -1);
+        free(pkg);
+    }
+
+    /* query is not a string */
+    {
+        packer = sirinet_packer_new(64);
+        qp_add_type(packer, QP_ARRAY_OPEN);
+        qp_add_type(packer, QP_ARRAY1);
+        qp_add_int64(packer, 42);
+        qp_add_type(packer, QP_ARRAY_CLOSE);
+        pkg = sirinet_packer2pkg(packer, 0, CPROTO_REQ_QUERY_BATCH);
+        _assert (siridb_batch_count(pkg) == -1);
+        free(pkg);
+    }
+
+    /* query with too many values */
+    {
+        packer = sirinet_packer_new(64);
+        qp_add_type(packer, QP_ARRAY_OPEN);
+        qp_add_type(packer, QP_ARRAY3);
+        qp_add_string(packer, queries[0]);
+        qp_add_int64(packer, 3);
+        qp_add_int64(packer, 3);
+        qp_add_type(packer, QP_ARRAY_CLOSE);
+        pkg = sirinet_packer2pkg(packer, 0, CPROTO_REQ_QUERY_BATCH);
+        _assert (siridb_batch_count(pkg) == -1);
+        free(pkg);
+    }
+
+    /* too many queries */
+    {
+        packer = sirinet_packer_new(64);
+        qp_add_type(packer, QP_ARRAY_OPEN);
+        for (i = 0; i <= SIRIDB_BATCH_MAX_QUERIES; i++)
+        {
+            qp_add_type(packer, QP_ARRAY1);
+            qp_add_string(packer, queries[2]);
+        }
+        qp_add_type(packer, QP_ARRAY_CLOSE);
+        pkg = sirinet_packer2pkg(packer, 0, CPROTO_REQ_QUERY_BATCH);
+        _assert (siridb_batch_count(pkg) == -1);
+        free(pkg);
+    }
+
+    return test_end();
+}
+
+static sirinet_promise_t * test_batch_promise(
+        siridb_server_t * server,
+        sirinet_pkg_t * pkg)
+{
+    sirinet_promise_t * promise = calloc(1, sizeof(sirinet_promise_t));
+    promise->ref = 1;
+    promise->server = server;
+    promise->data = pkg;
+    return promise;
+}
+
+static void test_batch_free(vec_t ** qpromises, size_t n)
+{
+    sirinet_promise_t * promise;
+    size_t i, j;
+
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < qpromises[i]->len; j++)
+        {
+            promise = qpromises[i]->data[j];
+            if (promise != NULL)
+            {
+                free(promise->data);
+                sirinet_promise_decref(promise);
+            }
+        }
+        vec_free(qpromises[i]);
+    }
+    free(qpromises);
+}
+
+static int test_batch_split(void)
+{
+    test_start("siridb (batch_split)");
+
+    siridb_server_t server;
+    sirinet_promise_t * promise;
+    sirinet_pkg_t * pkg;
+    qp_packer_t * packer;
+    vec_t * promises = vec_new(4);
+    vec_t ** qpromises;
+    size_t i;
+
+    server.name = "server:9010";
+
+    /* an invalid response is logged as an error */
+    logger_init(stderr, LOGGER_CRITICAL);
+
+    /* valid combined response */
+    packer = sirinet_packer_new(64);
+    qp_add_type(packer, QP_ARRAY_OPEN);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, BPROTO_RES_QUERY);
+    qp_add_raw(packer, (const unsigned char *) "abc", 3);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, BPROTO_ERR_QUERY);
+    qp_add_raw(packer, (const unsigned char *) "error", 5);
+    qp_add_type(packer, QP_ARRAY_CLOSE);
+    pkg = sirinet_packer2pkg(packer, 0, BPROTO_RES_QUERY_BATCH);
+    vec_append(promises, test_batch_promise(&server, pkg));
+
+    /* no response from this pool */
+    vec_append(promises, NULL);
+
+    /* error response for the whole batch */
+    pkg = sirinet_pkg_new(
+            0, 5, BPROTO_ERR_QUERY, (const unsigned char *) "error");
+    vec_append(promises, test_batch_promise(&server, pkg));
+
+    /* combined response with only one result */
+    packer = sirinet_packer_new(64);
+    qp_add_type(packer, QP_ARRAY_OPEN);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, BPROTO_RES_QUERY);
+    qp_add_raw(packer, (const unsigned char *) "xy", 2);
+    qp_add_type(packer, QP_ARRAY_CLOSE);
+    pkg = sirinet_packer2pkg(packer, 0, BPROTO_RES_QUERY_BATCH);
+    vec_append(promises, test_batch_promise(&server, pkg));
+
+    qpromises = siridb_batch_split(promises, 2);
+    _assert (qpromises != NULL);
+
+    for (i = 0; i < 2; i++)
+    {
+        _assert (qpromises[i]->len == 4);
+        _assert (qpromises[i]->data[1] == NULL);
+    }
+
+    /* first pool */
+    promise = qpromises[0]->data[0];
+    pkg = promise->data;
+    _assert (promise->server == &server);
+    _assert (pkg->tp == BPROTO_RES_QUERY);
+    _assert (pkg->len == 3 && memcmp(pkg->data, "abc", 3) == 0);
+
+    promise = qpromises[1]->data[0];
+    pkg = promise->data;
+    _assert (pkg->tp == BPROTO_ERR_QUERY);
+    _assert (pkg->len == 5 && memcmp(pkg->data, "error", 5) == 0);
+
+    /* the error for the whole batch is copied for each query */
+    for (i = 0; i < 2; i++)
+    {
+        promise = qpromises[i]->data[2];
+        pkg = promise->data;
+        _assert (pkg->tp == BPROTO_ERR_QUERY);
+        _assert (pkg->len == 5 && memcmp(pkg->data, "error", 5) == 0);
+    }
+
+    /* the missing result has no package */
+    promise = qpromises[0]->data[3];
+    pkg = promise->data;
+    _assert (pkg->tp == BPROTO_RES_QUERY);
+    _assert (pkg->len == 2 && memcmp(pkg->data, "xy", 2) == 0);
+
+    promise = qpromises[1]->data[3];
+    _assert (promise != NULL && promise->data == NULL);
+
+    test_batch_free(qpromises, 2);
+
+    for (i = 0; i < promises->len; i++)
+    {
+        promise = promises->data[i];
+        if (promise != NULL)
+        {
+            free(promise->data);
+            sirinet_promise_decref(promise);
+        }
+    }
+    vec_free(promises);
+
+    return test_end();
+}
+
+static siridb_series_t * test_series_new(
+        siridb_t * siridb,
+        uint32_t id,
+        const char * name,
+        uint8_t tp)
+{
+    siridb_series_t * series = calloc(1, sizeof(siridb_series_t));
+    series->ref = 1;
+    series->id = id;
+    series->tp = tp;
+    series->name = strdup(name);
+    series->name_len = strlen(name);
+    series->siridb = siridb;
+    return series;
+}
+
+static void test_series_free(siridb_series_t * series)
+{
+    if (series->buffer != NULL)
+    {
+        siridb_points_free(series->buffer);
+    }
+    free(series->name);
+    free(series);
+}
+
+static int test_buffer_map(void)
+{
+    test_start("siridb (buffer_map)");
+
+    char path[] = "/tmp/siridb_test_buffer_XXXXXX";
+    char fn[64];
+    siri_cfg_t cfg;
+    siridb_t siridb;
+    siridb_series_t * series[100];
+    struct stat st;
+    uint64_t ts;
+    qp_via_t val;
+    size_t i;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+    memset(&cfg, 0, sizeof(siri_cfg_t));
+    memset(&siridb, 0, sizeof(siridb_t));
+    siri.cfg = &cfg;
+
+    _assert (mkdtemp(path) != NULL);
+    snprintf(fn, sizeof(fn), "%s/buffer.dat", path);
+
+    siridb.series_map = imap_new();
+    siridb.buffer = siridb_buffer_new();
+    siridb_buffer_set_path(siridb.buffer, path);
+    siridb.buffer->size = 512;
+
+    /* a new buffer file is created */
+    _assert (siridb_buffer_load(&siridb) == 0);
+    _assert (siridb_buffer_open(siridb.buffer) == 0);
+    _assert (siridb.buffer->len == 32);
+
+    /* the mapping grows twice, with 64 buffer spaces each time */
+    for (i = 0; i < 100; i++)
+    {
+        series[i] = test_series_new(&siridb, i + 1, "series", TP_INT);
+        imap_add(siridb.series_map, series[i]->id, series[i]);
+        _assert (siridb_buffer_new_series(siridb.buffer, series[i]) == 0);
+        _assert ((size_t) series[i]->bf_offset == i * 512);
+    }
+    _assert (siridb.buffer->map_sz == 128 * 512);
+    _assert (stat(fn, &st) == 0 && st.st_size == 128 * 512);
+    _assert (siridb.buffer->empty->len == 28);
+
+    /* write a point in the first and in the last buffer space */
+    for (i = 0; i < 100; i += 99)
+    {
+        ts = 1000 + i;
+        val.int64 = (int64_t) i;
+        siridb_points_add_point(series[i]->buffer, &ts, &val);
+        _assert (siridb_buffer_write_point(
+                siridb.buffer, series[i], &ts, &val) == 0);
+    }
+
+    _assert (siridb_buffer_fsync(siridb.buffer) == 0);
+    siridb_buffer_free(siridb.buffer);
+
+    /* reopen the buffer file, it is used in place */
+    for (i = 0; i < 100; i++)
+    {
+        siridb_points_free(series[i]->buffer);
+        series[i]->buffer = NULL;
+        series[i]->bf_offset = 0;
+    }
+
+    siridb.buffer = siridb_buffer_new();
+    siridb_buffer_set_path(siridb.buffer, path);
+    siridb.buffer->size = 512;
+
+    _assert (siridb_buffer_load(&siridb) == 0);
+    _assert (siridb_buffer_open(siridb.buffer) == 0);
+    _assert (siridb.buffer->map_sz == 128 * 512);
+    _assert (siridb.buffer->empty->len == 28);
+
+    for (i = 0; i < 100; i++)
+    {
+        _assert (series[i]->buffer != NULL);
+        _assert ((size_t) series[i]->bf_offset == i * 512);
+        _assert (series[i]->buffer->len == (i == 0 || i == 99));
+    }
+    _assert (series[99]->buffer->data->ts == 1099);
+    _assert (series[99]->buffer->data->val.int64 == 99);
+
+    /* the next series re-uses an empty buffer space */
+    series[0]->buffer->len = 0;
+    _assert (siridb_buffer_write_empty(siridb.buffer, series[0]) == 0);
+
+    siridb_buffer_free(siridb.buffer);
+    imap_free(siridb.series_map, NULL);
+    for (i = 0; i < 100; i++)
+    {
+        test_series_free(series[i]);
+    }
+
+    _assert (unlink(fn) == 0);
+    _assert (rmdir(path) == 0);
+
+    siri.cfg = NULL;
+
+    return test_end();
+}
+
+#define TEST_SCAN_SZ 200000
+
+static int test_scan_done;
+
+static void test_scan_cb(uv_async_t * handle)
+{
+    test_scan_done++;
+    uv_close((uv_handle_t *) handle, NULL);
+}
+
+/*
+ * Run a parallel scan for 'length > 4' on all series and wait until the
+ * async call-back of the query is called.
+ */
+static int test_scan_run(
+        siridb_query_t * query,
+        siridb_series_t ** series,
+        siridb_scan_tp tp,
+        size_t * n,
+        size_t limit)
+{
+    query_wrapper_t * q_wrapper = query->data;
+    cexpr_t * where_expr = calloc(1, sizeof(cexpr_t));
+    cexpr_condition_t * cond = calloc(1, sizeof(cexpr_condition_t));
+    uv_async_t handle;
+    size_t i;
+
+    cond->prop = CLERI_GID_K_LENGTH;
+    cond->operator = CEXPR_GT;
+    cond->int64 = 4;
+    where_expr->operator = CEXPR_AND;
+    where_expr->tp_a = 2;  /* condition */
+    where_expr->via_a.cond = cond;
+
+    q_wrapper->where_expr = where_expr;
+    q_wrapper->vec = vec_new(TEST_SCAN_SZ);
+    for (i = 0; i < TEST_SCAN_SZ; i++)
+    {
+        siridb_series_incref(series[i]);
+        vec_append(q_wrapper->vec, series[i]);
+    }
+
+    uv_async_init(siri.loop, &handle, test_scan_cb);
+    handle.data = query;
+    test_scan_done = 0;
+
+    if (siridb_scan_start(&handle, tp, n, limit))
+    {
+        return -1;
+    }
+
+    uv_run(siri.loop, UV_RUN_DEFAULT);
+
+    if (q_wrapper->where_expr != NULL)
+    {
+        cexpr_free(q_wrapper->where_expr);
+        q_wrapper->where_expr = NULL;
+    }
+
+    return test_scan_done == 1 ? 0 : -1;
+}
+
+static int test_scan(void)
+{
+    test_start("siridb (scan)");
+
+    siridb_t siridb;
+    siridb_query_t query;
+    query_wrapper_t q_wrapper;
+    sirinet_stream_t client;
+    uv_loop_t loop;
+    siridb_series_t ** series;
+    size_t i, n;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+
+    memset(&siridb, 0, sizeof(siridb_t));
+    memset(&query, 0, sizeof(siridb_query_t));
+    memset(&q_wrapper, 0, sizeof(query_wrapper_t));
+    memset(&client, 0, sizeof(sirinet_stream_t));
+
+    uv_loop_init(&loop);
+    uv_mutex_init(&siridb.series_mutex);
+    siri.loop = &loop;
+    client.siridb = &siridb;
+    query.ref = 1;
+    query.client = &client;
+    query.data = &q_wrapper;
+
+    series = malloc(TEST_SCAN_SZ * sizeof(siridb_series_t *));
+    for (i = 0; i < TEST_SCAN_SZ; i++)
+    {
+        series[i] = test_series_new(&siridb, i + 1, "series", TP_INT);
+        series[i]->length = i % 10;
+    }
+
+    /* count series */
+    {
+        n = 0;
+        _assert (test_scan_run(&query, series, SIRIDB_SCAN_COUNT, &n, 0) == 0);
+        _assert (n == TEST_SCAN_SZ / 2);
+        _assert (q_wrapper.vec->len == 0);
+        vec_free(q_wrapper.vec);
+    }
+
+    /* count series length */
+    {
+        n = 0;
+        _assert (test_scan_run(&query, series, SIRIDB_SCAN_LENGTH, &n, 0) == 0);
+        _assert (n == (TEST_SCAN_SZ / 10) * (5 + 6 + 7 + 8 + 9));
+        _assert (q_wrapper.vec->len == 0);
+        vec_free(q_wrapper.vec);
+    }
+
+    /* list series, the order is kept */
+    {
+        _assert (test_scan_run(
+                &query, series, SIRIDB_SCAN_MATCH, NULL, SIZE_MAX) == 0);
+        _assert (q_wrapper.vec->len == TEST_SCAN_SZ / 2);
+        for (i = 0; i < q_wrapper.vec->len; i++)
+        {
+            siridb_series_t * s = q_wrapper.vec->data[i];
+            _assert (s == series[(i / 5) * 10 + 5 + i % 5]);
+            siridb_series_decref(s);
+        }
+        vec_free(q_wrapper.vec);
+    }
+
+    /* list series with a limit */
+    {
+        _assert (test_scan_run(
+                &query, series, SIRIDB_SCAN_MATCH, NULL, 7) == 0);
+        _assert (q_wrapper.vec->len == 7);
+        for (i = 0; i < q_wrapper.vec->len; i++)
+        {
+            siridb_series_t * s = q_wrapper.vec->data[i];
+            _assert (s == series[(i / 5) * 10 + 5 + i % 5]);
+            siridb_series_decref(s);
+        }
+        vec_free(q_wrapper.vec);
+    }
+
+    /* all references which were taken by the scans are released */
+    for (i = 0; i < TEST_SCAN_SZ; i++)
+    {
+        _assert (series[i]->ref == 1);
+        test_series_free(series[i]);
+    }
+    free(series);
+
+    uv_mutex_destroy(&siridb.series_mutex);
+    uv_loop_close(&loop);
+    siri.loop = NULL;
+
+    return test_end();
+}
+
+static int test_shards_size(void)
+{
+    test_start("siridb (shards_size)");
+
+    char path[] = "/tmp/siridb_test_shards_XXXXXX";
+    char dbpath[64], shards_path[64];
+    char * old_fn, * new_fn;
+    siri_cfg_t cfg;
+    siridb_t siridb;
+    siridb_series_t * series;
+    siridb_points_t * points;
+    siridb_shard_t * shard, * new_shard;
+    omap_t * shards;
+    uint16_t cinfo = 0;
+    uint64_t ts;
+    qp_via_t val;
+    size_t total;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+    memset(&cfg, 0, sizeof(siri_cfg_t));
+    memset(&siridb, 0, sizeof(siridb_t));
+    siri.cfg = &cfg;
+    siri.fh = siri_fh_new(8);
+
+    _assert (mkdtemp(path) != NULL);
+    snprintf(dbpath, sizeof(dbpath), "%s/", path);
+    snprintf(shards_path, sizeof(shards_path), "%s/%s", path,
+            SIRIDB_SHARDS_PATH);
+    _assert (mkdir(shards_path, 0700) == 0);
+
+    siridb.dbpath = dbpath;
+    siridb.time = siridb_time_new(SIRIDB_TIME_SECONDS);
+    shards = omap_create();
+
+    series = test_series_new(&siridb, 1, "series", TP_INT);
+    points = siridb_points_new(10, TP_INT);
+    for (ts = 0; ts < 10; ts++)
+    {
+        val.int64 = ts;
+        siridb_points_add_point(points, &ts, &val);
+    }
+
+    /* a new shard is counted including the points written */
+    shard = siridb_shard_create(
+            &siridb, shards, 0, 86400, SIRIDB_SHARD_TP_NUMBER, NULL);
+    _assert (shard != NULL);
+    _assert (siridb_shard_write_points(
+            &siridb, series, shard, points, 0, 10, NULL, &cinfo) != 0);
+    _assert (siridb.shards_size[SIRIDB_SHARD_TP_NUMBER] == shard->len);
+
+    /* while optimizing only the new shard is counted */
+    new_shard = siridb_shard_create(
+            &siridb, shards, 0, 86400, SIRIDB_SHARD_TP_NUMBER, shard);
+    _assert (new_shard != NULL);
+    _assert (shard->replaced);
+    _assert (siridb.shards_size[SIRIDB_SHARD_TP_NUMBER] == new_shard->len);
+
+    /* points inserted while optimizing are written to both shards */
+    _assert (siridb_shard_write_points(
+            &siridb, series, new_shard, points, 0, 10, NULL, &cinfo) != 0);
+    _assert (siridb_shard_write_points(
+            &siridb, series, shard, points, 0, 10, NULL, &cinfo) != 0);
+    _assert (siridb.shards_size[SIRIDB_SHARD_TP_NUMBER] == new_shard->len);
+
+    /* a batched write to the replaced shard is not counted either */
+    total = siridb.shards_size[SIRIDB_SHARD_TP_NUMBER];
+    _assert (siridb_shard_wbuf_start(shard) == 0);
+    _assert (siridb_shard_write_points(
+            &siridb, series, shard, points, 0, 10, NULL, &cinfo) != 0);
+    _assert (siridb_shard_wbuf_write(shard) == 0);
+    _assert (siridb.shards_size[SIRIDB_SHARD_TP_NUMBER] == total);
+
+    /* clean up, the new shard holds the reference to the old shard */
+    old_fn = strdup(shard->fn);
+    new_fn = strdup(new_shard->fn);
+    _assert (siri_optimize_finish_idx(shard->fn, 0) == 0);
+    siridb_shard_idx_file(idx_fn, old_fn);
+
+    omap_destroy(shards, NULL);
+    siridb_shard_decref(new_shard);
+    siridb_points_free(points);
+    test_series_free(series);
+    free(siridb.time);
+
+    _assert (unlink(old_fn) == 0);
+    _assert (unlink(new_fn) == 0);
+    _assert (unlink(idx_fn) == 0);
+    _assert (rmdir(shards_path) == 0);
+    _assert (rmdir(path) == 0);
+    free(old_fn);
+    free(new_fn);
+
+    siri_fh_free(siri.fh);
+    siri.fh = NULL;
+    siri.cfg = NULL;
+
+    return test_end();
+}
+
+typedef struct
+{
+    int64_t sum;        /* sum of the values in all query responses */
+    size_t handled;     /* number of packages handled by the each_cb */
+    size_t kept;        /* number of bytes kept for the promises cb */
+    size_t errors;      /* number of error responses and failed promises */
+} test_promises_t;
+
+static int64_t test_promises_sum(sirinet_pkg_t * pkg)
+{
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_val;
+    int64_t sum = 0;
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+    while (qp_next(&unpacker, &qp_val) == QP_INT64)
+    {
+        sum += qp_val.via.int64;
+    }
+    return sum;
+}
+
+static int test_promises_each_cb(
+        sirinet_promise_t * promise __attribute__((unused)),
+        sirinet_pkg_t * pkg,
+        test_promises_t * result)
+{
+    if (pkg->tp != BPROTO_RES_QUERY)
+    {
+        return 0;
+    }
+    result->sum += test_promises_sum(pkg);
+    result->handled++;
+    return 1;
+}
+
+static void test_promises_cb(vec_t * promises, test_promises_t * result)
+{
+    size_t i;
+
+    for (i = 0; i < promises->len; i++)
+    {
+        sirinet_promise_t * promise = promises->data[i];
+        sirinet_pkg_t * pkg = promise->data;
+
+        if (pkg == NULL || pkg->tp != BPROTO_RES_QUERY)
+        {
+            result->errors++;
+        }
+        else
+        {
+            /* not handled by the each_cb, an empty package adds nothing */
+            result->sum += test_promises_sum(pkg);
+        }
+
+        if (pkg != NULL)
+        {
+            result->kept += pkg->len;
+        }
+
+        free(pkg);
+        sirinet_promise_decref(promise);
+    }
+}
+
+/*
+ * Send three query responses, an error response and a failed promise to
+ * promises with or without an each_cb.
+ */
+static void test_promises_run(
+        test_promises_t * result,
+        sirinet_promises_each_cb each_cb)
+{
+    sirinet_promises_t * promises;
+    sirinet_promise_t * promise;
+    sirinet_pkg_t * pkg;
+    qp_packer_t * packer;
+    int64_t i, n;
+
+    memset(result, 0, sizeof(test_promises_t));
+
+    promises = sirinet_promises_new(
+            5,
+            (sirinet_promises_cb) test_promises_cb,
+            result,
+            sirinet_pkg_new(0, 0, BPROTO_QUERY_SERVER, NULL));
+    promises->each_cb = each_cb;
+
+    for (n = 0; n < 5; n++)
+    {
+        promise = calloc(1, sizeof(sirinet_promise_t));
+        promise->ref = 1;
+        promise->data = promises;
+
+        packer = sirinet_packer_new(64);
+        if (n == 3)
+        {
+            qp_add_type(packer, QP_MAP_OPEN);
+            qp_add_raw(packer, (const unsigned char *) "error_msg", 9);
+            qp_add_raw(packer, (const unsigned char *) "error", 5);
+            pkg = sirinet_packer2pkg(packer, 0, BPROTO_ERR_QUERY);
+        }
+        else
+        {
+            for (i = 0; i < 100; i++)
+            {
+                qp_add_int64(packer, n * 100 + i);
+            }
+            pkg = sirinet_packer2pkg(packer, 0, BPROTO_RES_QUERY);
+        }
+
+        sirinet_promises_on_response(
+                promise,
+                pkg,
+                (n == 4) ? PROMISE_WRITE_ERROR : PROMISE_SUCCESS);
+        free(pkg);
+    }
+}
+
+static int test_promises_each(void)
+{
+    test_start("siridb (promises_each)");
+
+    test_promises_t buffered, streamed;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+
+    test_promises_run(&buffered, NULL);
+    test_promises_run(
+            &streamed,
+            (sirinet_promises_each_cb) test_promises_each_cb);
+
+    /* both paths produce the same result */
+    _assert (buffered.sum == 300 * 299 / 2);
+    _assert (streamed.sum == buffered.sum);
+    _assert (buffered.errors == 2);
+    _assert (streamed.errors == 2);
+
+    /* handled packages are released, only the error response is kept */
+    _assert (buffered.handled == 0);
+    _assert (streamed.handled == 3);
+    _assert (streamed.kept > 0);
+    _assert (streamed.kept < 64);
+    _assert (buffered.kept > 3 * 100 + streamed.kept);
+
+    return test_end();
+}
+
+static void test_buffer_fill(
+        siridb_t * siridb,
+        siridb_series_t * series,
+        uint64_t ts,
+        size_t n)
+{
+    qp_via_t val;
+
+    for (; n--; ts++)
+    {
+        val.int64 = (int64_t) ts;
+        siridb_points_add_point(series->buffer, &ts, &val);
+        siridb_series_length_add(series, 1);
+        siridb_buffer_write_point(siridb->buffer, series, &ts, &val);
+    }
+}
+
+static int test_buffer_flush(void)
+{
+    test_start("siridb (buffer_flush)");
+
+    char path[] = "/tmp/siridb_test_flush_XXXXXX";
+    char dbpath[64], shards_path[64], fn[64];
+    char * shard_fn;
+    siri_cfg_t cfg;
+    siridb_t siridb;
+    siridb_series_t * series;
+    siridb_shard_t * shard;
+    omap_t * shards;
+    uv_loop_t loop;
+    size_t i;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+    memset(&cfg, 0, sizeof(siri_cfg_t));
+    memset(&siridb, 0, sizeof(siridb_t));
+    siri.cfg = &cfg;
+    siri.fh = siri_fh_new(8);
+    siri.loop = &loop;
+    uv_loop_init(&loop);
+
+    _assert (mkdtemp(path) != NULL);
+    snprintf(dbpath, sizeof(dbpath), "%s/", path);
+    snprintf(shards_path, sizeof(shards_path), "%s/%s", path,
+            SIRIDB_SHARDS_PATH);
+    snprintf(fn, sizeof(fn), "%s/buffer.dat", path);
+    _assert (mkdir(shards_path, 0700) == 0);
+
+    siridb.ref = 1;
+    siridb.dbpath = dbpath;
+    siridb.time = siridb_time_new(SIRIDB_TIME_SECONDS);
+    siridb.duration_num = 604800;
+    siridb.series_map = imap_new();
+    siridb.shards = imap_new();
+    siridb.flush = siridb_flush_new();
+    uv_mutex_init(&siridb.series_mutex);
+    uv_mutex_init(&siridb.shards_mutex);
+    uv_mutex_init(&siridb.values_mutex);
+
+    siridb.buffer = siridb_buffer_new();
+    siridb_buffer_set_path(siridb.buffer, path);
+    siridb.buffer->size = 512;
+
+    _assert (siridb_buffer_load(&siridb) == 0);
+    _assert (siridb_buffer_open(siridb.buffer) == 0);
+    _assert (siridb.buffer->len == 32);
+
+    series = test_series_new(&siridb, 1, "series", TP_INT);
+    imap_add(siridb.series_map, series->id, series);
+    _assert (siridb_buffer_new_series(siridb.buffer, series) == 0);
+    _assert (series->bf_offset == 0);
+    _assert (siridb.buffer->empty->len == 63);
+
+    /* a full buffer is swapped and flushed in the background */
+    {
+        test_buffer_fill(&siridb, series, 100, 31);
+
+        /* the worker starts right away, like insert we hold the lock */
+        uv_mutex_lock(&siridb.series_mutex);
+        _assert (siridb_flush_series(&siridb, series) == 0);
+        _assert (series->flushing != NULL);
+        _assert (series->flushing->len == 31);
+        _assert (series->buffer->len == 0);
+        _assert (series->bf_flush == 0);
+        _assert (series->bf_offset == 512);
+        _assert (siridb.buffer->empty->len == 62);
+        _assert (series->ref == 2);
+        uv_mutex_unlock(&siridb.series_mutex);
+
+        uv_run(&loop, UV_RUN_DEFAULT);
+
+        /* the points are written and the buffer space is released */
+        _assert (siridb.flush->is_running == 0);
+        _assert (series->flushing == NULL);
+        _assert (series->ref == 1);
+        _assert (series->idx_len == 1);
+        _assert (series->idx->len == 31);
+        _assert (series->idx->start_ts == 100);
+        _assert (series->idx->end_ts == 130);
+        _assert (series->length == 31);
+        _assert (siridb.buffer->empty->len == 63);
+        _assert (siridb.buffer->empty->data[62] == (void *) 0);
+    }
+
+    /* SiriDB stops before a flush has finished */
+    {
+        test_buffer_fill(&siridb, series, 200, 31);
+        _assert (siridb_buffer_swap(siridb.buffer, series) == 0);
+        _assert (series->bf_flush == 512);
+        _assert (series->bf_offset == 0);
+        test_buffer_fill(&siridb, series, 300, 3);
+        _assert (series->length == 65);
+
+        _assert (siridb_buffer_fsync(siridb.buffer) == 0);
+        siridb_buffer_free(siridb.buffer);
+
+        siridb_points_free(series->buffer);
+        siridb_points_free(series->flushing);
+        series->buffer = NULL;
+        series->flushing = NULL;
+        series->length = 31;
+    }
+
+    /* both buffer spaces are loaded and the pending points are written */
+    {
+        siridb.buffer = siridb_buffer_new();
+        siridb_buffer_set_path(siridb.buffer, path);
+        siridb.buffer->size = 512;
+
+        _assert (siridb_buffer_load(&siridb) == 0);
+        _assert (siridb_buffer_open(siridb.buffer) == 0);
+
+        _assert (series->buffer != NULL);
+        _assert (series->buffer->len == 3);
+        _assert (series->buffer->data->ts == 300);
+        _assert (series->bf_offset == 0);
+        _assert (series->flushing == NULL);
+        _assert (series->idx_len == 2);
+        _assert (series->idx[1].len == 31);
+        _assert (series->idx[1].start_ts == 200);
+        _assert (series->idx[1].end_ts == 230);
+        _assert (series->length == 65);
+        _assert (siridb.buffer->empty->len == 63);
+    }
+
+    /* clean up */
+    shards = imap_get(siridb.shards, 0);
+    _assert (shards != NULL);
+    shard = omap_get(shards, siridb.duration_num);
+    _assert (shard != NULL);
+    shard_fn = strdup(shard->fn);
+
+    for (i = 0; i < series->idx_len; i++)
+    {
+        siridb_shard_decref(series->idx[i].shard);
+    }
+    free(series->idx);
+
+    siridb_buffer_free(siridb.buffer);
+    siridb_flush_free(siridb.flush);
+    omap_destroy(shards, (omap_destroy_cb) siridb__shard_decref);
+    imap_free(siridb.shards, NULL);
+    imap_free(siridb.series_map, NULL);
+    test_series_free(series);
+    free(siridb.time);
+
+    uv_mutex_destroy(&siridb.series_mutex);
+    uv_mutex_destroy(&siridb.shards_mutex);
+    uv_mutex_destroy(&siridb.values_mutex);
+    uv_loop_close(&loop);
+
+    _assert (unlink(shard_fn) == 0);
+    _assert (unlink(fn) == 0);
+    _assert (rmdir(shards_path) == 0);
+    _assert (rmdir(path) == 0);
+    free(shard_fn);
+
+    siri_fh_free(siri.fh);
+    siri.fh = NULL;
+    siri.loop = NULL;
+    siri.cfg = NULL;
+
+    return test_end();
+}
+
+#define TEST_OPTIMIZE_DURATION 604800
+
+static int test_shard_points(
+        siridb_series_t * series,
+        siridb_points_t * points)
+{
+    size_t i;
+
+    if (points == NULL || points->len != 20)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < points->len; i++)
+    {
+        if (    points->data[i].ts != i ||
+                points->data[i].val.int64 != (int64_t) (series->id * 1000 + i))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Optimize a shard with interleaved chunks. When 'hints' is set, the read
+ * ahead for selects and dropping the optimized pages from the page cache
+ * are enabled, which must not change the result.
+ */
+static void test_shard_optimize_run(uint8_t hints)
+{
+    char path[] = "/tmp/siridb_test_optimize_XXXXXX";
+    char dbpath[64], shards_path[64];
+    char * shard_fn;
+    siri_cfg_t cfg;
+    siridb_t siridb;
+    siridb_series_t * series[3];
+    siridb_series_t * s;
+    siridb_points_t * points;
+    siridb_shard_t * shard, * new_shard;
+    omap_t * shards;
+    uv_loop_t loop;
+    uint16_t cinfo = 0;
+    uint64_t ts;
+    qp_via_t val;
+    size_t i, r, pos;
+
+    /* chunks are written in this order so series 3 is first in the shard */
+    size_t order[3] = {2, 0, 1};
+
+    logger_init(stderr, LOGGER_CRITICAL);
+    memset(&cfg, 0, sizeof(siri_cfg_t));
+    memset(&siridb, 0, sizeof(siridb_t));
+    cfg.optimize_drop_cache = hints;
+    cfg.select_read_ahead = hints;
+    siri.cfg = &cfg;
+    siri.fh = siri_fh_new(8);
+    siri.loop = &loop;
+    uv_loop_init(&loop);
+    siri_optimize_init(&siri);
+
+    _assert (mkdtemp(path) != NULL);
+    snprintf(dbpath, sizeof(dbpath), "%s/", path);
+    snprintf(shards_path, sizeof(shards_path), "%s/%s", path,
+            SIRIDB_SHARDS_PATH);
+    _assert (mkdir(shards_path, 0700) == 0);
+
+    siridb.dbpath = dbpath;
+    siridb.time = siridb_time_new(SIRIDB_TIME_SECONDS);
+    siridb.series_map = imap_new();
+    siridb.shards = imap_new();
+    siridb.share = siridb_share_new();
+    uv_mutex_init(&siridb.series_mutex);
+    uv_mutex_init(&siridb.shards_mutex);
+
+    shards = omap_create();
+    imap_add(siridb.shards, 0, shards);
+    shard = siridb_shard_create(
+            &siridb,
+            shards,
+            0,
+            TEST_OPTIMIZE_DURATION,
+            SIRIDB_SHARD_TP_NUMBER,
+            NULL);
+    _assert (shard != NULL);
+
+    for (i = 0; i < 3; i++)
+    {
+        series[i] = test_series_new(&siridb, i + 1, "series", TP_INT);
+        series[i]->flags |= SIRIDB_SERIES_IS_32BIT_TS;
+        imap_add(siridb.series_map, series[i]->id, series[i]);
+    }
+
+    /* write two chunks per series, interleaved with the other series */
+    points = siridb_points_new(10, TP_INT);
+    for (r = 0; r < 2; r++)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            s = series[order[i]];
+            points->len = 0;
+            for (ts = r * 10; ts < r * 10 + 10; ts++)
+            {
+                val.int64 = s->id * 1000 + ts;
+                siridb_points_add_point(points, &ts, &val);
+            }
+            pos = siridb_shard_write_points(
+                    &siridb, s, shard, points, 0, 10, NULL, &cinfo);
+            _assert (pos != 0);
+            _assert (siridb_series_add_idx(
+                    s, shard, r * 10, r * 10 + 9, pos, 10, cinfo) == 0);
+            siridb_series_length_add(s, 10);
+        }
+    }
+    siridb_points_free(points);
+
+    _assert (series[2]->idx->pos < series[0]->idx->pos);
+    _assert (series[0]->idx->pos < series[1]->idx->pos);
+
+    /* each series has two chunks in the shard */
+    for (i = 0; i < 3; i++)
+    {
+        _assert (series[i]->idx_len == 2);
+        points = siridb_series_get_points(series[i], NULL, NULL);
+        _assert (test_shard_points(series[i], points) == 0);
+        siridb_points_free(points);
+    }
+
+    /* the caller of optimize holds a reference to the shard */
+    siridb_shard_incref(shard);
+    _assert (siridb_shard_optimize(shard, &siridb) == 0);
+
+    new_shard = omap_get(shards, TEST_OPTIMIZE_DURATION);
+    _assert (new_shard != NULL && new_shard != shard);
+    _assert (new_shard->replacing == NULL);
+    siridb_shard_decref(shard);
+
+    /* the chunks of each series are merged and contain the same points */
+    for (i = 0; i < 3; i++)
+    {
+        _assert (series[i]->idx_len == 1);
+        _assert (series[i]->idx->shard == new_shard);
+        _assert (series[i]->idx->len == 20);
+        _assert (series[i]->idx->start_ts == 0);
+        _assert (series[i]->idx->end_ts == 19);
+        points = siridb_series_get_points(series[i], NULL, NULL);
+        _assert (test_shard_points(series[i], points) == 0);
+        siridb_points_free(points);
+    }
+
+    /* series are optimized in the order of their first chunk position */
+    _assert (series[2]->idx->pos < series[0]->idx->pos);
+    _assert (series[0]->idx->pos < series[1]->idx->pos);
+
+    /* clean up */
+    shard_fn = strdup(new_shard->fn);
+    for (i = 0; i < 3; i++)
+    {
+        siridb_shard_decref(series[i]->idx->shard);
+        free(series[i]->idx);
+        test_series_free(series[i]);
+    }
+
+    omap_destroy(shards, (omap_destroy_cb) siridb__shard_decref);
+    imap_free(siridb.shards, NULL);
+    imap_free(siridb.series_map, NULL);
+    siridb_share_free(siridb.share);
+    free(siridb.time);
+
+    uv_mutex_destroy(&siridb.series_mutex);
+    uv_mutex_destroy(&siridb.shards_mutex);
+    uv_close((uv_handle_t *) &siri.optimize->timer, NULL);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    uv_loop_close(&loop);
+
+    {
+        siridb_shard_idx_file(idx_fn, shard_fn);
+        (void) unlink(idx_fn);
+    }
+    _assert (unlink(shard_fn) == 0);
+    _assert (rmdir(shards_path) == 0);
+    _assert (rmdir(path) == 0);
+    free(shard_fn);
+
+    siri_fh_free(siri.fh);
+    siri.fh = NULL;
+    siri.loop = NULL;
+    siri.cfg = NULL;
+}
+
+static int test_shard_optimize(void)
+{
+    test_start("siridb (shard_optimize)");
+
+    test_shard_optimize_run(0);
+    test_shard_optimize_run(1);
+
+    return test_end();
+}
+
+/*
+ * Read all chunks of a series using the shared chunks.
+ */
+static int test_share_read(siridb_share_t * share, siridb_series_t * series)
+{
+    siridb_points_t * points = siridb_points_new(series->length, series->tp);
+    size_t i;
+    int rc = 0;
+
+    for (i = 0; i < series->idx_len && !rc; i++)
+    {
+        rc = siridb_share_get_points(
+                share, points, series, series->idx + i, NULL, NULL);
+    }
+
+    rc = rc || test_shard_points(series, points);
+    siridb_points_free(points);
+    return rc;
+}
+
+static int test_share(void)
+{
+    test_start("siridb (share)");
+
+    char path[] = "/tmp/siridb_test_share_XXXXXX";
+    char dbpath[64], shards_path[64];
+    char * shard_fn;
+    siri_cfg_t cfg;
+    siridb_t siridb;
+    siridb_series_t * series[2];
+    siridb_points_t * points;
+    siridb_shard_t * shard;
+    siridb_share_t * share;
+    omap_t * shards;
+    uint16_t cinfo = 0;
+    uint64_t ts, gen[4];
+    qp_via_t val;
+    size_t i, r, pos;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+    memset(&cfg, 0, sizeof(siri_cfg_t));
+    memset(&siridb, 0, sizeof(siridb_t));
+    siri.cfg = &cfg;
+    siri.fh = siri_fh_new(8);
+
+    _assert (mkdtemp(path) != NULL);
+    snprintf(dbpath, sizeof(dbpath), "%s/", path);
+    snprintf(shards_path, sizeof(shards_path), "%s/%s", path,
+            SIRIDB_SHARDS_PATH);
+    _assert (mkdir(shards_path, 0700) == 0);
+
+    siridb.dbpath = dbpath;
+    siridb.time = siridb_time_new(SIRIDB_TIME_SECONDS);
+    siridb.series_map = imap_new();
+    siridb.shards = imap_new();
+    siridb.share = share = siridb_share_new();
+    uv_mutex_init(&siridb.series_mutex);
+    uv_mutex_init(&siridb.shards_mutex);
+
+    shards = omap_create();
+    imap_add(siridb.shards, 0, shards);
+    shard = siridb_shard_create(
+            &siridb,
+            shards,
+            0,
+            TEST_OPTIMIZE_DURATION,
+            SIRIDB_SHARD_TP_NUMBER,
+            NULL);
+    _assert (shard != NULL);
+
+    /* two series with two chunks each */
+    points = siridb_points_new(10, TP_INT);
+    for (i = 0; i < 2; i++)
+    {
+        series[i] = test_series_new(&siridb, i + 1, "series", TP_INT);
+        series[i]->flags |= SIRIDB_SERIES_IS_32BIT_TS;
+        imap_add(siridb.series_map, series[i]->id, series[i]);
+
+        for (r = 0; r < 2; r++)
+        {
+            points->len = 0;
+            for (ts = r * 10; ts < r * 10 + 10; ts++)
+            {
+                val.int64 = series[i]->id * 1000 + ts;
+                siridb_points_add_point(points, &ts, &val);
+            }
+            pos = siridb_shard_write_points(
+                    &siridb, series[i], shard, points, 0, 10, NULL, &cinfo);
+            _assert (pos != 0);
+            _assert (siridb_series_add_idx(
+                    series[i], shard, r * 10, r * 10 + 9, pos, 10, cinfo) == 0);
+            siridb_series_length_add(series[i], 10);
+        }
+    }
+    siridb_points_free(points);
+
+    /* a single select query does not store chunks */
+    gen[0] = siridb_share_enter(share);
+    _assert (test_share_read(share, series[0]) == 0);
+    _assert (share->chunks->len == 0 && share->npoints == 0);
+
+    /* with two select queries, the chunks of series 1 are stored */
+    gen[1] = siridb_share_enter(share);
+    _assert (gen[1] > gen[0]);
+    _assert (test_share_read(share, series[0]) == 0);
+    _assert (share->chunks->len == 2 && share->npoints == 20);
+
+    /* the chunks of series 2 are read after two more queries have started */
+    gen[2] = siridb_share_enter(share);
+    gen[3] = siridb_share_enter(share);
+    _assert (test_share_read(share, series[1]) == 0);
+    _assert (share->chunks->len == 4 && share->npoints == 40);
+
+    /* the second query is still running and may use series 1 */
+    siridb_share_leave(share, gen[0]);
+    _assert (share->readers == 3);
+    _assert (share->chunks->len == 4 && share->npoints == 40);
+
+    /* series 1 is only used before the third query has started */
+    siridb_share_leave(share, gen[1]);
+    _assert (share->readers == 2);
+    _assert (share->chunks->len == 2 && share->npoints == 20);
+
+    /* the stored chunks of series 2 are used, series 1 is stored again */
+    _assert (test_share_read(share, series[1]) == 0);
+    _assert (test_share_read(share, series[0]) == 0);
+    _assert (share->chunks->len == 4 && share->npoints == 40);
+
+    /* the last query leaves after the other, all chunks are released */
+    siridb_share_leave(share, gen[3]);
+    _assert (share->readers == 1);
+    _assert (share->chunks->len == 0 && share->npoints == 0);
+    siridb_share_leave(share, gen[2]);
+    _assert (share->readers == 0 && share->active->len == 0);
+
+    /* released chunks no longer hold a reference to the shard */
+    _assert (shard->ref == 1 + 4);
+
+    /* clean up */
+    shard_fn = strdup(shard->fn);
+    for (i = 0; i < 2; i++)
+    {
+        for (r = 0; r < series[i]->idx_len; r++)
+        {
+            siridb_shard_decref(series[i]->idx[r].shard);
+        }
+        free(series[i]->idx);
+        test_series_free(series[i]);
+    }
+
+    omap_destroy(shards, (omap_destroy_cb) siridb__shard_decref);
+    imap_free(siridb.shards, NULL);
+    imap_free(siridb.series_map, NULL);
+    siridb_share_free(share);
+    free(siridb.time);
+
+    uv_mutex_destroy(&siridb.series_mutex);
+    uv_mutex_destroy(&siridb.shards_mutex);
+
+    {
+        siridb_shard_idx_file(idx_fn, shard_fn);
+        (void) unlink(idx_fn);
+    }
+    _assert (unlink(shard_fn) == 0);
+    _assert (rmdir(shards_path) == 0);
+    _assert (rmdir(path) == 0);
+    free(shard_fn);
+
+    siri_fh_free(siri.fh);
+    siri.fh = NULL;
+    siri.cfg = NULL;
+
+    return test_end();
+}
+
+/*
+ * Returns the start for 'name' using a list with the given group by values
+ * or -1 when all points must be read.
+ */
+static int64_t test_cursor_start(
+        ct_t * cursor,
+        const char * name,
+        siridb_aggr_t * aggrs,
+        size_t n)
+{
+    vec_t * alist = NULL;
+    uint64_t start;
+    int rc;
+    size_t i;
+
+    if (aggrs != NULL)
+    {
+        alist = vec_new(n);
+        for (i = 0; i < n; i++)
+        {
+            vec_append(alist, aggrs + i);
+        }
+    }
+
+    rc = siridb_cursor_start(cursor, name, alist, &start);
+    vec_free(alist);
+
+    return rc ? (int64_t) start : -1;
+}
+
+static int test_cursor(void)
+{
+    test_start("siridb (cursor)");
+
+    qp_packer_t * packer;
+    siridb_aggr_t aggrs[2];
+    ct_t * cursor;
+    uint64_t * ts;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+
+    /* an empty cursor starts a new cursor */
+    cursor = siridb_cursor_load(NULL, 0);
+    _assert (cursor != NULL);
+    _assert (cursor->len == 0);
+    _assert (test_cursor_start(cursor, "series", NULL, 0) == -1);
+    siridb_cursor_free(cursor);
+
+    /* invalid cursors */
+    {
+        /* not a map */
+        packer = qp_packer_new(64);
+        qp_add_int64(packer, 1);
+        _assert (siridb_cursor_load(
+                (const char *) packer->buffer, packer->len) == NULL);
+        qp_packer_free(packer);
+
+        /* timestamp is not an integer */
+        packer = qp_packer_new(64);
+        qp_add_type(packer, QP_MAP_OPEN);
+        qp_add_string(packer, "series");
+        qp_add_double(packer, 1.5);
+        _assert (siridb_cursor_load(
+                (const char *) packer->buffer, packer->len) == NULL);
+        qp_packer_free(packer);
+
+        /* negative timestamp */
+        packer = qp_packer_new(64);
+        qp_add_type(packer, QP_MAP_OPEN);
+        siridb_cursor_pack(packer, "series", 6, 1);
+        qp_add_string(packer, "other");
+        qp_add_int64(packer, -1);
+        _assert (siridb_cursor_load(
+                (const char *) packer->buffer, packer->len) == NULL);
+        qp_packer_free(packer);
+
+        /* name is not a string */
+        packer = qp_packer_new(64);
+        qp_add_type(packer, QP_MAP_OPEN);
+        qp_add_int64(packer, 1);
+        qp_add_int64(packer, 1);
+        _assert (siridb_cursor_load(
+                (const char *) packer->buffer, packer->len) == NULL);
+        qp_packer_free(packer);
+
+        /* raw data which is not qpack */
+        _assert (siridb_cursor_load("cursor", 6) == NULL);
+    }
+
+    /* a packed cursor is loaded with the last timestamp for each name */
+    packer = qp_packer_new(64);
+    qp_add_type(packer, QP_MAP_OPEN);
+    _assert (siridb_cursor_pack(packer, "series", 6, 25) == 0);
+    _assert (siridb_cursor_pack(packer, "zero", 4, 0) == 0);
+    _assert (siridb_cursor_pack(packer, "series", 6, 99) == 0);
+    cursor = siridb_cursor_load((const char *) packer->buffer, packer->len);
+    qp_packer_free(packer);
+
+    _assert (cursor != NULL);
+    _assert (cursor->len == 2);
+    ts = ct_get(cursor, "series");
+    _assert (ts != NULL && *ts == 25);  /* duplicated names are ignored */
+    _assert (test_cursor_start(cursor, "other", NULL, 0) == -1);
+
+    /* without aggregation, points after the last timestamp are read */
+    _assert (test_cursor_start(cursor, "series", NULL, 0) == 26);
+    _assert (test_cursor_start(cursor, "zero", NULL, 0) == 1);
+    _assert (test_cursor_start(cursor, "series", aggrs, 0) == 26);
+
+    memset(aggrs, 0, sizeof(aggrs));
+
+    /* aggregation without group by */
+    _assert (test_cursor_start(cursor, "series", aggrs, 1) == -1);
+
+    /* the last group is computed again */
+    aggrs[0].group_by = 10;
+    _assert (test_cursor_start(cursor, "series", aggrs, 1) == 21);
+    _assert (test_cursor_start(cursor, "zero", aggrs, 1) == 0);
+
+    /* aligned groups start with the largest group */
+    aggrs[1].group_by = 20;
+    _assert (test_cursor_start(cursor, "series", aggrs, 2) == 21);
+    aggrs[1].group_by = 5;
+    _assert (test_cursor_start(cursor, "series", aggrs, 2) == 21);
+    aggrs[0].group_by = 4;
+    aggrs[1].group_by = 8;
+    _assert (test_cursor_start(cursor, "series", aggrs, 2) == 25);
+
+    /* misaligned groups */
+    aggrs[0].group_by = 10;
+    aggrs[1].group_by = 15;
+    _assert (test_cursor_start(cursor, "series", aggrs, 2) == -1);
+    aggrs[1].group_by = 0;
+    _assert (test_cursor_start(cursor, "series", aggrs, 2) == -1);
+
+    /* limit() and offset are not incremental */
+    aggrs[1].group_by = 20;
+    aggrs[1].limit = 5;
+    _assert (test_cursor_start(cursor, "series", aggrs, 2) == -1);
+    aggrs[1].limit = 0;
+    aggrs[1].offset = 5;
+    _assert (test_cursor_start(cursor, "series", aggrs, 2) == -1);
+    aggrs[1].offset = 0;
+    _assert (test_cursor_start(cursor, "series", aggrs, 2) == 21);
+
+    siridb_cursor_free(cursor);
+
+    return test_end();
+}
+
+static void test_subscriptions_on_data(
+        sirinet_stream_t * client __attribute__((unused)),
+        sirinet_pkg_t * pkg __attribute__((unused)))
+{
+}
+
+static int test_subscriptions_subscribe(
+        siridb_t * siridb,
+        sirinet_stream_t * client,
+        siridb_subscription_tp tp,
+        const char * expr,
+        char * err_msg)
+{
+    *err_msg = '\0';
+    return siridb_subscriptions_subscribe(
+            siridb, client, tp, expr, strlen(expr), 0.0, err_msg);
+}
+
+static int test_subscriptions(void)
+{
+    test_start("siridb (subscriptions)");
+
+    char err_msg[SIRIDB_MAX_SIZE_ERR_MSG];
+    char buf[512];
+    siri_cfg_t cfg;
+    siridb_t siridb;
+    siridb_tags_t tags;
+    siridb_tag_t tag, other;
+    siridb_subscriptions_t * subscriptions;
+    siridb_series_t * cpu, * mem, * disk, * mouse;
+    sirinet_stream_t clients[9];
+    sirinet_pkg_t * pkg;
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_obj;
+    qp_obj_t val;
+    uv_loop_t loop;
+    uv_pipe_t pipe;
+    int fds[2];
+    ssize_t n;
+    size_t i, j;
+    int id, sid, tid;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+    memset(&cfg, 0, sizeof(siri_cfg_t));
+    memset(&siridb, 0, sizeof(siridb_t));
+    memset(&tags, 0, sizeof(siridb_tags_t));
+    memset(&tag, 0, sizeof(siridb_tag_t));
+    memset(&other, 0, sizeof(siridb_tag_t));
+    memset(clients, 0, sizeof(clients));
+    siri.cfg = &cfg;
+
+    siridb.series_map = imap_new();
+    siridb.subscriptions = subscriptions = siridb_subscriptions_new();
+    siridb.tags = &tags;
+    uv_mutex_init(&siridb.series_mutex);
+    uv_mutex_init(&tags.mutex);
+
+    cpu = test_series_new(&siridb, 1, "cpu", TP_INT);
+    mem = test_series_new(&siridb, 2, "mem", TP_INT);
+    disk = test_series_new(&siridb, 3, "disk", TP_INT);
+    imap_add(siridb.series_map, cpu->id, cpu);
+    imap_add(siridb.series_map, mem->id, mem);
+    imap_add(siridb.series_map, disk->id, disk);
+
+    /* tag 't' contains series disk */
+    tags.tags = ct_new();
+    tag.id = 1;
+    tag.name = "t";
+    tag.series = imap_new();
+    imap_add(tag.series, disk->id, disk);
+    ct_add(tags.tags, tag.name, &tag);
+    other.id = 2;
+
+    for (i = 0; i < 9; i++)
+    {
+        clients[i].ref = 1;
+        clients[i].on_data = test_subscriptions_on_data;
+    }
+
+    /* subscriptions set the bits of matching series */
+    sid = test_subscriptions_subscribe(
+            &siridb, clients, SUBSCRIPTION_SERIES, "cpu", err_msg);
+    _assert (sid == 0);
+    id = test_subscriptions_subscribe(
+            &siridb, clients, SUBSCRIPTION_REGEX, "/m.*/", err_msg);
+    _assert (id == 1);
+    tid = test_subscriptions_subscribe(
+            &siridb, clients, SUBSCRIPTION_TAG, "t", err_msg);
+    _assert (tid == 2);
+    _assert (subscriptions->used == 7);
+    _assert (cpu->subs == 1 && mem->subs == 2 && disk->subs == 4);
+
+    /* invalid subscriptions do not take an id */
+    _assert (test_subscriptions_subscribe(
+            &siridb, clients, SUBSCRIPTION_TAG, "x", err_msg) == -1);
+    _assert (strstr(err_msg, "Cannot find tag") != NULL);
+    _assert (test_subscriptions_subscribe(
+            &siridb, clients, SUBSCRIPTION_REGEX, "/(/", err_msg) == -1);
+    _assert (*err_msg);
+    _assert (subscriptions->used == 7);
+
+    /* a new series gets the bits for name and regex subscriptions only */
+    mouse = test_series_new(&siridb, 4, "mouse", TP_INT);
+    mouse->subs = siridb_subscriptions_match(subscriptions, mouse);
+    _assert (mouse->subs == 2);
+    imap_add(siridb.series_map, mouse->id, mouse);
+
+    /* tag and untag only change the bits for subscriptions on the tag */
+    siridb_subscriptions_tag(subscriptions, &tag, cpu);
+    _assert (cpu->subs == (1 | 4));
+    siridb_subscriptions_tag(subscriptions, &other, mem);
+    _assert (mem->subs == 2);
+    siridb_subscriptions_untag(subscriptions, &other, cpu);
+    _assert (cpu->subs == (1 | 4));
+    siridb_subscriptions_untag(subscriptions, &tag, cpu);
+    _assert (cpu->subs == 1);
+    siridb_subscriptions_untag(subscriptions, &tag, mem);
+    _assert (mem->subs == 2);
+
+    /* a single client can use at most SIRIDB_SUBSCRIPTIONS_MAX_CLIENT */
+    for (i = 3; i < SIRIDB_SUBSCRIPTIONS_MAX_CLIENT; i++)
+    {
+        _assert (test_subscriptions_subscribe(
+                &siridb, clients, SUBSCRIPTION_SERIES, "x", err_msg) ==
+                        (int) i);
+    }
+    _assert (test_subscriptions_subscribe(
+            &siridb, clients, SUBSCRIPTION_SERIES, "x", err_msg) == -1);
+    _assert (strstr(err_msg, "for a client") != NULL);
+
+    /* the other clients take the remaining subscriptions */
+    for (i = 1; i < 8; i++)
+    {
+        for (j = 0; j < SIRIDB_SUBSCRIPTIONS_MAX_CLIENT; j++)
+        {
+            _assert (test_subscriptions_subscribe(
+                    &siridb,
+                    clients + i,
+                    SUBSCRIPTION_REGEX,
+                    "/c.*/",
+                    err_msg) != -1);
+        }
+    }
+    _assert (subscriptions->used == UINT64_MAX);
+    _assert (test_subscriptions_subscribe(
+            &siridb, clients + 8, SUBSCRIPTION_SERIES, "x", err_msg) == -1);
+    _assert (strstr(err_msg, "Maximum number of subscriptions reached"));
+    _assert (cpu->subs == (UINT64_MAX & ~0xffULL) + 1);
+
+    /* only the owner can unsubscribe */
+    _assert (siridb_subscriptions_unsubscribe(&siridb, clients + 1, sid));
+    _assert (siridb_subscriptions_unsubscribe(
+            &siridb, clients, SIRIDB_SUBSCRIPTIONS_MAX));
+    _assert (siridb_subscriptions_unsubscribe(&siridb, clients, sid) == 0);
+    _assert (!(subscriptions->used & 1) && subscriptions->subs[0] == NULL);
+    _assert (cpu->subs == (UINT64_MAX & ~0xffULL));
+
+    /* closing a client clears the bits of all its subscriptions */
+    for (i = 1; i < 8; i++)
+    {
+        siridb_subscriptions_drop_client(&siridb, clients + i);
+    }
+    _assert (subscriptions->used == 0xfe);
+    _assert (cpu->subs == 0);
+    _assert (mouse->subs == 2);
+
+    /* a dropped tag clears the bits but the subscription stays */
+    siridb_subscriptions_drop_tag(&siridb, "t");
+    _assert (disk->subs == 0);
+    _assert (subscriptions->used == 0xfe);
+
+    siridb_subscriptions_drop_client(&siridb, clients);
+    _assert (subscriptions->used == 0);
+    _assert (mem->subs == 0 && mouse->subs == 0);
+
+    /* points for a full client are counted and pushed with the next points */
+    _assert (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    uv_loop_init(&loop);
+    uv_pipe_init(&loop, &pipe, 0);
+    _assert (uv_pipe_open(&pipe, fds[0]) == 0);
+    clients[8].tp = STREAM_PIPE_CLIENT;
+    clients[8].stream = (uv_stream_t *) &pipe;
+
+    sid = test_subscriptions_subscribe(
+            &siridb, clients + 8, SUBSCRIPTION_SERIES, "cpu", err_msg);
+    _assert (sid == 0 && cpu->subs == 1);
+
+    val.via.int64 = 42;
+    pipe.write_queue_size = SIRIDB_SUBSCRIPTIONS_MAX_QUEUE + 1;
+    siridb_subscriptions_point(subscriptions, cpu, 1, &val);
+    siridb_subscriptions_point(subscriptions, cpu, 2, &val);
+    siridb_subscriptions_point(subscriptions, mem, 3, &val);
+    _assert (subscriptions->subs[sid]->dropped == 2);
+    _assert (subscriptions->pending == 1);
+    _assert (subscriptions->subs[sid]->packer == NULL);
+
+    /* nothing is pushed while the client is full */
+    siridb_subscriptions_flush(subscriptions);
+    _assert (subscriptions->pending == 0);
+    _assert (subscriptions->subs[sid]->dropped == 2);
+    siridb_subscriptions_point(subscriptions, cpu, 3, &val);
+    _assert (subscriptions->subs[sid]->dropped == 3);
+    siridb_subscriptions_flush(subscriptions);
+
+    pipe.write_queue_size = 0;
+    siridb_subscriptions_point(subscriptions, cpu, 4, &val);
+    _assert (subscriptions->subs[sid]->packer != NULL);
+    siridb_subscriptions_flush(subscriptions);
+    _assert (subscriptions->subs[sid]->dropped == 0);
+    _assert (subscriptions->subs[sid]->packer == NULL);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    _assert (clients[8].ref == 1);
+
+    /* {"cpu": [[4, 42]], "__dropped__": 3} */
+    n = read(fds[1], buf, sizeof(buf));
+    pkg = (sirinet_pkg_t *) buf;
+    _assert (n > (ssize_t) sizeof(sirinet_pkg_t));
+    _assert (pkg->pid == sid && pkg->tp == CPROTO_PUSH_POINTS);
+    _assert (n == (ssize_t) (sizeof(sirinet_pkg_t) + pkg->len));
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+    _assert (qp_is_map(qp_next(&unpacker, NULL)));
+    _assert (qp_next(&unpacker, &qp_obj) == QP_RAW);
+    _assert (qp_obj.len == 3 && memcmp(qp_obj.via.raw, "cpu", 3) == 0);
+    _assert (qp_is_array(qp_next(&unpacker, NULL)));
+    _assert (qp_is_array(qp_next(&unpacker, NULL)));
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64);
+    _assert (qp_obj.via.int64 == 4);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64);
+    _assert (qp_obj.via.int64 == 42);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_RAW);
+    _assert (qp_obj.len == SIRIDB_SUBSCRIPTIONS_DROPPED_KEY_LEN);
+    _assert (memcmp(
+            qp_obj.via.raw,
+            SIRIDB_SUBSCRIPTIONS_DROPPED_KEY,
+            SIRIDB_SUBSCRIPTIONS_DROPPED_KEY_LEN) == 0);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64);
+    _assert (qp_obj.via.int64 == 3);
+    _assert (qp_next(&unpacker, NULL) == QP_END);
+
+    /* a closing client drops the points */
+    clients[8].on_data = NULL;
+    siridb_subscriptions_point(subscriptions, cpu, 5, &val);
+    _assert (subscriptions->subs[sid]->dropped == 1);
+    siridb_subscriptions_drop_client(&siridb, clients + 8);
+    _assert (subscriptions->used == 0 && cpu->subs == 0);
+
+    uv_close((uv_handle_t *) &pipe, NULL);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    uv_loop_close(&loop);
+    close(fds[1]);
+
+    /* clean up */
+    siridb_subscriptions_free(subscriptions);
+    ct_free(tags.tags, NULL);
+    imap_free(tag.series, NULL);
+    imap_free(siridb.series_map, (imap_free_cb) test_series_free);
+    uv_mutex_destroy(&siridb.series_mutex);
+    uv_mutex_destroy(&tags.mutex);
+    siri.cfg = NULL;
+
+    return test_end();
+}
+
+/*
+ * Returns an insert package with points for series a (integer), b (float),
+ * c (string) and x. Series x is not on this pool.
+ */
+static sirinet_pkg_t * test_tee_pkg(void)
+{
+    qp_packer_t * packer = sirinet_packer_new(256);
+
+    qp_add_type(packer, QP_MAP_OPEN);
+
+    qp_add_raw(packer, (const unsigned char *) "a", 2);
+    qp_add_type(packer, QP_ARRAY_OPEN);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 1);
+    qp_add_int64(packer, 10);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 2);
+    qp_add_int64(packer, 20);
+    qp_add_type(packer, QP_ARRAY_CLOSE);
+
+    qp_add_raw(packer, (const unsigned char *) "b", 2);
+    qp_add_type(packer, QP_ARRAY1);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 1);
+    qp_add_double(packer, 1.5);
+
+    qp_add_raw(packer, (const unsigned char *) "c", 2);
+    qp_add_type(packer, QP_ARRAY1);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 3);
+    qp_add_raw(packer, (const unsigned char *) "str", 3);
+
+    qp_add_raw(packer, (const unsigned char *) "x", 2);
+    qp_add_type(packer, QP_ARRAY1);
+    qp_add_type(packer, QP_ARRAY2);
+    qp_add_int64(packer, 4);
+    qp_add_int64(packer, 40);
+
+    return sirinet_packer2pkg(packer, 7, CPROTO_REQ_INSERT);
+}
+
+/*
+ * Write a package to the tee and read the result into 'buf'.
+ *
+ * Returns the number of bytes written to the tee or -1 when nothing is
+ * written.
+ */
+static ssize_t test_tee_write(
+        siridb_tee_t * tee,
+        siridb_t * siridb,
+        sirinet_pkg_t * pkg,
+        int fd,
+        char * buf,
+        size_t size)
+{
+    sirinet_promise_t promise;
+
+    memset(&promise, 0, sizeof(sirinet_promise_t));
+    promise.pkg = pkg;
+
+    siridb_tee_write(tee, siridb, &promise);
+    uv_run(tee->pipe.loop, UV_RUN_DEFAULT);
+
+    return read(fd, buf, size);
+}
+
+/*
+ * Returns the series names in a package from the tee as a string.
+ */
+static char * test_tee_names(char * buf, char * names)
+{
+    sirinet_pkg_t * pkg = (sirinet_pkg_t *) buf;
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_name;
+    char * pt = names;
+
+    qp_unpacker_init(&unpacker, pkg->data, pkg->len);
+    if (qp_is_map(qp_next(&unpacker, NULL)))
+    {
+        while (qp_next(&unpacker, &qp_name) == QP_RAW)
+        {
+            *pt++ = *qp_name.via.raw;
+            qp_skip_next(&unpacker);
+        }
+    }
+    *pt = '\0';
+    return names;
+}
+
+static int test_tee(void)
+{
+    test_start("siridb (tee)");
+
+    char err_msg[SIRIDB_MAX_SIZE_ERR_MSG];
+    char buf[512], names[8];
+    siri_cfg_t cfg;
+    siridb_t siridb;
+    siridb_tags_t tags;
+    siridb_tag_t tag;
+    siridb_tee_t * tee;
+    siridb_series_t * a, * b, * c;
+    sirinet_pkg_t * pkg, * tee_pkg;
+    qp_unpacker_t unpacker;
+    qp_obj_t qp_obj;
+    uv_loop_t loop;
+    uint8_t cached = SIRIDB_SERIES_TEE_CHECKED | SIRIDB_SERIES_TEE_MATCH;
+    int fds[2];
+    ssize_t n;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+    memset(&cfg, 0, sizeof(siri_cfg_t));
+    memset(&siridb, 0, sizeof(siridb_t));
+    memset(&tags, 0, sizeof(siridb_tags_t));
+    memset(&tag, 0, sizeof(siridb_tag_t));
+    siri.cfg = &cfg;
+
+    siridb.series = ct_new();
+    siridb.series_map = imap_new();
+    siridb.tags = &tags;
+    uv_mutex_init(&siridb.series_mutex);
+    uv_mutex_init(&tags.mutex);
+
+    a = test_series_new(&siridb, 1, "a", TP_INT);
+    b = test_series_new(&siridb, 2, "b", TP_DOUBLE);
+    c = test_series_new(&siridb, 3, "c", TP_STRING);
+    ct_add(siridb.series, a->name, a);
+    ct_add(siridb.series, b->name, b);
+    ct_add(siridb.series, c->name, c);
+    imap_add(siridb.series_map, a->id, a);
+    imap_add(siridb.series_map, b->id, b);
+    imap_add(siridb.series_map, c->id, c);
+
+    /* tag 't' contains series b */
+    tags.tags = ct_new();
+    tag.id = 1;
+    tag.name = "t";
+    tag.series = imap_new();
+    imap_add(tag.series, b->id, b);
+    ct_add(tags.tags, tag.name, &tag);
+
+    /* the tee writes to a socket pair */
+    _assert (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    _assert (fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+    uv_loop_init(&loop);
+    tee = siridb_tee_new();
+    uv_pipe_init(&loop, &tee->pipe, 0);
+    tee->pipe.data = tee;
+    _assert (uv_pipe_open(&tee->pipe, fds[0]) == 0);
+
+    pkg = test_tee_pkg();
+    tee_pkg = (sirinet_pkg_t *) buf;
+
+    /* columnar format without a filter */
+    _assert (siridb_tee_set_filter(
+            tee,
+            &siridb,
+            SIRIDB_TEE_FILTER_NONE,
+            NULL,
+            SIRIDB_TEE_FORMAT_COLUMNAR,
+            err_msg) == 0);
+    n = test_tee_write(tee, &siridb, pkg, fds[1], buf, sizeof(buf));
+    _assert (n == (ssize_t) (sizeof(sirinet_pkg_t) + tee_pkg->len));
+    _assert (tee_pkg->pid == 7 && tee_pkg->tp == CPROTO_TEE_COLUMNAR);
+    _assert (tee_pkg->checkbit == (CPROTO_TEE_COLUMNAR ^ 255));
+
+    /* {"a": [[1, 2], [10, 20]], "b": [[1], [1.5]], "c": [[3], ["str"]],
+     *  "x": [[4], [40]]} */
+    qp_unpacker_init(&unpacker, tee_pkg->data, tee_pkg->len);
+    _assert (qp_is_map(qp_next(&unpacker, NULL)));
+    _assert (qp_next(&unpacker, &qp_obj) == QP_RAW);
+    _assert (qp_obj.len == 1 && *qp_obj.via.raw == 'a');
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY2);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64 && qp_obj.via.int64 == 1);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64 && qp_obj.via.int64 == 2);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64);
+    _assert (qp_obj.via.int64 == 10);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64);
+    _assert (qp_obj.via.int64 == 20);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+
+    _assert (qp_next(&unpacker, &qp_obj) == QP_RAW);
+    _assert (qp_obj.len == 1 && *qp_obj.via.raw == 'b');
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY2);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64 && qp_obj.via.int64 == 1);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_DOUBLE);
+    _assert (qp_obj.via.real == 1.5);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+
+    _assert (qp_next(&unpacker, &qp_obj) == QP_RAW);
+    _assert (qp_obj.len == 1 && *qp_obj.via.raw == 'c');
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY2);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64 && qp_obj.via.int64 == 3);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_RAW);
+    _assert (qp_obj.len == 3 && memcmp(qp_obj.via.raw, "str", 3) == 0);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+
+    _assert (qp_next(&unpacker, &qp_obj) == QP_RAW);
+    _assert (qp_obj.len == 1 && *qp_obj.via.raw == 'x');
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY2);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64 && qp_obj.via.int64 == 4);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+    _assert (qp_next(&unpacker, &qp_obj) == QP_INT64);
+    _assert (qp_obj.via.int64 == 40);
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_CLOSE);
+    _assert (qp_next(&unpacker, NULL) == QP_END);
+
+    /* without a filter, nothing is cached */
+    _assert (!(a->flags & cached) && !(b->flags & cached));
+
+    /* regular expression filter using the insert format */
+    _assert (siridb_tee_set_filter(
+            tee,
+            &siridb,
+            SIRIDB_TEE_FILTER_REGEX,
+            "/[abx]/",
+            SIRIDB_TEE_FORMAT_INSERT,
+            err_msg) == 0);
+    n = test_tee_write(tee, &siridb, pkg, fds[1], buf, sizeof(buf));
+    _assert (n > 0 && tee_pkg->tp == CPROTO_REQ_INSERT);
+    _assert (strcmp(test_tee_names(buf, names), "abx") == 0);
+    _assert ((a->flags & cached) == cached);
+    _assert ((b->flags & cached) == cached);
+    _assert ((c->flags & cached) == SIRIDB_SERIES_TEE_CHECKED);
+
+    /* series names keep the terminator and points are copied */
+    qp_unpacker_init(&unpacker, tee_pkg->data, tee_pkg->len);
+    _assert (qp_is_map(qp_next(&unpacker, NULL)));
+    _assert (qp_next(&unpacker, &qp_obj) == QP_RAW);
+    _assert (qp_obj.len == 2 && qp_is_raw_term(&qp_obj));
+    _assert (qp_next(&unpacker, NULL) == QP_ARRAY_OPEN);
+
+    /* the cached result is used */
+    c->flags |= SIRIDB_SERIES_TEE_MATCH;
+    n = test_tee_write(tee, &siridb, pkg, fds[1], buf, sizeof(buf));
+    _assert (strcmp(test_tee_names(buf, names), "abcx") == 0);
+
+    /* an invalid filter is rejected and does not change the filter */
+    _assert (siridb_tee_set_filter(
+            tee,
+            &siridb,
+            SIRIDB_TEE_FILTER_GROUP + 1,
+            "t",
+            SIRIDB_TEE_FORMAT_INSERT,
+            err_msg) == -1);
+    _assert (siridb_tee_set_filter(
+            tee,
+            &siridb,
+            SIRIDB_TEE_FILTER_TAG,
+            NULL,
+            SIRIDB_TEE_FORMAT_INSERT,
+            err_msg) == -1);
+    _assert (tee->filter_tp_ == SIRIDB_TEE_FILTER_REGEX);
+    _assert ((c->flags & cached) == cached);
+
+    /* a new filter clears the cached results */
+    _assert (siridb_tee_set_filter(
+            tee,
+            &siridb,
+            SIRIDB_TEE_FILTER_TAG,
+            "t",
+            SIRIDB_TEE_FORMAT_INSERT,
+            err_msg) == 0);
+    _assert (!(a->flags & cached));
+    _assert (!(b->flags & cached));
+    _assert (!(c->flags & cached));
+
+    /* only tagged series on this pool are written */
+    n = test_tee_write(tee, &siridb, pkg, fds[1], buf, sizeof(buf));
+    _assert (strcmp(test_tee_names(buf, names), "b") == 0);
+    _assert ((a->flags & cached) == SIRIDB_SERIES_TEE_CHECKED);
+    _assert ((b->flags & cached) == cached);
+
+    /* tag and untag clear the cached results */
+    imap_add(tag.series, a->id, a);
+    siridb_tee_forget(tee, &siridb, a);
+    _assert (!(a->flags & SIRIDB_SERIES_TEE_CHECKED));
+    (void) imap_pop(tag.series, b->id);
+    siridb_tee_forget(tee, &siridb, b);
+    _assert (!(b->flags & SIRIDB_SERIES_TEE_CHECKED));
+    n = test_tee_write(tee, &siridb, pkg, fds[1], buf, sizeof(buf));
+    _assert (strcmp(test_tee_names(buf, names), "a") == 0);
+    _assert ((a->flags & cached) == cached);
+
+    /* dropping another tag keeps the cached results */
+    siridb_tee_drop_tag(tee, &siridb, "other");
+    _assert ((a->flags & cached) == cached);
+
+    /* dropping the tag clears the cached results */
+    (void) ct_pop(tags.tags, tag.name);
+    siridb_tee_drop_tag(tee, &siridb, "t");
+    _assert (!(a->flags & cached));
+    _assert (!(b->flags & cached));
+    _assert (!(c->flags & cached));
+
+    /* nothing is written when no series are matching */
+    n = test_tee_write(tee, &siridb, pkg, fds[1], buf, sizeof(buf));
+    _assert (n == -1);
+    _assert ((a->flags & cached) == SIRIDB_SERIES_TEE_CHECKED);
+
+    /* clean up */
+    free(pkg);
+    uv_close((uv_handle_t *) &tee->pipe, NULL);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    uv_loop_close(&loop);
+    close(fds[1]);
+    siridb_tee_free(tee);
+
+    ct_free(tags.tags, NULL);
+    imap_free(tag.series, NULL);
+    ct_free(siridb.series, NULL);
+    imap_free(siridb.series_map, (imap_free_cb) test_series_free);
+    uv_mutex_destroy(&siridb.series_mutex);
+    uv_mutex_destroy(&tags.mutex);
+    siri.cfg = NULL;
+
+    return test_end();
+}
+
+/*
+ * Returns 0 when the heap contains the candidate with the given score and
+ * the worst candidate is first.
+ */
+static int test_topk_has(siridb_topk_t * topk, const char * name, double score)
+{
+    size_t i;
+    int rc = -1;
+
+    for (i = 0; i < topk->len; i++)
+    {
+        if (topk->bottom
+                ? topk->items[i].score > topk->items->score
+                : topk->items[i].score < topk->items->score)
+        {
+            return -1;
+        }
+        if (strcmp(topk->items[i].name, name) == 0)
+        {
+            rc = (topk->items[i].score == score) ? 0 : -1;
+        }
+    }
+    return rc;
+}
+
+/*
+ * Returns 0 when each item in the heap is not worse than its parent.
+ */
+static int test_topk_heap(siridb_topk_t * topk)
+{
+    size_t i;
+
+    for (i = 1; i < topk->len; i++)
+    {
+        if (topk->bottom
+                ? topk->items[i].score > topk->items[(i - 1) / 2].score
+                : topk->items[i].score < topk->items[(i - 1) / 2].score)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int test_topk(void)
+{
+    test_start("siridb (topk)");
+
+    const char * names[6] = {"a", "b", "c", "d", "e", "f"};
+    double scores[6] = {5.0, 1.0, 9.0, 3.0, 7.0, NAN};
+    const char * cropped[4] = {"x.a", "a.y", "x.c", "c.y"};
+    char name[16];
+    siridb_topk_t * topk, * pool;
+    siridb_presuf_t presuf[2];
+    qp_packer_t * packer;
+    qp_unpacker_t unpacker;
+    ct_t * result;
+    size_t i;
+
+    logger_init(stderr, LOGGER_CRITICAL);
+
+    /* top keeps the highest scores, not a number is ignored */
+    topk = siridb_topk_new(CLERI_GID_K_MAX, 3, 0);
+    for (i = 0; i < 6; i++)
+    {
+        _assert (siridb_topk_push(topk, names[i], scores[i]) == 0);
+    }
+    _assert (topk->len == 3);
+    _assert (topk->items->score == 5.0);
+    _assert (test_topk_has(topk, "c", 9.0) == 0);
+    _assert (test_topk_has(topk, "e", 7.0) == 0);
+    _assert (test_topk_has(topk, "a", 5.0) == 0);
+
+    /* a full heap replaces the worst candidate with a better one */
+    _assert (siridb_topk_push(topk, "g", 6.0) == 0);
+    _assert (topk->len == 3 && topk->items->score == 6.0);
+    _assert (test_topk_has(topk, "a", 5.0) == -1);
+    _assert (test_topk_has(topk, "g", 6.0) == 0);
+    _assert (siridb_topk_push(topk, "h", 6.0) == 0);
+    _assert (siridb_topk_push(topk, "i", 2.0) == 0);
+    _assert (test_topk_has(topk, "h", 6.0) == -1);
+    _assert (test_topk_has(topk, "i", 2.0) == -1);
+    siridb_topk_free(topk);
+
+    /* bottom keeps the lowest scores */
+    topk = siridb_topk_new(CLERI_GID_K_MAX, 3, 1);
+    for (i = 0; i < 6; i++)
+    {
+        _assert (siridb_topk_push(topk, names[i], scores[i]) == 0);
+    }
+    _assert (topk->len == 3);
+    _assert (topk->items->score == 5.0);
+    _assert (test_topk_has(topk, "b", 1.0) == 0);
+    _assert (test_topk_has(topk, "d", 3.0) == 0);
+    _assert (test_topk_has(topk, "a", 5.0) == 0);
+    _assert (siridb_topk_push(topk, "g", 2.0) == 0);
+    _assert (topk->items->score == 3.0);
+    _assert (test_topk_has(topk, "g", 2.0) == 0);
+    _assert (siridb_topk_push(topk, "h", NAN) == 0);
+    _assert (topk->len == 3);
+    siridb_topk_free(topk);
+
+    /* the heap grows past the initial size up to k */
+    topk = siridb_topk_new(CLERI_GID_K_MAX, 200, 0);
+    _assert (topk->size == 64);
+    for (i = 0; i < 150; i++)
+    {
+        sprintf(name, "s%zu", i);
+        _assert (siridb_topk_push(topk, name, (double) ((i * 37) % 150)) == 0);
+    }
+    _assert (topk->len == 150 && topk->size == 200);
+    _assert (topk->items->score == 0.0);
+    _assert (test_topk_heap(topk) == 0);
+    for (i = 150; i < 210; i++)
+    {
+        sprintf(name, "s%zu", i);
+        _assert (siridb_topk_push(topk, name, (double) i) == 0);
+    }
+    _assert (topk->len == 200 && topk->size == 200);
+    _assert (topk->items->score == 10.0);
+    _assert (test_topk_heap(topk) == 0);
+    siridb_topk_free(topk);
+
+    /* candidates from two pools are merged */
+    topk = siridb_topk_new(CLERI_GID_K_MAX, 3, 0);
+    packer = qp_packer_new(256);
+    qp_add_type(packer, QP_MAP_OPEN);
+
+    pool = siridb_topk_new(CLERI_GID_K_MAX, 3, 0);
+    for (i = 0; i < 3; i++)
+    {
+        _assert (siridb_topk_push(pool, names[i], scores[i]) == 0);
+    }
+    _assert (siridb_topk_pack(pool, packer) == 0);
+    siridb_topk_free(pool);
+
+    qp_unpacker_init(&unpacker, packer->buffer, packer->len);
+    _assert (qp_is_map(qp_next(&unpacker, NULL)));
+    _assert (siridb_topk_unpack(topk, &unpacker) == 0);
+    _assert (topk->len == 3);
+    qp_packer_free(packer);
+
+    packer = qp_packer_new(256);
+    pool = siridb_topk_new(CLERI_GID_K_MAX, 3, 0);
+    for (i = 3; i < 6; i++)
+    {
+        _assert (siridb_topk_push(pool, names[i], scores[i]) == 0);
+    }
+    _assert (siridb_topk_pack(pool, packer) == 0);
+    siridb_topk_free(pool);
+
+    qp_unpacker_init(&unpacker, packer->buffer, packer->len);
+    _assert (siridb_topk_unpack(topk, &unpacker) == 0);
+    _assert (topk->len == 3);
+    _assert (test_topk_has(topk, "c", 9.0) == 0);
+    _assert (test_topk_has(topk, "e", 7.0) == 0);
+    _assert (test_topk_has(topk, "a", 5.0) == 0);
+
+    /* only candidates packed with the key are accepted */
+    qp_unpacker_init(&unpacker, packer->buffer + 1, packer->len - 1);
+    _assert (siridb_topk_unpack(topk, &unpacker) == -1);
+    qp_packer_free(packer);
+
+    /* crop keeps the names for the candidates with each prefix/suffix */
+    memset(presuf, 0, sizeof(presuf));
+    presuf[0].suffix = ".y";
+    presuf[0].len = 3;
+    presuf[1].prefix = "x.";
+    presuf[1].len = 3;
+    presuf[1].prev = presuf;
+
+    result = ct_new();
+    ct_add(result, "x.a", siridb_points_new(1, TP_INT));
+    ct_add(result, "a.y", siridb_points_new(1, TP_INT));
+    ct_add(result, "x.b", siridb_points_new(1, TP_INT));
+    ct_add(result, "b.y", siridb_points_new(1, TP_INT));
+    ct_add(result, "c.y", siridb_points_new(1, TP_INT));
+    ct_add(result, "c", siridb_points_new(1, TP_INT));
+
+    _assert (siridb_topk_crop(topk, &result, presuf + 1) == 0);
+    _assert (result->len == 3);
+    for (i = 0; i < 4; i++)
+    {
+        _assert ((ct_get(result, cropped[i]) != NULL) == (i != 2));
+    }
+
+    ct_free(result, (ct_free_cb) siridb_points_free);
+    siridb_topk_free(topk);
+
+    return test_end();
+}
+
 int main()
 {
     return (
         test_series_ensure_type() ||
+        test_batch_count() ||
+        test_batch_split() ||
+        test_buffer_map() ||
+        test_scan() ||
+        test_shards_size() ||
+        test_promises_each() ||
+        test_buffer_flush() ||
+        test_shard_optimize() ||
+        test_share() ||
+        test_cursor() ||
+        test_subscriptions() ||
+        test_tee() ||
+        test_topk() ||
         0
     );
 };
\ No newline at end of file